@@ -1,42 +1,342 @@
 #include "http_router.h"
-#include <spdlog/spdlog.h>
+#include "rpc_log.h"
+#include <algorithm>
+#include <limits>
 
 namespace cyfon_rpc {
 
+    namespace {
+        // 读者槽位独占一条缓存行, 读者进出临界区只写自己的槽位
+        struct alignas(64) ReaderSlot {
+            std::atomic<uint64_t> epoch{0};     // 0 表示不在临界区
+            std::atomic<bool> claimed{false};
+        };
+
+        constexpr size_t kMaxReaderSlots = 256;
+
+        std::atomic<uint64_t> g_epoch{1};
+        ReaderSlot g_reader_slots[kMaxReaderSlots];
+        // 槽位用完的线程退化为共享计数, 计数非零时写者不释放任何快照, 只是推迟回收
+        std::atomic<uint32_t> g_overflow_readers{0};
+
+        // 线程首次读路由时认领槽位, 线程退出时归还
+        struct ReaderRegistration {
+            ReaderSlot* slot = nullptr;
+            uint32_t depth = 0;
+
+            ReaderRegistration() {
+                for (auto& candidate : g_reader_slots) {
+                    bool expected = false;
+                    if (!candidate.claimed.load(std::memory_order_relaxed) &&
+                        candidate.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                        slot = &candidate;
+                        return;
+                    }
+                }
+            }
+
+            ~ReaderRegistration() {
+                if (slot) {
+                    slot->epoch.store(0, std::memory_order_release);
+                    slot->claimed.store(false, std::memory_order_release);
+                }
+            }
+
+            void enter() {
+                if (depth++ > 0) {
+                    return;
+                }
+                if (slot) {
+                    slot->epoch.store(g_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+                }
+                else {
+                    g_overflow_readers.fetch_add(1, std::memory_order_relaxed);
+                }
+                // 与写者发布后的 fence 配对: 要么写者扫描时看到本槽位, 要么本线程随后读到新快照
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+
+            void leave() {
+                if (--depth > 0) {
+                    return;
+                }
+                if (slot) {
+                    slot->epoch.store(0, std::memory_order_release);
+                }
+                else {
+                    g_overflow_readers.fetch_sub(1, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local ReaderRegistration t_reader;
+
+        // 活跃读者中最小的纪元, 没有读者时返回最大值
+        uint64_t minActiveEpoch() {
+            if (g_overflow_readers.load(std::memory_order_acquire) != 0) {
+                return 0;
+            }
+            uint64_t min_epoch = std::numeric_limits<uint64_t>::max();
+            for (const auto& slot : g_reader_slots) {
+                uint64_t epoch = slot.epoch.load(std::memory_order_acquire);
+                if (epoch != 0 && epoch < min_epoch) {
+                    min_epoch = epoch;
+                }
+            }
+            return min_epoch;
+        }
+    }
+
+    struct HttpRouter::Node {
+        std::string prefix;                          // 压缩后的静态路径片段
+        std::string indices;                         // 每个静态子节点 prefix 的首字符, 与 children 一一对应
+        std::vector<std::unique_ptr<Node>> children; // 静态子节点
+
+        std::unique_ptr<Node> param_child;           // {name} 子节点
+        std::string param_name;
+
+        std::unique_ptr<Node> wildcard_child;        // *name 子节点
+        std::string wildcard_name;
+
+        std::optional<RouteTarget> target;
+    };
+
+    struct HttpRouter::Snapshot {
+        Node root;
+        size_t route_count = 0;
+    };
+
+    HttpRouter::ReadGuard::ReadGuard() {
+        t_reader.enter();
+    }
+
+    HttpRouter::ReadGuard::~ReadGuard() {
+        t_reader.leave();
+    }
+
+    HttpRouter::HttpRouter() : owned_(std::make_unique<Snapshot>()) {
+        current_.store(owned_.get(), std::memory_order_release);
+    }
+
+    HttpRouter::~HttpRouter() = default;
+
     void HttpRouter::registerRoute(const std::string& path,
                                    uint32_t service_id,
-                                   uint32_t method_id) {
-        std::unqiue_lock lock(mutex_);
+                                   uint32_t method_id,
+                                   const google::protobuf::Descriptor* request_type,
+                                   const google::protobuf::Descriptor* response_type) {
+        std::lock_guard lock(write_mutex_);
+
+        RouteTarget target{service_id, method_id, request_type, response_type};
 
         // 检查是否存在
-        if(routes_.count(path)) {
-            spdlog::warn("Route '{}' already exists, overwriting", path);
+        auto it = std::find_if(routes_.begin(), routes_.end(),
+            [&path](const auto& route) { return route.first == path; });
+        if (it != routes_.end()) {
+            CYFON_LOG_WARN("Route '{}' already exists, overwriting", path);
+            it->second = target;
+        }
+        else {
+            routes_.emplace_back(path, target);
         }
 
-        routes_[path] = RouteTarget{service_id, method_id};
-        spdlog::info("Registered route: {} -> ServiceID: {}, MethodID: {}", path, 
+        if (!deferred_) {
+            rebuild();
+        }
+        CYFON_LOG_INFO("Registered route: {} -> ServiceID: {}, MethodID: {}", path,
             service_id, method_id);
     }
 
-    std::optional<RouteTarget> HttpRouter::findroute(std::string_view path) const {
-        std::shared_lock lock(mutex_);
+    void HttpRouter::beginUpdate() {
+        std::lock_guard lock(write_mutex_);
+        deferred_ = true;
+    }
+
+    void HttpRouter::commit() {
+        std::lock_guard lock(write_mutex_);
+        if (!deferred_) {
+            return;
+        }
+        deferred_ = false;
+        rebuild();
+    }
 
-        auto it = routes_.find(path);
-        if(it == routes_.end()) {
+    std::optional<RouteMatch> HttpRouter::match(std::string_view path) const {
+        ReadGuard guard;
+        const Snapshot* snapshot = current_.load(std::memory_order_acquire);
+
+        RouteMatch result;
+        if (!matchNode(&snapshot->root, path, result)) {
             return std::nullopt;
         }
-        return it->second;
+        return result;
+    }
+
+    std::optional<RouteTarget> HttpRouter::findroute(std::string_view path) const {
+        auto result = match(path);
+        if (!result) {
+            return std::nullopt;
+        }
+        return result->target;
     }
 
     void HttpRouter::clear() {
-        std::unqiue_lock lock(mutex_);
+        std::lock_guard lock(write_mutex_);
 
         routes_.clear();
-        spdlog::info("Cleared all routes");
+        if (!deferred_) {
+            rebuild();
+        }
+        CYFON_LOG_INFO("Cleared all routes");
     }
 
     size_t HttpRouter::size() const {
-        std::shared_lock lock(mutex_);
-        return routes_.size();
+        ReadGuard guard;
+        return current_.load(std::memory_order_acquire)->route_count;
+    }
+
+    size_t HttpRouter::retiredSnapshots() const {
+        std::lock_guard lock(write_mutex_);
+        return retired_.size();
+    }
+
+    void HttpRouter::rebuild() {
+        auto next = std::make_unique<Snapshot>();
+        for (const auto& [pattern, target] : routes_) {
+            insert(&next->root, pattern, target);
+        }
+        next->route_count = routes_.size();
+
+        current_.store(next.get(), std::memory_order_release);
+        // 纪元在发布之后推进: 读到新纪元的读者一定能看到新快照
+        uint64_t epoch = g_epoch.fetch_add(1, std::memory_order_acq_rel);
+        retired_.push_back({ std::move(owned_), epoch });
+        owned_ = std::move(next);
+        reclaim();
+    }
+
+    void HttpRouter::reclaim() {
+        // 与读者 enter 中的 fence 配对
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t min_epoch = minActiveEpoch();
+
+        auto freeable = std::find_if(retired_.begin(), retired_.end(),
+            [min_epoch](const Retired& retired) { return retired.epoch >= min_epoch; });
+        retired_.erase(retired_.begin(), freeable);
+    }
+
+    void HttpRouter::insert(Node* node, std::string_view pattern, const RouteTarget& target) {
+        while (!pattern.empty()) {
+            if (pattern.front() == '{') {
+                // {name}: 匹配一个完整路径段
+                size_t close = pattern.find('}');
+                if (close == std::string_view::npos) {
+                    CYFON_LOG_ERROR("Malformed route pattern, missing '}}'");
+                    return;
+                }
+                std::string_view name = pattern.substr(1, close - 1);
+                if (!node->param_child) {
+                    node->param_child = std::make_unique<Node>();
+                    node->param_name = name;
+                }
+                else if (node->param_name != name) {
+                    CYFON_LOG_WARN("Route param '{}' conflicts with existing '{}', keeping the existing name",
+                        name, node->param_name);
+                }
+                node = node->param_child.get();
+                pattern.remove_prefix(close + 1);
+                continue;
+            }
+
+            if (pattern.front() == '*') {
+                // *name: 吞掉剩余路径, 必须是模式的最后一段
+                if (!node->wildcard_child) {
+                    node->wildcard_child = std::make_unique<Node>();
+                }
+                node->wildcard_name = pattern.substr(1);
+                node = node->wildcard_child.get();
+                break;
+            }
+
+            // 静态片段: 一直取到下一个参数或通配符
+            std::string_view segment = pattern.substr(0, pattern.find_first_of("{*"));
+
+            size_t index = node->indices.find(segment.front());
+            if (index == std::string::npos) {
+                auto child = std::make_unique<Node>();
+                child->prefix = segment;
+                node->indices.push_back(segment.front());
+                node->children.push_back(std::move(child));
+                node = node->children.back().get();
+                pattern.remove_prefix(segment.size());
+                continue;
+            }
+
+            Node* child = node->children[index].get();
+            auto [seg_it, prefix_it] = std::mismatch(segment.begin(), segment.end(),
+                                                     child->prefix.begin(), child->prefix.end());
+            size_t common = static_cast<size_t>(seg_it - segment.begin());
+
+            if (common < child->prefix.size()) {
+                // 公共前缀比现有子节点短: 拆分出一个中间节点
+                auto split = std::make_unique<Node>();
+                split->prefix = child->prefix.substr(0, common);
+
+                std::unique_ptr<Node> old = std::move(node->children[index]);
+                old->prefix.erase(0, common);
+                split->indices.push_back(old->prefix.front());
+                split->children.push_back(std::move(old));
+
+                node->children[index] = std::move(split);
+                child = node->children[index].get();
+            }
+
+            node = child;
+            pattern.remove_prefix(common);
+        }
+
+        node->target = target;
+    }
+
+    bool HttpRouter::matchNode(const Node* node, std::string_view path, RouteMatch& result) {
+        if (path.empty()) {
+            if (node->target) {
+                result.target = *node->target;
+                return true;
+            }
+        }
+        else {
+            // 静态子节点优先
+            size_t index = node->indices.find(path.front());
+            if (index != std::string::npos) {
+                const Node* child = node->children[index].get();
+                if (path.starts_with(child->prefix) &&
+                    matchNode(child, path.substr(child->prefix.size()), result)) {
+                    return true;
+                }
+            }
+
+            // 参数匹配一个非空路径段
+            if (node->param_child && result.param_count < RouteMatch::kMaxParams) {
+                std::string_view segment = path.substr(0, path.find('/'));
+                if (!segment.empty()) {
+                    size_t saved = result.param_count;
+                    result.params[result.param_count++] = { node->param_name, segment };
+                    if (matchNode(node->param_child.get(), path.substr(segment.size()), result)) {
+                        return true;
+                    }
+                    result.param_count = saved;
+                }
+            }
+        }
+
+        // 通配符兜底, 匹配剩余路径 (可以为空)
+        if (node->wildcard_child && node->wildcard_child->target &&
+            result.param_count < RouteMatch::kMaxParams) {
+            result.params[result.param_count++] = { node->wildcard_name, path };
+            result.target = *node->wildcard_child->target;
+            return true;
+        }
+        return false;
     }
-}
\ No newline at end of file
+}
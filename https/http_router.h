@@ -1,34 +1,127 @@
 #pragma once
 
 #include <string>
-#include <unordered_map>
+#include <vector>
+#include <array>
+#include <memory>
 #include <optional>
 #include <string_view>
-#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <google/protobuf/descriptor.h>
 
 namespace cyfon_rpc {
     struct RouteTarget {
         uint32_t service_id;
         uint32_t method_id;
+        // 请求/响应的 protobuf 描述符, 为空时网关按原始字节透传 body
+        const google::protobuf::Descriptor* request_type = nullptr;
+        const google::protobuf::Descriptor* response_type = nullptr;
     };
 
+    // 路由匹配结果, 参数名指向路由快照, 参数值指向请求路径, 整个过程不做堆分配
+    // 被替换的快照会被回收, 匹配后还要读参数名时需在 HttpRouter::ReadGuard 内完成匹配和读取
+    struct RouteMatch {
+        static constexpr size_t kMaxParams = 8;
+
+        RouteTarget target{};
+        std::array<std::pair<std::string_view, std::string_view>, kMaxParams> params{};
+        size_t param_count = 0;
+
+        // 按名字取路径参数
+        std::optional<std::string_view> param(std::string_view name) const {
+            for (size_t i = 0; i < param_count; ++i) {
+                if (params[i].first == name) {
+                    return params[i].second;
+                }
+            }
+            return std::nullopt;
+        }
+    };
+
+    // 基于压缩基数树的 HTTP 路由
+    // 模式语法:
+    //   /v1/calculator/add        静态路径
+    //   /v1/{service}/{method}    {name} 匹配一个路径段
+    //   /static/*path             *name 匹配剩余全部路径, 只能出现在末尾
+    // 匹配优先级: 静态 > 参数 > 通配
+    //
+    // 读路径无锁: 每次更新都在写锁内重建一棵不可变的树, 再以 release 语义原子发布;
+    // 读者只做一次 acquire load, 不碰引用计数.
+    // 回收基于纪元: 读者进入临界区时把全局纪元写进本线程独占的槽位, 离开时清零;
+    // 被替换的快照带着退役时的纪元进入退役列表, 写者每次发布后释放所有活跃读者都已越过的快照,
+    // 所以退役列表只留下发布时仍有读者在用的快照, 不会随更新次数增长.
+    // 启动时批量注册应放在 beginUpdate / commit 之间, 整批只重建、发布一次快照
     class HttpRouter {
     public:
+        HttpRouter();
+        ~HttpRouter();
+
+        HttpRouter(const HttpRouter&) = delete;
+        HttpRouter& operator=(const HttpRouter&) = delete;
+
+        // 读侧临界区: 持有期间本线程取到的快照不会被释放, RouteMatch 中的参数名保持有效.
+        // match 内部自带一层, 可以嵌套; 必须在构造它的线程上析构
+        class ReadGuard {
+        public:
+            ReadGuard();
+            ~ReadGuard();
+
+            ReadGuard(const ReadGuard&) = delete;
+            ReadGuard& operator=(const ReadGuard&) = delete;
+        };
+
         // 注册路由
-        void registerRoute(const std::string& path, uint32_t service_id, uint32_t method_id);
+        void registerRoute(const std::string& path, uint32_t service_id, uint32_t method_id,
+                           const google::protobuf::Descriptor* request_type = nullptr,
+                           const google::protobuf::Descriptor* response_type = nullptr);
+
+        // 批量更新: 之后的 registerRoute / clear 只修改路由表, 不重建快照, 读者继续看到旧路由;
+        // commit 时按完整路由表重建并发布一次. N 条路由逐条注册要重建 N 次并留下 N 个快照
+        void beginUpdate();
+        void commit();
+
+        // 匹配路径并提取参数
+        std::optional<RouteMatch> match(std::string_view path) const;
 
         // 根据路径查找路由
-        std::optional<RouteTarget> findroute(const std::string& path);
+        std::optional<RouteTarget> findroute(std::string_view path) const;
 
         void clear();
 
         // 获取路由数量
         size_t size() const;
 
+        // 已退役但仍可能被读者引用、尚未释放的快照数
+        size_t retiredSnapshots() const;
+
     private:
-        std::unordered_map<std::string, RouteTarget> routes_;
-        mutable std::shared_mutex  mutex_;
+        struct Node;
+        struct Snapshot;
+
+        static void insert(Node* root, std::string_view pattern, const RouteTarget& target);
+        static bool matchNode(const Node* node, std::string_view path, RouteMatch& result);
+
+        struct Retired {
+            std::unique_ptr<const Snapshot> snapshot;
+            uint64_t epoch;     // 退役时的全局纪元, 所有活跃读者的纪元都大于它时才能释放
+        };
+
+        // 根据 routes_ 重建并发布新快照, 调用方需持有 write_mutex_
+        void rebuild();
+        // 释放已没有读者的退役快照, 调用方需持有 write_mutex_
+        void reclaim();
+
+        std::atomic<const Snapshot*> current_;
+        std::unique_ptr<const Snapshot> owned_;    // current_ 指向的快照, 由 write_mutex_ 保护
+        std::vector<Retired> retired_;             // 按纪元递增排列, 由 write_mutex_ 保护
+
+        std::vector<std::pair<std::string, RouteTarget>> routes_;  // 写端保存的原始路由表
+        mutable std::mutex write_mutex_;
+        bool deferred_ = false;     // 处于 beginUpdate 之后, 由 write_mutex_ 保护
     };
 
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,302 @@
+#include "http_session.h"
+#include <google/protobuf/message.h>
+#include <google/protobuf/util/json_util.h>
+#include <unordered_map>
+
+namespace cyfon_rpc {
+
+    namespace {
+        // 每个线程为每种消息类型缓存一个 protobuf 对象, 转码时 Clear() 后复用,
+        // 避免每个请求都通过 MessageFactory New() 一个动态消息
+        google::protobuf::Message* acquireMessage(const google::protobuf::Descriptor* descriptor) {
+            thread_local std::unordered_map<const google::protobuf::Descriptor*,
+                                            std::unique_ptr<google::protobuf::Message>> pool;
+
+            auto& slot = pool[descriptor];
+            if (!slot) {
+                const auto* prototype = google::protobuf::MessageFactory::generated_factory()->GetPrototype(descriptor);
+                if (!prototype) {
+                    return nullptr;
+                }
+                slot.reset(prototype->New());
+            }
+            slot->Clear();
+            return slot.get();
+        }
+
+        bool jsonToBinary(const google::protobuf::Descriptor* descriptor, const std::string& json, std::string& out) {
+            auto* message = acquireMessage(descriptor);
+            if (!message) {
+                return false;
+            }
+
+            google::protobuf::util::JsonParseOptions options;
+            options.ignore_unknown_fields = true;
+            std::string_view input = json.empty() ? std::string_view("{}") : std::string_view(json);
+            if (!google::protobuf::util::JsonStringToMessage(input, message, options).ok()) {
+                return false;
+            }
+            return message->SerializeToString(&out);
+        }
+
+        bool binaryToJson(const google::protobuf::Descriptor* descriptor, const std::string& payload, std::string& out) {
+            auto* message = acquireMessage(descriptor);
+            if (!message || !message->ParseFromString(payload)) {
+                return false;
+            }
+
+            google::protobuf::util::JsonPrintOptions options;
+            options.always_print_primitive_fields = true;
+            options.preserve_proto_field_names = true;
+            return google::protobuf::util::MessageToJsonString(*message, &out, options).ok();
+        }
+
+        http::status toHttpStatus(RpcStatus status) {
+            switch (status) {
+                case RpcStatus::OK:                 return http::status::ok;
+                case RpcStatus::SERVICE_NOT_FOUND:
+                case RpcStatus::METHOD_NOT_FOUND:   return http::status::not_found;
+                case RpcStatus::INVALID_ARGUMENT:   return http::status::bad_request;
+                case RpcStatus::DEADLINE_EXCEEDED:  return http::status::gateway_timeout;
+                case RpcStatus::RESOURCE_EXHAUSTED: return http::status::payload_too_large;
+                case RpcStatus::UNAVAILABLE:        return http::status::service_unavailable;
+                default:                            return http::status::internal_server_error;
+            }
+        }
+    }
+
+    HttpSession::HttpSession(boost::asio::ip::tcp::socket socket, RpcServer& server, const HttpRouter& router)
+        : stream_(std::move(socket)),
+          server_(server),
+          router_(router) {
+    }
+
+    void HttpSession::start() {
+        // 在会话的 strand 上开始, 之后所有状态只在该 strand 上访问
+        boost::asio::dispatch(stream_.get_executor(),
+            beast::bind_front_handler(&HttpSession::do_read, shared_from_this()));
+    }
+
+    void HttpSession::do_read() {
+        // pipelining 队列满时暂停读取, 由写完成后恢复, 形成背压
+        if (reading_ || closing_ || pipeline_.size() >= kMaxPipelined) {
+            return;
+        }
+        reading_ = true;
+
+        resetParser();
+
+        stream_.expires_after(kIdleTimeout);
+        http::async_read(stream_, buffer_, *parser_,
+            beast::bind_front_handler(&HttpSession::on_read, shared_from_this()));
+    }
+
+    void HttpSession::resetParser() {
+        Request recycled;
+        if (parser_) {
+            // 上一条请求已处理完, 清掉字段和内容但保留 body 的容量
+            recycled = parser_->release();
+            recycled.clear();
+            recycled.body().clear();
+        }
+        parser_.emplace(std::move(recycled));
+        parser_->body_limit(kBodyLimit);
+    }
+
+    void HttpSession::on_read(beast::error_code ec, std::size_t /*bytes_transferred*/) {
+        reading_ = false;
+
+        if (ec == http::error::end_of_stream) {
+            closing_ = true;
+            if (pipeline_.empty()) {
+                do_close();
+            }
+            return;
+        }
+        if (ec) {
+            if (ec != beast::error::timeout) {
+                CYFON_LOG_WARN("HTTP read error: {}", ec.message());
+            }
+            return;
+        }
+
+        Request& req = parser_->get();
+        if (!req.keep_alive()) {
+            closing_ = true;
+        }
+        handleRequest(req);
+        do_read();
+    }
+
+    void HttpSession::handleRequest(Request& req) {
+        const uint64_t seq = next_seq_++;
+        pipeline_.emplace_back();
+
+        const unsigned version = req.version();
+        const bool keep_alive = req.keep_alive();
+
+        if (req.method() != http::verb::post && req.method() != http::verb::get) {
+            complete(seq, makeError(version, keep_alive, http::status::method_not_allowed, "only GET and POST are supported"));
+            return;
+        }
+
+        // 去掉查询串后再匹配路由
+        std::string_view path(req.target().data(), req.target().size());
+        if (auto pos = path.find('?'); pos != std::string_view::npos) {
+            path = path.substr(0, pos);
+        }
+
+        auto target = router_.findroute(path);
+        if (!target) {
+            complete(seq, makeError(version, keep_alive, http::status::not_found, "route not found"));
+            return;
+        }
+
+        auto& stats = server_.methodStats(target->service_id, target->method_id);
+        stats.requests.add();
+        stats.bytes_in.add(req.body().size());
+
+        std::string body;
+        if (target->request_type) {
+            if (!jsonToBinary(target->request_type, req.body(), body)) {
+                complete(seq, makeError(version, keep_alive, http::status::bad_request, "invalid JSON request body"));
+                return;
+            }
+        }
+        else {
+            body = std::move(req.body());
+        }
+
+        server_.dispatch(target->service_id, target->method_id, std::move(body),
+            [self = shared_from_this(), seq, version, keep_alive, response_type = target->response_type]
+            (RpcStatus status, std::string payload) {
+                // 响应转码在工作线程完成, strand 上只做排队和写出
+                Response res;
+                if (status != RpcStatus::OK) {
+                    res = makeError(version, keep_alive, toHttpStatus(status), payload);
+                }
+                else if (response_type) {
+                    std::string json;
+                    if (binaryToJson(response_type, payload, json)) {
+                        res = makeResponse(version, keep_alive, http::status::ok, std::move(json), "application/json");
+                    }
+                    else {
+                        res = makeError(version, keep_alive, http::status::internal_server_error, "failed to encode response");
+                    }
+                }
+                else {
+                    res = makeResponse(version, keep_alive, http::status::ok, std::move(payload), "application/octet-stream");
+                }
+
+                boost::asio::post(self->stream_.get_executor(),
+                    [self, seq, res = std::move(res)]() mutable {
+                        self->complete(seq, std::move(res));
+                    });
+            });
+    }
+
+    void HttpSession::complete(uint64_t seq, Response&& res) {
+        auto& slot = pipeline_[seq - head_seq_];
+        slot.response = std::move(res);
+        slot.ready = true;
+        do_write();
+    }
+
+    void HttpSession::do_write() {
+        if (writing_ || pipeline_.empty() || !pipeline_.front().ready) {
+            return;
+        }
+        writing_ = true;
+
+        const bool close = pipeline_.front().response.need_eof();
+        serializer_.emplace(pipeline_.front().response);
+
+        stream_.expires_after(kIdleTimeout);
+        http::async_write(stream_, *serializer_,
+            [self = shared_from_this(), close](beast::error_code ec, std::size_t /*bytes_transferred*/) {
+                self->on_write(ec, close);
+            });
+    }
+
+    void HttpSession::on_write(beast::error_code ec, bool close) {
+        writing_ = false;
+        serializer_.reset();
+        pipeline_.pop_front();
+        ++head_seq_;
+
+        if (ec) {
+            CYFON_LOG_WARN("HTTP write error: {}", ec.message());
+            return;
+        }
+        if (close || (closing_ && pipeline_.empty())) {
+            do_close();
+            return;
+        }
+
+        do_write();
+        do_read();
+    }
+
+    void HttpSession::do_close() {
+        beast::error_code ec;
+        stream_.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+    }
+
+    HttpSession::Response HttpSession::makeResponse(unsigned version, bool keep_alive, http::status status,
+                                                    std::string body, std::string_view content_type) {
+        Response res{ status, version };
+        res.set(http::field::server, "cyfon_rpc");
+        res.set(http::field::content_type, beast::string_view(content_type.data(), content_type.size()));
+        res.keep_alive(keep_alive);
+        res.body() = std::move(body);
+        res.prepare_payload();
+        return res;
+    }
+
+    HttpSession::Response HttpSession::makeError(unsigned version, bool keep_alive, http::status status, std::string_view message) {
+        // message 可能是业务方法的异常文本, 控制字符也要转义, 否则生成的 JSON 不合法
+        std::string body = "{\"error\":\"";
+        for (char c : message) {
+            switch (c) {
+                case '"':  body += "\\\""; break;
+                case '\\': body += "\\\\"; break;
+                case '\n': body += "\\n"; break;
+                case '\r': body += "\\r"; break;
+                case '\t': body += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        static constexpr char kHex[] = "0123456789abcdef";
+                        body += "\\u00";
+                        body.push_back(kHex[static_cast<unsigned char>(c) >> 4]);
+                        body.push_back(kHex[c & 0x0f]);
+                    }
+                    else {
+                        body.push_back(c);
+                    }
+            }
+        }
+        body += "\"}";
+        return makeResponse(version, keep_alive, status, std::move(body), "application/json");
+    }
+
+    HttpGateway::HttpGateway(IoContextPool& pool,
+                             const boost::asio::ip::tcp::endpoint& endpoint,
+                             RpcServer& server,
+                             const HttpRouter& router)
+        : pool_(pool),
+          acceptor_(pool.worker(0).context, endpoint),
+          server_(server),
+          router_(router) {
+        do_accept();
+    }
+
+    void HttpGateway::do_accept() {
+        acceptor_.async_accept(boost::asio::make_strand(pool_.next().context),
+            [this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+                if (!ec) {
+                    std::make_shared<HttpSession>(std::move(socket), server_, router_)->start();
+                }
+                do_accept();
+            });
+    }
+}
@@ -4,11 +4,92 @@
 #include <boost/beast.hpp>
 #include <boost/asio.hpp>
 #include <memory>
+#include <deque>
+#include <optional>
+#include <chrono>
 #include "http_router.h"
 #include "rpc_server.h"
 #include "rpc_header.h"
-#include "spdlog/spdlog.h"
+#include "rpc_log.h"
+#include "io_context_pool.h"
 
 namespace cyfon_rpc {
 
-}
\ No newline at end of file
+    namespace beast = boost::beast;
+    namespace http = boost::beast::http;
+
+    // HTTP/1.1 JSON 网关会话
+    // - 支持 keep-alive 和 pipelining, 响应严格按请求顺序写回
+    // - 按路由上的描述符做 JSON <-> protobuf 转码
+    // - 直接调用 RpcServer::dispatch, 不再封装成 RpcHeader 走回环 socket
+    // - 解析器/序列化器的存储放在会话内, 每个请求原地重建, 不做堆分配; 读缓冲区和请求 body 的容量跨请求复用
+    class HttpSession : public std::enable_shared_from_this<HttpSession> {
+    public:
+        HttpSession(boost::asio::ip::tcp::socket socket, RpcServer& server, const HttpRouter& router);
+
+        void start();
+
+    private:
+        using Request = http::request<http::string_body>;
+        using Response = http::response<http::string_body>;
+
+        // pipelining 队列中的一个槽位, 响应就绪后才能按顺序写出
+        struct PendingResponse {
+            bool ready = false;
+            Response response;
+        };
+
+        void do_read();
+        void resetParser();
+        void on_read(beast::error_code ec, std::size_t bytes_transferred);
+        void handleRequest(Request& req);
+        void complete(uint64_t seq, Response&& res);
+        void do_write();
+        void on_write(beast::error_code ec, bool close);
+        void do_close();
+
+        static Response makeResponse(unsigned version, bool keep_alive, http::status status,
+                                     std::string body, std::string_view content_type);
+        static Response makeError(unsigned version, bool keep_alive, http::status status, std::string_view message);
+
+        beast::tcp_stream stream_;
+        beast::flat_buffer buffer_;
+        // Beast 的解析器只能解析一条消息, 也没有 reset; 每个请求在这块存储上原地重建,
+        // 并接手上一条请求清空后的消息对象, body 的容量不必每次重新分配
+        std::optional<http::request_parser<http::string_body>> parser_;
+        std::optional<http::response_serializer<http::string_body>> serializer_;   // 同样原地重建, 写完即析构
+        RpcServer& server_;
+        const HttpRouter& router_;
+
+        std::deque<PendingResponse> pipeline_;
+        uint64_t head_seq_ = 0;     // pipeline_.front() 对应的请求序号
+        uint64_t next_seq_ = 0;     // 下一个请求的序号
+        bool reading_ = false;
+        bool writing_ = false;
+        bool closing_ = false;      // 对端已关闭或不再 keep-alive, 写完剩余响应后关闭
+
+        static constexpr std::size_t kMaxPipelined = 16;
+        static constexpr std::size_t kBodyLimit = 1024 * 1024;
+        static constexpr std::chrono::seconds kIdleTimeout{ 30 };
+    };
+
+    // HTTP 网关监听器, 连接轮转分配到各 I/O 线程, 每个连接一个 strand, 会话内部无需加锁
+    class HttpGateway {
+    public:
+        HttpGateway(IoContextPool& pool,
+                    const boost::asio::ip::tcp::endpoint& endpoint,
+                    RpcServer& server,
+                    const HttpRouter& router);
+
+        // 实际监听的端口, endpoint 端口为 0 时由系统分配
+        [[nodiscard]] unsigned short port() const { return acceptor_.local_endpoint().port(); }
+
+    private:
+        void do_accept();
+
+        IoContextPool& pool_;
+        boost::asio::ip::tcp::acceptor acceptor_;
+        RpcServer& server_;
+        const HttpRouter& router_;
+    };
+}
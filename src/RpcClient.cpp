@@ -2,6 +2,9 @@
 #include "buffer.h"
 #include "rpc_header.h"
 #include "rpc_protocol_utils.h"
+#include "rpc_log.h"
+#include "crc32c.h"
+#include <array>
 #include <iostream>
 #include <string>
 #include <boost/asio.hpp>
@@ -16,39 +19,119 @@ namespace cyfon_rpc {
 		try {
 			boost::asio::ip::tcp::resolver resolver(ioc_);
 			auto endpoints = resolver.resolve(host, std::to_string(port));
-			boost::asio::connect(socket_, endpoints);
-			return true;
+
+			boost::system::error_code ec = boost::asio::error::host_not_found;
+			for (const auto& entry : endpoints) {
+				socket_.close(ec);
+				socket_.connect(boost::asio::generic::stream_protocol::endpoint(entry.endpoint()), ec);
+				if (!ec) {
+					return true;
+				}
+			}
+			CYFON_LOG_ERROR("connect error: {}", ec.message());
+			return false;
 		}
 		catch (std::exception& e) {
-			std::cerr << " connect error" << std::endl;
+			CYFON_LOG_ERROR("connect error: {}", e.what());
+			return false;
+		}
+	}
+
+	bool RpcClient::connectLocal(const std::string& path) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		boost::system::error_code ec;
+		socket_.close(ec);
+		socket_.connect(boost::asio::local::stream_protocol::endpoint(path), ec);
+		if (ec) {
+			CYFON_LOG_ERROR("local connect error: {}", ec.message());
 			return false;
 		}
+		return true;
+#else
+		CYFON_LOG_ERROR("local sockets are not supported on this platform");
+		return false;
+#endif
 	}
 
 	void RpcClient::close() {
 		boost::system::error_code ec;
-		socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+		socket_.shutdown(boost::asio::socket_base::shutdown_both, ec);
 		socket_.close(ec);
 	}
 
+	bool RpcClient::enableChecksum() {
+		std::lock_guard<std::mutex> lock(exchange_mutex_);
+		boost::system::error_code ec;
+
+		// Ϣ PING, βֻͷ
+		RpcHeader ping{};
+		ping.message_size = sizeof(RpcHeader);
+		ping.message_type = static_cast<uint8_t>(MessageType::PING);
+		Buffer frame;
+		prepend_header(frame, ping);
+		append_checksum(frame);
+		boost::asio::write(socket_, boost::asio::buffer(frame.readableBytesView().data(), frame.readableBytes()), ec);
+		if (ec) { CYFON_LOG_ERROR("client write error: {}", ec.message()); return false; }
+
+		Buffer pong_buffer = receive_frame();
+		RpcHeader pong;
+		// ֧Уķ˻ظ־ PONG, ˫ʹԭ֡ʽ
+		checksum_ = deserialize_header(pong_buffer, pong) &&
+			pong.message_type == static_cast<uint8_t>(MessageType::PONG) &&
+			strip_checksum(pong_buffer, true);
+		return checksum_;
+	}
+
 	Buffer RpcClient::send_receive(const Buffer& buf) {
+		std::lock_guard<std::mutex> lock(exchange_mutex_);
 		boost::system::error_code ec;
 
-		boost::asio::write(socket_, boost::asio::buffer(buf.readableBytesView()), ec);
-		if (ec) { std::cerr << "client write error" << std::endl;  return; }
+		auto frame = buf.readableBytesView();
+		RpcHeader header;
+		if (checksum_ && deserialize_header(frame, header) && !(header.flags & Flag::CHECKSUM)) {
+			// дͷ + ԭϢ + βһ gather д, 
+			header.message_size += kChecksumSize;
+			header.flags |= Flag::CHECKSUM;
+			char head[sizeof(RpcHeader)];
+			encode_header(header, head);
+			auto body = frame.subspan(sizeof(RpcHeader));
+			uint32_t trailer = hostToNetwork(crc32c(body.data(), body.size(), crc32c(head, sizeof(head))));
+			std::array<boost::asio::const_buffer, 3> buffers{
+				boost::asio::buffer(head, sizeof(head)),
+				boost::asio::buffer(body.data(), body.size()),
+				boost::asio::buffer(&trailer, sizeof(trailer)),
+			};
+			boost::asio::write(socket_, buffers, ec);
+		}
+		else {
+			boost::asio::write(socket_, boost::asio::buffer(frame.data(), frame.size()), ec);
+		}
+		if (ec) { CYFON_LOG_ERROR("client write error: {}", ec.message()); return Buffer(); }
+
+		Buffer response_buffer = receive_frame();
+		if (!strip_checksum(response_buffer, checksum_)) {
+			CYFON_LOG_ERROR("Response checksum mismatch");
+			return Buffer();
+		}
+		return response_buffer;
+	}
+
+	Buffer RpcClient::receive_frame() {
+		boost::system::error_code ec;
 
 		// ط˻ش
 		Buffer response_buffer;
 		response_buffer.ensureWritableBytes(sizeof(RpcHeader));
 		boost::asio::read(socket_, boost::asio::buffer(response_buffer.writableBytesView().data(),
 			sizeof(RpcHeader)), ec);
-		if (ec) { std::cerr << "error response_buffer" << ec.message() << std::endl; return; }
+		if (ec) { CYFON_LOG_ERROR("Failed to read response header: {}", ec.message()); return Buffer(); }
 		response_buffer.hasWritten(sizeof(RpcHeader));
 
 		RpcHeader response_header;
-		if (!deserialize_header(response_buffer, response_header)) {
-			std::cerr << "deserialize error " << std::endl;
-			return;
+		if (decode_header(response_buffer.readableBytesView(), response_header) != HeaderStatus::OK) {
+			CYFON_LOG_ERROR("Invalid response header, message_size={}", response_header.message_size);
+			socket_.close(ec);
+			return Buffer();
 		}
 
 		// ȡӦ
@@ -57,71 +140,11 @@ namespace cyfon_rpc {
 			response_buffer.ensureWritableBytes(body_len);
 			boost::asio::read(socket_, boost::asio::buffer(response_buffer.writableBytesView().data(), body_len), ec);
 			if (ec) {
-				std::cerr << "Failed to read response body: " << ec.message() << std::endl;
-				return;
+				CYFON_LOG_ERROR("Failed to read response body: {}", ec.message());
+				return Buffer();
 			}
 			response_buffer.hasWritten(body_len);
 		}
 		return response_buffer;
 	}
 }
-
-
-int main() {
-	try {
-		boost::asio::io_context ioc;
-		cyfon_rpc::RpcClient client(ioc);
-
-		if (!client.connect("127.0.0.1", 8888)) {
-			return 1;
-		}
-		std::cout << "Successfully connected to server." << std::endl;
-
-		// ---  Add(15, 27)  ---
-		rpc_demo::AddRequest add_req;
-		add_req.set_a(15);
-		add_req.set_b(27);
-		std::string add_req_body = add_req.SerializeAsString();
-
-		cyfon_rpc::Buffer request_buffer;
-		// ׷Body
-		request_buffer.append(add_req_body);
-
-		// ԤHeader ( prependableBytes ֮)
-		cyfon_rpc::RpcHeader header;
-		header.service_id = std::hash<std::string>{}("CalculatorService");
-		header.method_id = std::hash<std::string>{}("Add");
-		header.message_size = sizeof(cyfon_rpc::RpcHeader) + add_req_body.size();
-		cyfon_rpc::prepend_header(request_buffer, header);
-
-		// --- 󲢽Ӧ ---
-		std::cout << "Sending Add(15, 27) request..." << std::endl;
-		cyfon_rpc::Buffer response_buffer = client.send_receive(request_buffer);
-
-		if (response_buffer.readableBytes() > sizeof(cyfon_rpc::RpcHeader)) {
-			// HeaderBody
-			response_buffer.retrieve(sizeof(cyfon_rpc::RpcHeader));
-
-			rpc_demo::AddResponse add_res;
-			if (add_res.ParseFromArray(response_buffer.peek(), response_buffer.readableBytes())) {
-				std::cout << ">>> Add Response received. Result: " << add_res.result() << std::endl;
-			}
-			else {
-				std::cerr << "Error: Failed to parse AddResponse protobuf." << std::endl;
-			}
-		}
-		else {
-			std::cerr << "Error: Received an invalid or empty response." << std::endl;
-		}
-
-		client.close();
-		std::cout << "Connection closed." << std::endl;
-
-	}
-	catch (std::exception& e) {
-		std::cerr << "Exception: " << e.what() << std::endl;
-	}
-
-	google::protobuf::ShutdownProtobufLibrary();
-	return 0;
-}
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <functional>
+#include <mutex>
 #include "rpc_header.h"
 #include <boost/asio.hpp>
 #include "buffer.h"
@@ -18,9 +19,15 @@ namespace cyfon_rpc {
 		RpcClient(boost::asio::io_context& io_context);
 
 		bool connect(const std::string& host, short port);
+		// 通过 AF_UNIX 连接本机服务端
+		bool connectLocal(const std::string& path);
 		void close();
 
-		// 普通RPC
+		// 用带 CHECKSUM 标志的 PING 请求开启 CRC32C 尾部, 服务端同意时返回 true
+		// 开启后 send_receive 自动给请求加尾部, 并在返回前校验和去掉响应的尾部; 校验失败返回空 Buffer
+		bool enableChecksum();
+
+		// 普通RPC; 多个线程共用一个连接时逐个收发, 请求和响应不会交错
 		Buffer send_receive(const Buffer& request_buffer);
 
 		// 流式服务端
@@ -49,12 +56,19 @@ namespace cyfon_rpc {
 
 		// 开启客户端流式调用
 		std::shared_ptr<ClientStreamContext> callClientStreaming(
-
-		)
+			uint32_t service_id,
+			uint32_t method_id
+		);
 
 		Buffer receive_buffer();
 	private:
+		// 读一条完整的帧 (头部 + 消息体), 出错返回空 Buffer
+		Buffer receive_frame();
+
 		boost::asio::io_context& ioc_;
-		boost::asio::ip::tcp::socket socket_;
+		// 通用流 socket, TCP 与 AF_UNIX 共用同一套收发逻辑
+		boost::asio::generic::stream_protocol::socket socket_;
+		std::mutex exchange_mutex_;		// 保护 send_receive 的一问一答
+		bool checksum_ = false;
 	};
 }
\ No newline at end of file
@@ -1,92 +1,930 @@
 #include "Session.h"
 #include "rpc_server.h"
 #include "rpc_protocol_utils.h"
-#include "spdlog/spdlog.h"
+#include "rpc_log.h"
+#include "rpc_capture.h"
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <unistd.h>
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define CYFON_RPC_MSG_ZEROCOPY
+#endif
+#endif
+
+namespace {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+	// io_uring 后端下 async_wait 是一次 poll 提交, 醒来后的同步 read_some 又是一次系统调用,
+	// 比直接提交一次 recv 多一轮往返, 所以挂起读只在反应器后端上使用
+	constexpr bool kParkIdleSupported = false;
+#else
+	constexpr bool kParkIdleSupported = true;
+#endif
+
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	// 会话关闭时仍有未确认的零拷贝发送, 最多再等这么久, 之后放弃并释放区间
+	constexpr auto kZeroCopyLinger = std::chrono::seconds(10);
+	constexpr auto kZeroCopyLingerPoll = std::chrono::milliseconds(10);
+
+	// 完成通知确认的序号区间 [lo, lo + count) 与 [first, first + sends) 的重叠次数, 序号按 32 位回绕
+	uint32_t seqOverlap(uint32_t lo, uint32_t count, uint32_t first, uint32_t sends) {
+		if (uint32_t d = lo - first; d < sends) {
+			return std::min(sends - d, count);
+		}
+		if (uint32_t d = first - lo; d < count) {
+			return std::min(count - d, sends);
+		}
+		return 0;
+	}
+#endif
+}
+
+void Session::start() {
+	// accept 可能发生在其它 I/O 线程, 切到会话所属线程后再操作时间轮
+	boost::asio::dispatch(socket_.get_executor(), [self = shared_from_this()]() {
+		boost::system::error_code ec;
+		self -> socket_.non_blocking(true, ec);
+		self -> session_stats_ = &cyfon_rpc::MetricsRegistry::instance().localSessions();
+		self -> session_stats_ -> sessions.add(1);
+		self -> worker_ = self -> server_.assignWorker();
+		self -> updateBufferGauge();
+
+		self -> last_activity_ = self -> wheel_.now();
+		self -> armIdleTimer(self -> options_.idle_timeout);
+		self -> do_read();
+	});
+}
 
 void Session::do_read() {
 	auto self = shared_from_this();
+
+	// 缓冲区里没有半帧时挂起在零字节读上, 数据到达后才准备缓冲区;
+	// 挂起期间没有读操作引用缓冲区, 空闲回收可以直接释放它
+	if (kParkIdleSupported && options_.park_idle && socketBuffer_.readableBytes() == 0) {
+		parked_ = true;
+		session_stats_ -> parked.add(1);
+		socket_.async_wait(socket_type::wait_read, [this, self](boost::system::error_code ec) {
+			parked_ = false;
+			session_stats_ -> parked.add(-1);
+			if (ec) {
+				onReadError(ec);
+				return;
+			}
+
+			reserveReadSpace();
+			auto writable = socketBuffer_.writableBytesView();
+			size_t length = socket_.read_some(boost::asio::buffer(writable.data(), writable.size()), ec);
+			if (ec == boost::asio::error::would_block || ec == boost::asio::error::try_again) {
+				do_read();
+				return;
+			}
+			if (ec) {
+				onReadError(ec);
+				return;
+			}
+			onRead(length);
+		});
+		return;
+	}
+
+	reserveReadSpace();
+	auto writable = socketBuffer_.writableBytesView();
 	socket_.async_read_some(
-		boost::asio::buffer(socketBuffer_.writableBytesView().data(), socketBuffer_.writableBytesView().size()),
+		boost::asio::buffer(writable.data(), writable.size()),
 		[this, self](boost::system::error_code ec, size_t length) {
 			if (!ec) {
-				socketBuffer_.hasWritten(length);
-				spdlog::debug("Socket read {} bytes.", length);
-				while (processMessage()) {
-					spdlog::debug("Processed one complete message in buffer.");
-				}
-				do_read();
+				onRead(length);
 			}
 			else {
-				if (ec == boost::asio::error::eof) {
-					spdlog::info("Client disconnected gracefully. (EOF)");
-				}
-				else {
-					spdlog::error("Read error: {}", ec.message()); 
-				}
+				onReadError(ec);
+			}
+		});
+}
+
+void Session::onRead(size_t length) {
+	if (cyfon_rpc::Tracer::instance().enabled()) {
+		last_read_ns_ = cyfon_rpc::Tracer::nowNanos();
+		if (socketBuffer_.readableBytes() == 0) {
+			first_byte_ns_ = last_read_ns_;
+		}
+	}
+	socketBuffer_.hasWritten(length);
+	last_activity_ = wheel_.now();
+	CYFON_LOG_DEBUG("Socket read {} bytes.", length);
+	bool progressed = false;
+	const size_t inbound_remaining = inbound_ ? inbound_ -> remaining : 0;
+	while (processMessage()) {
+		progressed = true;
+		CYFON_LOG_DEBUG("Processed one complete message in buffer.");
+	}
+	// 分块请求体收到新数据也算进展
+	if (inbound_ && inbound_ -> remaining != inbound_remaining) {
+		progressed = true;
+	}
+	if (closed_) {
+		return;
+	}
+
+	// 读超时只针对半帧: 从最近一次凑齐整帧 (或收到一块分块请求体) 开始计时, 缓冲区清空时取消
+	const bool partial = socketBuffer_.readableBytes() > 0 || inbound_.has_value();
+	if (progressed || !partial) {
+		wheel_.cancel(read_timer_);
+	}
+	if (partial && options_.read_timeout.count() > 0 && !wheel_.pending(read_timer_)) {
+		read_timer_ = wheel_.schedule(options_.read_timeout, [weak = weak_from_this()]() {
+			if (auto session = weak.lock()) {
+				CYFON_LOG_INFO("Incomplete frame not finished within {} ms, closing session",
+					session -> options_.read_timeout.count());
+				session -> close("read timeout");
 			}
 		});
+	}
+
+	// 一条大消息之后容量远超近期消息大小时立即收缩, 不让它在整个连接生命周期里占着内存
+	if (socketBuffer_.readableBytes() == 0 && socketBuffer_.internalCapacity() > kRetainedBufferSize) {
+		size_t target = readSizeHint();
+		if (socketBuffer_.internalCapacity() > target * kShrinkFactor) {
+			socketBuffer_.shrinkTo(target);
+			session_stats_ -> buffer_shrinks.add();
+		}
+	}
+	updateBufferGauge();
+	if (kParkIdleSupported && options_.park_idle && options_.reclaim_after.count() > 0 && !wheel_.pending(reclaim_timer_)) {
+		armReclaimTimer(options_.reclaim_after);
+	}
+
+	// 分块请求的数据块在工作线程上积压过多时暂停读, 由工作线程消化后恢复; 暂停期间不计读超时
+	if (chunk_backlog_.load(std::memory_order_relaxed) > kMaxChunkBacklog) {
+		read_paused_ = true;
+		wheel_.cancel(read_timer_);
+		return;
+	}
+	do_read();
+}
+
+void Session::onReadError(const boost::system::error_code& ec) {
+	if (closed_) {
+		return;
+	}
+	if (ec == boost::asio::error::eof) {
+		CYFON_LOG_DEBUG("Client disconnected gracefully. (EOF)");
+	}
+	else {
+		CYFON_LOG_ERROR("Read error: {}", ec.message()); 
+	}
+	close("read finished");
+}
+
+size_t Session::readSizeHint() const {
+	// 读缓冲区按近期消息大小的两倍准备, 一次读能装下一整条消息
+	return std::clamp(std::bit_ceil(avg_message_size_ * 2), kMinReadSize, kMaxReadSize);
+}
+
+void Session::reserveReadSpace() {
+	size_t wanted = readSizeHint();
+	// 已知半帧的总长度时按剩余字节准备, 大帧不会被切成许多次小读
+	if (pending_frame_size_ > socketBuffer_.readableBytes()) {
+		wanted = std::max(wanted, std::min(pending_frame_size_ - socketBuffer_.readableBytes(), kMaxReadAhead));
+	}
+	// 分块接收时每次读就是一块, 按读缓冲上限准备; 块的大小和积压上限一起决定这条连接最多占用的内存
+	else if (inbound_ && inbound_ -> remaining > socketBuffer_.readableBytes()) {
+		wanted = std::max(wanted, std::min(inbound_ -> remaining - socketBuffer_.readableBytes(), kMaxReadSize));
+	}
+	socketBuffer_.ensureWritableBytes(wanted);
+	updateBufferGauge();
+}
+
+void Session::updateBufferGauge() {
+	if (closed_ || !session_stats_) {
+		return;
+	}
+	size_t capacity = socketBuffer_.internalCapacity();
+	if (capacity != accounted_buffer_bytes_) {
+		session_stats_ -> buffer_bytes.add(static_cast<int64_t>(capacity) - static_cast<int64_t>(accounted_buffer_bytes_));
+		accounted_buffer_bytes_ = capacity;
+	}
+}
+
+void Session::armReclaimTimer(std::chrono::milliseconds delay) {
+	reclaim_timer_ = wheel_.schedule(delay, [weak = weak_from_this()]() {
+		if (auto session = weak.lock()) {
+			session -> onReclaimTimer();
+		}
+	});
+}
+
+void Session::onReclaimTimer() {
+	if (closed_) {
+		return;
+	}
+	auto idle = wheel_.now() - last_activity_;
+	if (idle < options_.reclaim_after) {
+		armReclaimTimer(std::chrono::duration_cast<std::chrono::milliseconds>(options_.reclaim_after - idle));
+		return;
+	}
+	// 只有挂起在零字节读上时缓冲区才没有被异步读引用; 有半帧时交给读超时处理
+	if (parked_ && socketBuffer_.readableBytes() == 0) {
+		if (socketBuffer_.internalCapacity() > cyfon_rpc::Buffer::kCheapPrepend) {
+			socketBuffer_.shrinkTo(0);
+			session_stats_ -> buffer_shrinks.add();
+			updateBufferGauge();
+			CYFON_LOG_DEBUG("Released read buffer of idle session");
+		}
+	}
+}
+
+void Session::armIdleTimer(std::chrono::milliseconds delay) {
+	if (options_.idle_timeout.count() <= 0) {
+		return;
+	}
+	idle_timer_ = wheel_.schedule(delay, [weak = weak_from_this()]() {
+		if (auto session = weak.lock()) {
+			session -> onIdleTimer();
+		}
+	});
+}
+
+void Session::onIdleTimer() {
+	if (closed_) {
+		return;
+	}
+	// 活跃时只记录时间不动定时器, 到期时再按剩余时间重新挂上, 读写路径上没有额外开销
+	auto idle = wheel_.now() - last_activity_;
+	if (idle >= options_.idle_timeout) {
+		CYFON_LOG_INFO("Session idle for {} ms, closing",
+			std::chrono::duration_cast<std::chrono::milliseconds>(idle).count());
+		close("idle timeout");
+		return;
+	}
+	armIdleTimer(std::chrono::duration_cast<std::chrono::milliseconds>(options_.idle_timeout - idle));
+}
+
+void Session::close([[maybe_unused]] std::string_view reason) {
+	if (closed_) {
+		return;
+	}
+	if (session_stats_) {
+		session_stats_ -> sessions.add(-1);
+		session_stats_ -> buffer_bytes.add(-static_cast<int64_t>(accounted_buffer_bytes_));
+		accounted_buffer_bytes_ = 0;
+	}
+	closed_ = true;
+	// reason 只用于调试日志, 日志级别高于 DEBUG 时调试日志被编译掉
+	CYFON_LOG_DEBUG("Closing session: {}", reason);
+
+	wheel_.cancel(idle_timer_);
+	wheel_.cancel(read_timer_);
+	wheel_.cancel(write_timer_);
+	wheel_.cancel(reclaim_timer_);
+
+	boost::system::error_code ec;
+	socket_.shutdown(socket_type::shutdown_both, ec);
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	// 已排队的数据在关闭后仍会发出, 内核可能还引用着零拷贝区间的页:
+	// 复制一个描述符留住错误队列, 在 write_strand_ 上等完成通知取回后再释放区间
+	if (zerocopy_enabled_.load(std::memory_order_relaxed)) {
+		int fd = ::dup(socket_.native_handle());
+		if (fd >= 0) {
+			boost::asio::dispatch(write_strand_, [self = shared_from_this(), fd]() {
+				self -> lingerZeroCopy(fd, std::chrono::steady_clock::now() + kZeroCopyLinger);
+			});
+		}
+	}
+#endif
+	socket_.close(ec);
 }
 
 bool Session::processMessage() {
+	if (inbound_) {
+		return consumeInbound();
+	}
+
     // 检测是否足够解析出一个完整的消息头
 	cyfon_rpc::RpcHeader header;
-	if (!cyfon_rpc::deserialize_header(socketBuffer_, header)) {
+	auto header_status = cyfon_rpc::decode_header(socketBuffer_.readableBytesView(), header, UINT32_MAX);
+	if (header_status == cyfon_rpc::HeaderStatus::INCOMPLETE) {
 		return false;
 	}
+	// 帧长小于头部时对端的字节流已无法重新对齐, 直接断开
+	if (header_status != cyfon_rpc::HeaderStatus::OK) {
+		CYFON_LOG_WARN("Rejecting frame with message_size={}, closing session", header.message_size);
+		close("malformed frame");
+		return false;
+	}
+
+	// 按服务的限制检查帧长, 在按 message_size 预留读缓冲之前拒绝超限的帧:
+	// 立即回复错误, 帧的其余数据到达后直接丢弃, 连接继续可用
+	const auto limits = server_.messageLimits(header.service_id);
+	const uint32_t max_message_size = limits.max_message_size ? limits.max_message_size : options_.max_message_size;
+	if (header.message_size > max_message_size) {
+		CYFON_LOG_WARN("Rejecting frame with message_size={} for service {} (limit {})",
+			header.message_size, header.service_id, max_message_size);
+		server_.methodStats(header.service_id, header.method_id).errors.add();
+		cyfon_rpc::TrafficCapture::instance().skip(header.message_size);
+		sendError(header, cyfon_rpc::RpcStatus::RESOURCE_EXHAUSTED, "message too large");
+		pending_frame_size_ = 0;
+		socketBuffer_.retrieve(sizeof(cyfon_rpc::RpcHeader));
+		inbound_.emplace();
+		inbound_ -> header = header;
+		inbound_ -> remaining = header.message_size - sizeof(cyfon_rpc::RpcHeader);
+		consumeInbound();
+		return true;
+	}
+
+	// 超过分块阈值的普通请求: 头部到达时决定一次, 支持分块的方法边读边交给工作线程, 不缓存整帧
+	const bool has_checksum = (header.flags & cyfon_rpc::Flag::CHECKSUM) != 0;
+	// 协商了校验之后对端的每一帧都必须带尾部; 标志位本身可能在传输中被清掉, 不带尾部的帧按损坏处理
+	const bool missing_checksum = !has_checksum && checksum_.load(std::memory_order_relaxed);
+	size_t body_size = header.message_size - sizeof(cyfon_rpc::RpcHeader);
+	if (pending_frame_size_ == 0 && !missing_checksum && limits.chunk_threshold > 0 && body_size > limits.chunk_threshold &&
+		header.message_type == static_cast<uint8_t>(cyfon_rpc::MessageType::REQUEST) &&
+		(!has_checksum || body_size >= cyfon_rpc::kChecksumSize)) {
+		if (has_checksum) {
+			body_size -= cyfon_rpc::kChecksumSize;
+		}
+		const bool has_trace = (header.flags & cyfon_rpc::Flag::TRACE_CONTEXT) && body_size >= cyfon_rpc::kTraceExtensionSize;
+		if (has_trace) {
+			body_size -= cyfon_rpc::kTraceExtensionSize;
+			if (socketBuffer_.readableBytes() < sizeof(cyfon_rpc::RpcHeader) + cyfon_rpc::kTraceExtensionSize) {
+				return false;
+			}
+		}
+		if (auto call = server_.openChunkedCall(header, body_size, worker_)) {
+			auto& stats = server_.methodStats(header.service_id, header.method_id);
+			stats.requests.add();
+			stats.bytes_in.add(body_size);
+			// 请求体不会整帧留在缓冲区里, 抓包记录不了, 只计数
+			cyfon_rpc::TrafficCapture::instance().skip(header.message_size);
+
+			// 尾部从头部算起
+			uint32_t crc = has_checksum ? cyfon_rpc::crc32c(socketBuffer_.peek(), sizeof(cyfon_rpc::RpcHeader)) : 0;
+			socketBuffer_.retrieve(sizeof(cyfon_rpc::RpcHeader));
+			auto& tracer = cyfon_rpc::Tracer::instance();
+			cyfon_rpc::TraceContext trace;
+			if (has_trace) {
+				if (has_checksum) {
+					crc = cyfon_rpc::crc32c(socketBuffer_.peek(), cyfon_rpc::kTraceExtensionSize, crc);
+				}
+				auto upstream = cyfon_rpc::read_trace_extension(socketBuffer_, header.request_id);
+				if (tracer.enabled()) {
+					trace = tracer.childOf(upstream, first_byte_ns_);
+				}
+			}
+			else if (tracer.enabled()) {
+				trace = tracer.startTrace(header.request_id, first_byte_ns_);
+			}
+
+			inbound_.emplace();
+			inbound_ -> header = header;
+			inbound_ -> call = std::move(call);
+			inbound_ -> remaining = body_size;
+			inbound_ -> trace = trace;
+			inbound_ -> checksum = has_checksum;
+			inbound_ -> crc = crc;
+			consumeInbound();
+			return true;
+		}
+	}
 
 	if (socketBuffer_.readableBytes() < header.message_size) {
+		pending_frame_size_ = header.message_size;
 		return false;
 	}
+	pending_frame_size_ = 0;
+	// 近期消息大小的指数移动平均 (权重 1/8), 决定下一次读准备多大的缓冲区
+	avg_message_size_ = avg_message_size_ - avg_message_size_ / 8 + header.message_size / 8;
+
+	// 带尾部的帧先校验再处理; 帧长字段可信才能走到这里, 所以只丢弃这一帧并回复错误, 连接继续可用
+	if (missing_checksum || (has_checksum && !cyfon_rpc::verify_checksum(socketBuffer_.readableBytesView().first(header.message_size)))) {
+		CYFON_LOG_WARN("Checksum {} on request {} (service {} method {})", missing_checksum ? "missing" : "mismatch",
+			header.request_id, header.service_id, header.method_id);
+		server_.methodStats(header.service_id, header.method_id).errors.add();
+		socketBuffer_.retrieve(header.message_size);
+		sendError(header, cyfon_rpc::RpcStatus::DATA_LOSS, missing_checksum ? "checksum required" : "checksum mismatch");
+		return true;
+	}
+
+	// 抓包: 在消费前记录整帧; 尾部属于这条连接协商的校验, 去掉尾部、清掉标志后再记录, 回放时不依赖校验
+	auto& capture = cyfon_rpc::TrafficCapture::instance();
+	if (capture.enabled()) {
+		auto frame = socketBuffer_.readableBytesView().first(header.message_size);
+		if (has_checksum) {
+			cyfon_rpc::RpcHeader unsealed = header;
+			unsealed.message_size -= cyfon_rpc::kChecksumSize;
+			unsealed.flags &= ~cyfon_rpc::Flag::CHECKSUM;
+			char unsealed_header[sizeof(cyfon_rpc::RpcHeader)];
+			cyfon_rpc::encode_header(unsealed, unsealed_header);
+			capture.record(unsealed_header, frame.subspan(sizeof(cyfon_rpc::RpcHeader), unsealed.message_size - sizeof(cyfon_rpc::RpcHeader)));
+		}
+		else {
+			capture.record(frame);
+		}
+	}
 
 	//------------------------------
 	// 至此，我们解析出了一个完整的消息
 	// 开始消费信息
 	socketBuffer_.retrieve(sizeof(cyfon_rpc::RpcHeader));
-	std::string payload = socketBuffer_.retrieveAsString(header.message_size - sizeof(cyfon_rpc::RpcHeader));
+	size_t payload_size = header.message_size - sizeof(cyfon_rpc::RpcHeader) - (has_checksum ? cyfon_rpc::kChecksumSize : 0);
 
 	// 根据消息类型分发
 	auto msg_type = static_cast<cyfon_rpc::MessageType>(header.message_type);
 
+	// 链路上下文: 上游带了头部扩展就接上游的链路, 否则在开启追踪时为请求新建一条
+	auto& tracer = cyfon_rpc::Tracer::instance();
+	cyfon_rpc::TraceContext trace;
+	if ((header.flags & cyfon_rpc::Flag::TRACE_CONTEXT) && payload_size >= cyfon_rpc::kTraceExtensionSize) {
+		auto upstream = cyfon_rpc::read_trace_extension(socketBuffer_, header.request_id);
+		payload_size -= cyfon_rpc::kTraceExtensionSize;
+		if (tracer.enabled()) {
+			trace = tracer.childOf(upstream, first_byte_ns_);
+		}
+	}
+	else if (tracer.enabled() && (msg_type == cyfon_rpc::MessageType::REQUEST || msg_type == cyfon_rpc::MessageType::BATCH)) {
+		trace = tracer.startTrace(header.request_id, first_byte_ns_);
+	}
+
+	std::string payload = socketBuffer_.retrieveAsString(payload_size);
+	if (has_checksum) {
+		socketBuffer_.retrieve(cyfon_rpc::kChecksumSize);
+	}
+
+	uint64_t decoded_ns = 0;
+	if (trace) {
+		decoded_ns = cyfon_rpc::Tracer::nowNanos();
+		tracer.record("socket_read", trace, first_byte_ns_, decoded_ns);
+	}
+	// 缓冲区里剩下的数据属于下一条消息, 它的首字节随最近一次读到达
+	if (socketBuffer_.readableBytes() > 0) {
+		first_byte_ns_ = last_read_ns_;
+	}
+
 	switch (msg_type) {
 		case cyfon_rpc::MessageType::REQUEST:
-		    handleRequest(header, payload);
+		    handleRequest(header, payload, trace);
+			if (trace) {
+				tracer.record("process_message", trace, decoded_ns, cyfon_rpc::Tracer::nowNanos());
+			}
 			break;
 		
 		case cyfon_rpc::MessageType::STREAM:
 		    handleStreamMessage(header, payload);
 			break;
 
+		case cyfon_rpc::MessageType::BATCH:
+			handleBatch(header, payload, trace);
+			if (trace) {
+				tracer.record("process_message", trace, decoded_ns, cyfon_rpc::Tracer::nowNanos());
+			}
+			break;
+
 		// 检测心跳
 		case cyfon_rpc::MessageType::PING:
-			spdlog::debug("Received PING message");
+			CYFON_LOG_DEBUG("Received PING message");
+			sendPong(header);
 			break;
 			
 		default:
-			spdlog::warn("warn message type: {}", (int)header.message_type);
+			CYFON_LOG_WARN("warn message type: {}", (int)header.message_type);
 			break;
 	}
 
 	return true;
 }
 
-void Session::do_write(std::span<const char> data) {
-	// 为了确保数据在异步写操作完成前不会被销毁，我们将数据拷贝到一个shared_ptr管理的vector中
-	auto shared_data = std::make_shared<std::vector<char>>(data.begin(), data.end());
+bool Session::consumeInbound() {
+	size_t length = std::min(socketBuffer_.readableBytes(), inbound_ -> remaining);
+	if (length > 0) {
+		if (inbound_ -> call) {
+			if (inbound_ -> checksum) {
+				inbound_ -> crc = cyfon_rpc::crc32c(socketBuffer_.peek(), length, inbound_ -> crc);
+			}
+			// 每次读到的数据作为一块交给请求的串行队列; 积压统计在工作线程处理完后扣减
+			// 回调持有会话: 暂停读期间没有挂起的读操作, 由在途的数据块保证会话存活
+			chunk_backlog_.fetch_add(length, std::memory_order_relaxed);
+			server_.enqueueChunk(inbound_ -> call, socketBuffer_.retrieveAsString(length),
+				[self = shared_from_this(), length, executor = socket_.get_executor()]() {
+					size_t before = self -> chunk_backlog_.fetch_sub(length, std::memory_order_relaxed);
+					if (before > kResumeChunkBacklog && before - length <= kResumeChunkBacklog) {
+						boost::asio::post(executor, [self]() {
+							self -> resumeRead();
+						});
+					}
+				});
+		}
+		else {
+			socketBuffer_.retrieve(length);
+		}
+		inbound_ -> remaining -= length;
+	}
 
-	boost::asio::post(write_strand_, [self = shared_from_this(), shared_data]() {
-		boost::asio::async_write(self->socket_, boost::asio::buffer(*shared_data),
-			[self, shared_data](boost::system::error_code ec, std::size_t /*length*/) {
-				if (ec) {
-					spdlog::error("read error {}", ec.message());
-				}
-			});
+	if (inbound_ -> remaining > 0) {
+		return false;
+	}
+	// 请求体之后是 CRC32C 尾部
+	if (inbound_ -> checksum) {
+		if (socketBuffer_.readableBytes() < cyfon_rpc::kChecksumSize) {
+			return false;
+		}
+		inbound_ -> corrupted = socketBuffer_.readInt<uint32_t>() != inbound_ -> crc;
+	}
+	finishInbound();
+	return true;
+}
+
+void Session::finishInbound() {
+	InboundBody body = std::move(*inbound_);
+	inbound_.reset();
+	if (!body.call) {
+		return;		// 超限的帧, 错误在解出头部时已经回复
+	}
+	// 数据块已经交给处理函数, 校验失败时不再调用 finish, 接收器随最后一个数据块一起析构
+	if (body.corrupted) {
+		CYFON_LOG_WARN("Checksum mismatch on chunked request {} (service {} method {})",
+			body.header.request_id, body.header.service_id, body.header.method_id);
+		server_.methodStats(body.header.service_id, body.header.method_id).errors.add();
+		sendError(body.header, cyfon_rpc::RpcStatus::DATA_LOSS, "checksum mismatch");
+		return;
+	}
+
+	server_.enqueueChunkedFinish(std::move(body.call),
+		[self = shared_from_this(), header = body.header, trace = body.trace](cyfon_rpc::RpcStatus status, std::string response) {
+			cyfon_rpc::Buffer response_buffer;
+			response_buffer.append(response);
+			cyfon_rpc::prepend_header(response_buffer, cyfon_rpc::make_response_header(header, status, response.size()));
+			self -> do_write(response_buffer.readableBytesView(), trace);
 		});
 }
 
-void Session::handleRequest(const cyfon_rpc::RpcHeader& header, const std::string& payload) {
+void Session::resumeRead() {
+	if (closed_ || !read_paused_ || chunk_backlog_.load(std::memory_order_relaxed) > kMaxChunkBacklog) {
+		return;
+	}
+	read_paused_ = false;
+	do_read();
+}
+
+void Session::do_write(std::span<const char> data, const cyfon_rpc::TraceContext& trace, TimerId deadline_timer) {
+	// 为了确保数据在异步写操作完成前不会被销毁，我们将数据拷贝到写队列中
+	PendingWrite pending;
+	pending.frame.assign(data.begin(), data.end());
+	pending.queued_at = cyfon_rpc::MetricsRegistry::Clock::now();
+	pending.trace = trace;
+
+	cyfon_rpc::RpcHeader header;
+	if (cyfon_rpc::deserialize_header(data, header)) {
+		pending.service_id = header.service_id;
+		pending.method_id = header.method_id;
+	}
+
+	boost::asio::post(write_strand_, [self = shared_from_this(), pending = std::move(pending), deadline_timer]() mutable {
+		if (deadline_timer) {
+			self -> wheel_.cancel(deadline_timer);
+		}
+		self -> queueWrite(std::move(pending));
+	});
+}
+
+void Session::queueWrite(PendingWrite&& pending) {
+	if (closed_) {
+		return;
+	}
+	// 协商开启校验后, 所有发出的帧在入队时统一加上 CRC32C 尾部; 文件区间的尾部由 sendBlob 在工作线程上算好
+	if (checksum_.load(std::memory_order_relaxed) && !pending.blob) {
+		sealChecksum(pending.frame);
+	}
+	write_queue_.push_back(std::move(pending));
+	if (!writing_) {
+		flush_writes();
+	}
+}
+
+void Session::flush_writes() {
+	// 把排队的多个帧合并成一次 gather 写, 高负载下显著减少 send 系统调用次数
+	// 带区间的帧是一批的最后一个: 头部随前面的帧一起写出, 区间另外发送
+	writing_ = true;
+
+	size_t count = std::min(write_queue_.size(), kMaxCoalescedFrames);
+	for (size_t i = 0; i < count; ++i) {
+		inflight_frames_.push_back(std::move(write_queue_.front()));
+		write_queue_.pop_front();
+		if (inflight_frames_.back().blob) {
+			break;
+		}
+	}
+
+	write_buffers_.clear();
+	for (const auto& pending : inflight_frames_) {
+		write_buffers_.emplace_back(boost::asio::buffer(pending.frame));
+	}
+
+	armWriteTimer();
+
+	boost::asio::async_write(socket_, write_buffers_,
+		boost::asio::bind_executor(write_strand_,
+			[self = shared_from_this()](boost::system::error_code ec, std::size_t /*length*/) {
+				if (!ec && self -> inflight_frames_.back().blob) {
+					self -> blob_sent_ = 0;
+					self -> writeBlob();
+					return;
+				}
+				self -> onWriteComplete(ec);
+			}));
+}
+
+void Session::armWriteTimer() {
+	if (options_.write_timeout.count() <= 0) {
+		return;
+	}
+	wheel_.cancel(write_timer_);
+	write_timer_ = wheel_.schedule(options_.write_timeout, [weak = weak_from_this()]() {
+		if (auto session = weak.lock()) {
+			CYFON_LOG_INFO("Write not finished within {} ms, closing session",
+				session -> options_.write_timeout.count());
+			session -> close("write timeout");
+		}
+	});
+}
+
+void Session::writeBlob() {
+	auto& pending = inflight_frames_.back();
+	const cyfon_rpc::BlobResponse& blob = *pending.blob;
+	auto continuation = [self = shared_from_this()](boost::system::error_code ec, std::size_t /*length*/ = 0) {
+		if (ec) {
+			self -> onWriteComplete(ec);
+			return;
+		}
+		self -> writeBlob();
+	};
+
+	// 大区间要写很久, 写超时按"多久没有进展"计算, 每次有进展就重新计时
+	if (blob_sent_ > 0) {
+		last_activity_ = wheel_.now();
+		armWriteTimer();
+	}
+
+	if (blob_sent_ == blob.size()) {
+		if (pending.trailer) {
+			blob_chunk_.resize(sizeof(uint32_t));
+			std::memcpy(blob_chunk_.data(), &*pending.trailer, sizeof(uint32_t));
+			pending.trailer.reset();
+			boost::asio::async_write(socket_, boost::asio::buffer(blob_chunk_),
+				boost::asio::bind_executor(write_strand_, continuation));
+			return;
+		}
+		onWriteComplete({});
+		return;
+	}
+
+	if (!blob.isFile()) {
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+		// MSG_ZEROCOPY: 内核 pin 住用户页直接发送, 不拷进 socket 缓冲区; 发送返回后页仍被引用,
+		// 写完成时区间转入 zerocopy_holds_, 等错误队列上的完成通知再释放
+		if (zerocopy_ok_ && blob.size() - blob_sent_ >= kZeroCopyThreshold && enableZeroCopy()) {
+			boost::system::error_code ec;
+			socket_.native_non_blocking(true, ec);
+			while (!ec && blob_sent_ < blob.size()) {
+				size_t length = static_cast<size_t>(std::min<uint64_t>(blob.size() - blob_sent_, kBlobChunkSize));
+				ssize_t sent = ::send(socket_.native_handle(), blob.data() + blob_sent_, length, MSG_ZEROCOPY | MSG_NOSIGNAL);
+				if (sent > 0) {
+					blob_sent_ += static_cast<uint64_t>(sent);
+					++zerocopy_next_seq_;
+					++zerocopy_blob_sends_;
+					continue;
+				}
+				if (sent < 0 && errno == EINTR) {
+					continue;
+				}
+				if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+					socket_.async_wait(socket_type::wait_write, boost::asio::bind_executor(write_strand_, continuation));
+					return;
+				}
+				if (sent < 0 && errno == ENOBUFS) {
+					// 未确认的零拷贝发送占满了 optmem, 剩余部分走普通写
+					break;
+				}
+				ec = boost::system::error_code(errno, boost::system::system_category());
+			}
+			if (ec) {
+				CYFON_LOG_ERROR("Zerocopy send failed: {}", ec.message());
+				onWriteComplete(ec);
+				return;
+			}
+			if (blob_sent_ == blob.size()) {
+				writeBlob();
+				return;
+			}
+		}
+#endif
+		// 内存区间 (或零拷贝没发完的剩余部分) 直接作为缓冲区写出, 生命周期由 pending.blob 保证
+		const uint64_t offset = blob_sent_;
+		blob_sent_ = blob.size();
+		boost::asio::async_write(socket_, boost::asio::buffer(blob.data() + offset, static_cast<size_t>(blob.size() - offset)),
+			boost::asio::bind_executor(write_strand_, continuation));
+		return;
+	}
+
+#if defined(__linux__)
+	// sendfile: 页缓存直接进 socket, 数据不经过用户态; 发送缓冲区满时等 socket 可写再继续
+	if (sendfile_ok_) {
+		boost::system::error_code ec;
+		socket_.native_non_blocking(true, ec);
+		while (!ec && blob_sent_ < blob.size()) {
+			off_t offset = static_cast<off_t>(blob.offset() + blob_sent_);
+			size_t length = static_cast<size_t>(std::min<uint64_t>(blob.size() - blob_sent_, kBlobChunkSize));
+			ssize_t sent = ::sendfile(socket_.native_handle(), blob.file() -> fd(), &offset, length);
+			if (sent > 0) {
+				blob_sent_ += static_cast<uint64_t>(sent);
+				continue;
+			}
+			if (sent < 0 && errno == EINTR) {
+				continue;
+			}
+			if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				socket_.async_wait(socket_type::wait_write, boost::asio::bind_executor(write_strand_, continuation));
+				return;
+			}
+			if (sent < 0 && (errno == EINVAL || errno == ENOSYS) && blob_sent_ == 0) {
+				CYFON_LOG_DEBUG("sendfile unavailable, falling back to buffered blob writes");
+				sendfile_ok_ = false;
+				break;
+			}
+			// 文件在发送期间被截短 (返回 0) 或其它错误: 头部已经发出, 只能断开连接
+			ec = sent == 0 ? boost::asio::error::eof : boost::system::error_code(errno, boost::system::system_category());
+		}
+		if (ec) {
+			CYFON_LOG_ERROR("sendfile failed: {}", ec.message());
+			onWriteComplete(ec);
+			return;
+		}
+		if (sendfile_ok_) {
+			writeBlob();
+			return;
+		}
+	}
+#endif
+
+	// 分块回退: 每次读出一块再写, 内存占用不超过一块
+	size_t length = static_cast<size_t>(std::min<uint64_t>(blob.size() - blob_sent_, kBlobChunkSize));
+	blob_chunk_.resize(length);
+	if (!blob.readAt(blob_sent_, blob_chunk_.data(), length)) {
+		CYFON_LOG_ERROR("Failed to read blob at {}", blob_sent_);
+		onWriteComplete(boost::asio::error::eof);
+		return;
+	}
+	blob_sent_ += length;
+	boost::asio::async_write(socket_, boost::asio::buffer(blob_chunk_),
+		boost::asio::bind_executor(write_strand_, continuation));
+}
+
+bool Session::enableZeroCopy() {
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	if (zerocopy_enabled_.load(std::memory_order_relaxed)) {
+		return true;
+	}
+	// Unix 域 socket 等不支持 SO_ZEROCOPY 的连接在这里失败, 之后一直走普通写
+	int one = 1;
+	if (::setsockopt(socket_.native_handle(), SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+		zerocopy_ok_ = false;
+		return false;
+	}
+	zerocopy_enabled_.store(true, std::memory_order_relaxed);
+	return true;
+#else
+	zerocopy_ok_ = false;
+	return false;
+#endif
+}
+
+void Session::reapZeroCopy() {
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	// 先挂上等待再读错误队列: 通知在两者之间到达也会唤醒等待, 不会因边沿触发而丢失
+	if (!zerocopy_waiting_) {
+		zerocopy_waiting_ = true;
+		socket_.async_wait(socket_type::wait_error, boost::asio::bind_executor(write_strand_,
+			[self = shared_from_this()](boost::system::error_code ec) {
+				self -> zerocopy_waiting_ = false;
+				// socket 已关闭时剩下的区间由 lingerZeroCopy 接管
+				if (!ec && !self -> zerocopy_holds_.empty()) {
+					self -> reapZeroCopy();
+				}
+			}));
+	}
+	drainZeroCopy(socket_.native_handle());
+#endif
+}
+
+void Session::drainZeroCopy([[maybe_unused]] int fd) {
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	while (!zerocopy_holds_.empty()) {
+		alignas(cmsghdr) char control[128];
+		msghdr msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+		for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+			if (!(cm -> cmsg_level == SOL_IP && cm -> cmsg_type == IP_RECVERR) &&
+				!(cm -> cmsg_level == SOL_IPV6 && cm -> cmsg_type == IPV6_RECVERR)) {
+				continue;
+			}
+			sock_extended_err err;
+			std::memcpy(&err, CMSG_DATA(cm), sizeof(err));
+			if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			// 内核退回了拷贝 (例如回环或网卡不支持 scatter-gather), 零拷贝只剩开销, 之后改走普通写
+			if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				zerocopy_ok_ = false;
+			}
+			// 一条通知确认 [ee_info, ee_data] 区间的发送; TCP 上通常按序到达, 但不依赖顺序
+			const uint32_t count = err.ee_data - err.ee_info + 1;
+			for (auto& hold : zerocopy_holds_) {
+				hold.pending -= seqOverlap(err.ee_info, count, hold.first_seq, hold.sends);
+			}
+			std::erase_if(zerocopy_holds_, [](const ZeroCopyHold& hold) { return hold.pending == 0; });
+		}
+	}
+#endif
+}
+
+void Session::lingerZeroCopy([[maybe_unused]] int fd, [[maybe_unused]] std::chrono::steady_clock::time_point deadline) {
+#if defined(CYFON_RPC_MSG_ZEROCOPY)
+	drainZeroCopy(fd);
+	if (zerocopy_holds_.empty() || std::chrono::steady_clock::now() >= deadline) {
+		zerocopy_holds_.clear();
+		::close(fd);
+		return;
+	}
+	// 关闭后的描述符没有可靠的就绪通知 (HUP 会反复唤醒), 改为定时轮询错误队列
+	auto timer = std::make_shared<boost::asio::steady_timer>(write_strand_, kZeroCopyLingerPoll);
+	timer -> async_wait([self = shared_from_this(), timer, fd, deadline](boost::system::error_code) {
+		self -> lingerZeroCopy(fd, deadline);
+	});
+#endif
+}
+
+void Session::onWriteComplete(const boost::system::error_code& ec) {
+	wheel_.cancel(write_timer_);
+	if (zerocopy_blob_sends_ > 0) {
+		// 写失败也要留住区间: 已经交给内核的页要等通知或关闭后的 linger 结束才能释放
+		zerocopy_holds_.push_back({ zerocopy_next_seq_ - zerocopy_blob_sends_, zerocopy_blob_sends_, zerocopy_blob_sends_, *inflight_frames_.back().blob });
+		zerocopy_blob_sends_ = 0;
+		reapZeroCopy();
+	}
+	if (!ec) {
+		last_activity_ = wheel_.now();
+		auto now = cyfon_rpc::MetricsRegistry::Clock::now();
+		auto& tracer = cyfon_rpc::Tracer::instance();
+		for (const auto& pending : inflight_frames_) {
+			server_.methodStats(pending.service_id, pending.method_id).write_time.record(
+				cyfon_rpc::MetricsRegistry::elapsedNanos(pending.queued_at, now));
+
+			if (pending.trace) {
+				uint64_t now_ns = cyfon_rpc::Tracer::toNanos(now);
+				tracer.record("do_write", pending.trace, cyfon_rpc::Tracer::toNanos(pending.queued_at), now_ns);
+				tracer.finish("rpc.server", pending.trace, now_ns);
+			}
+		}
+	}
+	inflight_frames_.clear();
+	if (blob_chunk_.capacity() > 0) {
+		std::vector<char>().swap(blob_chunk_);	// 分块回退的缓冲区不长期占用
+	}
+	if (ec) {
+		if (!closed_) {
+			CYFON_LOG_ERROR("write error {}", ec.message());
+		}
+		write_queue_.clear();
+		writing_ = false;
+		close("write failed");
+		return;
+	}
+
+	if (!write_queue_.empty()) {
+		flush_writes();
+	}
+	else {
+		writing_ = false;
+	}
+}
+
+void Session::handleRequest(const cyfon_rpc::RpcHeader& header, const std::string& payload, const cyfon_rpc::TraceContext& trace) {
+	auto& stats = server_.methodStats(header.service_id, header.method_id);
+	stats.requests.add();
+	stats.bytes_in.add(payload.size());
+
 	auto service= server_.getService(header.service_id);
 	if(!service) {
-		spdlog::error(" Service not found : {}", header.service_id);
+		CYFON_LOG_ERROR(" Service not found : {}", header.service_id);
+		stats.errors.add();
+		sendError(header, cyfon_rpc::RpcStatus::SERVICE_NOT_FOUND, "service not found");
 		return;
 	}
 
@@ -96,151 +934,321 @@ void Session::handleRequest(const cyfon_rpc::RpcHeader& header, const std::strin
 	// 根据方法类型处理
 	if(method_type == cyfon_rpc::MethodType::UNARY) {
 		// 普通RPC
-		server_.enqueueTask(header, payload, 
-			[self = shared_from_this()](std::span<const char> response_data) {
-				self -> do_write(response_data);
-			});
+		if (header.deadline_ms == 0) {
+			server_.enqueueTask(header, payload, 
+				[self = shared_from_this(), trace](std::span<const char> response_data) {
+					self -> do_write(response_data, trace);
+				}, trace);
+			return;
+		}
+
+		// 带截止时间的请求: 时间轮定时器和工作线程谁先把 completed 置位谁负责回复,
+		// 超时后到达的响应直接丢弃; 排队到截止时间还没开始执行的请求不会再调用业务方法
+		auto timeout = std::chrono::milliseconds(header.deadline_ms);
+		auto completed = std::make_shared<std::atomic<bool>>(false);
+		TimerId deadline_timer = wheel_.schedule(timeout, [weak = weak_from_this(), header, completed]() {
+			if (completed -> exchange(true)) {
+				return;
+			}
+			if (auto session = weak.lock()) {
+				session -> server_.methodStats(header.service_id, header.method_id).errors.add();
+				session -> sendError(header, cyfon_rpc::RpcStatus::DEADLINE_EXCEEDED, "deadline exceeded");
+			}
+		});
+
+		server_.enqueueTask(header, payload,
+			[self = shared_from_this(), trace, completed, deadline_timer](std::span<const char> response_data) {
+				if (completed -> exchange(true)) {
+					return;
+				}
+				self -> do_write(response_data, trace, deadline_timer);
+			}, trace, cyfon_rpc::MetricsRegistry::Clock::now() + timeout);
 	}
 	else if (method_type == cyfon_rpc::MethodType::SERVER_STREAMING) {
 		// 服务端流式
-		uint32_t stream_id = createStream(header);
+		uint32_t stream_id = createStream(header, method_type);
+		if (stream_id == 0) {
+			stats.errors.add();
+			sendError(header, cyfon_rpc::RpcStatus::RESOURCE_EXHAUSTED, "too many streams");
+			return;
+		}
 
-		spdlog::info("Created server streaming, stream_id={}, method_id={}",
+		CYFON_LOG_DEBUG("Created server streaming, stream_id={}, method_id={}",
 					stream_id, header.method_id);
 
+		// 两个回调都在工作线程上调用, sendStreamMessage 会切回会话线程再访问流表
 		cyfon_rpc::StreamContext stream_ctx(
 			[self = shared_from_this(), stream_id] (const std::string&message) {
 				self -> sendStreamMessage(stream_id, message);
 			},
 			[self = shared_from_this(), stream_id]() {
-				self -> closeStream(stream_id);
+				// 发送一帧空的 STREAM_END 通知客户端流已结束, 发送后关闭流
+				self -> sendStreamMessage(stream_id, std::string(), true);
 			});
 		
-		server_.enqueueStreamTask(header, payload, stream_ctx);
+		server_.enqueueStreamTask(header, payload, stream_ctx, streams_.executor(*streams_.find(stream_id)));
 	} 
 	else if (method_type == cyfon_rpc::MethodType::BIDIRECTIONAL) {
-		spdlog::warn("Bidirectional streaming not implemented yet");
+		CYFON_LOG_WARN("Bidirectional streaming not implemented yet");
+	}
+	else if (method_type == cyfon_rpc::MethodType::BLOB_RESPONSE) {
+		// 响应体是文件或内存区间: 头部单独成帧, 区间在写路径上直接交给内核; 截止时间只约束排队
+		auto deadline = header.deadline_ms != 0
+			? cyfon_rpc::MetricsRegistry::Clock::now() + std::chrono::milliseconds(header.deadline_ms)
+			: cyfon_rpc::MetricsRegistry::Clock::time_point::max();
+		server_.dispatchBlob(header.service_id, header.method_id, payload,
+			[self = shared_from_this(), header, trace](cyfon_rpc::RpcStatus status, std::string error, cyfon_rpc::BlobResponse blob) {
+				if (status != cyfon_rpc::RpcStatus::OK) {
+					cyfon_rpc::Buffer buffer;
+					buffer.append(error);
+					cyfon_rpc::prepend_header(buffer, cyfon_rpc::make_response_header(header, status, error.size()));
+					self -> do_write(buffer.readableBytesView(), trace);
+					return;
+				}
+				self -> sendBlob(header, std::move(blob), trace);
+			}, trace, deadline);
 	}
 	else if(method_type == cyfon_rpc::MethodType::CLIENT_STREAMING) {
 		// 客户端流式
-		uint32_t stream_id = createStream(header);
-		spdlog::info("Created client streaming, stream_id = {}, method_id = {}",
+		uint32_t stream_id = createStream(header, method_type);
+		if (stream_id == 0) {
+			stats.errors.add();
+			sendError(header, cyfon_rpc::RpcStatus::RESOURCE_EXHAUSTED, "too many streams");
+			return;
+		}
+		CYFON_LOG_DEBUG("Created client streaming, stream_id = {}, method_id = {}",
 			stream_id, header.method_id);
+
+		// 流ID由服务端分配, 先回一帧空的 STREAM_BEGIN 告诉客户端后续消息使用的 stream_id
+		sendStreamMessage(stream_id, std::string(), false, cyfon_rpc::Flag::STREAM_BEGIN);
 	}
 }
 
-void Session::handleStreamMessage(const cyfon_rpc::RpcHeader& header, const std::string& payload) {
-	std::lock_guard<std::mutex> lock(stream_mutex_);
+void Session::handleBatch(const cyfon_rpc::RpcHeader& header, const std::string& payload, const cyfon_rpc::TraceContext& trace) {
+	std::vector<cyfon_rpc::BatchCall> calls;
+	if (!cyfon_rpc::parse_batch_calls(payload, calls)) {
+		CYFON_LOG_WARN("Malformed batch, request_id={}", header.request_id);
+		sendError(header, cyfon_rpc::RpcStatus::INVALID_ARGUMENT, "malformed batch");
+		return;
+	}
+
+	// 子调用的 ID 来自网络, 先按注册表校验再取统计槽, 未注册的都记到 unknown
+	for (const auto& call : calls) {
+		auto& stats = server_.methodStats(call.service_id, call.method_id);
+		stats.requests.add();
+		stats.bytes_in.add(call.body.size());
+	}
+
+	auto deadline = header.deadline_ms != 0
+		? cyfon_rpc::MetricsRegistry::Clock::now() + std::chrono::milliseconds(header.deadline_ms)
+		: cyfon_rpc::MetricsRegistry::Clock::time_point::max();
+	bool run_inline = (header.flags & cyfon_rpc::Flag::BATCH_INLINE) != 0;
 
+	server_.dispatchBatch(std::move(calls), run_inline,
+		[self = shared_from_this(), header, trace](std::vector<cyfon_rpc::BatchResult> results) {
+			size_t size = sizeof(uint32_t);
+			for (const auto& result : results) {
+				size += cyfon_rpc::kBatchResultHeaderSize + result.payload.size();
+			}
+
+			cyfon_rpc::Buffer buffer(size);
+			buffer.appendInt<uint32_t>(static_cast<uint32_t>(results.size()));
+			for (const auto& result : results) {
+				cyfon_rpc::append_batch_result(buffer, result.status, result.payload);
+			}
+
+			cyfon_rpc::RpcHeader response_header = cyfon_rpc::make_response_header(header, cyfon_rpc::RpcStatus::OK, buffer.readableBytes());
+			response_header.message_type = static_cast<uint8_t>(cyfon_rpc::MessageType::BATCH);
+			cyfon_rpc::prepend_header(buffer, response_header);
+			self -> do_write(buffer.readableBytesView(), trace);
+		}, trace, deadline);
+}
+
+void Session::sendError(const cyfon_rpc::RpcHeader& request, cyfon_rpc::RpcStatus status, std::string_view message) {
+	cyfon_rpc::Buffer buffer;
+	buffer.append(message);
+	cyfon_rpc::prepend_header(buffer, cyfon_rpc::make_response_header(request, status, message.size()));
+	do_write(buffer.readableBytesView());
+}
+
+void Session::sendBlob(const cyfon_rpc::RpcHeader& request, cyfon_rpc::BlobResponse blob, const cyfon_rpc::TraceContext& trace) {
+	if (blob.size() > UINT32_MAX - sizeof(cyfon_rpc::RpcHeader) - cyfon_rpc::kChecksumSize) {
+		CYFON_LOG_ERROR("Blob of {} bytes does not fit in one frame", blob.size());
+		sendError(request, cyfon_rpc::RpcStatus::RESOURCE_EXHAUSTED, "blob too large");
+		return;
+	}
+	cyfon_rpc::RpcHeader header = cyfon_rpc::make_response_header(request, cyfon_rpc::RpcStatus::OK, static_cast<size_t>(blob.size()));
+
+	PendingWrite pending;
+	// 协商了校验时在工作线程上按块算好尾部, 写路径上不读文件内容, 区间照样零拷贝发送
+	const bool checksum = checksum_.load(std::memory_order_relaxed);
+	if (checksum) {
+		header.message_size += cyfon_rpc::kChecksumSize;
+		header.flags |= cyfon_rpc::Flag::CHECKSUM;
+	}
+	pending.frame.resize(sizeof(cyfon_rpc::RpcHeader));
+	cyfon_rpc::encode_header(header, pending.frame.data());
+	if (checksum) {
+		auto crc = cyfon_rpc::crc32c(blob, cyfon_rpc::crc32c(pending.frame.data(), pending.frame.size()));
+		if (!crc) {
+			CYFON_LOG_ERROR("Failed to read blob for checksum, request_id={}", request.request_id);
+			sendError(request, cyfon_rpc::RpcStatus::INTERNAL, "failed to read blob");
+			return;
+		}
+		pending.trailer = hostToNetwork(*crc);
+	}
+	pending.blob = std::move(blob);
+	pending.service_id = request.service_id;
+	pending.method_id = request.method_id;
+	pending.queued_at = cyfon_rpc::MetricsRegistry::Clock::now();
+	pending.trace = trace;
+
+	boost::asio::post(write_strand_, [self = shared_from_this(), pending = std::move(pending)]() mutable {
+		self -> queueWrite(std::move(pending));
+	});
+}
+
+void Session::sealChecksum(std::vector<char>& frame) {
+	cyfon_rpc::RpcHeader header;
+	if (!cyfon_rpc::deserialize_header(frame, header) || (header.flags & cyfon_rpc::Flag::CHECKSUM)) {
+		return;
+	}
+	header.message_size += cyfon_rpc::kChecksumSize;
+	header.flags |= cyfon_rpc::Flag::CHECKSUM;
+	cyfon_rpc::encode_header(header, frame.data());
+	uint32_t crc = hostToNetwork(cyfon_rpc::crc32c(frame.data(), frame.size()));
+	const char* trailer = reinterpret_cast<const char*>(&crc);
+	frame.insert(frame.end(), trailer, trailer + sizeof(crc));
+}
+
+void Session::sendPong(const cyfon_rpc::RpcHeader& ping) {
+	// 带 CHECKSUM 的 PING 是开启校验的请求; PONG 经 queueWrite 加上尾部和标志, 对端据此确认
+	if ((ping.flags & cyfon_rpc::Flag::CHECKSUM) && options_.enable_checksum && !checksum_.load(std::memory_order_relaxed)) {
+		checksum_.store(true, std::memory_order_relaxed);
+		CYFON_LOG_DEBUG("CRC32C checksums enabled for session");
+	}
+
+	cyfon_rpc::RpcHeader pong{};
+	pong.message_size = sizeof(cyfon_rpc::RpcHeader);
+	pong.service_id = ping.service_id;
+	pong.method_id = ping.method_id;
+	pong.request_id = ping.request_id;
+	pong.message_type = static_cast<uint8_t>(cyfon_rpc::MessageType::PONG);
+
+	cyfon_rpc::Buffer buffer;
+	cyfon_rpc::prepend_header(buffer, pong);
+	do_write(buffer.readableBytesView());
+}
+
+void Session::handleStreamMessage(const cyfon_rpc::RpcHeader& header, const std::string& payload) {
 	// 根据stream_id 查找流
-	auto it = streams_.find(header.stream_id);
-	if (it == streams_.end()) {
-		spdlog::warn("Stream not found: {}", header.stream_id);
+	cyfon_rpc::StreamState* stream = streams_.find(header.stream_id);
+	if (!stream) {
+		CYFON_LOG_WARN("Stream not found: {}", header.stream_id);
 		return ;
 	}
 
-	// Stream具体方法，这里是string流结构体
-	auto& stream = it -> second;
-
 	// 根据流方法推断
-	if (stream.method_type == cyfon_rpc::MethodType::CLIENT_STREAMING) {
-		stream.collected_message.push_back(payload);
-		stream.sequence_number++;
+	if (stream -> method_type == cyfon_rpc::MethodType::CLIENT_STREAMING) {
+		auto& messages = streams_.messages(*stream);
+		messages.push_back(payload);
+		stream -> sequence_number++;
 
 		// 检查是不是最后一条消息
 		if(header.flags & cyfon_rpc::Flag::STREAM_END) {
-			spdlog::info("Client streaming finished, stream_id= {}, total message = {}",
-				header.stream_id, stream.collected_message.size());
+			CYFON_LOG_DEBUG("Client streaming finished, stream_id= {}, total message = {}",
+				header.stream_id, messages.size());
 			
-			auto service = server_.getService(stream.service_id);
-			if (service) {
-				std::string response = service -> callClientStreaming(
-					stream.method_id,
-					stream.collected_message
-				);
-
-				cyfon_rpc::Buffer response_buffer;
-				response_buffer.append(response);
-
-				cyfon_rpc::RpcHeader response_header;
-                response_header.message_size = sizeof(cyfon_rpc::RpcHeader) + response.size();
-                response_header.service_id = stream.service_id;
-                response_header.method_id = stream.method_id;
-                response_header.request_id = stream.request_id;
-                response_header.stream_id = stream.stream_id;
-                response_header.sequence_number = 0;
-                response_header.message_type = static_cast<uint8_t>(cyfon_rpc::MessageType::RESPONSE);
-                response_header.flags = cyfon_rpc::Flag::NONE;
-                response_header.reserved = 0;
-
-				cyfon_rpc::prepend_header(response_buffer, response_header);
-				self -> do_write(response_buffer.readableBytesView());
-			}
+			// 处理函数放到流的串行队列上执行, 不阻塞 I/O 线程; 消息直接移交, 不再拷贝
+			cyfon_rpc::RpcHeader response_header{};
+			response_header.service_id = stream -> service_id;
+			response_header.method_id = stream -> method_id;
+			response_header.request_id = stream -> request_id;
+			response_header.stream_id = stream -> stream_id;
+
+			server_.enqueueClientStreamTask(stream -> service_id, stream -> method_id, std::move(messages), streams_.executor(*stream),
+				[self = shared_from_this(), response_header](cyfon_rpc::RpcStatus status, std::string response) {
+					cyfon_rpc::Buffer response_buffer;
+					response_buffer.append(response);
+					cyfon_rpc::prepend_header(response_buffer,
+						cyfon_rpc::make_response_header(response_header, status, response.size()));
+					self -> do_write(response_buffer.readableBytesView());
+				});
 			closeStream(header.stream_id);
 		}
 	}
-	else if (stream.method_type == cyfon_rpc::MethodType::BIDIRECTIONAL) {
-		spdlog::warn("Bidirectional streaming not implemented yet");
+	else if (stream -> method_type == cyfon_rpc::MethodType::BIDIRECTIONAL) {
+		CYFON_LOG_WARN("Bidirectional streaming not implemented yet");
 	}
 }
 
-uint32_t Session::createStream(const cyfon_rpc::RpcHeader& header) {
-	std::lock_guard<std::mutex> lock(stream_mutex_);
-
-	uint32_t stream_id = next_stream_id_++;
-
-	Stream stream;
-	stream.stream_id = stream_id;
-	stream.request_id = header.request_id;
-	stream.method_type = server_.getMethodType(header.service_id) -> getMethodType(header.method_id);
-	stream.service_id = header.service_id;
-	stream.method_id = header.method_id;
-	stream.is_active = true;
+uint32_t Session::createStream(const cyfon_rpc::RpcHeader& header, cyfon_rpc::MethodType method_type) {
+	cyfon_rpc::StreamState* stream = streams_.open();
+	if (!stream) {
+		CYFON_LOG_WARN("Stream table full ({} streams), rejecting request {}", streams_.size(), header.request_id);
+		return 0;
+	}
 
-	streams_[stream_id] = stream;
-	return stream_id;
+	stream -> request_id = header.request_id;
+	stream -> method_type = method_type;
+	stream -> service_id = header.service_id;
+	stream -> method_id = header.method_id;
+	streams_.executor(*stream) = server_.openStreamExecutor(worker_);
+	return stream -> stream_id;
 }
 
-void Session::sendStreamMessage(uint32_t stream_id, const std::string& message, bool is_end) {
-	std::lock_guard<std::mutex> lock(stream_mutex_);
+void Session::sendStreamMessage(uint32_t stream_id, std::string message, bool is_end, uint8_t flags) {
+	// 可以从任意线程调用: 帧在会话线程上组装, 流表不需要加锁
+	boost::asio::post(write_strand_, [self = shared_from_this(), stream_id, message = std::move(message), is_end, flags]() {
+		self -> writeStreamFrame(stream_id, message, is_end, flags);
+	});
+}
 
-	auto it = streams_.find(stream_id);
-	if (it == streams.end()) {
-		spdlog::warn("Cannot send message: stream not found {}", stream_id);
+void Session::writeStreamFrame(uint32_t stream_id, const std::string& message, bool is_end, uint8_t flags) {
+	cyfon_rpc::StreamState* stream = streams_.find(stream_id);
+	if (!stream) {
+		if (!closed_) {
+			CYFON_LOG_WARN("Cannot send message: stream not found {}", stream_id);
+		}
 		return;
 	}
 
-	auto& stream = it -> second;
-	stream.sequence_number++;
+	stream -> sequence_number++;
 
-	cyfon_rpc::Buffer buffer;
+	cyfon_rpc::Buffer buffer(message.size());
 	buffer.append(message);
 
-	cyfon_rpc::RpcHeader header;
+	cyfon_rpc::RpcHeader header{};
 	header.message_size = sizeof(cyfon_rpc::RpcHeader) + message.size();
-	header.service_id = stream.service_id;
-	header.method_id = stream.method_id;
-	header.request_id = stream.request_id;
-	header.stream_id = stream.stream_id;
-	header.sequence_number = stream.sequence_number;
+	header.service_id = stream -> service_id;
+	header.method_id = stream -> method_id;
+	header.request_id = stream -> request_id;
+	header.stream_id = stream -> stream_id;
+	header.sequence_number = stream -> sequence_number;
 	header.message_type = static_cast<uint8_t>(cyfon_rpc::MessageType::STREAM);
-	header.flags = is_end ? cyfon_rpc::Flag::STREAM_END : cyfon_rpc::Flag::NONE;
+	header.flags = flags | (is_end ? cyfon_rpc::Flag::STREAM_END : cyfon_rpc::Flag::NONE);
 	header.reserved = 0;
 
 	cyfon_rpc::prepend_header(buffer, header);
-	do_write(buffer.readableBytesView());
 
-	spdlog::debug("Sent stream message, stream_id={}, sequence_number={}, is_end={}",
-		 stream_id, stream.sequence_number, is_end);
-}
+	PendingWrite pending;
+	auto frame = buffer.readableBytesView();
+	pending.frame.assign(frame.begin(), frame.end());
+	pending.service_id = header.service_id;
+	pending.method_id = header.method_id;
+	pending.queued_at = cyfon_rpc::MetricsRegistry::Clock::now();
 
-void Session::closeStream(uint32_t stream_id) {
-	std::lock_guard<std::mutex> lock(stream_mutex_);
+	CYFON_LOG_DEBUG("Sent stream message, stream_id={}, sequence_number={}, is_end={}",
+		 stream_id, header.sequence_number, is_end);
 
-	auto it = streams_find(stream_id);
-	if(it != streams_.end()) {
-		spdlog::info("Closed stream, stream_id={}", stream_id);
-		streams_.erase(it);
+	if (is_end) {
+		closeStream(stream_id);
 	}
+	queueWrite(std::move(pending));
 }
 
+void Session::closeStream(uint32_t stream_id) {
+	if (streams_.close(stream_id)) {
+		CYFON_LOG_DEBUG("Closed stream, stream_id={}", stream_id);
+	}
+}
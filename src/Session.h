@@ -3,56 +3,210 @@
 #include <boost/asio.hpp>
 #include <memory>
 #include <iostream>
+#include "blob_response.h"
 #include "buffer.h"
+#include "header_codec.h"
 #include "rpc_header.h"
-#include <unordered_map>
-#include <mutex>
+#include "rpc_metrics.h"
+#include "rpc_trace.h"
+#include "timer_wheel.h"
+#include "stream_table.h"
 #include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <optional>
 
-class RpcServer;
+namespace cyfon_rpc {
+	class RpcServer;
+	enum class MethodType;
+	struct ChunkedCall;
+
+	// 会话超时配置, 全部由所在 I/O 线程的时间轮驱动
+	struct SessionOptions {
+		std::chrono::milliseconds idle_timeout{ 60'000 };	// 连续这么久既没有读到数据也没有写完数据就关闭连接
+		std::chrono::milliseconds read_timeout{ 30'000 };	// 收到半帧后这么久还没凑齐就关闭连接
+		std::chrono::milliseconds write_timeout{ 30'000 };	// 一次写迟迟不完成 (对端不读) 就关闭连接
+
+		// 缓冲区里没有半帧时用零字节读 (async_wait) 等待数据, 空闲连接可以完全归还读缓冲区
+		// 只对 epoll 等反应器后端生效, io_uring 后端下忽略, 始终直接提交 async_read_some
+		bool park_idle = true;
+		std::chrono::milliseconds reclaim_after{ 10'000 };	// 挂起的连接空闲这么久后释放读缓冲区
+
+		// 默认单帧上限, 服务可用 RpcServer::setMessageLimits 单独设置;
+		// 头部声明的长度超限时回复 RESOURCE_EXHAUSTED 并丢弃该帧的数据, 不为消息体预留内存
+		uint32_t max_message_size = kDefaultMaxMessageSize;
+
+		// 是否接受对端通过 PING 开启 CRC32C 尾部; 不论是否开启, 收到带 CHECKSUM 标志的帧都会校验,
+		// 开启之后不带尾部的帧按损坏处理
+		bool enable_checksum = true;
+	};
+}
 
 class Session : public std::enable_shared_from_this<Session> {
 public:
-	Session(boost::asio::ip::tcp::socket sock, cyfon_rpc::RpcServer& server)
+	// 会话统一使用通用流协议, TCP 和 AF_UNIX 连接共用同一条代码路径
+	using stream_protocol = boost::asio::generic::stream_protocol;
+	using socket_type = stream_protocol::socket;
+
+	// 会话固定在 wheel 所属的 I/O 线程上, 读回调、写 strand 和定时器回调都在该线程执行
+	Session(socket_type sock, cyfon_rpc::RpcServer& server, cyfon_rpc::TimerWheel& wheel,
+			const cyfon_rpc::SessionOptions& options = {})
 		: socket_(std::move(sock)),
 		  server_(server),
-		  write_strand_(socket_.get_executor()),
-		  next_stream_id_(1) {}
+		  write_strand_(boost::asio::make_strand(socket_.get_executor())),
+		  wheel_(wheel),
+		  options_(options) {}
 
-	void start() { do_read(); }
+	void start();
 
 private:
-	struct Stream {
-		uint32_t stream_id;					// 流ID
-		uint32_t request_id;				// 请求ID
-		cyfon_rpc::MethodType method_type;  // 方法类型
-		uint32_t service_id;				// 服务ID	
-		uint32_t method_id;					// 方法ID
-		uint32_t sequence_number;			// 消息序号
-		bool is_active;						// 是否活跃
-
-		// 客户端流: 收集客户端发送来的流信息
-		std::vector<std::string> collected_message;
-	};
+	using TimerId = cyfon_rpc::TimerWheel::TimerId;
 
 	void do_read();
+	void onRead(size_t length);
+	void onReadError(const boost::system::error_code& ec);
 	bool processMessage();
-	void do_write(std::span<const char> data);
+	// 分块接收或丢弃当前帧剩余的请求体, 只在 I/O 线程调用
+	bool consumeInbound();
+	void finishInbound();
+	void resumeRead();
+	// deadline_timer 非空时, 帧进入写队列前先取消该请求的超时定时器
+	void do_write(std::span<const char> data, const cyfon_rpc::TraceContext& trace = {}, TimerId deadline_timer = {});
+	// 零拷贝响应: 头部入队, 区间在写路径上直接交给内核; 可以在任意线程调用
+	void sendBlob(const cyfon_rpc::RpcHeader& request, cyfon_rpc::BlobResponse blob, const cyfon_rpc::TraceContext& trace);
+	void flush_writes();
+	// 以下只在 write_strand_ 上调用
+	void writeBlob();
+	void onWriteComplete(const boost::system::error_code& ec);
+	bool enableZeroCopy();
+	void reapZeroCopy();
+	void drainZeroCopy(int fd);
+	void lingerZeroCopy(int fd, std::chrono::steady_clock::time_point deadline);
+	void armWriteTimer();
+	struct PendingWrite;
+	void queueWrite(PendingWrite&& pending);
+
+	// 超时管理, 只在 I/O 线程调用
+	void armIdleTimer(std::chrono::milliseconds delay);
+	void onIdleTimer();
+	void close(std::string_view reason);
+	void sendPong(const cyfon_rpc::RpcHeader& ping);
+	void sealChecksum(std::vector<char>& frame);
+
+	// 读缓冲区管理, 只在 I/O 线程调用
+	size_t readSizeHint() const;
+	void reserveReadSpace();
+	void updateBufferGauge();
+	void armReclaimTimer(std::chrono::milliseconds delay);
+	void onReclaimTimer();
 
 	// 消息处理方法
-	void handleRequest(const cyfon_rpc::RpcHeader& header, const std::string& payload);
+	void handleRequest(const cyfon_rpc::RpcHeader& header, const std::string& payload, const cyfon_rpc::TraceContext& trace);
 	void handleStreamMessage(const cyfon_rpc::RpcHeader& header, const std::string& payload);
+	// BATCH: 一帧携带多个子调用, 合并成一个 BATCH 响应帧返回
+	void handleBatch(const cyfon_rpc::RpcHeader& header, const std::string& payload, const cyfon_rpc::TraceContext& trace);
+	void sendError(const cyfon_rpc::RpcHeader& request, cyfon_rpc::RpcStatus status, std::string_view message);
 
 	// 流管理方法
-	uint32_t createStream(const cyfon_rpc::RpcHeader& header);
-	void sendStreamMessage(uint32_t stream_id, const std::string& message, bool is_end = false);
+	// 流表只在会话线程上访问; 工作线程通过 sendStreamMessage 投递到 write_strand_
+	// 每条流有自己的串行队列, 优先在会话的工作线程 (worker_) 上执行, 同一条流的回调按顺序执行, 不需要加锁
+	uint32_t createStream(const cyfon_rpc::RpcHeader& header, cyfon_rpc::MethodType method_type);
+	void sendStreamMessage(uint32_t stream_id, std::string message, bool is_end = false, uint8_t flags = cyfon_rpc::Flag::NONE);
+	void writeStreamFrame(uint32_t stream_id, const std::string& message, bool is_end, uint8_t flags);
 	void closeStream(uint32_t stream_id);
 
-	boost::asio::ip::tcp::socket socket_;
+	socket_type socket_;
 	cyfon_rpc::Buffer socketBuffer_;
 	cyfon_rpc::RpcServer& server_;
-	boost::asio::strand<boost::asio::io_context::executor_type> write_strand_;
-	std::unordered_map<uint32_t, Stream> streams_;
-	uint32_t next_stream_id_;
-	std::mutex stream_mutex_;
+	boost::asio::strand<socket_type::executor_type> write_strand_;
+
+	cyfon_rpc::TimerWheel& wheel_;
+	cyfon_rpc::SessionOptions options_;
+	TimerId idle_timer_;
+	TimerId read_timer_;
+	TimerId write_timer_;
+	TimerId reclaim_timer_;
+	cyfon_rpc::TimerWheel::Clock::time_point last_activity_;
+	bool closed_ = false;
+
+	size_t avg_message_size_ = kMinReadSize / 2;	// 近期消息大小的移动平均
+	size_t pending_frame_size_ = 0;				// 缓冲区中半帧的总长度, 没有半帧时为 0
+	bool parked_ = false;						// 正挂起在零字节读上
+	size_t accounted_buffer_bytes_ = 0;			// 已计入 session_stats_ 的读缓冲区容量
+	cyfon_rpc::SessionStats* session_stats_ = nullptr;	// 所属 I/O 线程的连接统计
+
+	// 单次 gather 写最多合并的帧数, 不超过常见的 IOV_MAX
+	static constexpr size_t kMaxCoalescedFrames = 64;
+	// 区间分块读写的块大小, 也是单次 sendfile 的上限
+	static constexpr size_t kBlobChunkSize = 256 * 1024;
+
+	// 读缓冲区大小策略
+	static constexpr size_t kMinReadSize = 4 * 1024;
+	static constexpr size_t kMaxReadSize = 256 * 1024;		// 按近期消息大小准备的上限
+	static constexpr size_t kMaxReadAhead = 4 * 1024 * 1024;	// 已知大帧时单次最多预留
+	static constexpr size_t kRetainedBufferSize = 64 * 1024;	// 不超过这个容量就不收缩
+	static constexpr size_t kShrinkFactor = 4;					// 容量超过目标大小的倍数才收缩
+
+	// 一个待发送的帧, 记录路由和入队时间用于写完成耗时统计
+	struct PendingWrite {
+		std::vector<char> frame;
+		std::optional<cyfon_rpc::BlobResponse> blob;	// 非空时 frame 只是头部, 写完头部后接着发送区间
+		std::optional<uint32_t> trailer;				// 区间之后的 CRC32C 尾部 (网络字节序)
+		uint32_t service_id;
+		uint32_t method_id;
+		cyfon_rpc::MetricsRegistry::Clock::time_point queued_at;
+		cyfon_rpc::TraceContext trace;	// 响应帧所属链路, 写完成时结束服务端根 span
+	};
+
+	// 写队列, 只在 write_strand_ 上访问
+	std::deque<PendingWrite> write_queue_;					// 等待发送的帧
+	std::vector<PendingWrite> inflight_frames_;				// 正在发送的帧
+	std::vector<boost::asio::const_buffer> write_buffers_;	// 对应的 gather 缓冲区
+	bool writing_ = false;
+	uint64_t blob_sent_ = 0;		// 当前区间已发送的字节数
+	std::vector<char> blob_chunk_;	// 不能 sendfile 时逐块读出的数据, 也用来写尾部
+	bool sendfile_ok_ = true;		// sendfile 对这个 socket 或文件不可用时退回分块读写
+
+	// MSG_ZEROCOPY 发出的内存区间: 内核在错误队列里确认 [first_seq, first_seq + sends) 全部完成之前,
+	// 页仍被内核引用, BlobResponse 的副本留在这里保证 owner 不被释放
+	struct ZeroCopyHold {
+		uint32_t first_seq;
+		uint32_t sends;
+		uint32_t pending;	// 还没确认的发送次数
+		cyfon_rpc::BlobResponse blob;
+	};
+	static constexpr uint64_t kZeroCopyThreshold = 16 * 1024;	// 更小的区间 pin 页和完成通知的开销超过一次拷贝
+	std::deque<ZeroCopyHold> zerocopy_holds_;
+	uint32_t zerocopy_next_seq_ = 0;	// 与内核对这个 socket 的 MSG_ZEROCOPY 发送计数保持一致
+	uint32_t zerocopy_blob_sends_ = 0;	// 当前区间用 MSG_ZEROCOPY 成功发送的次数
+	bool zerocopy_ok_ = true;			// socket 不支持或内核退回了拷贝 (例如回环) 时不再尝试
+	bool zerocopy_waiting_ = false;		// 错误队列上已挂起 async_wait
+	std::atomic<bool> zerocopy_enabled_{ false };	// 已打开 SO_ZEROCOPY; close 在 I/O 线程上读取
+	cyfon_rpc::StreamTable streams_;
+	size_t worker_ = 0;		// 会话的流和分块请求优先在这个工作线程上执行, start 时分配
+
+	// 正在分块接收或丢弃的请求体; 它占着字节流, 同一时刻最多一个, 只在 I/O 线程访问
+	struct InboundBody {
+		cyfon_rpc::RpcHeader header;
+		std::shared_ptr<cyfon_rpc::ChunkedCall> call;	// 为空表示帧超限, 到达的数据直接丢弃
+		size_t remaining = 0;
+		cyfon_rpc::TraceContext trace;
+		bool checksum = false;		// 请求体后跟 CRC32C 尾部, 边读边累计
+		bool corrupted = false;
+		uint32_t crc = 0;
+	};
+	std::optional<InboundBody> inbound_;
+	// 已交给工作线程还没处理完的数据块字节数; 超过上限时暂停读, 消化到一半以下再恢复
+	std::atomic<size_t> chunk_backlog_{ 0 };
+	bool read_paused_ = false;
+	std::atomic<bool> checksum_{ false };	// 已协商 CRC32C 尾部; I/O 线程写, 工作线程发送文件区间前读
+	static constexpr size_t kMaxChunkBacklog = 4 * 1024 * 1024;
+	static constexpr size_t kResumeChunkBacklog = kMaxChunkBacklog / 2;
+
+	// 链路追踪: 当前待解析消息首字节到达的时间, 以及最近一次读完成的时间
+	uint64_t first_byte_ns_ = 0;
+	uint64_t last_read_ns_ = 0;
 };
\ No newline at end of file
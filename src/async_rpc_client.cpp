@@ -0,0 +1,224 @@
+#include "async_rpc_client.h"
+#include "rpc_protocol_utils.h"
+#include "rpc_log.h"
+
+namespace cyfon_rpc {
+
+	AsyncRpcClient::AsyncRpcClient(const boost::asio::any_io_executor& executor)
+		: socket_(executor),
+		  strand_(boost::asio::make_strand(executor)) {
+	}
+
+	AsyncRpcClient::AsyncRpcClient(stream_protocol::socket socket)
+		: socket_(std::move(socket)),
+		  strand_(boost::asio::make_strand(socket_.get_executor())) {
+	}
+
+	bool AsyncRpcClient::connect(const std::string& host, unsigned short port) {
+		boost::system::error_code ec;
+		boost::asio::ip::tcp::resolver resolver(socket_.get_executor());
+		auto endpoints = resolver.resolve(host, std::to_string(port), ec);
+		if (ec) {
+			CYFON_LOG_ERROR("resolve {} failed: {}", host, ec.message());
+			return false;
+		}
+
+		ec = boost::asio::error::host_not_found;
+		for (const auto& entry : endpoints) {
+			socket_.close(ec);
+			socket_.connect(stream_protocol::endpoint(entry.endpoint()), ec);
+			if (!ec) {
+				// 小请求不等待 Nagle 合并
+				socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+				return true;
+			}
+		}
+		CYFON_LOG_ERROR("connect error: {}", ec.message());
+		return false;
+	}
+
+	bool AsyncRpcClient::connectLocal(const std::string& path) {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		boost::system::error_code ec;
+		socket_.close(ec);
+		socket_.connect(boost::asio::local::stream_protocol::endpoint(path), ec);
+		if (ec) {
+			CYFON_LOG_ERROR("local connect error: {}", ec.message());
+			return false;
+		}
+		return true;
+#else
+		CYFON_LOG_ERROR("local sockets are not supported on this platform");
+		return false;
+#endif
+	}
+
+	void AsyncRpcClient::start() {
+		boost::asio::dispatch(strand_, [self = shared_from_this()]() {
+			self -> do_read();
+		});
+	}
+
+	void AsyncRpcClient::close() {
+		boost::asio::dispatch(strand_, [self = shared_from_this()]() {
+			boost::system::error_code ec;
+			self -> socket_.shutdown(boost::asio::socket_base::shutdown_both, ec);
+			self -> socket_.close(ec);
+			self -> failAll("client closed");
+		});
+	}
+
+	uint32_t AsyncRpcClient::call(uint32_t service_id, uint32_t method_id, std::string payload,
+								  ReplyCallback callback, uint8_t flags, uint32_t deadline_ms) {
+		uint32_t request_id = next_request_id_.fetch_add(1, std::memory_order_relaxed);
+
+		RpcHeader header{};
+		header.message_size = static_cast<uint32_t>(sizeof(RpcHeader) + payload.size());
+		header.service_id = service_id;
+		header.method_id = method_id;
+		header.request_id = request_id;
+		header.message_type = static_cast<uint8_t>(MessageType::REQUEST);
+		header.flags = flags;
+		header.deadline_ms = deadline_ms;
+
+		Buffer buffer(payload.size());
+		buffer.append(payload);
+		prepend_header(buffer, header);
+
+		pending_count_.fetch_add(1, std::memory_order_relaxed);
+		boost::asio::post(strand_,
+			[self = shared_from_this(), request_id, frame = std::string(buffer.toStringView()), cb = std::move(callback)]() mutable {
+				if (self -> closed_) {
+					self -> pending_count_.fetch_sub(1, std::memory_order_relaxed);
+					RpcHeader header{};
+					header.request_id = request_id;
+					cb(RpcStatus::UNAVAILABLE, header, "connection closed", true);
+					return;
+				}
+				self -> callbacks_.emplace(request_id, std::move(cb));
+				self -> write_queue_.push_back(std::move(frame));
+				if (!self -> writing_) {
+					self -> flush_writes();
+				}
+			});
+		return request_id;
+	}
+
+	void AsyncRpcClient::cancel(uint32_t request_id) {
+		boost::asio::post(strand_, [self = shared_from_this(), request_id]() {
+			if (self -> callbacks_.erase(request_id)) {
+				self -> pending_count_.fetch_sub(1, std::memory_order_relaxed);
+			}
+		});
+	}
+
+	void AsyncRpcClient::do_read() {
+		read_buffer_.ensureWritableBytes(4096);
+		auto writable = read_buffer_.writableBytesView();
+		socket_.async_read_some(boost::asio::buffer(writable.data(), writable.size()),
+			boost::asio::bind_executor(strand_,
+				[self = shared_from_this()](boost::system::error_code ec, size_t length) {
+					if (ec) {
+						if (ec != boost::asio::error::eof && ec != boost::asio::error::operation_aborted) {
+							CYFON_LOG_ERROR("client read error: {}", ec.message());
+						}
+						self -> failAll("connection lost");
+						return;
+					}
+					self -> read_buffer_.hasWritten(length);
+					while (self -> processReply()) {
+					}
+					if (!self -> closed_) {
+						self -> do_read();
+					}
+				}));
+	}
+
+	bool AsyncRpcClient::processReply() {
+		RpcHeader header;
+		auto header_status = decode_header(read_buffer_.readableBytesView(), header);
+		if (header_status == HeaderStatus::INCOMPLETE) {
+			return false;
+		}
+		if (header_status != HeaderStatus::OK) {
+			CYFON_LOG_ERROR("malformed reply, message_size={}", header.message_size);
+			boost::system::error_code ec;
+			socket_.close(ec);
+			failAll("malformed reply");
+			return false;
+		}
+		if (read_buffer_.readableBytes() < header.message_size) {
+			return false;
+		}
+
+		read_buffer_.retrieve(sizeof(RpcHeader));
+		size_t payload_size = header.message_size - sizeof(RpcHeader);
+		std::string_view payload(read_buffer_.peek(), payload_size);
+
+		auto type = static_cast<MessageType>(header.message_type);
+		auto it = callbacks_.find(header.request_id);
+		if (it == callbacks_.end()) {
+			CYFON_LOG_DEBUG("drop reply for unknown request_id={}", header.request_id);
+		}
+		else if (type == MessageType::STREAM && !(header.flags & Flag::STREAM_END)) {
+			it -> second(RpcStatus::OK, header, payload, false);
+		}
+		else {
+			RpcStatus status = type == MessageType::ERROR ? static_cast<RpcStatus>(header.reserved) : RpcStatus::OK;
+			// 先从表中移除再回调, 回调里可以放心地发起下一次调用
+			ReplyCallback cb = std::move(it -> second);
+			callbacks_.erase(it);
+			pending_count_.fetch_sub(1, std::memory_order_relaxed);
+			cb(status, header, payload, true);
+		}
+
+		read_buffer_.retrieve(payload_size);
+		return true;
+	}
+
+	void AsyncRpcClient::flush_writes() {
+		writing_ = true;
+
+		size_t count = std::min(write_queue_.size(), kMaxCoalescedFrames);
+		for (size_t i = 0; i < count; ++i) {
+			inflight_frames_.push_back(std::move(write_queue_.front()));
+			write_queue_.pop_front();
+		}
+
+		write_buffers_.clear();
+		for (const auto& frame : inflight_frames_) {
+			write_buffers_.emplace_back(boost::asio::buffer(frame));
+		}
+
+		boost::asio::async_write(socket_, write_buffers_,
+			boost::asio::bind_executor(strand_,
+				[self = shared_from_this()](boost::system::error_code ec, size_t /*length*/) {
+					self -> inflight_frames_.clear();
+					if (ec) {
+						CYFON_LOG_ERROR("client write error: {}", ec.message());
+						self -> write_queue_.clear();
+						self -> writing_ = false;
+						self -> failAll("write failed");
+						return;
+					}
+					if (!self -> write_queue_.empty()) {
+						self -> flush_writes();
+					}
+					else {
+						self -> writing_ = false;
+					}
+				}));
+	}
+
+	void AsyncRpcClient::failAll(std::string_view reason) {
+		closed_.store(true, std::memory_order_relaxed);
+		auto callbacks = std::move(callbacks_);
+		callbacks_.clear();
+		for (auto& [request_id, cb] : callbacks) {
+			pending_count_.fetch_sub(1, std::memory_order_relaxed);
+			RpcHeader header{};
+			header.request_id = request_id;
+			cb(RpcStatus::UNAVAILABLE, header, reason, true);
+		}
+	}
+}
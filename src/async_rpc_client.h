@@ -0,0 +1,78 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "buffer.h"
+#include "rpc_header.h"
+
+namespace cyfon_rpc {
+
+	// 异步客户端: 一条连接上同时挂起多个调用, 回复按 request_id 分发给各自的回调
+	// 内部状态只在 strand_ 上访问, call 可以从任意线程发起; 回调在 strand_ 上执行
+	class AsyncRpcClient : public std::enable_shared_from_this<AsyncRpcClient> {
+	public:
+		using stream_protocol = boost::asio::generic::stream_protocol;
+
+		// 收到一帧回复时调用
+		// last 为 true 表示调用结束: RESPONSE / ERROR, 或者带 STREAM_END 的 STREAM 帧
+		// 连接断开时所有挂起的调用以 UNAVAILABLE 结束
+		using ReplyCallback = std::function<void(RpcStatus status, const RpcHeader& header, std::string_view payload, bool last)>;
+
+		explicit AsyncRpcClient(const boost::asio::any_io_executor& executor);
+		// 接管一条已经连接好的 socket, 例如 local::connect_pair 得到的一端; 之后直接 start
+		explicit AsyncRpcClient(stream_protocol::socket socket);
+
+		bool connect(const std::string& host, unsigned short port);
+		// 通过 AF_UNIX 连接本机服务端
+		bool connectLocal(const std::string& path);
+
+		// 连接成功后调用一次, 开始接收回复
+		void start();
+		void close();
+
+		// 发起一次调用, 返回本连接上分配的 request_id
+		// deadline_ms 非 0 时随请求头发给服务端, 超时后服务端回复 DEADLINE_EXCEEDED
+		uint32_t call(uint32_t service_id, uint32_t method_id, std::string payload,
+					  ReplyCallback callback, uint8_t flags = Flag::NONE, uint32_t deadline_ms = 0);
+
+		// 放弃一次尚未结束的调用: 它的回调不再被调用, 之后到达的回复直接丢弃
+		// 服务端仍会执行该请求; 对已结束或不存在的 request_id 是空操作
+		void cancel(uint32_t request_id);
+
+		[[nodiscard]] bool isOpen() const noexcept { return !closed_.load(std::memory_order_relaxed); }
+
+		// 尚未结束的调用数
+		[[nodiscard]] size_t pending() const noexcept { return pending_count_.load(std::memory_order_relaxed); }
+
+	private:
+		void do_read();
+		bool processReply();
+		void flush_writes();
+		void failAll(std::string_view reason);
+
+		// 单次 gather 写最多合并的帧数, 与服务端 Session 保持一致
+		static constexpr size_t kMaxCoalescedFrames = 64;
+
+		stream_protocol::socket socket_;
+		boost::asio::strand<boost::asio::any_io_executor> strand_;
+		Buffer read_buffer_;
+
+		std::unordered_map<uint32_t, ReplyCallback> callbacks_;
+		std::deque<std::string> write_queue_;
+		std::vector<std::string> inflight_frames_;
+		std::vector<boost::asio::const_buffer> write_buffers_;
+		bool writing_ = false;
+		std::atomic<bool> closed_{ false };
+
+		std::atomic<uint32_t> next_request_id_{ 1 };
+		std::atomic<size_t> pending_count_{ 0 };
+	};
+}
@@ -0,0 +1,147 @@
+#include "blob_response.h"
+#include "crc32c.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cyfon_rpc {
+
+	std::shared_ptr<const BlobFile> BlobFile::open(const std::string& path) {
+		std::shared_ptr<BlobFile> file(new BlobFile());
+#if defined(_WIN32)
+		HANDLE handle = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			return nullptr;
+		}
+		file -> handle_ = handle;
+		LARGE_INTEGER size;
+		if (!::GetFileSizeEx(handle, &size)) {
+			return nullptr;
+		}
+		file -> size_ = static_cast<uint64_t>(size.QuadPart);
+#else
+		file -> fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file -> fd_ < 0) {
+			return nullptr;
+		}
+		struct stat st;
+		if (::fstat(file -> fd_, &st) != 0 || !S_ISREG(st.st_mode)) {
+			return nullptr;
+		}
+		file -> size_ = static_cast<uint64_t>(st.st_size);
+#endif
+		return file;
+	}
+
+	BlobFile::~BlobFile() {
+#if defined(_WIN32)
+		if (handle_) {
+			::CloseHandle(handle_);
+		}
+#else
+		if (fd_ >= 0) {
+			::close(fd_);
+		}
+#endif
+	}
+
+	bool BlobFile::readAt(uint64_t offset, char* out, size_t length) const {
+		while (length > 0) {
+#if defined(_WIN32)
+			OVERLAPPED overlapped{};
+			overlapped.Offset = static_cast<DWORD>(offset);
+			overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+			DWORD read = 0;
+			DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 1u << 30));
+			if (!::ReadFile(handle_, out, chunk, &read, &overlapped) || read == 0) {
+				return false;
+			}
+#else
+			ssize_t read = ::pread(fd_, out, length, static_cast<off_t>(offset));
+			if (read < 0 && errno == EINTR) {
+				continue;
+			}
+			if (read <= 0) {
+				return false;		// 出错, 或文件在发送期间被截短
+			}
+#endif
+			out += read;
+			offset += static_cast<uint64_t>(read);
+			length -= static_cast<size_t>(read);
+		}
+		return true;
+	}
+
+	std::optional<BlobResponse> BlobResponse::fromFile(const std::string& path, uint64_t offset, uint64_t length) {
+		auto file = BlobFile::open(path);
+		if (!file) {
+			return std::nullopt;
+		}
+		return fromFile(std::move(file), offset, length);
+	}
+
+	std::optional<BlobResponse> BlobResponse::fromFile(std::shared_ptr<const BlobFile> file, uint64_t offset, uint64_t length) {
+		if (!file || offset > file -> size()) {
+			return std::nullopt;
+		}
+		uint64_t available = file -> size() - offset;
+		if (length == npos) {
+			length = available;
+		}
+		if (length > available) {
+			return std::nullopt;
+		}
+		BlobResponse blob;
+		blob.file_ = std::move(file);
+		blob.offset_ = offset;
+		blob.size_ = length;
+		return blob;
+	}
+
+	BlobResponse BlobResponse::fromMemory(std::shared_ptr<const void> owner, const char* data, size_t size) {
+		BlobResponse blob;
+		blob.owner_ = std::move(owner);
+		blob.data_ = data;
+		blob.size_ = size;
+		return blob;
+	}
+
+	bool BlobResponse::readAt(uint64_t pos, char* out, size_t length) const {
+		if (pos > size_ || length > size_ - pos) {
+			return false;
+		}
+		if (file_) {
+			return file_ -> readAt(offset_ + pos, out, length);
+		}
+		std::memcpy(out, data_ + pos, length);
+		return true;
+	}
+
+	std::optional<uint32_t> crc32c(const BlobResponse& blob, uint32_t crc) {
+		if (!blob.isFile()) {
+			return crc32c(blob.data(), blob.size(), crc);
+		}
+		constexpr size_t kChunkSize = 256 * 1024;
+		std::vector<char> chunk(static_cast<size_t>(std::min<uint64_t>(blob.size(), kChunkSize)));
+		for (uint64_t pos = 0; pos < blob.size(); pos += chunk.size()) {
+			size_t length = static_cast<size_t>(std::min<uint64_t>(blob.size() - pos, chunk.size()));
+			if (!blob.readAt(pos, chunk.data(), length)) {
+				return std::nullopt;
+			}
+			crc = crc32c(chunk.data(), length, crc);
+		}
+		return crc;
+	}
+}
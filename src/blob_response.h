@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+namespace cyfon_rpc {
+
+	// 只读打开的文件, 多个 BlobResponse 可以共享同一个句柄, 最后一个引用释放时关闭
+	class BlobFile {
+	public:
+		// 打开失败返回 nullptr
+		static std::shared_ptr<const BlobFile> open(const std::string& path);
+		~BlobFile();
+
+		BlobFile(const BlobFile&) = delete;
+		BlobFile& operator=(const BlobFile&) = delete;
+
+		[[nodiscard]] uint64_t size() const noexcept { return size_; }
+
+		// 从 offset 处读 length 字节, 不移动文件位置, 多线程可以同时调用; 读满返回 true
+		bool readAt(uint64_t offset, char* out, size_t length) const;
+
+#if !defined(_WIN32)
+		[[nodiscard]] int fd() const noexcept { return fd_; }
+#endif
+
+	private:
+		BlobFile() = default;
+
+#if defined(_WIN32)
+		void* handle_ = nullptr;
+#else
+		int fd_ = -1;
+#endif
+		uint64_t size_ = 0;
+	};
+
+	// 零拷贝响应体: 文件的一段区间, 或调用方持有的一段只读内存 (例如 mmap 映射)
+	// 会话先写响应头, 再把区间直接交给内核: Linux 上文件区间用 sendfile, 数据不经过用户态;
+	// 其它平台或文件系统不支持 sendfile 时按块读出再写. 内存区间在 Linux TCP 连接上用 MSG_ZEROCOPY 发送,
+	// 会话在错误队列收到内核的完成通知后才释放它, 所以 owner 可能比响应写完活得更久; 小区间、Unix 域 socket
+	// 或内核退回拷贝 (例如回环) 的连接上直接作为 gather 缓冲区写出
+	// 对象可以廉价拷贝, 底层文件或内存由 shared_ptr 保证在写完之前有效; 内容在发送期间不应被修改
+	class BlobResponse {
+	public:
+		BlobResponse() = default;
+
+		// 文件的 [offset, offset + length) 区间, length 为 npos 表示到文件末尾; 打开失败或区间越界返回 nullopt
+		static std::optional<BlobResponse> fromFile(const std::string& path, uint64_t offset = 0, uint64_t length = npos);
+		static std::optional<BlobResponse> fromFile(std::shared_ptr<const BlobFile> file, uint64_t offset = 0, uint64_t length = npos);
+
+		// 内存区间, owner 负责区间的生命周期
+		static BlobResponse fromMemory(std::shared_ptr<const void> owner, const char* data, size_t size);
+
+		[[nodiscard]] uint64_t size() const noexcept { return size_; }
+		[[nodiscard]] bool isFile() const noexcept { return file_ != nullptr; }
+		[[nodiscard]] const BlobFile* file() const noexcept { return file_.get(); }
+		[[nodiscard]] uint64_t offset() const noexcept { return offset_; }
+		[[nodiscard]] const char* data() const noexcept { return data_; }
+
+		// 把区间内 [pos, pos + length) 读到 out, 供不能零拷贝的路径使用 (分块回退、计算校验和)
+		bool readAt(uint64_t pos, char* out, size_t length) const;
+
+		static constexpr uint64_t npos = UINT64_MAX;
+
+	private:
+		std::shared_ptr<const BlobFile> file_;
+		std::shared_ptr<const void> owner_;
+		const char* data_ = nullptr;
+		uint64_t offset_ = 0;
+		uint64_t size_ = 0;
+	};
+
+	// 按块计算区间的 CRC32C, crc 为之前各段的结果, 读文件失败返回 nullopt; 协商了校验的连接在工作线程上调用
+	std::optional<uint32_t> crc32c(const BlobResponse& blob, uint32_t crc = 0);
+}
@@ -7,41 +7,13 @@
 #include <algorithm>
 #include <assert.h>
 #include <string_view>
-#include <WinSock2.h>
 #include <cstdint>
 #include <type_traits>
 #include <span>
 #include <cstddef>
 #include <concepts>
+#include "byte_order.h"
 
-
-#if __cplusplus >= 202002L && __has_include(<bit>)
-#include <bit>
-#endif
-
-template<std::integral T>
-T hostToNetwork(T value) noexcept {
-#if __cplusplus >= 202302L
-	if constexpr (std::endian::native == std::endian::little) {
-		return std::byteswap(value);
-	}
-#endif
-	if constexpr (sizeof(T) == 8) {
-		return static_cast<T>(htonll(static_cast<uint64_t>(value)));
-	}
-	else if constexpr (sizeof(T) == 4) {
-		return static_cast<T>(htonl(static_cast<uint32_t>(value)));
-	}
-	else if constexpr (sizeof(T) == 2) {
-		return static_cast<T>(htons(static_cast<uint16_t>(value)));
-	}
-	return value; 
-}
-
-template<std::integral T>
-T networkToHost(T value) noexcept {
-	return hostToNetwork(value); 
-}
 	// +-------------------+------------------+------------------+
 	// | prependable bytes |  readable bytes  |  writable bytes  |
 	// |                   |     (CONTENT)    |                  |
@@ -52,8 +24,8 @@ T networkToHost(T value) noexcept {
 namespace cyfon_rpc {
 	class Buffer {
 	public:
-		// 头部预留8字节
-		static constexpr size_t kCheapPrepend = 8;
+		// 头部预留32字节, 正好放下一个 RpcHeader, 响应可以直接 prepend_header 而不搬移数据
+		static constexpr size_t kCheapPrepend = 32;
 		// 初始缓冲区大小1024字节
 		static constexpr size_t kInitialSize = 1024;
 
@@ -259,8 +231,29 @@ namespace cyfon_rpc {
 			buffer_.shrink_to_fit();
 		}
 
-		// 直接从socket fd读取数据到缓冲区
-		size_t readSock(boost::asio::ip::tcp::socket&, boost::system::error_code&);
+		// 把容量收缩到 可读数据 + writable, 头部依然保留 kCheapPrepend
+		// 用于长连接归还大消息留下的内存; writable 为 0 且没有可读数据时只剩预留头部
+		void shrinkTo(size_t writable) {
+			size_t readable = readableBytes();
+			std::vector<char> new_buffer(kCheapPrepend + readable + writable);
+			if (readable > 0) {
+				std::memcpy(new_buffer.data() + kCheapPrepend, peek(), readable);
+			}
+			buffer_.swap(new_buffer);
+			readerIndex_ = kCheapPrepend;
+			writerIndex_ = readerIndex_ + readable;
+		}
+
+		// 直接从socket读取数据到缓冲区, 适用于任意同步读流 (tcp / local / generic)
+		template<typename SyncReadStream>
+		size_t readSock(SyncReadStream& sock, boost::system::error_code& ec) {
+			auto writable_view = writableBytesView();
+			size_t n = sock.read_some(boost::asio::buffer(writable_view.data(), writable_view.size()), ec);
+			if (!ec && n > 0) {
+				hasWritten(n);
+			}
+			return n;
+		}
 
 	private:
 
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <type_traits>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <stdlib.h>
+#endif
+
+// 可移植的字节序转换, 不依赖 WinSock2 / arpa/inet.h
+// - 有 std::byteswap (C++23) 时直接使用
+// - 否则 GCC/Clang 用 __builtin_bswap*, MSVC 用 _byteswap_*, 编译期求值时退回移位实现
+// - 大端主机上 hostToNetwork / networkToHost 是恒等变换
+// 全部是 constexpr, 协议里的常量也可以在编译期转换
+
+template<std::integral T>
+constexpr T byteSwap(T value) noexcept {
+	if constexpr (sizeof(T) == 1) {
+		return value;
+	}
+	else {
+#if defined(__cpp_lib_byteswap)
+		return std::byteswap(value);
+#else
+		using U = std::make_unsigned_t<T>;
+		U bits = static_cast<U>(value);
+#if defined(__GNUC__) || defined(__clang__)
+		if constexpr (sizeof(T) == 2) {
+			return static_cast<T>(__builtin_bswap16(bits));
+		}
+		else if constexpr (sizeof(T) == 4) {
+			return static_cast<T>(__builtin_bswap32(bits));
+		}
+		else {
+			static_assert(sizeof(T) == 8, "unsupported integer width");
+			return static_cast<T>(__builtin_bswap64(bits));
+		}
+#else
+		if (!std::is_constant_evaluated()) {
+#if defined(_MSC_VER)
+			if constexpr (sizeof(T) == 2) {
+				return static_cast<T>(_byteswap_ushort(bits));
+			}
+			else if constexpr (sizeof(T) == 4) {
+				return static_cast<T>(_byteswap_ulong(bits));
+			}
+			else {
+				return static_cast<T>(_byteswap_uint64(bits));
+			}
+#endif
+		}
+		U result = 0;
+		for (size_t i = 0; i < sizeof(T); ++i) {
+			result = static_cast<U>((result << 8) | (bits & 0xff));
+			bits = static_cast<U>(bits >> 8);
+		}
+		return static_cast<T>(result);
+#endif
+#endif
+	}
+}
+
+template<std::integral T>
+constexpr T hostToNetwork(T value) noexcept {
+	if constexpr (std::endian::native == std::endian::big) {
+		return value;
+	}
+	else {
+		return byteSwap(value);
+	}
+}
+
+template<std::integral T>
+constexpr T networkToHost(T value) noexcept {
+	return hostToNetwork(value);
+}
+
+static_assert(byteSwap(uint16_t{ 0x1234 }) == 0x3412);
+static_assert(byteSwap(uint32_t{ 0x12345678 }) == 0x78563412u);
+static_assert(byteSwap(uint64_t{ 0x0102030405060708 }) == 0x0807060504030201ull);
+static_assert(byteSwap(int32_t{ -2 }) == static_cast<int32_t>(0xfeffffffu));
+static_assert(networkToHost(hostToNetwork(uint32_t{ 0xdeadbeef })) == 0xdeadbeefu);
@@ -0,0 +1,63 @@
+#include "call_policy.h"
+#include <algorithm>
+#include <random>
+
+namespace cyfon_rpc {
+
+	bool CallPolicy::retryable(RpcStatus status) const noexcept {
+		return std::find(retryable_statuses.begin(), retryable_statuses.end(), status) != retryable_statuses.end();
+	}
+
+	std::chrono::milliseconds CallPolicy::backoff(uint32_t attempt) const {
+		double ceiling = static_cast<double>(initial_backoff.count());
+		for (uint32_t i = 0; i < attempt && ceiling < max_backoff.count(); ++i) {
+			ceiling *= backoff_multiplier;
+		}
+		ceiling = std::min(ceiling, static_cast<double>(max_backoff.count()));
+
+		thread_local std::minstd_rand rng{ std::random_device{}() };
+		std::uniform_real_distribution<double> jitter(0.0, ceiling);
+		return std::chrono::milliseconds(static_cast<int64_t>(jitter(rng)));
+	}
+
+	void RetryBudget::deposit() noexcept {
+		int64_t current = tokens_.load(std::memory_order_relaxed);
+		while (current < max_ &&
+			   !tokens_.compare_exchange_weak(current, std::min(current + ratio_, max_), std::memory_order_relaxed)) {
+		}
+	}
+
+	bool RetryBudget::tryWithdraw() noexcept {
+		int64_t current = tokens_.load(std::memory_order_relaxed);
+		while (current >= 1000) {
+			if (tokens_.compare_exchange_weak(current, current - 1000, std::memory_order_relaxed)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void LatencyWindow::record(std::chrono::steady_clock::duration latency) {
+		auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+		std::lock_guard<std::mutex> lock(mutex_);
+		samples_[next_] = static_cast<uint32_t>(std::clamp<int64_t>(micros, 0, UINT32_MAX));
+		next_ = (next_ + 1) % kCapacity;
+		size_ = std::min(size_ + 1, kCapacity);
+	}
+
+	std::chrono::microseconds LatencyWindow::percentile(double q, std::chrono::microseconds fallback) const {
+		std::array<uint32_t, kCapacity> sorted;
+		size_t size;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			size = size_;
+			std::copy_n(samples_.begin(), size, sorted.begin());
+		}
+		if (size < kMinSamples) {
+			return fallback;
+		}
+		size_t rank = std::min(size - 1, static_cast<size_t>(q * static_cast<double>(size)));
+		std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + size);
+		return std::chrono::microseconds(sorted[rank]);
+	}
+}
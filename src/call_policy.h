@@ -0,0 +1,80 @@
+#pragma once
+
+#include "rpc_header.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 单个方法的重试与对冲策略, 由 RpcChannel::setCallPolicy 按方法配置
+	// 重试和对冲都会让同一请求执行多次, 只能用于幂等方法
+	struct CallPolicy {
+		// ===== 重试 =====
+		uint32_t max_attempts = 1;								// 包括第一次, 1 表示不重试
+		std::chrono::milliseconds initial_backoff{ 10 };
+		std::chrono::milliseconds max_backoff{ 1'000 };
+		double backoff_multiplier = 2.0;
+		std::vector<RpcStatus> retryable_statuses{ RpcStatus::UNAVAILABLE, RpcStatus::RESOURCE_EXHAUSTED };
+
+		// ===== 对冲 =====
+		// 调用超过最近延迟的 hedge_percentile 分位仍未返回时, 向下一个副本再发一份, 取最先成功的结果
+		// 取消落后的请求只在客户端生效: 协议里没有 CANCEL 消息, 已发出的请求在服务端照常执行完,
+		// 每次对冲都让这次调用的服务端负载加倍. 对冲次数受重试预算限制; 设置了超时 (RpcChannel::setTimeout) 时,
+		// 服务端会丢弃排队超过截止时间的请求, 但已开始执行的不会中断
+		// 对冲延迟只用第一次尝试的延迟估计, 重试和胜出的对冲请求不计入
+		uint32_t max_hedges = 0;								// 0 表示不对冲
+		double hedge_percentile = 0.95;
+		std::chrono::milliseconds initial_hedge_delay{ 50 };	// 样本不足时使用的对冲延迟
+		std::chrono::milliseconds min_hedge_delay{ 1 };
+
+		[[nodiscard]] bool retryable(RpcStatus status) const noexcept;
+
+		// 第 attempt 次重试前的等待 (attempt 从 0 开始): 在 [0, min(max_backoff, initial * multiplier^attempt)] 中均匀随机,
+		// 避免大量客户端在同一时刻一起重试
+		[[nodiscard]] std::chrono::milliseconds backoff(uint32_t attempt) const;
+	};
+
+	// 重试预算: 每个请求存入 ratio 个令牌 (上限 max_tokens), 每次重试或对冲取走一个
+	// 稳态下额外请求不超过正常请求的 ratio 倍, 服务端过载时重试不会把流量放大数倍
+	class RetryBudget {
+	public:
+		explicit RetryBudget(double ratio = 0.1, double max_tokens = 10.0)
+			: ratio_(toMilli(ratio)), max_(toMilli(max_tokens)), tokens_(toMilli(max_tokens)) {}
+
+		void deposit() noexcept;
+		// 有令牌时取走一个并返回 true
+		bool tryWithdraw() noexcept;
+
+		[[nodiscard]] double tokens() const noexcept { return tokens_.load(std::memory_order_relaxed) / 1000.0; }
+
+	private:
+		// 以千分之一令牌为单位存成整数, 用一个原子变量即可无锁更新
+		static int64_t toMilli(double value) noexcept { return static_cast<int64_t>(value * 1000.0); }
+
+		int64_t ratio_;
+		int64_t max_;
+		std::atomic<int64_t> tokens_;
+	};
+
+	// 最近 kCapacity 次调用的延迟, 用来估计对冲延迟; 只反映近期的服务状况
+	class LatencyWindow {
+	public:
+		static constexpr size_t kCapacity = 256;
+		static constexpr size_t kMinSamples = 16;	// 样本少于此数时不给出分位数
+
+		void record(std::chrono::steady_clock::duration latency);
+
+		// 返回分位数 q (0~1); 样本不足时返回 fallback
+		[[nodiscard]] std::chrono::microseconds percentile(double q, std::chrono::microseconds fallback) const;
+
+	private:
+		mutable std::mutex mutex_;
+		std::array<uint32_t, kCapacity> samples_{};	// 微秒
+		size_t next_ = 0;
+		size_t size_ = 0;
+	};
+}
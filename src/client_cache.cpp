@@ -0,0 +1,176 @@
+#include "client_cache.h"
+#include "rpc_log.h"
+#include <cstring>
+#include <exception>
+
+namespace cyfon_rpc {
+
+	ClientCache::~ClientCache() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+			refresh_queue_.clear();
+		}
+		refresh_cv_.notify_all();
+		if (refresher_.joinable()) {
+			refresher_.join();
+		}
+	}
+
+	void ClientCache::setCapacity(size_t bytes) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		capacity_ = bytes;
+		evict();
+	}
+
+	size_t ClientCache::bytes() const {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return bytes_;
+	}
+
+	std::string ClientCache::makeKey(uint32_t method_id, const std::string& body) {
+		std::string key(sizeof(method_id) + body.size(), '\0');
+		std::memcpy(key.data(), &method_id, sizeof(method_id));
+		std::memcpy(key.data() + sizeof(method_id), body.data(), body.size());
+		return key;
+	}
+
+	std::string ClientCache::get(uint32_t method_id, const std::string& body, const Loader& load) {
+		const Policy& policy = policies_.at(method_id);
+		std::string key = makeKey(method_id, body);
+
+		std::unique_lock<std::mutex> lock(mutex_);
+		auto now = Clock::now();
+		auto it = entries_.find(key);
+		if (it != entries_.end()) {
+			Entry& entry = *it -> second;
+			if (now < entry.fresh_until) {
+				touch(it -> second);
+				stats_.hits.fetch_add(1, std::memory_order_relaxed);
+				return entry.payload;
+			}
+			if (now < entry.stale_until) {
+				// 先用旧值; 还没有刷新在进行时由后台线程刷新, 调用方不等待
+				touch(it -> second);
+				stats_.stale_hits.fetch_add(1, std::memory_order_relaxed);
+				if (!entry.refreshing) {
+					entry.refreshing = true;
+					scheduleRefresh(policy, key, load);
+				}
+				return entry.payload;
+			}
+		}
+
+		// 未命中: 有相同的调用在途就等它, 否则自己发请求
+		auto flight = in_flight_.find(key);
+		if (flight != in_flight_.end()) {
+			std::shared_future<std::string> result = flight -> second;
+			lock.unlock();
+			stats_.coalesced.fetch_add(1, std::memory_order_relaxed);
+			return result.get();
+		}
+
+		std::promise<std::string> promise;
+		in_flight_.emplace(key, promise.get_future().share());
+		stats_.misses.fetch_add(1, std::memory_order_relaxed);
+		lock.unlock();
+
+		std::string payload;
+		try {
+			payload = load();
+		}
+		catch (...) {
+			lock.lock();
+			in_flight_.erase(key);
+			lock.unlock();
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		in_flight_.erase(key);
+		store(policy, key, payload);
+		lock.unlock();
+		promise.set_value(payload);
+		return payload;
+	}
+
+	void ClientCache::scheduleRefresh(const Policy& policy, const std::string& key, const Loader& load) {
+		refresh_queue_.push_back([this, policy, key, load]() {
+			std::string payload;
+			try {
+				payload = load();
+			}
+			catch (const std::exception& e) {
+				CYFON_LOG_WARN("Client cache refresh failed, keeping the stale value: {}", e.what());
+				stats_.refresh_failures.fetch_add(1, std::memory_order_relaxed);
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto current = entries_.find(key);
+				if (current != entries_.end()) {
+					current -> second -> refreshing = false;
+				}
+				return;
+			}
+			std::lock_guard<std::mutex> lock(mutex_);
+			stats_.refreshes.fetch_add(1, std::memory_order_relaxed);
+			store(policy, key, payload);
+		});
+		if (!refresher_.joinable()) {
+			refresher_ = std::thread([this]() { refreshLoop(); });
+		}
+		refresh_cv_.notify_one();
+	}
+
+	void ClientCache::refreshLoop() {
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (true) {
+			refresh_cv_.wait(lock, [this]() { return stopping_ || !refresh_queue_.empty(); });
+			if (stopping_) {
+				return;
+			}
+			auto task = std::move(refresh_queue_.front());
+			refresh_queue_.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+
+	void ClientCache::store(const Policy& policy, const std::string& key, const std::string& payload) {
+		auto existing = entries_.find(key);
+		if (existing != entries_.end()) {
+			erase(existing -> second);
+		}
+		if (policy.ttl.count() <= 0) {
+			return;
+		}
+
+		auto now = Clock::now();
+		Entry entry;
+		entry.key = key;
+		entry.payload = payload;
+		entry.fresh_until = now + policy.ttl;
+		entry.stale_until = entry.fresh_until + policy.stale_while_revalidate;
+		if (entry.charge() > capacity_) {
+			return;
+		}
+
+		bytes_ += entry.charge();
+		lru_.push_front(std::move(entry));
+		entries_.emplace(key, lru_.begin());
+		evict();
+	}
+
+	void ClientCache::erase(LruList::iterator it) {
+		bytes_ -= it -> charge();
+		entries_.erase(it -> key);
+		lru_.erase(it);
+	}
+
+	void ClientCache::evict() {
+		while (bytes_ > capacity_ && !lru_.empty()) {
+			erase(std::prev(lru_.end()));
+			stats_.evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace cyfon_rpc {
+
+	// 客户端响应缓存 + 相同请求合并, 供 RpcChannel 使用
+	// - 按方法开启, 键为 (method_id, 请求体), 值为响应体; 总内存超过 capacity 时按 LRU 淘汰
+	// - 同一时刻多个线程发起相同调用时只有一个真正发请求, 其余等待它的结果 (失败时一起收到异常)
+	// - stale_while_revalidate: 条目过期后的这段时间里所有调用方 (包括第一个) 都直接拿旧值不等待,
+	//   第一个调用方把刷新交给缓存自己的后台线程; 刷新失败只记日志, 旧值留到下一个调用方再次触发刷新
+	// 线程安全; 策略需在开始调用之前配置. 析构时等待进行中的刷新结束, 未开始的刷新直接丢弃
+	class ClientCache {
+	public:
+		using Clock = std::chrono::steady_clock;
+		using Loader = std::function<std::string()>;
+
+		struct Policy {
+			std::chrono::milliseconds ttl{ 0 };						// 0 表示不缓存, 只合并并发的相同调用
+			std::chrono::milliseconds stale_while_revalidate{ 0 };	// 过期后仍可返回旧值的时长
+		};
+
+		struct Stats {
+			std::atomic<uint64_t> hits{ 0 };
+			std::atomic<uint64_t> stale_hits{ 0 };	// 返回了过期但仍在容忍期内的旧值
+			std::atomic<uint64_t> misses{ 0 };
+			std::atomic<uint64_t> coalesced{ 0 };	// 等待了其它线程的相同调用
+			std::atomic<uint64_t> evictions{ 0 };
+			std::atomic<uint64_t> refreshes{ 0 };	// 后台刷新成功的次数
+			std::atomic<uint64_t> refresh_failures{ 0 };
+		};
+
+		explicit ClientCache(size_t capacity = 16 * 1024 * 1024) : capacity_(capacity) {}
+		~ClientCache();
+
+		ClientCache(const ClientCache&) = delete;
+		ClientCache& operator=(const ClientCache&) = delete;
+
+		void setPolicy(uint32_t method_id, Policy policy) { policies_[method_id] = policy; }
+		void setCapacity(size_t bytes);
+
+		[[nodiscard]] bool enabled(uint32_t method_id) const { return policies_.count(method_id) != 0; }
+
+		// 取 (method_id, body) 的响应; 未命中时调用 load 发请求, load 抛出的异常原样传给所有等待者
+		// 过期刷新会把 load 复制到后台线程上执行, 它捕获的状态必须按值持有, 或者活得比缓存久
+		std::string get(uint32_t method_id, const std::string& body, const Loader& load);
+
+		[[nodiscard]] const Stats& stats() const noexcept { return stats_; }
+		[[nodiscard]] size_t bytes() const;
+
+	private:
+		struct Entry {
+			std::string key;
+			std::string payload;
+			Clock::time_point fresh_until;
+			Clock::time_point stale_until;
+			bool refreshing = false;
+
+			[[nodiscard]] size_t charge() const noexcept { return key.size() + payload.size() + sizeof(Entry); }
+		};
+		using LruList = std::list<Entry>;
+
+		static std::string makeKey(uint32_t method_id, const std::string& body);
+
+		// 下面几个函数调用方持有 mutex_
+		void store(const Policy& policy, const std::string& key, const std::string& payload);
+		void touch(LruList::iterator it) { lru_.splice(lru_.begin(), lru_, it); }
+		void erase(LruList::iterator it);
+		void evict();
+
+		// 把过期条目的刷新交给后台线程, 线程在第一次刷新时启动; 调用方持有 mutex_
+		void scheduleRefresh(const Policy& policy, const std::string& key, const Loader& load);
+		void refreshLoop();
+
+		std::unordered_map<uint32_t, Policy> policies_;
+
+		mutable std::mutex mutex_;
+		LruList lru_;	// 头部最近使用
+		std::unordered_map<std::string, LruList::iterator> entries_;
+		std::unordered_map<std::string, std::shared_future<std::string>> in_flight_;
+		size_t capacity_;
+		size_t bytes_ = 0;
+		Stats stats_;
+
+		std::deque<std::function<void()>> refresh_queue_;	// 由 mutex_ 保护
+		std::condition_variable refresh_cv_;
+		bool stopping_ = false;
+		std::thread refresher_;
+	};
+}
@@ -0,0 +1,206 @@
+#include "crc32c.h"
+#include "byte_order.h"
+#include <array>
+#include <bit>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#define CYFON_RPC_CRC32C_X86 1
+#endif
+
+namespace cyfon_rpc {
+
+	namespace {
+		constexpr uint32_t kPolynomial = 0x82F63B78;
+
+		// slicing-by-8: tables[k][b] 是字节 b 后面再跟 k 个零字节的 CRC
+		constexpr std::array<std::array<uint32_t, 256>, 8> makeTables() {
+			std::array<std::array<uint32_t, 256>, 8> tables{};
+			for (uint32_t b = 0; b < 256; ++b) {
+				uint32_t crc = b;
+				for (int bit = 0; bit < 8; ++bit) {
+					crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+				}
+				tables[0][b] = crc;
+			}
+			for (size_t k = 1; k < 8; ++k) {
+				for (uint32_t b = 0; b < 256; ++b) {
+					tables[k][b] = (tables[k - 1][b] >> 8) ^ tables[0][tables[k - 1][b] & 0xff];
+				}
+			}
+			return tables;
+		}
+
+		constexpr auto kTables = makeTables();
+
+		uint32_t updatePortable(const unsigned char* p, size_t size, uint32_t crc) noexcept {
+			while (size >= 8) {
+				uint32_t low;
+				uint32_t high;
+				std::memcpy(&low, p, 4);
+				std::memcpy(&high, p + 4, 4);
+				if constexpr (std::endian::native == std::endian::big) {
+					low = byteSwap(low);
+					high = byteSwap(high);
+				}
+				low ^= crc;
+				crc = kTables[7][low & 0xff] ^ kTables[6][(low >> 8) & 0xff] ^
+					  kTables[5][(low >> 16) & 0xff] ^ kTables[4][low >> 24] ^
+					  kTables[3][high & 0xff] ^ kTables[2][(high >> 8) & 0xff] ^
+					  kTables[1][(high >> 16) & 0xff] ^ kTables[0][high >> 24];
+				p += 8;
+				size -= 8;
+			}
+			while (size--) {
+				crc = (crc >> 8) ^ kTables[0][(crc ^ *p++) & 0xff];
+			}
+			return crc;
+		}
+
+#if defined(CYFON_RPC_CRC32C_X86)
+		// crc32 指令延迟 3 个周期、吞吐每周期 1 条, 单条依赖链只能用到三分之一;
+		// 大块数据切成三段并行计算, 再用"追加 N 个零字节"的线性变换把前两段的 CRC 移位后合并
+		constexpr size_t kLongBlock = 8192;
+		constexpr size_t kShortBlock = 256;
+
+		using ShiftTable = std::array<std::array<uint32_t, 256>, 4>;
+
+		constexpr uint32_t gf2MatrixTimes(const std::array<uint32_t, 32>& matrix, uint32_t vector) {
+			uint32_t sum = 0;
+			for (size_t i = 0; vector; ++i, vector >>= 1) {
+				if (vector & 1) {
+					sum ^= matrix[i];
+				}
+			}
+			return sum;
+		}
+
+		constexpr std::array<uint32_t, 32> gf2MatrixSquare(const std::array<uint32_t, 32>& matrix) {
+			std::array<uint32_t, 32> square{};
+			for (size_t i = 0; i < 32; ++i) {
+				square[i] = gf2MatrixTimes(matrix, matrix[i]);
+			}
+			return square;
+		}
+
+		// 追加 bytes 个零字节的变换表 (bytes 为 2 的幂), 按 CRC 的 4 个字节分别查表
+		constexpr ShiftTable makeShiftTable(size_t bytes) {
+			std::array<uint32_t, 32> op{};
+			op[0] = kPolynomial;	// 一个零比特
+			for (size_t i = 1; i < 32; ++i) {
+				op[i] = uint32_t{ 1 } << (i - 1);
+			}
+			for (size_t bits = 1; bits < bytes * 8; bits <<= 1) {
+				op = gf2MatrixSquare(op);
+			}
+			ShiftTable table{};
+			for (uint32_t b = 0; b < 256; ++b) {
+				for (size_t k = 0; k < 4; ++k) {
+					table[k][b] = gf2MatrixTimes(op, b << (8 * k));
+				}
+			}
+			return table;
+		}
+
+		constexpr ShiftTable kLongShift = makeShiftTable(kLongBlock);
+		constexpr ShiftTable kShortShift = makeShiftTable(kShortBlock);
+
+		inline uint32_t shift(const ShiftTable& table, uint32_t crc) noexcept {
+			return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+		}
+
+#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("sse4.2")))
+#endif
+		inline const unsigned char* interleave(const unsigned char* p, size_t block, const ShiftTable& table, uint64_t& crc) noexcept {
+			uint64_t crc1 = 0;
+			uint64_t crc2 = 0;
+			for (const unsigned char* end = p + block; p < end; p += 8) {
+				uint64_t word0;
+				uint64_t word1;
+				uint64_t word2;
+				std::memcpy(&word0, p, 8);
+				std::memcpy(&word1, p + block, 8);
+				std::memcpy(&word2, p + block * 2, 8);
+				crc = _mm_crc32_u64(crc, word0);
+				crc1 = _mm_crc32_u64(crc1, word1);
+				crc2 = _mm_crc32_u64(crc2, word2);
+			}
+			crc = shift(table, static_cast<uint32_t>(crc)) ^ crc1;
+			crc = shift(table, static_cast<uint32_t>(crc)) ^ crc2;
+			return p + block * 2;
+		}
+
+#if defined(__GNUC__) || defined(__clang__)
+		__attribute__((target("sse4.2")))
+#endif
+		uint32_t updateHardware(const unsigned char* p, size_t size, uint32_t crc) noexcept {
+			uint64_t crc64 = crc;
+			while (size >= kLongBlock * 3) {
+				p = interleave(p, kLongBlock, kLongShift, crc64);
+				size -= kLongBlock * 3;
+			}
+			while (size >= kShortBlock * 3) {
+				p = interleave(p, kShortBlock, kShortShift, crc64);
+				size -= kShortBlock * 3;
+			}
+			while (size >= 8) {
+				uint64_t word;
+				std::memcpy(&word, p, 8);
+				crc64 = _mm_crc32_u64(crc64, word);
+				p += 8;
+				size -= 8;
+			}
+			crc = static_cast<uint32_t>(crc64);
+			while (size--) {
+				crc = _mm_crc32_u8(crc, *p++);
+			}
+			return crc;
+		}
+
+		bool detectSse42() noexcept {
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 20)) != 0;
+#else
+			return __builtin_cpu_supports("sse4.2");
+#endif
+		}
+#endif
+
+		using UpdateFn = uint32_t (*)(const unsigned char*, size_t, uint32_t) noexcept;
+
+		UpdateFn selectUpdate() noexcept {
+#if defined(CYFON_RPC_CRC32C_X86)
+			if (detectSse42()) {
+				return updateHardware;
+			}
+#endif
+			return updatePortable;
+		}
+
+		// 函数内静态量, 其它翻译单元的静态初始化里调用也安全
+		UpdateFn update() noexcept {
+			static const UpdateFn selected = selectUpdate();
+			return selected;
+		}
+	}
+
+	uint32_t crc32c(const void* data, size_t size, uint32_t crc) noexcept {
+		return ~update()(static_cast<const unsigned char*>(data), size, ~crc);
+	}
+
+	bool crc32cHardware() noexcept {
+		return update() != updatePortable;
+	}
+
+	namespace detail {
+		uint32_t crc32cPortable(const void* data, size_t size, uint32_t crc) noexcept {
+			return ~updatePortable(static_cast<const unsigned char*>(data), size, ~crc);
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cyfon_rpc {
+
+	// CRC32C (Castagnoli, 反射多项式 0x82F63B78), 与 iSCSI / ext4 / gRPC 使用的相同
+	// - x86-64 上运行时检测 SSE4.2, 有则用 crc32 指令每次处理 8 字节, 否则退回 slicing-by-8 查表
+	// - crc 传入上一段的结果即可分段计算: crc32c(b, nb, crc32c(a, na)) 等于两段拼接后的 CRC
+	uint32_t crc32c(const void* data, size_t size, uint32_t crc = 0) noexcept;
+
+	// 当前 CPU 是否使用硬件指令
+	[[nodiscard]] bool crc32cHardware() noexcept;
+
+	namespace detail {
+		// 查表实现, 没有 SSE4.2 时使用, 也是硬件版本的对照
+		uint32_t crc32cPortable(const void* data, size_t size, uint32_t crc = 0) noexcept;
+	}
+}
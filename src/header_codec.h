@@ -0,0 +1,138 @@
+#pragma once
+
+#include "byte_order.h"
+#include "rpc_header.h"
+#include <cstring>
+#include <span>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+// SSSE3 / AVX2 版本用 target 属性单独编译, 运行时按 CPU 选择, 默认编译选项下也能用上
+#define CYFON_RPC_HEADER_SIMD_X86 1
+#elif defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+namespace cyfon_rpc {
+
+	// 默认的单帧上限 (含头部); 超过它的帧在分配消息体内存之前就被拒绝
+	constexpr uint32_t kDefaultMaxMessageSize = 64 * 1024 * 1024;
+
+	enum class HeaderStatus : uint8_t {
+		OK         = 0,
+		INCOMPLETE = 1,  // 不足一个头部, 等待更多数据
+		MALFORMED  = 2,  // message_size 小于头部长度
+		TOO_LARGE  = 3,  // message_size 超过上限
+	};
+
+	namespace detail {
+		// RpcHeader 是紧凑布局, 内存布局和线路格式逐字节对应, 字节序转换就是按字段宽度翻转字节:
+		// 字段宽度 4 4 4 4 | 4 4 1 1 2 4, 两个 16 字节各用一张 pshufb 掩码 (AVX2 下合成一次 vpshufb)
+		// 这个变换是对合的, 编码和解码共用
+		alignas(32) inline constexpr char kHeaderShuffle[32] = {
+			3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+			3, 2, 1, 0, 7, 6, 5, 4, 8, 9, 11, 10, 15, 14, 13, 12,
+		};
+
+		// 逐字段转换, 没有 SIMD 时使用, 也是 SIMD 版本的对照实现
+		inline void swapHeaderBytesScalar(const char* in, char* out) noexcept {
+			RpcHeader header;
+			std::memcpy(&header, in, sizeof(RpcHeader));
+			header.message_size = networkToHost(header.message_size);
+			header.service_id = networkToHost(header.service_id);
+			header.method_id = networkToHost(header.method_id);
+			header.request_id = networkToHost(header.request_id);
+			header.stream_id = networkToHost(header.stream_id);
+			header.sequence_number = networkToHost(header.sequence_number);
+			header.reserved = networkToHost(header.reserved);
+			header.deadline_ms = networkToHost(header.deadline_ms);
+			// message_type 和 flags 是单字节，不需要转换
+			std::memcpy(out, &header, sizeof(RpcHeader));
+		}
+
+#if defined(CYFON_RPC_HEADER_SIMD_X86)
+		__attribute__((target("ssse3")))
+		inline void swapHeaderBytesSsse3(const char* in, char* out) noexcept {
+			const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+			const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+			const __m128i low_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(kHeaderShuffle));
+			const __m128i high_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(kHeaderShuffle + 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(low, low_mask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_shuffle_epi8(high, high_mask));
+		}
+
+		__attribute__((target("avx2")))
+		inline void swapHeaderBytesAvx2(const char* in, char* out) noexcept {
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+			const __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(kHeaderShuffle));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_shuffle_epi8(bytes, mask));
+		}
+
+		inline bool cpuHasSsse3() noexcept {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("ssse3");
+		}
+
+		inline bool cpuHasAvx2() noexcept {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("avx2");
+		}
+
+		using SwapHeaderFn = void (*)(const char*, char*) noexcept;
+
+		inline SwapHeaderFn selectSwapHeaderBytes() noexcept {
+			if (cpuHasAvx2()) {
+				return swapHeaderBytesAvx2;
+			}
+			if (cpuHasSsse3()) {
+				return swapHeaderBytesSsse3;
+			}
+			return swapHeaderBytesScalar;
+		}
+#endif
+
+		inline void swapHeaderBytes(const char* in, char* out) noexcept {
+#if defined(CYFON_RPC_HEADER_SIMD_X86) && defined(__AVX2__)
+			swapHeaderBytesAvx2(in, out);		// 编译期已确定, 不必再检测
+#elif defined(CYFON_RPC_HEADER_SIMD_X86)
+			// 函数内静态量, 其它翻译单元的静态初始化里调用也安全
+			static const SwapHeaderFn selected = selectSwapHeaderBytes();
+			selected(in, out);
+#elif defined(__AVX2__)
+			const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+			const __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(kHeaderShuffle));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_shuffle_epi8(bytes, mask));
+#elif defined(__SSSE3__)
+			const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+			const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 16));
+			const __m128i low_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(kHeaderShuffle));
+			const __m128i high_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(kHeaderShuffle + 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(low, low_mask));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_shuffle_epi8(high, high_mask));
+#else
+			swapHeaderBytesScalar(in, out);
+#endif
+		}
+	}
+
+	// 把头部编码成 32 字节的网络字节序
+	inline void encode_header(const RpcHeader& header, char* out) noexcept {
+		detail::swapHeaderBytes(reinterpret_cast<const char*>(&header), out);
+	}
+
+	// 一次解码 32 字节头部并校验帧长
+	// 只依赖这 32 字节就能判定帧是否合法, 调用方应在为消息体分配内存之前检查返回值
+	inline HeaderStatus decode_header(std::span<const char> data, RpcHeader& header,
+		uint32_t max_message_size = kDefaultMaxMessageSize) noexcept {
+		if (data.size() < sizeof(RpcHeader)) {
+			return HeaderStatus::INCOMPLETE;
+		}
+		detail::swapHeaderBytes(data.data(), reinterpret_cast<char*>(&header));
+		if (header.message_size < sizeof(RpcHeader)) {
+			return HeaderStatus::MALFORMED;
+		}
+		if (header.message_size > max_message_size) {
+			return HeaderStatus::TOO_LARGE;
+		}
+		return HeaderStatus::OK;
+	}
+}
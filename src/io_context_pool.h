@@ -0,0 +1,98 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "timer_wheel.h"
+
+namespace cyfon_rpc {
+
+	// 每个 I/O 线程独占一个 io_context 和一个时间轮
+	// 连接在 accept 时固定到某个线程, 会话的读写和定时器都在这个线程上执行, 时间轮无需加锁;
+	// 每个线程只有一个 steady_timer 按 tick 推进时间轮, 十万个连接也不会产生十万个堆定时器
+	class IoContextPool {
+	public:
+		struct Worker {
+			explicit Worker(std::chrono::milliseconds tick)
+				: context(1),
+				  wheel(tick),
+				  ticker(context),
+				  guard(boost::asio::make_work_guard(context)) {}
+
+			boost::asio::io_context context;
+			TimerWheel wheel;
+			boost::asio::steady_timer ticker;
+			boost::asio::executor_work_guard<boost::asio::io_context::executor_type> guard;
+			std::thread thread;
+		};
+
+		explicit IoContextPool(size_t size, std::chrono::milliseconds tick = std::chrono::milliseconds(10))
+			: tick_(tick) {
+			if (size == 0) {
+				throw std::invalid_argument("IoContextPool requires at least one thread.");
+			}
+			workers_.reserve(size);
+			for (size_t i = 0; i < size; ++i) {
+				workers_.push_back(std::make_unique<Worker>(tick));
+			}
+		}
+
+		~IoContextPool() { stop(); join(); }
+
+		IoContextPool(const IoContextPool&) = delete;
+		IoContextPool& operator=(const IoContextPool&) = delete;
+
+		// 轮转选择下一个线程, 新连接绑定到它上面
+		Worker& next() {
+			return *workers_[next_.fetch_add(1, std::memory_order_relaxed) % workers_.size()];
+		}
+
+		Worker& worker(size_t index) { return *workers_[index]; }
+		[[nodiscard]] size_t size() const noexcept { return workers_.size(); }
+
+		// 启动所有 I/O 线程并阻塞到 stop
+		void run() {
+			for (auto& worker : workers_) {
+				Worker* w = worker.get();
+				scheduleTick(*w);
+				w -> thread = std::thread([w]() { w -> context.run(); });
+			}
+			join();
+		}
+
+		void stop() {
+			for (auto& worker : workers_) {
+				worker -> guard.reset();
+				worker -> context.stop();
+			}
+		}
+
+	private:
+		void scheduleTick(Worker& worker) {
+			worker.ticker.expires_after(tick_);
+			worker.ticker.async_wait([this, &worker](boost::system::error_code ec) {
+				if (ec) {
+					return;
+				}
+				worker.wheel.advance(TimerWheel::Clock::now());
+				scheduleTick(worker);
+			});
+		}
+
+		void join() {
+			for (auto& worker : workers_) {
+				if (worker -> thread.joinable()) {
+					worker -> thread.join();
+				}
+			}
+		}
+
+		std::chrono::milliseconds tick_;
+		std::vector<std::unique_ptr<Worker>> workers_;
+		std::atomic<size_t> next_{ 0 };
+	};
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include "buffer.h"
+#include <bit>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace cyfon_rpc {
+
+	// ===== 消息编解码 =====
+	// MessageCodec<T> 负责 T 与线路字节之间的转换, RpcChannel、TypedChannel、类型化服务和 CYFON_RPC_DISPATCH 都通过它编解码,
+	// 所以每个方法用哪种格式只取决于它的请求/响应类型:
+	// - protobuf 消息: SerializeToString / ParseFromArray
+	// - 声明了 kPodFields 的平凡可复制结构体: 定长格式, 字段按声明顺序紧排, 各自转成网络字节序; 解码只有拷贝和字节交换
+	// - 声明了 kFlatFields 的结构体: 偏移表格式, 支持 std::string 字段, 可以不解码整条消息只读取某个字段
+	//
+	//   struct AddPod {
+	//       int32_t a;
+	//       int32_t b;
+	//       static constexpr auto kPodFields = std::make_tuple(&AddPod::a, &AddPod::b);
+	//   };
+	//
+	// 两端的字段列表必须一致; 字段只能追加在末尾 (偏移表格式下旧版本读不到新字段, 新版本读旧消息时新字段为默认值)
+
+	template <typename T>
+	concept RpcMessage = std::default_initializable<T> && requires(T message, const T& const_message, std::string bytes) {
+		{ message.ParseFromString(bytes) } -> std::convertible_to<bool>;
+		{ const_message.SerializeToString(&bytes) } -> std::convertible_to<bool>;
+	};
+
+	// 可以定长编码的标量: 整数 (含 bool, 编码为一个字节)、枚举、浮点
+	template <typename T>
+	concept WireScalar = std::integral<T> || std::is_enum_v<T> || std::floating_point<T>;
+
+	namespace detail {
+		// 标量对应的同宽度无符号整数, 字节序转换在它上面做
+		template <WireScalar T>
+		using wire_uint_t = std::conditional_t<sizeof(T) == 1, uint8_t,
+							std::conditional_t<sizeof(T) == 2, uint16_t,
+							std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+		template <WireScalar T>
+		void storeScalar(char* out, T value) noexcept {
+			auto bits = hostToNetwork(std::bit_cast<wire_uint_t<T>>(value));
+			std::memcpy(out, &bits, sizeof(bits));
+		}
+
+		template <WireScalar T>
+		T loadScalar(const char* in) noexcept {
+			wire_uint_t<T> bits;
+			std::memcpy(&bits, in, sizeof(bits));
+			if constexpr (std::is_same_v<T, bool>) {
+				return bits != 0;	// 除 0/1 以外的字节直接 bit_cast 成 bool 是未定义行为, 非零一律为 true
+			}
+			else {
+				return std::bit_cast<T>(networkToHost(bits));
+			}
+		}
+	}
+
+	template <typename T>
+	concept PodMessage = !RpcMessage<T> && std::is_trivially_copyable_v<T> && std::default_initializable<T> &&
+		requires { T::kPodFields; };
+
+	template <typename T>
+	concept FlatMessage = !RpcMessage<T> && !PodMessage<T> && std::default_initializable<T> &&
+		requires { T::kFlatFields; };
+
+	template <typename T>
+	struct MessageCodec;
+
+	template <RpcMessage T>
+	struct MessageCodec<T> {
+		static bool encode(const T& message, std::string& out) { return message.SerializeToString(&out); }
+
+		static bool decode(std::string_view in, T& message) {
+			if constexpr (requires { message.ParseFromArray(in.data(), static_cast<int>(in.size())); }) {
+				if (in.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+					return false;
+				}
+				return message.ParseFromArray(in.data(), static_cast<int>(in.size()));
+			}
+			else {
+				return message.ParseFromString(std::string(in));
+			}
+		}
+	};
+
+	template <PodMessage T>
+	struct MessageCodec<T> {
+		static_assert(std::apply([](auto... members) {
+			return (WireScalar<std::remove_reference_t<decltype(std::declval<T&>().*members)>> && ...);
+		}, T::kPodFields), "kPodFields may only list integer, enum and floating-point members");
+
+		static constexpr size_t kSize = std::apply([](auto... members) {
+			return (size_t{ 0 } + ... + sizeof(std::remove_reference_t<decltype(std::declval<T&>().*members)>));
+		}, T::kPodFields);
+
+		static bool encode(const T& message, std::string& out) {
+			out.resize(kSize);
+			char* cursor = out.data();
+			std::apply([&](auto... members) {
+				((detail::storeScalar(cursor, message.*members), cursor += sizeof(message.*members)), ...);
+			}, T::kPodFields);
+			return true;
+		}
+
+		// 长度必须正好等于 kSize
+		static bool decode(std::string_view in, T& message) {
+			if (in.size() != kSize) {
+				return false;
+			}
+			const char* cursor = in.data();
+			std::apply([&](auto... members) {
+				((message.*members = detail::loadScalar<std::remove_reference_t<decltype(message.*members)>>(cursor),
+				  cursor += sizeof(message.*members)), ...);
+			}, T::kPodFields);
+			return true;
+		}
+	};
+
+	// ===== 偏移表格式 =====
+	// | u16 字段数 | u16 保留 | u32 偏移 x 字段数 | 数据区 |
+	// 偏移相对消息开头, 0 表示字段不存在 (读出默认值); 标量按网络字节序存放, 字符串是 u32 长度 + 字节
+	// 所有整数都是网络字节序
+	namespace flat {
+		constexpr size_t kHeaderSize = 4;
+		constexpr size_t kOffsetSize = 4;
+
+		template <typename F>
+		concept Field = WireScalar<F> || std::same_as<F, std::string>;
+
+		template <typename F>
+		size_t encodedSize(const F& value) {
+			if constexpr (std::same_as<F, std::string>) {
+				return sizeof(uint32_t) + value.size();
+			}
+			else {
+				return sizeof(F);
+			}
+		}
+
+		template <typename F>
+		void write(char* out, const F& value) {
+			if constexpr (std::same_as<F, std::string>) {
+				detail::storeScalar(out, static_cast<uint32_t>(value.size()));
+				std::memcpy(out + sizeof(uint32_t), value.data(), value.size());
+			}
+			else {
+				detail::storeScalar(out, value);
+			}
+		}
+
+		// 从 offset 处读一个字段, 越界时返回 false
+		template <typename F>
+		bool read(std::string_view in, size_t offset, F& value) {
+			if constexpr (std::same_as<F, std::string>) {
+				if (offset + sizeof(uint32_t) > in.size()) {
+					return false;
+				}
+				uint32_t length = detail::loadScalar<uint32_t>(in.data() + offset);
+				if (length > in.size() - offset - sizeof(uint32_t)) {
+					return false;
+				}
+				value.assign(in.data() + offset + sizeof(uint32_t), length);
+			}
+			else {
+				if (offset + sizeof(F) > in.size()) {
+					return false;
+				}
+				value = detail::loadScalar<F>(in.data() + offset);
+			}
+			return true;
+		}
+	}
+
+	template <FlatMessage T>
+	struct MessageCodec<T> {
+		static constexpr size_t kFieldCount = std::tuple_size_v<std::remove_cv_t<decltype(T::kFlatFields)>>;
+		static constexpr size_t kTableSize = flat::kHeaderSize + flat::kOffsetSize * kFieldCount;
+
+		static_assert(std::apply([](auto... members) {
+			return (flat::Field<std::remove_reference_t<decltype(std::declval<T&>().*members)>> && ...);
+		}, T::kFlatFields), "kFlatFields may only list scalar and std::string members");
+
+		static bool encode(const T& message, std::string& out) {
+			size_t size = kTableSize;
+			std::apply([&](auto... members) {
+				((size += flat::encodedSize(message.*members)), ...);
+			}, T::kFlatFields);
+			if (size > std::numeric_limits<uint32_t>::max()) {
+				return false;
+			}
+
+			out.assign(size, '\0');
+			detail::storeScalar(out.data(), static_cast<uint16_t>(kFieldCount));
+			size_t index = 0;
+			size_t offset = kTableSize;
+			std::apply([&](auto... members) {
+				((detail::storeScalar(out.data() + flat::kHeaderSize + flat::kOffsetSize * index++, static_cast<uint32_t>(offset)),
+				  flat::write(out.data() + offset, message.*members),
+				  offset += flat::encodedSize(message.*members)), ...);
+			}, T::kFlatFields);
+			return true;
+		}
+
+		static bool decode(std::string_view in, T& message) {
+			message = T{};
+			bool ok = true;
+			size_t index = 0;
+			std::apply([&](auto... members) {
+				((ok = ok && readField(in, index++, message.*members)), ...);
+			}, T::kFlatFields);
+			return ok;
+		}
+
+		// 只读取第 I 个字段, 不解码其它字段
+		template <size_t I>
+		static bool get(std::string_view in, std::remove_reference_t<decltype(std::declval<T&>().*std::get<I>(T::kFlatFields))>& value) {
+			return readField(in, I, value);
+		}
+
+	private:
+		template <typename F>
+		static bool readField(std::string_view in, size_t index, F& value) {
+			if (in.size() < flat::kHeaderSize) {
+				return false;
+			}
+			size_t count = detail::loadScalar<uint16_t>(in.data());
+			if (index >= count) {
+				return true;	// 旧版本的消息没有这个字段, 保留默认值
+			}
+			size_t slot = flat::kHeaderSize + flat::kOffsetSize * index;
+			if (slot + flat::kOffsetSize > in.size()) {
+				return false;
+			}
+			uint32_t offset = detail::loadScalar<uint32_t>(in.data() + slot);
+			if (offset == 0) {
+				return true;
+			}
+			return flat::read(in, offset, value);
+		}
+	};
+
+	// 有编解码器的消息类型
+	template <typename T>
+	concept WireMessage = requires(const T& message, T& out, std::string bytes, std::string_view view) {
+		{ MessageCodec<T>::encode(message, bytes) } -> std::convertible_to<bool>;
+		{ MessageCodec<T>::decode(view, out) } -> std::convertible_to<bool>;
+	};
+
+	template <WireMessage T>
+	bool encode_message(const T& message, std::string& out) {
+		return MessageCodec<T>::encode(message, out);
+	}
+
+	template <WireMessage T>
+	bool decode_message(std::string_view in, T& message) {
+		return MessageCodec<T>::decode(in, message);
+	}
+}
@@ -0,0 +1,268 @@
+// 微基准测试: Buffer / 头部编解码 / CRC32C / ThreadPool / 方法统计
+// 运行示例 (JSON 结果可用 benchmark 自带的 tools/compare.py 跨提交对比):
+//   cyfon_micro_bench --benchmark_out=micro_bench.json --benchmark_out_format=json
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+#include "buffer.h"
+#include "crc32c.h"
+#include "rpc_header.h"
+#include "rpc_metrics.h"
+#include "rpc_protocol_utils.h"
+#include "threadpool.h"
+
+using namespace cyfon_rpc;
+
+namespace {
+
+	RpcHeader makeHeader() {
+		RpcHeader header{};
+		header.message_size = sizeof(RpcHeader) + 64;
+		header.service_id = 0x12345678;
+		header.method_id = 0x9abcdef0;
+		header.request_id = 42;
+		header.stream_id = 0;
+		header.sequence_number = 0;
+		header.message_type = static_cast<uint8_t>(MessageType::REQUEST);
+		header.flags = Flag::NONE;
+		header.reserved = 0;
+		return header;
+	}
+
+	// 生成一段不含换行的数据, 末尾放 "\r\n", 让查找扫描整段数据
+	std::string makeLine(size_t size) {
+		std::string line(size, 'a');
+		if (size >= 2) {
+			line[size - 2] = '\r';
+			line[size - 1] = '\n';
+		}
+		return line;
+	}
+}
+
+// ---------------- Buffer ----------------
+
+// 稳态: 写入后全部读走, 不触发扩容
+static void BM_BufferAppendRetrieve(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	std::string payload(size, 'x');
+	Buffer buffer;
+	buffer.ensureWritableBytes(size);
+
+	for (auto _ : state) {
+		buffer.append(payload);
+		benchmark::DoNotOptimize(buffer.peek());
+		buffer.retrieve(size);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK(BM_BufferAppendRetrieve)->RangeMultiplier(4)->Range(16, 64 << 10);
+
+// 扩容: 新建缓冲区后按 64 字节小块追加到目标大小, 覆盖 makeSpace 的重新分配分支
+static void BM_BufferGrowth(benchmark::State& state) {
+	const size_t total = static_cast<size_t>(state.range(0));
+	const std::string chunk(64, 'x');
+
+	for (auto _ : state) {
+		Buffer buffer;
+		for (size_t written = 0; written < total; written += chunk.size()) {
+			buffer.append(chunk);
+		}
+		benchmark::DoNotOptimize(buffer.peek());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(total));
+}
+BENCHMARK(BM_BufferGrowth)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+
+// 搬移: 每次只读走一部分数据, 剩余数据在 makeSpace 中被挪回头部
+static void BM_BufferCompact(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	const size_t keep = size / 8;
+	std::string payload(size, 'x');
+	Buffer buffer(size + keep);
+
+	for (auto _ : state) {
+		buffer.append(payload);
+		buffer.retrieve(buffer.readableBytes() - keep);
+		benchmark::DoNotOptimize(buffer.peek());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK(BM_BufferCompact)->RangeMultiplier(4)->Range(256, 64 << 10);
+
+static void BM_BufferAppendInt(benchmark::State& state) {
+	Buffer buffer;
+	for (auto _ : state) {
+		buffer.appendInt<uint32_t>(0xdeadbeef);
+		buffer.appendInt<uint64_t>(0x0123456789abcdefull);
+		benchmark::DoNotOptimize(buffer.readInt<uint32_t>());
+		benchmark::DoNotOptimize(buffer.readInt<uint64_t>());
+	}
+}
+BENCHMARK(BM_BufferAppendInt);
+
+// ---------------- 头部编解码 ----------------
+
+static void BM_PrependHeader(benchmark::State& state) {
+	const RpcHeader header = makeHeader();
+	const std::string payload(64, 'x');
+	Buffer buffer;
+
+	for (auto _ : state) {
+		buffer.append(payload);
+		prepend_header(buffer, header);
+		benchmark::DoNotOptimize(buffer.peek());
+		buffer.retrieveAll();
+	}
+}
+BENCHMARK(BM_PrependHeader);
+
+static void BM_DeserializeHeader(benchmark::State& state) {
+	Buffer buffer;
+	serialize_header(buffer, makeHeader());
+	const std::span<const char> frame = buffer.readableBytesView();
+
+	RpcHeader header{};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(frame.data());
+		bool ok = deserialize_header(frame, header);
+		benchmark::DoNotOptimize(ok);
+		benchmark::DoNotOptimize(header);
+	}
+}
+BENCHMARK(BM_DeserializeHeader);
+
+// 带帧长校验的一次性解码 (SSSE3/AVX2 下是一次字节重排)
+static void BM_DecodeHeader(benchmark::State& state) {
+	Buffer buffer;
+	serialize_header(buffer, makeHeader());
+	const std::span<const char> frame = buffer.readableBytesView();
+
+	RpcHeader header{};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(frame.data());
+		HeaderStatus status = decode_header(frame, header);
+		benchmark::DoNotOptimize(status);
+		benchmark::DoNotOptimize(header);
+	}
+}
+BENCHMARK(BM_DecodeHeader);
+
+// 逐字段转换的对照组
+static void BM_DecodeHeaderScalar(benchmark::State& state) {
+	Buffer buffer;
+	serialize_header(buffer, makeHeader());
+	const std::span<const char> frame = buffer.readableBytesView();
+
+	RpcHeader header{};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(frame.data());
+		detail::swapHeaderBytesScalar(frame.data(), reinterpret_cast<char*>(&header));
+		benchmark::DoNotOptimize(header);
+	}
+}
+BENCHMARK(BM_DecodeHeaderScalar);
+
+// ---------------- CRC32C 校验 ----------------
+
+// 运行时选中的实现 (有 SSE4.2 时是三路交织的 crc32 指令), 结果按 GB/s 看
+static void BM_Crc32c(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	std::string data(size, 'x');
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(crc32c(data.data(), data.size()));
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+	state.SetLabel(crc32cHardware() ? "sse4.2" : "table");
+}
+BENCHMARK(BM_Crc32c)->RangeMultiplier(8)->Range(64, 1 << 20);
+
+// slicing-by-8 查表的对照组
+static void BM_Crc32cPortable(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	std::string data(size, 'x');
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(detail::crc32cPortable(data.data(), data.size()));
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK(BM_Crc32cPortable)->RangeMultiplier(8)->Range(64, 1 << 20);
+
+// ---------------- 分隔符查找 ----------------
+
+static void BM_FindCRLF(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	Buffer buffer;
+	buffer.append(makeLine(size));
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(buffer.findCRLF());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK(BM_FindCRLF)->RangeMultiplier(4)->Range(16, 64 << 10);
+
+static void BM_FindEOL(benchmark::State& state) {
+	const size_t size = static_cast<size_t>(state.range(0));
+	Buffer buffer;
+	buffer.append(makeLine(size));
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(buffer.findEOL());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(size));
+}
+BENCHMARK(BM_FindEOL)->RangeMultiplier(4)->Range(16, 64 << 10);
+
+// ---------------- ThreadPool ----------------
+
+// 1~N 个生产者线程同时向同一个线程池投递空任务, 衡量 enqueue 的吞吐和锁竞争
+// 每轮结束时等待本线程投递的最后一个任务完成, 避免队列无限堆积
+static void BM_ThreadPoolEnqueue(benchmark::State& state) {
+	static ThreadPool pool(4);
+	constexpr int kBatch = 256;
+
+	for (auto _ : state) {
+		std::future<void> last;
+		for (int i = 0; i < kBatch; ++i) {
+			last = pool.enqueue([] {});
+		}
+		last.wait();
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * kBatch);
+}
+BENCHMARK(BM_ThreadPoolEnqueue)->ThreadRange(1, 8)->UseRealTime();
+
+// ---------------- Metrics ----------------
+
+// 一次调用的全部记录: 查找方法槽, 请求数和字节数, 三个延迟直方图; 每次调用的开销要求低于 50ns
+// 延迟值在 1us~1ms 之间变化, 落在不同的桶上. clock:1 另外计入算写耗时的两次取时钟,
+// 调用路径本来就要取这两次时钟, 虚拟机上每次可能要几十纳秒, 单独列出便于区分
+static void BM_MethodStatsRecord(benchmark::State& state) {
+	auto& registry = MetricsRegistry::instance();
+	const bool read_clock = state.range(0) != 0;
+	uint32_t seed = 1;
+
+	for (auto _ : state) {
+		seed = seed * 1103515245u + 12345u;
+		const uint64_t latency = 1000 + (seed >> 12) % 1000000;
+		uint64_t write_time = latency / 2;
+		if (read_clock) {
+			auto start = MetricsRegistry::Clock::now();
+			write_time = MetricsRegistry::elapsedNanos(start, MetricsRegistry::Clock::now());
+		}
+		MethodStats& stats = registry.local(7, 3);
+		stats.requests.add();
+		stats.bytes_in.add(64);
+		stats.bytes_out.add(128);
+		stats.queue_wait.record(latency);
+		stats.handler_time.record(latency * 3);
+		stats.write_time.record(write_time);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_MethodStatsRecord)->ArgName("clock")->Arg(0)->Arg(1)->ThreadRange(1, 4);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,118 @@
+#include "response_cache.h"
+#include "rpc_metrics.h"
+#include "rpc_protocol_utils.h"
+
+namespace cyfon_rpc {
+
+	bool ResponseCache::lookup(uint32_t service_id, uint32_t method_id, std::string_view body, std::string& payload) {
+		const size_t hash = request_hash(service_id, method_id, body);
+		Shard& shard = shardFor(hash);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.index.find(Key{ service_id, method_id, hash, body });
+		if (it == shard.index.end()) {
+			return false;
+		}
+		Entry& entry = shard.entries[it -> second];
+		if (entry.expires <= Clock::now()) {
+			// 过期条目留给 CLOCK 指针或下一次写入回收
+			return false;
+		}
+		entry.referenced = true;
+		payload = entry.payload;
+		return true;
+	}
+
+	void ResponseCache::insert(uint32_t service_id, uint32_t method_id, std::string_view body, std::string payload,
+							   Clock::duration ttl) {
+		const size_t charge = body.size() + payload.size() + kEntryOverhead;
+		if (charge > shard_capacity_) {
+			return;
+		}
+		const size_t hash = request_hash(service_id, method_id, body);
+		Shard& shard = shardFor(hash);
+		const auto now = Clock::now();
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.index.find(Key{ service_id, method_id, hash, body });
+		if (it != shard.index.end()) {
+			// 同一请求并发未命中后各自写入, 保留后到的结果
+			erase(shard, it -> second);
+		}
+
+		evict(shard, charge, now);
+
+		uint32_t slot;
+		if (!shard.free.empty()) {
+			slot = shard.free.back();
+			shard.free.pop_back();
+		}
+		else {
+			slot = static_cast<uint32_t>(shard.entries.size());
+			shard.entries.emplace_back();
+		}
+
+		Entry& entry = shard.entries[slot];
+		entry.service_id = service_id;
+		entry.method_id = method_id;
+		entry.hash = hash;
+		entry.body.assign(body);
+		entry.payload = std::move(payload);
+		entry.expires = now + ttl;
+		entry.occupied = true;
+		entry.referenced = false;	// 新条目要被再次访问才能躲过一轮扫描, 只出现一次的请求先被淘汰
+		shard.bytes += entry.charge();
+		shard.index.emplace(Key{ service_id, method_id, hash, entry.body }, slot);
+	}
+
+	void ResponseCache::evict(Shard& shard, size_t needed, Clock::time_point now) {
+		// 每个条目最多被扫两遍 (第一遍清访问位, 第二遍淘汰), 有界
+		size_t budget = shard.entries.size() * 2;
+		while (shard.bytes + needed > shard_capacity_ && budget-- > 0 && !shard.entries.empty()) {
+			if (shard.hand >= shard.entries.size()) {
+				shard.hand = 0;
+			}
+			uint32_t slot = shard.hand++;
+			Entry& entry = shard.entries[slot];
+			if (!entry.occupied) {
+				continue;
+			}
+			if (entry.referenced && entry.expires > now) {
+				entry.referenced = false;
+				continue;
+			}
+			MetricsRegistry::instance().local(entry.service_id, entry.method_id).cache_evictions.add();
+			erase(shard, slot);
+		}
+	}
+
+	void ResponseCache::erase(Shard& shard, uint32_t slot) {
+		Entry& entry = shard.entries[slot];
+		shard.index.erase(Key{ entry.service_id, entry.method_id, entry.hash, entry.body });
+		shard.bytes -= entry.charge();
+		entry.occupied = false;
+		entry.referenced = false;
+		// 归还内存, 空闲条目不保留大缓冲
+		std::string().swap(entry.body);
+		std::string().swap(entry.payload);
+		shard.free.push_back(slot);
+	}
+
+	size_t ResponseCache::bytes() const {
+		size_t total = 0;
+		for (const auto& shard : shards_) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			total += shard.bytes;
+		}
+		return total;
+	}
+
+	size_t ResponseCache::size() const {
+		size_t total = 0;
+		for (const auto& shard : shards_) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			total += shard.index.size();
+		}
+		return total;
+	}
+}
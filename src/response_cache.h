@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 幂等方法的响应缓存, 键为 (service_id, method_id, 请求体)
+	// - 按哈希分成 16 个分片, 每个分片一把锁, 容量按分片平分, 总内存不超过 capacity
+	// - 淘汰用 CLOCK: 命中只置访问位, 指针扫过时清掉访问位, 再次扫到仍未被访问的条目才淘汰; 已过期的直接淘汰
+	// - 比较完整的请求体, 哈希碰撞不会返回别的请求的响应
+	class ResponseCache {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		explicit ResponseCache(size_t capacity = 64 * 1024 * 1024) { setCapacity(capacity); }
+
+		ResponseCache(const ResponseCache&) = delete;
+		ResponseCache& operator=(const ResponseCache&) = delete;
+
+		// 设置内存上限 (字节); 需在开始服务之前调用
+		void setCapacity(size_t capacity) noexcept { shard_capacity_ = capacity / kShardCount; }
+
+		// 命中且未过期时把响应拷到 payload 并返回 true
+		bool lookup(uint32_t service_id, uint32_t method_id, std::string_view body, std::string& payload);
+
+		// 写入一条响应, ttl 后过期; 单条超过分片容量时不缓存
+		void insert(uint32_t service_id, uint32_t method_id, std::string_view body, std::string payload, Clock::duration ttl);
+
+		[[nodiscard]] size_t bytes() const;
+		[[nodiscard]] size_t size() const;
+
+	private:
+		static constexpr size_t kShardCount = 16;
+		static constexpr size_t kEntryOverhead = 96;	// 条目和哈希表节点的大致开销, 计入内存占用
+		static constexpr uint32_t kNil = UINT32_MAX;
+
+		struct Key {
+			uint32_t service_id;
+			uint32_t method_id;
+			size_t hash;
+			std::string_view body;	// 指向 Entry::body, 条目存在期间有效
+
+			bool operator==(const Key& other) const noexcept {
+				return hash == other.hash && service_id == other.service_id &&
+					method_id == other.method_id && body == other.body;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const noexcept { return key.hash; }
+		};
+
+		struct Entry {
+			uint32_t service_id = 0;
+			uint32_t method_id = 0;
+			size_t hash = 0;
+			std::string body;
+			std::string payload;
+			Clock::time_point expires;
+			bool occupied = false;
+			bool referenced = false;	// CLOCK 访问位
+
+			[[nodiscard]] size_t charge() const noexcept { return body.size() + payload.size() + kEntryOverhead; }
+		};
+
+		struct Shard {
+			mutable std::mutex mutex;
+			std::unordered_map<Key, uint32_t, KeyHash> index;
+			std::deque<Entry> entries;		// deque 追加时不移动已有条目, Key 里的 string_view 保持有效
+			std::vector<uint32_t> free;		// 空闲条目
+			uint32_t hand = 0;				// CLOCK 指针
+			size_t bytes = 0;
+		};
+
+		Shard& shardFor(size_t hash) noexcept { return shards_[(hash >> 4) % kShardCount]; }
+
+		// 在 shard 中腾出 needed 字节; 调用方持有分片锁
+		void evict(Shard& shard, size_t needed, Clock::time_point now);
+		void erase(Shard& shard, uint32_t slot);
+
+		std::array<Shard, kShardCount> shards_;
+		size_t shard_capacity_ = 0;
+	};
+}
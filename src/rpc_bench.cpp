@@ -0,0 +1,508 @@
+// cyfon_bench: 压测工具
+//
+// 闭环 (默认): 每条连接保持 --concurrency 个调用在途, 一个结束立刻发下一个
+// 开环 (--rate): 按固定速率排定每个请求的计划发送时间, 延迟从计划时间开始计算,
+//               服务端变慢时排队等待的时间也计入延迟, 不会因为少发请求而低估尾延迟
+// 闭环结果额外给出按期望间隔补点的修正直方图 (与 HdrHistogram recordValueWithExpectedInterval 相同)
+// stream 模式调用服务端流式方法, 延迟取到 STREAM_END 为止, 另外统计消息吞吐和首条消息延迟
+//
+// 示例:
+//   cyfon_bench --connections 8 --concurrency 32 --duration 30
+//   cyfon_bench --rate 50000 --connections 4 --hgrm latency.hgrm
+//   cyfon_bench --unix /tmp/cyfon_rpc.sock --service CalculatorService --method Add --payload-size 512
+//   cyfon_bench --mode stream --stream-messages 64
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_rpc_client.h"
+#include "rpc_metrics.h"
+#include "rpc_log.h"
+#include "calu.pb.h"
+
+using namespace cyfon_rpc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+	struct BenchOptions {
+		std::string host = "127.0.0.1";
+		unsigned short port = 8888;
+		std::string unix_path;					// 非空时走 AF_UNIX
+		std::string service = "CalculatorService";
+		std::string method;						// 为空时 unary 模式取 Add, stream 模式取 Count
+		size_t connections = 4;
+		size_t concurrency = 16;				// 每条连接最多在途的调用数
+		size_t threads = 1;						// I/O 线程数, 连接按轮转分配到各线程
+		double rate = 0;						// 总请求速率 (次/秒), 0 表示闭环
+		double duration = 10;					// 测量时长 (秒)
+		double warmup = 2;						// 预热时长 (秒), 不计入结果
+		size_t payload_size = 0;				// 0 表示发送 AddRequest, 否则发送指定长度的原始字节
+		bool streaming = false;					// 服务端流式: 延迟取到最后一帧为止
+		size_t stream_messages = 16;			// stream 模式下每次调用请求服务端推送的消息数
+		uint64_t expected_interval_ns = 0;		// 闭环修正的期望间隔, 0 表示取预热期间的平均延迟
+		std::string hgrm_path;					// 输出 HdrHistogram 百分位分布文件
+	};
+
+	void printUsage() {
+		std::cout <<
+			"usage: cyfon_bench [options]\n"
+			"  --host <host>              server host (default 127.0.0.1)\n"
+			"  --port <port>              server port (default 8888)\n"
+			"  --unix <path>              connect over a unix domain socket instead of TCP\n"
+			"  --service <name>           service name (default CalculatorService)\n"
+			"  --method <name>            method name (default Add, or Count in stream mode)\n"
+			"  --connections <n>          number of connections (default 4)\n"
+			"  --concurrency <n>          max in-flight calls per connection (default 16)\n"
+			"  --threads <n>              I/O threads (default 1)\n"
+			"  --rate <req/s>             open-loop fixed rate across all connections (default closed loop)\n"
+			"  --duration <sec>           measurement duration (default 10)\n"
+			"  --warmup <sec>             warm-up duration (default 2)\n"
+			"  --payload-size <bytes>     send raw payload of this size instead of an AddRequest\n"
+			"  --mode <unary|stream>      unary or server-streaming calls (default unary)\n"
+			"  --stream-messages <n>      messages requested per streaming call (default 16)\n"
+			"  --expected-interval-us <n> closed-loop coordinated omission correction interval\n"
+			"  --hgrm <file>              write the HDR percentile distribution to a file\n";
+	}
+
+	bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--help" || arg == "-h") {
+				return false;
+			}
+			if (i + 1 >= argc) {
+				std::cerr << "missing value for " << arg << std::endl;
+				return false;
+			}
+			std::string value = argv[++i];
+			try {
+				if (arg == "--host") options.host = value;
+				else if (arg == "--port") options.port = static_cast<unsigned short>(std::stoul(value));
+				else if (arg == "--unix") options.unix_path = value;
+				else if (arg == "--service") options.service = value;
+				else if (arg == "--method") options.method = value;
+				else if (arg == "--connections") options.connections = std::stoul(value);
+				else if (arg == "--concurrency") options.concurrency = std::stoul(value);
+				else if (arg == "--threads") options.threads = std::stoul(value);
+				else if (arg == "--rate") options.rate = std::stod(value);
+				else if (arg == "--duration") options.duration = std::stod(value);
+				else if (arg == "--warmup") options.warmup = std::stod(value);
+				else if (arg == "--payload-size") options.payload_size = std::stoul(value);
+				else if (arg == "--mode") {
+					if (value != "unary" && value != "stream") {
+						throw std::invalid_argument(value);
+					}
+					options.streaming = (value == "stream");
+				}
+				else if (arg == "--stream-messages") options.stream_messages = std::stoul(value);
+				else if (arg == "--expected-interval-us") options.expected_interval_ns = std::stoull(value) * 1000;
+				else if (arg == "--hgrm") options.hgrm_path = value;
+				else {
+					std::cerr << "unknown option " << arg << std::endl;
+					return false;
+				}
+			}
+			catch (const std::exception&) {
+				std::cerr << "invalid value for " << arg << ": " << value << std::endl;
+				return false;
+			}
+		}
+		if (options.connections == 0 || options.concurrency == 0 || options.threads == 0) {
+			std::cerr << "--connections, --concurrency and --threads must be positive" << std::endl;
+			return false;
+		}
+		if (options.method.empty()) {
+			options.method = options.streaming ? "Count" : "Add";
+		}
+		return true;
+	}
+
+	uint64_t toNanos(Clock::time_point tp) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count());
+	}
+
+	// 各连接共享的运行状态, 由主线程推进
+	struct BenchState {
+		std::atomic<bool> stopping{ false };
+		std::atomic<uint64_t> measure_begin_ns{ UINT64_MAX };	// 计划发送时间落在 [begin, end) 内的调用计入结果
+		std::atomic<uint64_t> measure_end_ns{ UINT64_MAX };
+		std::atomic<uint64_t> expected_interval_ns{ 0 };
+	};
+
+	// 一条压测连接, 所有回调都在所属 io_context 的单个线程上执行
+	class BenchConnection : public std::enable_shared_from_this<BenchConnection> {
+	public:
+		BenchConnection(boost::asio::io_context& ioc, const BenchOptions& options, BenchState& state,
+						uint32_t service_id, uint32_t method_id, std::string payload)
+			: options_(options), state_(state), timer_(ioc),
+			  client_(std::make_shared<AsyncRpcClient>(ioc.get_executor())),
+			  service_id_(service_id), method_id_(method_id), payload_(std::move(payload)) {
+			if (options_.rate > 0) {
+				interval_ns_ = static_cast<uint64_t>(1e9 * static_cast<double>(options_.connections) / options_.rate);
+			}
+		}
+
+		bool connect() {
+			bool ok = options_.unix_path.empty()
+				? client_ -> connect(options_.host, options_.port)
+				: client_ -> connectLocal(options_.unix_path);
+			if (ok) {
+				client_ -> start();
+			}
+			return ok;
+		}
+
+		void start() {
+			boost::asio::post(timer_.get_executor(), [self = shared_from_this()]() {
+				self -> next_intended_ns_ = toNanos(Clock::now());
+				self -> pump();
+			});
+		}
+
+		void close() { client_ -> close(); }
+
+		[[nodiscard]] size_t outstanding() const { return client_ -> pending(); }
+
+		const LatencyHistogram& latency() const { return *latency_; }
+		const LatencyHistogram& corrected() const { return *corrected_; }
+		const LatencyHistogram& warmupLatency() const { return *warmup_latency_; }
+		uint64_t completed() const { return completed_.load(); }
+		uint64_t errors() const { return errors_.load(); }
+		const LatencyHistogram& firstMessageLatency() const { return *first_message_latency_; }
+		uint64_t streamMessages() const { return stream_messages_.load(); }
+		uint64_t unaryReplies() const { return unary_replies_.load(); }
+
+	private:
+		// 在并发上限内发出所有已到计划时间的请求
+		void pump() {
+			if (state_.stopping.load(std::memory_order_relaxed)) {
+				return;
+			}
+
+			if (interval_ns_ == 0) {
+				while (outstanding_ < options_.concurrency) {
+					issue(toNanos(Clock::now()));
+				}
+				return;
+			}
+
+			uint64_t now = toNanos(Clock::now());
+			while (next_intended_ns_ <= now && outstanding_ < options_.concurrency) {
+				issue(next_intended_ns_);
+				next_intended_ns_ += interval_ns_;
+			}
+
+			// 达到并发上限时等在途调用结束后再补发, 计划时间不变, 排队时间计入延迟
+			if (outstanding_ < options_.concurrency && !timer_armed_) {
+				timer_armed_ = true;
+				timer_.expires_at(Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(next_intended_ns_))));
+				timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+					self -> timer_armed_ = false;
+					if (!ec) {
+						self -> pump();
+					}
+				});
+			}
+		}
+
+		void issue(uint64_t intended_ns) {
+			++outstanding_;
+			client_ -> call(service_id_, method_id_, payload_,
+				[self = shared_from_this(), intended_ns, first = true](RpcStatus status, const RpcHeader& header, std::string_view, bool last) mutable {
+					if (!last) {
+						self -> onStreamMessage(intended_ns, first);
+						first = false;
+						return;
+					}
+					// stream 模式下以 RESPONSE 结束说明目标方法不是服务端流式, 这次调用不能算作流式样本
+					if (self -> options_.streaming && status == RpcStatus::OK
+						&& header.message_type != static_cast<uint8_t>(MessageType::STREAM)) {
+						self -> unary_replies_.add();
+						status = RpcStatus::INVALID_ARGUMENT;
+					}
+					self -> onComplete(intended_ns, status);
+				});
+		}
+
+		// 流式调用的中间帧: 计数, 第一帧到达时记录首条消息延迟
+		void onStreamMessage(uint64_t intended_ns, bool first) {
+			if (intended_ns < state_.measure_begin_ns.load(std::memory_order_relaxed)
+				|| intended_ns >= state_.measure_end_ns.load(std::memory_order_relaxed)) {
+				return;
+			}
+			stream_messages_.add();
+			if (first) {
+				uint64_t now = toNanos(Clock::now());
+				first_message_latency_ -> record(now > intended_ns ? now - intended_ns : 0);
+			}
+		}
+
+		void onComplete(uint64_t intended_ns, RpcStatus status) {
+			--outstanding_;
+			uint64_t now = toNanos(Clock::now());
+			uint64_t latency = now > intended_ns ? now - intended_ns : 0;
+
+			if (intended_ns < state_.measure_begin_ns.load(std::memory_order_relaxed)) {
+				warmup_latency_ -> record(latency);
+			}
+			else if (intended_ns < state_.measure_end_ns.load(std::memory_order_relaxed)) {
+				completed_.add();
+				if (status != RpcStatus::OK) {
+					errors_.add();
+				}
+				latency_ -> record(latency);
+				recordCorrected(latency);
+			}
+			// 连接已断开时停止发压, 避免在失败回调里空转
+			if (client_ -> isOpen()) {
+				pump();
+			}
+		}
+
+		// 闭环模式下一次慢调用会让本该在此期间发出的请求被推迟, 按期望间隔补记这些缺失的样本
+		void recordCorrected(uint64_t latency) {
+			corrected_ -> record(latency);
+			if (interval_ns_ != 0) {
+				return;
+			}
+			uint64_t expected = state_.expected_interval_ns.load(std::memory_order_relaxed);
+			if (expected == 0 || latency <= expected) {
+				return;
+			}
+			for (uint64_t missing = latency - expected; missing >= expected; missing -= expected) {
+				corrected_ -> record(missing);
+			}
+		}
+
+		const BenchOptions& options_;
+		BenchState& state_;
+		boost::asio::steady_timer timer_;
+		std::shared_ptr<AsyncRpcClient> client_;
+		uint32_t service_id_;
+		uint32_t method_id_;
+		std::string payload_;
+
+		uint64_t interval_ns_ = 0;			// 开环: 本连接相邻请求的计划间隔
+		uint64_t next_intended_ns_ = 0;
+		size_t outstanding_ = 0;
+		bool timer_armed_ = false;
+
+		std::unique_ptr<LatencyHistogram> latency_ = std::make_unique<LatencyHistogram>();
+		std::unique_ptr<LatencyHistogram> corrected_ = std::make_unique<LatencyHistogram>();
+		std::unique_ptr<LatencyHistogram> warmup_latency_ = std::make_unique<LatencyHistogram>();
+		std::unique_ptr<LatencyHistogram> first_message_latency_ = std::make_unique<LatencyHistogram>();
+		LocalCounter completed_;
+		LocalCounter errors_;
+		LocalCounter stream_messages_;
+		LocalCounter unary_replies_;
+	};
+
+	std::string makePayload(const BenchOptions& options) {
+		if (options.payload_size == 0) {
+			// stream 模式调用 Count: 从 a 开始推送 b 条消息
+			rpc_demo::AddRequest request;
+			request.set_a(options.streaming ? 0 : 20);
+			request.set_b(options.streaming ? static_cast<int32_t>(options.stream_messages) : 22);
+			return request.SerializeAsString();
+		}
+		std::string payload(options.payload_size, '\0');
+		for (size_t i = 0; i < payload.size(); ++i) {
+			payload[i] = static_cast<char>('a' + i % 26);
+		}
+		return payload;
+	}
+
+	void printSummary(const char* title, const HistogramSnapshot& hist) {
+		static constexpr double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999, 0.9999 };
+		std::printf("%s (us):\n", title);
+		std::printf("  %-8s %10.1f\n", "mean", hist.mean() / 1e3);
+		for (double q : kQuantiles) {
+			std::printf("  p%-7g %10.1f\n", q * 100, static_cast<double>(hist.percentile(q)) / 1e3);
+		}
+		std::printf("  %-8s %10.1f\n", "max", static_cast<double>(hist.max) / 1e3);
+	}
+
+	// HdrHistogram 的 .hgrm 文本格式 (单位毫秒), 可以直接交给 HdrHistogram 的绘图工具
+	void writeHgrm(std::ostream& out, const HistogramSnapshot& hist) {
+		char line[128];
+		out << "       Value     Percentile TotalCount 1/(1-Percentile)\n\n";
+		uint64_t seen = 0;
+		for (size_t i = 0; i < hist.counts.size(); ++i) {
+			if (hist.counts[i] == 0) {
+				continue;
+			}
+			seen += hist.counts[i];
+			double percentile = static_cast<double>(seen) / static_cast<double>(hist.count);
+			double value_ms = static_cast<double>(std::min(LatencyHistogram::bucketUpperBound(i), hist.max)) / 1e6;
+			if (seen < hist.count) {
+				std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu %14.2f\n", value_ms, percentile,
+					static_cast<unsigned long long>(seen), 1.0 / (1.0 - percentile));
+			}
+			else {
+				std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu\n", value_ms, percentile,
+					static_cast<unsigned long long>(seen));
+			}
+			out << line;
+		}
+		std::snprintf(line, sizeof(line), "#[Mean    = %12.3f, Max            = %12.3f]\n",
+			hist.mean() / 1e6, static_cast<double>(hist.max) / 1e6);
+		out << line;
+		std::snprintf(line, sizeof(line), "#[Total count    = %12llu]\n", static_cast<unsigned long long>(hist.count));
+		out << line;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+
+	const uint32_t service_id = static_cast<uint32_t>(std::hash<std::string>{}(options.service));
+	const uint32_t method_id = static_cast<uint32_t>(std::hash<std::string>{}(options.method));
+	const std::string payload = makePayload(options);
+
+	// 每个 I/O 线程一个 io_context, 连接上的回调不跨线程, 直方图保持单写者
+	std::vector<std::unique_ptr<boost::asio::io_context>> contexts;
+	using WorkGuard = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
+	std::vector<WorkGuard> guards;
+	for (size_t i = 0; i < options.threads; ++i) {
+		contexts.push_back(std::make_unique<boost::asio::io_context>(1));
+		guards.emplace_back(contexts.back() -> get_executor());
+	}
+
+	BenchState state;
+	std::vector<std::shared_ptr<BenchConnection>> connections;
+	for (size_t i = 0; i < options.connections; ++i) {
+		auto conn = std::make_shared<BenchConnection>(*contexts[i % contexts.size()], options, state,
+													  service_id, method_id, payload);
+		if (!conn -> connect()) {
+			std::cerr << "failed to open connection " << i << std::endl;
+			return 1;
+		}
+		connections.push_back(std::move(conn));
+	}
+
+	std::vector<std::thread> threads;
+	for (auto& ioc : contexts) {
+		threads.emplace_back([&ioc]() { ioc -> run(); });
+	}
+
+	std::printf("cyfon_bench: %s.%s, %zu connections x %zu in-flight, %s, %s mode, payload %zu bytes\n",
+		options.service.c_str(), options.method.c_str(), options.connections, options.concurrency,
+		options.rate > 0 ? "open loop" : "closed loop", options.streaming ? "stream" : "unary", payload.size());
+
+	auto start = Clock::now();
+	auto measure_begin = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.warmup));
+	auto measure_end = measure_begin + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.duration));
+	state.measure_begin_ns.store(toNanos(measure_begin));
+	state.measure_end_ns.store(toNanos(measure_end));
+
+	for (auto& conn : connections) {
+		conn -> start();
+	}
+
+	// 预热结束时用预热期间的平均延迟作为闭环修正的期望间隔
+	std::this_thread::sleep_until(measure_begin);
+	uint64_t expected = options.expected_interval_ns;
+	if (expected == 0) {
+		HistogramSnapshot warmup;
+		for (auto& conn : connections) {
+			conn -> warmupLatency().mergeInto(warmup);
+		}
+		expected = static_cast<uint64_t>(warmup.mean());
+	}
+	state.expected_interval_ns.store(expected);
+
+	std::this_thread::sleep_until(measure_end);
+	state.stopping.store(true);
+
+	// 等待在途调用结束, 最多 5 秒
+	auto drain_deadline = Clock::now() + std::chrono::seconds(5);
+	while (Clock::now() < drain_deadline) {
+		size_t outstanding = 0;
+		for (auto& conn : connections) {
+			outstanding += conn -> outstanding();
+		}
+		if (outstanding == 0) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	for (auto& conn : connections) {
+		conn -> close();
+	}
+	guards.clear();
+	for (auto& ioc : contexts) {
+		ioc -> stop();
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	HistogramSnapshot latency;
+	HistogramSnapshot corrected;
+	uint64_t completed = 0;
+	uint64_t errors = 0;
+	HistogramSnapshot first_message;
+	uint64_t stream_messages = 0;
+	uint64_t unary_replies = 0;
+	for (auto& conn : connections) {
+		conn -> latency().mergeInto(latency);
+		conn -> corrected().mergeInto(corrected);
+		completed += conn -> completed();
+		errors += conn -> errors();
+		conn -> firstMessageLatency().mergeInto(first_message);
+		stream_messages += conn -> streamMessages();
+		unary_replies += conn -> unaryReplies();
+	}
+
+	std::printf("\nrequests: %llu, errors: %llu, throughput: %.0f req/s\n",
+		static_cast<unsigned long long>(completed), static_cast<unsigned long long>(errors),
+		static_cast<double>(completed) / options.duration);
+	if (options.streaming) {
+		std::printf("stream messages: %llu (%.0f msg/s)\n", static_cast<unsigned long long>(stream_messages),
+			static_cast<double>(stream_messages) / options.duration);
+		if (unary_replies > 0) {
+			std::printf("warning: %llu calls ended with a unary RESPONSE, %s.%s is not a server-streaming method\n",
+				static_cast<unsigned long long>(unary_replies), options.service.c_str(), options.method.c_str());
+		}
+		if (first_message.count > 0) {
+			printSummary("time to first stream message", first_message);
+		}
+	}
+
+	const HistogramSnapshot* reported = &latency;
+	if (options.rate > 0) {
+		printSummary("latency from intended send time", latency);
+	}
+	else {
+		printSummary("latency (uncorrected)", latency);
+		std::printf("expected interval for correction: %.1f us\n", static_cast<double>(expected) / 1e3);
+		printSummary("latency (coordinated omission corrected)", corrected);
+		reported = &corrected;
+	}
+
+	if (!options.hgrm_path.empty()) {
+		std::ofstream out(options.hgrm_path);
+		if (!out) {
+			std::cerr << "cannot write " << options.hgrm_path << std::endl;
+			return 1;
+		}
+		writeHgrm(out, *reported);
+		std::printf("percentile distribution written to %s\n", options.hgrm_path.c_str());
+	}
+	return 0;
+}
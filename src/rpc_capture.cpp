@@ -0,0 +1,96 @@
+#include "rpc_capture.h"
+#include "rpc_log.h"
+
+namespace cyfon_rpc {
+
+	TrafficCapture& TrafficCapture::instance() {
+		static TrafficCapture capture;
+		return capture;
+	}
+
+	bool TrafficCapture::open(const std::string& path, uint64_t max_bytes) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closeLocked();
+
+		file_ = std::fopen(path.c_str(), "wb");
+		if (!file_) {
+			CYFON_LOG_ERROR("Cannot open capture file {}", path);
+			return false;
+		}
+
+		pending_.retrieveAll();
+		pending_.append(kCaptureMagic, sizeof(kCaptureMagic));
+		written_ = sizeof(kCaptureMagic);
+		max_bytes_ = max_bytes;
+		skipped_frames_.store(0, std::memory_order_relaxed);
+		skipped_bytes_.store(0, std::memory_order_relaxed);
+		start_ = Clock::now();
+		enabled_.store(true, std::memory_order_relaxed);
+
+		CYFON_LOG_INFO("Capturing traffic to {} (limit {} bytes)", path, max_bytes);
+		return true;
+	}
+
+	void TrafficCapture::close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closeLocked();
+	}
+
+	void TrafficCapture::record(std::span<const char> header, std::span<const char> payload) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!file_) {
+			return;
+		}
+		// 在锁内取时间戳, 保证文件中的记录按时间单调递增; start_ 也只在锁内由 open 改写
+		uint64_t timestamp = static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count());
+		const size_t frame_size = header.size() + payload.size();
+		if (written_ + kCaptureRecordHeaderSize + frame_size > max_bytes_) {
+			CYFON_LOG_WARN("Capture size limit reached, stop capturing");
+			closeLocked();
+			return;
+		}
+
+		pending_.appendInt<uint64_t>(timestamp);
+		pending_.appendInt<uint32_t>(static_cast<uint32_t>(frame_size));
+		pending_.append(header.data(), header.size());
+		pending_.append(payload.data(), payload.size());
+		written_ += kCaptureRecordHeaderSize + frame_size;
+
+		if (pending_.readableBytes() >= kFlushThreshold) {
+			flushLocked();
+		}
+	}
+
+	void TrafficCapture::skip(size_t frame_size) {
+		if (!enabled()) {
+			return;
+		}
+		skipped_bytes_.fetch_add(frame_size, std::memory_order_relaxed);
+		if (skipped_frames_.fetch_add(1, std::memory_order_relaxed) == 0) {
+			CYFON_LOG_WARN("Capture skipped a {}-byte frame that was not buffered whole; further skips are only counted",
+				frame_size);
+		}
+	}
+
+	void TrafficCapture::flushLocked() {
+		if (file_ && pending_.readableBytes() > 0) {
+			std::fwrite(pending_.peek(), 1, pending_.readableBytes(), file_);
+		}
+		pending_.retrieveAll();
+	}
+
+	void TrafficCapture::closeLocked() {
+		enabled_.store(false, std::memory_order_relaxed);
+		if (!file_) {
+			return;
+		}
+		flushLocked();
+		std::fclose(file_);
+		file_ = nullptr;
+		if (uint64_t skipped = skipped_frames_.load(std::memory_order_relaxed)) {
+			CYFON_LOG_WARN("Capture finished with {} frames ({} bytes) not recorded", skipped,
+				skipped_bytes_.load(std::memory_order_relaxed));
+		}
+	}
+}
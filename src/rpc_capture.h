@@ -0,0 +1,126 @@
+#pragma once
+
+#include "buffer.h"
+#include "rpc_protocol_utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <span>
+#include <string>
+
+namespace cyfon_rpc {
+
+	// 抓包文件格式 (整数均为网络字节序):
+	//   文件头: 8 字节魔数 "CYFCAP01"
+	//   记录:   u64 时间戳 (纳秒, 相对抓包开始) | u32 帧长度 | 帧 (RpcHeader + payload, 与线上字节一致)
+	// 带 CRC32C 尾部的帧记录为去掉尾部、清掉 CHECKSUM 标志后的样子: 校验只属于原连接, 回放连接不一定协商
+	inline constexpr char kCaptureMagic[8] = { 'C', 'Y', 'F', 'C', 'A', 'P', '0', '1' };
+	inline constexpr size_t kCaptureRecordHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+
+	// 流量抓取: 把服务端收到的完整帧追加写入文件, 供 cyfon_replay 回放
+	// 未开启时 processMessage 中只有一次 relaxed load; 开启后各 I/O 线程在锁内追加到同一个缓冲区, 攒满后再写文件
+	class TrafficCapture {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static TrafficCapture& instance();
+
+		// 开始抓包, 写满 max_bytes 后自动停止
+		bool open(const std::string& path, uint64_t max_bytes = uint64_t{ 1 } << 30);
+		void close();
+
+		[[nodiscard]] bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+		// 记录一帧, frame 为线上原始字节
+		void record(std::span<const char> frame) {
+			record(frame.first(sizeof(RpcHeader)), frame.subspan(sizeof(RpcHeader)));
+		}
+
+		// 头部和 payload 分开给出, 两段拼成一帧记录; 用于头部经过改写的帧
+		void record(std::span<const char> header, std::span<const char> payload);
+
+		// 没有整帧缓存、因而无法记录的帧 (分块接收的大请求、超限被丢弃的帧) 只计数,
+		// 第一次跳过时和结束抓包时各打一条日志, 回放结果需要按跳过的量折算
+		void skip(size_t frame_size);
+
+		[[nodiscard]] uint64_t skippedFrames() const noexcept { return skipped_frames_.load(std::memory_order_relaxed); }
+		[[nodiscard]] uint64_t skippedBytes() const noexcept { return skipped_bytes_.load(std::memory_order_relaxed); }
+
+	private:
+		void flushLocked();
+		void closeLocked();
+
+		static constexpr size_t kFlushThreshold = 64 * 1024;
+
+		std::atomic<bool> enabled_{ false };
+		std::atomic<uint64_t> skipped_frames_{ 0 };
+		std::atomic<uint64_t> skipped_bytes_{ 0 };
+		std::mutex mutex_;
+		std::FILE* file_ = nullptr;
+		Buffer pending_{ kFlushThreshold };
+		uint64_t written_ = 0;
+		uint64_t max_bytes_ = 0;
+		Clock::time_point start_;
+	};
+
+	// 抓包文件中的一条记录, frame 直接指向文件数据
+	struct CaptureRecord {
+		uint64_t timestamp_ns;
+		std::span<const char> frame;
+	};
+
+	// 在抓包数据 (通常是映射区) 上顺序遍历记录, 不拷贝数据
+	class CaptureReader {
+	public:
+		explicit CaptureReader(std::span<const char> data) : data_(data) {}
+
+		[[nodiscard]] bool valid() const {
+			return data_.size() >= sizeof(kCaptureMagic) &&
+				std::memcmp(data_.data(), kCaptureMagic, sizeof(kCaptureMagic)) == 0;
+		}
+
+		bool next(CaptureRecord& record) {
+			if (offset_ + kCaptureRecordHeaderSize > data_.size()) {
+				return false;
+			}
+			uint64_t timestamp;
+			uint32_t length;
+			std::memcpy(&timestamp, data_.data() + offset_, sizeof(timestamp));
+			std::memcpy(&length, data_.data() + offset_ + sizeof(timestamp), sizeof(length));
+			length = networkToHost(length);
+
+			size_t frame_offset = offset_ + kCaptureRecordHeaderSize;
+			if (length < sizeof(RpcHeader) || frame_offset + length > data_.size()) {
+				return false;	// 截断的尾部记录
+			}
+			record.timestamp_ns = networkToHost(timestamp);
+			record.frame = data_.subspan(frame_offset, length);
+			offset_ = frame_offset + length;
+			return true;
+		}
+
+	private:
+		std::span<const char> data_;
+		size_t offset_ = sizeof(kCaptureMagic);
+	};
+
+	// 把抓到的一帧改成在回放连接上发送的样子: 头部写入 header_out, request_id 换成 request_id, 返回随后发送的 payload
+	// 旧版本抓包文件里的帧可能还带着原连接的 CRC32C 尾部; 改写 request_id 后尾部对不上, 回放连接也没有协商校验,
+	// 所以去掉尾部并清掉 CHECKSUM 标志
+	inline std::span<const char> prepare_replay_frame(std::span<const char> frame, uint32_t request_id, char* header_out) {
+		RpcHeader header;
+		deserialize_header(frame, header);
+		std::span<const char> payload = frame.subspan(sizeof(RpcHeader));
+		if ((header.flags & Flag::CHECKSUM) && payload.size() >= kChecksumSize) {
+			payload = payload.first(payload.size() - kChecksumSize);
+			header.message_size -= kChecksumSize;
+			header.flags &= ~Flag::CHECKSUM;
+		}
+		header.request_id = request_id;
+		encode_header(header, header_out);
+		return payload;
+	}
+}
@@ -0,0 +1,128 @@
+#include "rpc_channel.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace cyfon_rpc {
+
+    std::string RpcChannel::invokeWithPolicy(MethodCallState& state, uint32_t method_id, const std::string& body) {
+        const CallPolicy& policy = state.policy;
+        const bool hedged = policy.max_hedges > 0 && !replicas_.empty();
+        retry_budget_.deposit();
+
+        for (uint32_t attempt = 0;; ++attempt) {
+            auto started_at = std::chrono::steady_clock::now();
+            try {
+                // 对冲延迟按第一次尝试的延迟分布估计; 重试发生在服务端出错之后, 延迟不具代表性
+                if (hedged) {
+                    return hedgedExchange(state, method_id, body, attempt == 0);
+                }
+                std::string response = exchange(MessageType::REQUEST, Flag::NONE, method_id, body).retrieveAllAsString();
+                if (attempt == 0) {
+                    state.latency.record(std::chrono::steady_clock::now() - started_at);
+                }
+                return response;
+            }
+            catch (const RpcError& e) {
+                // 不可重试的状态、次数用完或预算耗尽时把最后一次的错误交给调用方
+                if (!policy.retryable(e.status()) || attempt + 1 >= policy.max_attempts || !retry_budget_.tryWithdraw()) {
+                    throw;
+                }
+            }
+            std::this_thread::sleep_for(policy.backoff(attempt));
+        }
+    }
+
+    std::string RpcChannel::hedgedExchange(MethodCallState& state, uint32_t method_id, const std::string& body,
+                                           bool record_latency) {
+        // 各副本的回复在各自连接的 strand 上到达, 第一个成功的结果胜出;
+        // 失败的回复只有在没有其它在途副本时才作为最终结果, 否则继续等别的副本
+        struct HedgeState {
+            std::mutex mutex;
+            std::condition_variable cv;
+            size_t outstanding = 0;
+            bool done = false;
+            RpcStatus status = RpcStatus::OK;
+            std::string payload;
+            std::chrono::steady_clock::time_point completed_at;
+        };
+        auto hedge = std::make_shared<HedgeState>();
+
+        const CallPolicy& policy = state.policy;
+        const size_t replica_count = replicas_.size();
+        const size_t first = next_replica_.fetch_add(1, std::memory_order_relaxed) % replica_count;
+        const size_t max_sends = 1 + std::min<size_t>(policy.max_hedges, replica_count - 1);
+
+        std::vector<std::pair<AsyncRpcClient*, uint32_t>> sent;
+        sent.reserve(max_sends);
+        auto send = [&]() {
+            {
+                std::lock_guard<std::mutex> lock(hedge -> mutex);
+                ++hedge -> outstanding;
+            }
+            auto& client = replicas_[(first + sent.size()) % replica_count];
+            uint32_t request_id = client -> call(service_id_, method_id, body,
+                [hedge](RpcStatus status, const RpcHeader&, std::string_view payload, bool last) {
+                    if (!last) {
+                        return;
+                    }
+                    std::lock_guard<std::mutex> lock(hedge -> mutex);
+                    --hedge -> outstanding;
+                    if (hedge -> done || (status != RpcStatus::OK && hedge -> outstanding > 0)) {
+                        return;
+                    }
+                    hedge -> done = true;
+                    hedge -> status = status;
+                    hedge -> payload.assign(payload);
+                    hedge -> completed_at = std::chrono::steady_clock::now();
+                    hedge -> cv.notify_all();
+                }, Flag::NONE, timeout_ms_);
+            sent.emplace_back(client.get(), request_id);
+        };
+
+        auto fallback = std::chrono::duration_cast<std::chrono::microseconds>(policy.initial_hedge_delay);
+        auto delay = std::max<std::chrono::microseconds>(state.latency.percentile(policy.hedge_percentile, fallback),
+                                                         policy.min_hedge_delay);
+
+        auto started_at = std::chrono::steady_clock::now();
+        send();
+        std::unique_lock<std::mutex> lock(hedge -> mutex);
+        while (!hedge -> done) {
+            if (sent.size() >= max_sends) {
+                hedge -> cv.wait(lock, [&]() { return hedge -> done; });
+                break;
+            }
+            if (hedge -> cv.wait_for(lock, delay, [&]() { return hedge -> done; })) {
+                break;
+            }
+            // 超过对冲延迟仍未返回; 预算不足时不再对冲, 只等已发出的请求
+            if (!retry_budget_.tryWithdraw()) {
+                hedge -> cv.wait(lock, [&]() { return hedge -> done; });
+                break;
+            }
+            lock.unlock();
+            send();
+            lock.lock();
+        }
+        RpcStatus status = hedge -> status;
+        std::string payload = std::move(hedge -> payload);
+        auto completed_at = hedge -> completed_at;
+        lock.unlock();
+
+        // 只记录第一份请求的延迟: 它先返回时是准确值; 对冲胜出时第一份还没回来, 它的延迟至少是这么长,
+        // 按下界计入, 否则分位数只剩下快的样本, 对冲延迟会越估越短
+        if (record_latency && status == RpcStatus::OK) {
+            state.latency.record(completed_at - started_at);
+        }
+
+        // 取消落后的请求, 它们的回复到达后直接丢弃; 取消只在本地生效, 服务端仍会执行完 (见 CallPolicy)
+        for (auto& [client, request_id] : sent) {
+            client -> cancel(request_id);
+        }
+
+        if (status != RpcStatus::OK) {
+            throw RpcError(status, payload);
+        }
+        return payload;
+    }
+}
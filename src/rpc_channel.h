@@ -1,14 +1,97 @@
 #pragma once
 
 #include "RpcClient.h"
+#include "async_rpc_client.h"
+#include "call_policy.h"
+#include "client_cache.h"
 #include "rpc_header.h"
 #include "rpc_protocol_utils.h"
+#include "rpc_trace.h"
+#include "message_codec.h"
+#include "typed_service.h"
 #include <google/protobuf/message.h>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace cyfon_rpc {
 
+    // 服务端以 ERROR 回复时抛出, 携带状态码供调用方和重试策略判断
+    class RpcError : public std::runtime_error {
+    public:
+        RpcError(RpcStatus status, const std::string& message)
+            : std::runtime_error("RPC failed: " + message), status_(status) {}
+
+        [[nodiscard]] RpcStatus status() const noexcept { return status_; }
+
+    private:
+        RpcStatus status_;
+    };
+
+    // 批量调用构造器: 收集多个独立的小请求, 由 RpcChannel::callBatch 合并成一个 BATCH 帧发出
+    // 每个子调用只多 12 字节子头, 服务端一次解析、一次回包
+    class RpcBatch {
+    public:
+        explicit RpcBatch(uint32_t service_id) : service_id_(service_id) {}
+
+        // 添加一个发往默认服务的子调用, 返回它在结果中的下标
+        template<typename RequestType>
+        size_t add(uint32_t method_id, const RequestType& request) {
+            return add(service_id_, method_id, request);
+        }
+
+        // 添加一个发往任意服务的子调用
+        template<typename RequestType>
+        size_t add(uint32_t service_id, uint32_t method_id, const RequestType& request) {
+            if (count_ >= kMaxBatchCalls) {
+                throw std::length_error("Too many calls in one batch");
+            }
+            std::string body;
+            if (!encode_message(request, body)) {
+                throw std::runtime_error("Failed to serialize request");
+            }
+            append_batch_call(calls_, service_id, method_id, body);
+            return count_++;
+        }
+
+        [[nodiscard]] size_t size() const noexcept { return count_; }
+
+        // 按响应类型取出第 index 个结果, 子调用失败时抛出异常
+        template<typename ResponseType>
+        static ResponseType get(const std::vector<BatchResult>& results, size_t index) {
+            const BatchResult& result = results.at(index);
+            if (result.status != RpcStatus::OK) {
+                throw std::runtime_error("RPC failed: " + result.payload);
+            }
+            ResponseType response;
+            if (!decode_message(result.payload, response)) {
+                throw std::runtime_error("Failed to parse response");
+            }
+            return response;
+        }
+
+    private:
+        friend class RpcChannel;
+
+        // BATCH 请求 payload: 子调用数 + 已编码的子调用
+        [[nodiscard]] std::string encode() const {
+            Buffer payload(sizeof(uint32_t) + calls_.readableBytes());
+            payload.appendInt<uint32_t>(static_cast<uint32_t>(count_));
+            payload.append(calls_.toStringView());
+            return payload.retrieveAllAsString();
+        }
+
+        uint32_t service_id_;
+        Buffer calls_;
+        size_t count_ = 0;
+    };
+
     // RpcChannel - 提供类型安全的客户端调用接口
     class RpcChannel {
     public:
@@ -16,48 +99,179 @@ namespace cyfon_rpc {
             : client_(client), service_id_(service_id) {
         }
 
+        // 设置每次调用的超时, 随请求头发给服务端; 0 表示不限
+        void setTimeout(std::chrono::milliseconds timeout) {
+            timeout_ms_ = static_cast<uint32_t>(timeout.count());
+        }
+
+        // 对某个方法开启客户端缓存和相同请求合并; 需在开始调用之前配置
+        // ttl 为 0 时不缓存, 只合并多个线程同时发起的相同调用
+        void enableCache(uint32_t method_id, ClientCache::Policy policy) {
+            cache_.setPolicy(method_id, policy);
+        }
+
+        // 对某个方法设置重试 / 对冲策略; 需在开始调用之前配置, 只能用于幂等方法
+        void setCallPolicy(uint32_t method_id, const CallPolicy& policy) {
+            call_policies_[method_id] = std::make_unique<MethodCallState>(policy);
+        }
+
+        // 对冲请求发往的副本连接 (已 connect 并 start); 设置后配置了 max_hedges 的方法只走这些连接,
+        // 每次调用轮转选择第一个副本, 对冲依次发往后面的副本
+        void setReplicas(std::vector<std::shared_ptr<AsyncRpcClient>> replicas) {
+            replicas_ = std::move(replicas);
+        }
+
+        [[nodiscard]] const RetryBudget& retryBudget() const noexcept { return retry_budget_; }
+
+        // 客户端缓存的内存上限 (字节), 本 Channel 的所有方法共用
+        void setCacheCapacity(size_t bytes) { cache_.setCapacity(bytes); }
+
+        [[nodiscard]] const ClientCache::Stats& cacheStats() const noexcept { return cache_.stats(); }
+
         // 模板方法：自动处理序列化和反序列化
+        // 编码格式由 MessageCodec<RequestType> / MessageCodec<ResponseType> 决定 (protobuf、定长 POD 或偏移表)
         template<typename RequestType, typename ResponseType>
         ResponseType callMethod(uint32_t method_id, const RequestType& request) {
             // 序列化请求
             std::string request_body;
-            if (!request.SerializeToString(&request_body)) {
+            if (!encode_message(request, request_body)) {
                 throw std::runtime_error("Failed to serialize request");
             }
 
-            // 构造请求缓冲区
+            // 缓存可能在后台线程上用这个 loader 刷新过期条目, 请求体按值捕获
+            std::string response_body = cache_.enabled(method_id)
+                ? cache_.get(method_id, request_body, [this, method_id, request_body]() { return invoke(method_id, request_body); })
+                : invoke(method_id, request_body);
+
+            // 反序列化响应
+            ResponseType response;
+            if (!decode_message(response_body, response)) {
+                throw std::runtime_error("Failed to parse response");
+            }
+
+            return response;
+        }
+
+        // 创建一个默认发往本服务的批量调用
+        [[nodiscard]] RpcBatch batch() const { return RpcBatch(service_id_); }
+
+        // 把批量调用作为一个 BATCH 帧发出, 结果与 add 的顺序一一对应
+        // run_inline 为 true 时服务端在一个工作线程里顺序执行所有子调用, 适合大量很小的调用
+        std::vector<BatchResult> callBatch(const RpcBatch& batch, bool run_inline = false) {
+            Buffer response_buffer = exchange(MessageType::BATCH, run_inline ? Flag::BATCH_INLINE : Flag::NONE, 0,
+                                              batch.encode());
+
+            std::vector<BatchResult> results;
+            if (!parse_batch_results(response_buffer.readableBytesView(), results) || results.size() != batch.size()) {
+                throw std::runtime_error("Failed to parse batch response");
+            }
+            return results;
+        }
+
+    private:
+        struct MethodCallState {
+            explicit MethodCallState(const CallPolicy& p) : policy(p) {}
+
+            CallPolicy policy;
+            LatencyWindow latency;  // 第一次尝试的延迟, 用来计算对冲延迟
+        };
+
+        // 发出一次普通调用, 返回响应体; 方法配置了策略时按策略重试和对冲
+        std::string invoke(uint32_t method_id, const std::string& body) {
+            auto it = call_policies_.find(method_id);
+            if (it == call_policies_.end()) {
+                return exchange(MessageType::REQUEST, Flag::NONE, method_id, body).retrieveAllAsString();
+            }
+            return invokeWithPolicy(*it -> second, method_id, body);
+        }
+
+        std::string invokeWithPolicy(MethodCallState& state, uint32_t method_id, const std::string& body);
+        std::string hedgedExchange(MethodCallState& state, uint32_t method_id, const std::string& body, bool record_latency);
+
+        // 发送一帧请求并等待响应, 返回的缓冲区已跳过响应头
+        // 服务端返回 ERROR 时抛出 RpcError; 连接断开、读写失败时抛出 UNAVAILABLE, 可按策略重试
+        Buffer exchange(MessageType message_type, uint8_t flags, uint32_t method_id, std::string_view body) {
+            uint32_t request_id = next_request_id_.fetch_add(1, std::memory_order_relaxed);
+
+            // 链路追踪: 当前线程已有链路时作为其子 span, 否则新开一条
+            auto& tracer = Tracer::instance();
+            TraceContext trace;
+            if (tracer.enabled()) {
+                uint64_t start_ns = Tracer::nowNanos();
+                const TraceContext& current = Tracer::current();
+                trace = current ? tracer.childOf(current, start_ns) : tracer.startTrace(request_id, start_ns);
+            }
+
+            // 构造请求缓冲区, 链路上下文作为头部扩展放在 body 之前
             Buffer request_buffer;
-            request_buffer.append(request_body);
+            if (trace) {
+                append_trace_extension(request_buffer, trace);
+            }
+            request_buffer.append(body);
 
             // 添加 RPC 头部
-            RpcHeader header;
-            header.message_size = static_cast<uint32_t>(request_body.size());
+            RpcHeader header{};
+            header.message_size = static_cast<uint32_t>(sizeof(RpcHeader) + request_buffer.readableBytes());
             header.service_id = service_id_;
             header.method_id = method_id;
+            header.request_id = request_id;
+            header.message_type = static_cast<uint8_t>(message_type);
+            header.flags = flags | (trace ? Flag::TRACE_CONTEXT : Flag::NONE);
+            header.deadline_ms = timeout_ms_;
             prepend_header(request_buffer, header);
 
             // 发送并接收响应
             Buffer response_buffer = client_.send_receive(request_buffer);
+            tracer.finish("rpc.client", trace, Tracer::nowNanos());
+            if (response_buffer.readableBytes() == 0) {
+                // send_receive 在连接或读写失败时返回空缓冲区, 原因已记录日志
+                throw RpcError(RpcStatus::UNAVAILABLE, "transport error");
+            }
 
             // 解析响应头部
             RpcHeader response_header;
-            if (!parse_header(response_buffer, response_header)) {
+            if (!deserialize_header(response_buffer, response_header)) {
                 throw std::runtime_error("Failed to parse response header");
             }
-
-            // 反序列化响应
-            ResponseType response;
-            std::string response_body = response_buffer.retrieveAllAsString();
-            if (!response.ParseFromString(response_body)) {
-                throw std::runtime_error("Failed to parse response");
+            response_buffer.retrieve(sizeof(RpcHeader));
+            if (response_header.message_type == static_cast<uint8_t>(MessageType::ERROR)) {
+                throw RpcError(static_cast<RpcStatus>(response_header.reserved), response_buffer.retrieveAllAsString());
             }
-
-            return response;
+            return response_buffer;
         }
 
-    private:
         RpcClient& client_;
         uint32_t service_id_;
+        uint32_t timeout_ms_ = 0;
+        std::atomic<uint32_t> next_request_id_{ 1 };
+
+        std::unordered_map<uint32_t, std::unique_ptr<MethodCallState>> call_policies_;
+        std::vector<std::shared_ptr<AsyncRpcClient>> replicas_;
+        std::atomic<size_t> next_replica_{ 0 };
+        RetryBudget retry_budget_;
+
+        // 放在最后, 最先析构: 后台刷新线程调用 invoke, 要在上面的成员析构之前停下
+        ClientCache cache_;
+    };
+
+    // 类型化 Channel: 服务ID、方法ID和请求/响应类型都来自服务定义 (见 typed_service.h),
+    // 调用服务里不存在的方法或传错请求类型在编译期报错
+    template <TypedServiceDef Service>
+    class TypedChannel {
+    public:
+        explicit TypedChannel(RpcClient& client) : channel_(client, service_id_v<Service>) {}
+
+        template <typename Method>
+            requires ServiceMethod<Service, Method>
+        typename Method::Response call(const typename Method::Request& request) {
+            return channel_.callMethod<typename Method::Request, typename Method::Response>(Method::kId, request);
+        }
+
+        // 超时、缓存、重试等按方法的配置仍在底层 RpcChannel 上设置
+        [[nodiscard]] RpcChannel& channel() noexcept { return channel_; }
+
+    private:
+        RpcChannel channel_;
     };
 
     // 为特定服务创建强类型 Channel 的辅助宏
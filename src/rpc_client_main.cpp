@@ -0,0 +1,76 @@
+#include "RpcClient.h"
+#include "buffer.h"
+#include "rpc_header.h"
+#include "rpc_protocol_utils.h"
+#include <iostream>
+#include <string>
+#include <boost/asio.hpp>
+
+#include "calu.pb.h"
+
+int main(int argc, char* argv[]) {
+	try {
+		boost::asio::io_context ioc;
+		cyfon_rpc::RpcClient client(ioc);
+
+		// ÷: RpcClient [--unix <path>], Ĭ TCP 127.0.0.1:8888
+		bool connected = (argc > 2 && std::string(argv[1]) == "--unix")
+			? client.connectLocal(argv[2])
+			: client.connect("127.0.0.1", 8888);
+		if (!connected) {
+			return 1;
+		}
+		std::cout << "Successfully connected to server." << std::endl;
+		if (client.enableChecksum()) {
+			std::cout << "CRC32C checksums enabled." << std::endl;
+		}
+
+		// ---  Add(15, 27)  ---
+		rpc_demo::AddRequest add_req;
+		add_req.set_a(15);
+		add_req.set_b(27);
+		std::string add_req_body = add_req.SerializeAsString();
+
+		cyfon_rpc::Buffer request_buffer;
+		// ׷Body
+		request_buffer.append(add_req_body);
+
+		// ԤHeader ( prependableBytes ֮)
+		cyfon_rpc::RpcHeader header{};
+		header.service_id = std::hash<std::string>{}("CalculatorService");
+		header.method_id = std::hash<std::string>{}("Add");
+		header.message_size = sizeof(cyfon_rpc::RpcHeader) + add_req_body.size();
+		header.message_type = static_cast<uint8_t>(cyfon_rpc::MessageType::REQUEST);
+		cyfon_rpc::prepend_header(request_buffer, header);
+
+		// --- 󲢽Ӧ ---
+		std::cout << "Sending Add(15, 27) request..." << std::endl;
+		cyfon_rpc::Buffer response_buffer = client.send_receive(request_buffer);
+
+		if (response_buffer.readableBytes() > sizeof(cyfon_rpc::RpcHeader)) {
+			// HeaderBody
+			response_buffer.retrieve(sizeof(cyfon_rpc::RpcHeader));
+
+			rpc_demo::AddResponse add_res;
+			if (add_res.ParseFromArray(response_buffer.peek(), response_buffer.readableBytes())) {
+				std::cout << ">>> Add Response received. Result: " << add_res.result() << std::endl;
+			}
+			else {
+				std::cerr << "Error: Failed to parse AddResponse protobuf." << std::endl;
+			}
+		}
+		else {
+			std::cerr << "Error: Received an invalid or empty response." << std::endl;
+		}
+
+		client.close();
+		std::cout << "Connection closed." << std::endl;
+
+	}
+	catch (std::exception& e) {
+		std::cerr << "Exception: " << e.what() << std::endl;
+	}
+
+	google::protobuf::ShutdownProtobufLibrary();
+	return 0;
+}
\ No newline at end of file
@@ -11,6 +11,20 @@ namespace cyfon_rpc {
 		ERROR    = 0x04,  // 错误消息
 		PING     = 0x05,  // 心跳请求
 		PONG     = 0x06,  // 心跳响应
+		BATCH    = 0x07,  // 批量调用, payload 携带多个子调用; 响应同样是一个 BATCH 帧
+	};
+
+	// 调用状态: ERROR 消息在 RpcHeader::reserved 中携带状态码, payload 为错误描述
+	enum class RpcStatus : uint16_t {
+		OK                 = 0,
+		SERVICE_NOT_FOUND  = 1,  // 服务未注册
+		METHOD_NOT_FOUND   = 2,  // 方法不存在
+		INVALID_ARGUMENT   = 3,  // 请求无法解析
+		DEADLINE_EXCEEDED  = 4,  // 超时
+		RESOURCE_EXHAUSTED = 5,  // 超出资源限制
+		UNAVAILABLE        = 6,  // 暂时不可用, 可重试
+		INTERNAL           = 7,  // 服务内部错误
+		DATA_LOSS          = 8,  // 校验和不符, 数据在传输中损坏
 	};
 
 	// 标志位
@@ -20,6 +34,10 @@ namespace cyfon_rpc {
         STREAM_END   = 0x02,   // 流的最后一条消息
         COMPRESSED   = 0x04,   // 数据已压缩（可选，未来扩展）
         ENCRYPTED    = 0x08,   // 数据已加密（可选，未来扩展）
+        TRACE_CONTEXT = 0x10,  // payload 前携带 16 字节链路上下文 (trace_id + span_id)
+        BATCH_INLINE  = 0x20,  // BATCH 的子调用在同一个工作线程里顺序执行, 不逐个入队
+        CHECKSUM      = 0x40,  // payload 后跟 4 字节 CRC32C 尾部 (网络字节序), 覆盖头部 (含本标志和最终的 message_size) 到尾部之前的所有字节;
+                               // PING 带此标志表示请求开启校验, PONG 带此标志表示对端同意, 之后双方发出的帧都带尾部, 不带的按损坏处理
 	};
 
 	struct RpcHeader {
@@ -35,6 +53,7 @@ namespace cyfon_rpc {
         uint8_t  message_type;      // 消息类型（MessageType）
         uint8_t  flags;             // 标志位（Flags）
         uint16_t reserved;          // 保留字段（未来扩展）
+        uint32_t deadline_ms;       // 请求的相对超时（毫秒），0 表示不限
 	};
 
 	static_assert(sizeof(RpcHeader) == 32, "RpcHeader size is not 32 bytes");
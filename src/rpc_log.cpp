@@ -0,0 +1,33 @@
+#include "rpc_log.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/basic_file_sink.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+
+namespace cyfon_rpc::log {
+
+	void init(const LogOptions& options) {
+		spdlog::init_thread_pool(options.queue_size, 1);
+
+		spdlog::sink_ptr sink;
+		if (options.file.empty()) {
+			sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+		}
+		else {
+			sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(options.file);
+		}
+
+		auto policy = options.overflow == OverflowPolicy::Block
+			? spdlog::async_overflow_policy::block
+			: spdlog::async_overflow_policy::overrun_oldest;
+
+		auto logger = std::make_shared<spdlog::async_logger>(
+			"cyfon_rpc", std::move(sink), spdlog::thread_pool(), policy);
+		logger->set_level(options.level);
+		logger->flush_on(spdlog::level::err);
+		spdlog::set_default_logger(std::move(logger));
+	}
+
+	void shutdown() {
+		spdlog::shutdown();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "spdlog/spdlog.h"
+#include <cstddef>
+#include <string>
+
+// 编译期最低日志级别, 取值与 spdlog 一致: 0=trace 1=debug 2=info 3=warn 4=error 5=critical 6=off
+// 低于该级别的 CYFON_LOG_* 调用在预处理阶段就被移除, 参数既不求值也不格式化
+#define CYFON_RPC_LOG_LEVEL_TRACE    0
+#define CYFON_RPC_LOG_LEVEL_DEBUG    1
+#define CYFON_RPC_LOG_LEVEL_INFO     2
+#define CYFON_RPC_LOG_LEVEL_WARN     3
+#define CYFON_RPC_LOG_LEVEL_ERROR    4
+#define CYFON_RPC_LOG_LEVEL_CRITICAL 5
+#define CYFON_RPC_LOG_LEVEL_OFF      6
+
+#ifndef CYFON_RPC_LOG_LEVEL
+#define CYFON_RPC_LOG_LEVEL CYFON_RPC_LOG_LEVEL_INFO
+#endif
+
+#define CYFON_LOG_CALL(level, ...) \
+	SPDLOG_LOGGER_CALL(spdlog::default_logger_raw(), level, __VA_ARGS__)
+
+#if CYFON_RPC_LOG_LEVEL <= CYFON_RPC_LOG_LEVEL_TRACE
+#define CYFON_LOG_TRACE(...) CYFON_LOG_CALL(spdlog::level::trace, __VA_ARGS__)
+#else
+#define CYFON_LOG_TRACE(...) (void)0
+#endif
+
+#if CYFON_RPC_LOG_LEVEL <= CYFON_RPC_LOG_LEVEL_DEBUG
+#define CYFON_LOG_DEBUG(...) CYFON_LOG_CALL(spdlog::level::debug, __VA_ARGS__)
+#else
+#define CYFON_LOG_DEBUG(...) (void)0
+#endif
+
+#if CYFON_RPC_LOG_LEVEL <= CYFON_RPC_LOG_LEVEL_INFO
+#define CYFON_LOG_INFO(...) CYFON_LOG_CALL(spdlog::level::info, __VA_ARGS__)
+#else
+#define CYFON_LOG_INFO(...) (void)0
+#endif
+
+#if CYFON_RPC_LOG_LEVEL <= CYFON_RPC_LOG_LEVEL_WARN
+#define CYFON_LOG_WARN(...) CYFON_LOG_CALL(spdlog::level::warn, __VA_ARGS__)
+#else
+#define CYFON_LOG_WARN(...) (void)0
+#endif
+
+#if CYFON_RPC_LOG_LEVEL <= CYFON_RPC_LOG_LEVEL_ERROR
+#define CYFON_LOG_ERROR(...) CYFON_LOG_CALL(spdlog::level::err, __VA_ARGS__)
+#else
+#define CYFON_LOG_ERROR(...) (void)0
+#endif
+
+namespace cyfon_rpc::log {
+
+	// 日志队列满时的处理策略
+	enum class OverflowPolicy {
+		Block,			// 调用线程阻塞等待, 不丢日志
+		DropOldest,		// 覆盖队列中最旧的日志, 调用线程永不阻塞
+	};
+
+	struct LogOptions {
+		std::size_t queue_size = 8192;						// 异步队列容量 (条)
+		OverflowPolicy overflow = OverflowPolicy::DropOldest;
+		spdlog::level::level_enum level = spdlog::level::info;	// 运行期级别, 不能低于编译期级别
+		std::string file;									// 为空时输出到控制台
+	};
+
+	// 用异步 logger 替换 spdlog 默认 logger, 格式化之后的 I/O 由后台线程完成
+	void init(const LogOptions& options = {});
+
+	// 刷出队列中剩余的日志并停止后台线程
+	void shutdown();
+}
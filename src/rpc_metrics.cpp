@@ -0,0 +1,240 @@
+#include "rpc_metrics.h"
+#include <map>
+#include <sstream>
+
+namespace cyfon_rpc {
+
+	uint64_t HistogramSnapshot::percentile(double q) const {
+		if (count == 0) {
+			return 0;
+		}
+		uint64_t target = static_cast<uint64_t>(q * static_cast<double>(count));
+		if (target >= count) {
+			target = count - 1;
+		}
+
+		uint64_t seen = 0;
+		for (size_t i = 0; i < counts.size(); ++i) {
+			seen += counts[i];
+			if (seen > target) {
+				return std::min(LatencyHistogram::bucketUpperBound(i), max);
+			}
+		}
+		return max;
+	}
+
+	void LatencyHistogram::mergeInto(HistogramSnapshot& snapshot) const {
+		if (snapshot.counts.size() < kBucketCount) {
+			snapshot.counts.resize(kBucketCount, 0);
+		}
+		for (size_t i = 0; i < kBucketCount; ++i) {
+			snapshot.counts[i] += counts_[i].load(std::memory_order_relaxed);
+		}
+		snapshot.count += count_.load();
+		snapshot.sum += sum_.load();
+		snapshot.max = std::max(snapshot.max, max_.load(std::memory_order_relaxed));
+	}
+
+	MetricsRegistry& MetricsRegistry::instance() {
+		static MetricsRegistry registry;
+		return registry;
+	}
+
+	MetricsRegistry::ThreadShard& MetricsRegistry::localShard() {
+		thread_local ThreadShard* shard = nullptr;
+		if (!shard) {
+			auto created = std::make_shared<ThreadShard>();
+			shard = created.get();
+			std::lock_guard<std::mutex> lock(shards_mutex_);
+			shards_.push_back(std::move(created));
+		}
+		return *shard;
+	}
+
+	MethodStats& MetricsRegistry::local(uint32_t service_id, uint32_t method_id) {
+		const uint64_t key = (static_cast<uint64_t>(service_id) << 32) | method_id;
+
+		// 同一线程上连续请求通常命中同一个方法, 先查一次缓存
+		thread_local uint64_t cached_key = 0;
+		thread_local MethodStats* cached_stats = nullptr;
+		if (cached_stats && cached_key == key) {
+			return *cached_stats;
+		}
+
+		ThreadShard& shard = localShard();
+		auto it = shard.methods.find(key);
+		if (it == shard.methods.end()) {
+			if (shard.methods.size() >= kMaxMethodsPerThread) {
+				return localUnknown();
+			}
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			it = shard.methods.emplace(key, std::make_unique<MethodStats>()).first;
+		}
+
+		cached_key = key;
+		cached_stats = it->second.get();
+		return *cached_stats;
+	}
+
+	MethodStats& MetricsRegistry::localUnknown() {
+		ThreadShard& shard = localShard();
+		if (!shard.unknown) {
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.unknown = shard.methods.emplace(kUnknownKey, std::make_unique<MethodStats>()).first -> second.get();
+		}
+		return *shard.unknown;
+	}
+
+	SessionStats& MetricsRegistry::localSessions() {
+		return localShard().sessions;
+	}
+
+	namespace {
+		struct MergedStats {
+			uint64_t requests = 0;
+			uint64_t errors = 0;
+			uint64_t bytes_in = 0;
+			uint64_t bytes_out = 0;
+			uint64_t coalesced = 0;
+			uint64_t cache_hits = 0;
+			uint64_t cache_misses = 0;
+			uint64_t cache_evictions = 0;
+			HistogramSnapshot queue_wait;
+			HistogramSnapshot handler_time;
+			HistogramSnapshot write_time;
+		};
+
+		// service="..",method=".." 标签, unknown 槽单独命名
+		void writeLabels(std::ostringstream& out, uint64_t key) {
+			if (key == MetricsRegistry::kUnknownKey) {
+				out << "service=\"unknown\",method=\"unknown\"";
+				return;
+			}
+			out << "service=\"" << static_cast<uint32_t>(key >> 32) << "\",method=\"" << static_cast<uint32_t>(key) << '"';
+		}
+
+		// 导出的 le 边界: 每个 2 的幂区间取第 8 和第 16 个子桶的上界, 约 0.77us ~ 68.7s, 相邻边界相差 1.33~1.5 倍
+		// 边界与 HDR 桶边界重合, 累计计数是精确的; 全部 608 个桶逐个导出对每个序列来说太多
+		constexpr unsigned kFirstExportedShift = 5;
+		constexpr unsigned kLastExportedShift = 31;
+
+		std::vector<size_t> exportedBuckets() {
+			std::vector<size_t> indices;
+			constexpr size_t kSub = LatencyHistogram::kSubBucketCount;
+			for (unsigned shift = kFirstExportedShift; shift <= kLastExportedShift; ++shift) {
+				indices.push_back(kSub + shift * kSub + kSub / 2 - 1);
+				indices.push_back(kSub + shift * kSub + kSub - 1);
+			}
+			return indices;
+		}
+
+		void writeHistogram(std::ostringstream& out, const char* name, const char* help,
+							const std::map<uint64_t, MergedStats>& merged,
+							HistogramSnapshot MergedStats::* member) {
+			static const std::vector<size_t> kExported = exportedBuckets();
+
+			out << "# HELP " << name << ' ' << help << '\n';
+			out << "# TYPE " << name << " histogram\n";
+			for (const auto& [key, stats] : merged) {
+				const HistogramSnapshot& hist = stats.*member;
+
+				// 桶计数与 count 分别读取, 抓取时可能相差几次记录; 以桶计数之和作为 +Inf 和 _count, 保持一致
+				uint64_t cumulative = 0;
+				size_t next = 0;
+				for (size_t i = 0; i < hist.counts.size() && next < kExported.size(); ++i) {
+					cumulative += hist.counts[i];
+					if (i == kExported[next]) {
+						out << name << "_bucket{";
+						writeLabels(out, key);
+						out << ",le=\"" << LatencyHistogram::bucketUpperBound(i) / 1e9 << "\"} " << cumulative << '\n';
+						++next;
+					}
+				}
+				uint64_t total = 0;
+				for (uint64_t count : hist.counts) {
+					total += count;
+				}
+				out << name << "_bucket{";
+				writeLabels(out, key);
+				out << ",le=\"+Inf\"} " << total << '\n';
+				out << name << "_sum{";
+				writeLabels(out, key);
+				out << "} " << hist.sum / 1e9 << '\n';
+				out << name << "_count{";
+				writeLabels(out, key);
+				out << "} " << total << '\n';
+			}
+		}
+
+		void writeScalar(std::ostringstream& out, const char* name, const char* type, const char* help, int64_t value) {
+			out << "# HELP " << name << ' ' << help << '\n';
+			out << "# TYPE " << name << ' ' << type << '\n';
+			out << name << ' ' << value << '\n';
+		}
+
+		void writeCounter(std::ostringstream& out, const char* name, const char* help,
+						  const std::map<uint64_t, MergedStats>& merged,
+						  uint64_t MergedStats::* member) {
+			out << "# HELP " << name << ' ' << help << '\n';
+			out << "# TYPE " << name << " counter\n";
+			for (const auto& [key, stats] : merged) {
+				out << name << '{';
+				writeLabels(out, key);
+				out << "} " << stats.*member << '\n';
+			}
+		}
+	}
+
+	std::string MetricsRegistry::renderPrometheus() const {
+		std::map<uint64_t, MergedStats> merged;
+		int64_t sessions = 0;
+		int64_t parked = 0;
+		int64_t buffer_bytes = 0;
+		int64_t buffer_shrinks = 0;
+		{
+			std::lock_guard<std::mutex> lock(shards_mutex_);
+			for (const auto& shard : shards_) {
+				sessions += shard->sessions.sessions.load();
+				parked += shard->sessions.parked.load();
+				buffer_bytes += shard->sessions.buffer_bytes.load();
+				buffer_shrinks += static_cast<int64_t>(shard->sessions.buffer_shrinks.load());
+
+				std::lock_guard<std::mutex> shard_lock(shard->mutex);
+				for (const auto& [key, stats] : shard->methods) {
+					MergedStats& dst = merged[key];
+					dst.requests += stats->requests.load();
+					dst.errors += stats->errors.load();
+					dst.bytes_in += stats->bytes_in.load();
+					dst.bytes_out += stats->bytes_out.load();
+					dst.coalesced += stats->coalesced.load();
+					dst.cache_hits += stats->cache_hits.load();
+					dst.cache_misses += stats->cache_misses.load();
+					dst.cache_evictions += stats->cache_evictions.load();
+					stats->queue_wait.mergeInto(dst.queue_wait);
+					stats->handler_time.mergeInto(dst.handler_time);
+					stats->write_time.mergeInto(dst.write_time);
+				}
+			}
+		}
+
+		std::ostringstream out;
+		writeCounter(out, "cyfon_rpc_requests_total", "RPC requests received.", merged, &MergedStats::requests);
+		writeCounter(out, "cyfon_rpc_errors_total", "RPC calls that completed with an error status.", merged, &MergedStats::errors);
+		writeCounter(out, "cyfon_rpc_received_bytes_total", "Request payload bytes.", merged, &MergedStats::bytes_in);
+		writeCounter(out, "cyfon_rpc_sent_bytes_total", "Response payload bytes.", merged, &MergedStats::bytes_out);
+		writeCounter(out, "cyfon_rpc_coalesced_total", "Requests answered by an identical in-flight call.", merged, &MergedStats::coalesced);
+		writeCounter(out, "cyfon_rpc_cache_hits_total", "Requests answered from the response cache.", merged, &MergedStats::cache_hits);
+		writeCounter(out, "cyfon_rpc_cache_misses_total", "Cacheable requests that missed the response cache.", merged, &MergedStats::cache_misses);
+		writeCounter(out, "cyfon_rpc_cache_evictions_total", "Response cache entries evicted to make room.", merged, &MergedStats::cache_evictions);
+		writeHistogram(out, "cyfon_rpc_queue_wait_seconds", "Time from enqueue to worker start.", merged, &MergedStats::queue_wait);
+		writeHistogram(out, "cyfon_rpc_handler_seconds", "Time spent in the service handler.", merged, &MergedStats::handler_time);
+		writeHistogram(out, "cyfon_rpc_write_seconds", "Time from response enqueue to write completion.", merged, &MergedStats::write_time);
+		writeScalar(out, "cyfon_rpc_sessions", "gauge", "Open RPC sessions.", sessions);
+		writeScalar(out, "cyfon_rpc_parked_sessions", "gauge", "Idle sessions waiting on a zero-byte read.", parked);
+		writeScalar(out, "cyfon_rpc_session_buffer_bytes", "gauge", "Read buffer capacity held by all sessions.", buffer_bytes);
+		writeScalar(out, "cyfon_rpc_session_buffer_bytes_per_session", "gauge", "Average read buffer capacity per session.",
+			sessions > 0 ? buffer_bytes / sessions : 0);
+		writeScalar(out, "cyfon_rpc_session_buffer_shrinks_total", "counter", "Read buffer shrinks and releases.", buffer_shrinks);
+		return out.str();
+	}
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 单写者计数器: 只由所属线程递增, 用 relaxed load+store 代替原子 RMW, 其它线程抓取时只读
+	class LocalCounter {
+	public:
+		void add(uint64_t n = 1) noexcept {
+			value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+		[[nodiscard]] uint64_t load() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<uint64_t> value_{ 0 };
+	};
+
+	// 单写者计量值, 可增可减, 写法与 LocalCounter 相同
+	class LocalGauge {
+	public:
+		void add(int64_t n) noexcept {
+			value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+		}
+		[[nodiscard]] int64_t load() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+	private:
+		std::atomic<int64_t> value_{ 0 };
+	};
+
+	// 直方图快照, 由多个线程的直方图合并得到
+	struct HistogramSnapshot {
+		std::vector<uint64_t> counts;
+		uint64_t count = 0;
+		uint64_t sum = 0;
+		uint64_t max = 0;
+
+		// 返回分位数 q (0~1) 对应的值, 取所在桶的上界
+		[[nodiscard]] uint64_t percentile(double q) const;
+		[[nodiscard]] double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+	};
+
+	// HDR 风格的对数线性直方图 (单位纳秒)
+	// 每个 2 的幂区间均分为 16 个子桶, 相对误差不超过 1/16; 超过 2^40 ns 的值记到最后一个桶
+	// 单写者: record 只能由所属线程调用, 其它线程可随时 mergeInto
+	class LatencyHistogram {
+	public:
+		static constexpr unsigned kSubBucketBits = 4;
+		static constexpr uint64_t kSubBucketCount = uint64_t{ 1 } << kSubBucketBits;
+		static constexpr unsigned kMaxExponent = 40;
+		static constexpr size_t kBucketCount = kSubBucketCount + (kMaxExponent - kSubBucketBits + 1) * kSubBucketCount;
+
+		static constexpr size_t bucketIndex(uint64_t value) noexcept {
+			if (value < kSubBucketCount) {
+				return static_cast<size_t>(value);
+			}
+			unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+			if (exponent > kMaxExponent) {
+				return kBucketCount - 1;
+			}
+			unsigned shift = exponent - kSubBucketBits;
+			uint64_t mantissa = (value >> shift) - kSubBucketCount;
+			return static_cast<size_t>(kSubBucketCount + shift * kSubBucketCount + mantissa);
+		}
+
+		// 桶内可表示的最大值
+		static constexpr uint64_t bucketUpperBound(size_t index) noexcept {
+			if (index < kSubBucketCount) {
+				return index;
+			}
+			uint64_t shift = (index - kSubBucketCount) / kSubBucketCount;
+			uint64_t mantissa = (index - kSubBucketCount) % kSubBucketCount;
+			return ((kSubBucketCount + mantissa + 1) << shift) - 1;
+		}
+
+		void record(uint64_t value) noexcept {
+			auto& bucket = counts_[bucketIndex(value)];
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			count_.add();
+			sum_.add(value);
+			if (value > max_.load(std::memory_order_relaxed)) {
+				max_.store(value, std::memory_order_relaxed);
+			}
+		}
+
+		void mergeInto(HistogramSnapshot& snapshot) const;
+
+	private:
+		std::array<std::atomic<uint64_t>, kBucketCount> counts_{};
+		LocalCounter count_;
+		LocalCounter sum_;
+		std::atomic<uint64_t> max_{ 0 };
+	};
+
+	// 一个 (service, method) 在单个线程上的统计
+	struct MethodStats {
+		LocalCounter requests;
+		LocalCounter errors;
+		LocalCounter bytes_in;
+		LocalCounter bytes_out;
+		LocalCounter coalesced;			// 挂接到相同在途调用上、没有单独执行的请求
+		LocalCounter cache_hits;		// 由响应缓存直接应答的请求
+		LocalCounter cache_misses;		// 开启了缓存但未命中的请求
+		LocalCounter cache_evictions;	// 为腾出空间被淘汰的缓存条目
+		LatencyHistogram queue_wait;	// 入队到工作线程开始执行
+		LatencyHistogram handler_time;	// IService::callMethod 耗时
+		LatencyHistogram write_time;	// 响应入写队列到写完成
+	};
+
+	// 一个 I/O 线程上所有连接的内存统计, 只由该线程更新 (会话固定在一个 I/O 线程上)
+	struct SessionStats {
+		LocalGauge sessions;			// 打开的连接数
+		LocalGauge parked;				// 挂起在零字节读上的连接数
+		LocalGauge buffer_bytes;		// 读缓冲区容量之和
+		LocalCounter buffer_shrinks;	// 读缓冲区收缩或释放的次数
+	};
+
+	// 全局指标注册表
+	// 每个线程拥有自己的分片, 记录路径无共享写; 抓取时加锁遍历所有分片并合并
+	class MetricsRegistry {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static MetricsRegistry& instance();
+
+		// 当前线程上 (service, method) 的统计槽, 首次访问时分配
+		// 每个槽带几个直方图, 约 15KB; 调用方应只对已注册的方法调用它 (见 RpcServer::methodStats),
+		// 线程上的槽数达到 kMaxMethodsPerThread 后新的 ID 一律记入 unknown 槽, 作为兜底
+		MethodStats& local(uint32_t service_id, uint32_t method_id);
+
+		// 未注册的服务或方法共用的统计槽, 导出时标签为 service="unknown",method="unknown"
+		MethodStats& localUnknown();
+
+		static constexpr uint64_t kUnknownKey = UINT64_MAX;
+		static constexpr size_t kMaxMethodsPerThread = 1024;
+
+		// 当前线程的连接内存统计
+		SessionStats& localSessions();
+
+		// 导出 Prometheus 文本格式
+		[[nodiscard]] std::string renderPrometheus() const;
+
+		static uint64_t elapsedNanos(Clock::time_point start, Clock::time_point end) noexcept {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+		}
+
+	private:
+		struct ThreadShard {
+			// 只有所属线程会插入; 插入和抓取都持有 mutex, 所属线程查找无需加锁
+			std::unordered_map<uint64_t, std::unique_ptr<MethodStats>> methods;
+			MethodStats* unknown = nullptr;		// methods[kUnknownKey], 首次使用时创建
+			SessionStats sessions;
+			mutable std::mutex mutex;
+		};
+
+		ThreadShard& localShard();
+
+		mutable std::mutex shards_mutex_;
+		// 线程退出后分片仍然保留, 已记录的数据不会丢失
+		std::vector<std::shared_ptr<ThreadShard>> shards_;
+	};
+}
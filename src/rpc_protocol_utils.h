@@ -1,61 +1,211 @@
 #pragma once
 
 #include "buffer.h"
+#include "crc32c.h"
+#include "header_codec.h"
 #include "rpc_header.h"
+#include <functional>
 #include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace cyfon_rpc {
-	inline bool deserialize_header(const Buffer& buffer, RpcHeader& header) {
-		if (buffer.readableBytes() < sizeof(header)) {
+	// 从一段已封帧的字节中解析头部, 不校验帧长; 读取网络数据的路径应使用 decode_header
+	inline bool deserialize_header(std::span<const char> data, RpcHeader& header) {
+		if (data.size() < sizeof(header)) {
 			return false; 
 		}
+		detail::swapHeaderBytes(data.data(), reinterpret_cast<char*>(&header));
+		return true;
+	}
 
-		// first方返回一个span对象，表示缓冲区中前sizeof(RpcHeader)个字节的视图
-		auto header_view = buffer.readableBytesView().first(sizeof(RpcHeader));
-		std::memcpy(&header, header_view.data(), sizeof(RpcHeader));
+	inline bool deserialize_header(const Buffer& buffer, RpcHeader& header) {
+		return deserialize_header(buffer.readableBytesView(), header);
+	}
 
-		// 开始转换字节序
-		header.message_size = networkToHost(header.message_size);
-		header.method_id = networkToHost(header.method_id);
-		header.service_id = networkToHost(header.service_id);
-		header.request_id = networkToHost(header.request_id);
-		header.stream_id = networkToHost(header.stream_id);
-		header.sequence_number = networkToHost(header.sequence_number);
-		header.reserved = networkToHost(header.reserved);
-		// message_type 和 flags 是单字节，不需要转换
+	inline void serialize_header(Buffer& buffer, const RpcHeader& header) {
+		char network_header[sizeof(RpcHeader)];
+		encode_header(header, network_header);
+		buffer.append({ network_header, sizeof(network_header) });
+	}
+
+	// 插入buffer预制头部
+	inline void prepend_header(Buffer& buffer, const RpcHeader& header) {
+		char network_header[sizeof(RpcHeader)];
+		encode_header(header, network_header);
+		buffer.prepend(network_header, sizeof(network_header));
+	}
 
+	// ===== CRC32C 尾部 (Flag::CHECKSUM) =====
+	// 尾部覆盖整帧: 已置 CHECKSUM 标志、message_size 已含尾部的头部, 加上其后到尾部之前的所有字节,
+	// 头部里 request_id、状态码或标志位的翻转同样能被发现
+	constexpr size_t kChecksumSize = sizeof(uint32_t);
+
+	// frame 是一条完整的帧, 末尾 4 字节为尾部
+	inline bool verify_checksum(std::span<const char> frame) {
+		if (frame.size() < sizeof(RpcHeader) + kChecksumSize) {
+			return false;
+		}
+		size_t covered = frame.size() - kChecksumSize;
+		uint32_t expected;
+		std::memcpy(&expected, frame.data() + covered, kChecksumSize);
+		return crc32c(frame.data(), covered) == networkToHost(expected);
+	}
+
+	// 给一条完整的帧加上尾部: 先置 CHECKSUM 标志、message_size 加 4, 再按改好的头部计算
+	inline void append_checksum(Buffer& frame) {
+		RpcHeader header;
+		deserialize_header(frame, header);
+		header.message_size += kChecksumSize;
+		header.flags |= Flag::CHECKSUM;
+		frame.retrieve(sizeof(RpcHeader));
+		prepend_header(frame, header);
+		auto covered = frame.readableBytesView();
+		uint32_t crc = crc32c(covered.data(), covered.size());
+		frame.appendInt<uint32_t>(crc);
+	}
+
+	// 校验并去掉一条完整帧的尾部, 帧还原成不带校验时的样子
+	// 没有 CHECKSUM 标志的帧: required 为 true (已协商校验, 标志可能在传输中被清掉) 时返回 false, 否则原样返回 true
+	inline bool strip_checksum(Buffer& frame, bool required = false) {
+		RpcHeader header;
+		if (!deserialize_header(frame, header) || !(header.flags & Flag::CHECKSUM)) {
+			return !required;
+		}
+		if (!verify_checksum(frame.readableBytesView())) {
+			return false;
+		}
+		frame.unwrite(kChecksumSize);
+		header.message_size -= kChecksumSize;
+		header.flags &= ~Flag::CHECKSUM;
+		frame.retrieve(sizeof(RpcHeader));
+		prepend_header(frame, header);
 		return true;
 	}
 
-	inline void serialize_header(Buffer& buffer, const RpcHeader& header) {
-		RpcHeader network_header = header;
+	// 根据请求头构造响应头, 非 OK 状态生成 ERROR 消息并把状态码写入 reserved
+	inline RpcHeader make_response_header(const RpcHeader& request, RpcStatus status, size_t payload_size) {
+		RpcHeader header{};
+		header.message_size = static_cast<uint32_t>(sizeof(RpcHeader) + payload_size);
+		header.service_id = request.service_id;
+		header.method_id = request.method_id;
+		header.request_id = request.request_id;
+		header.stream_id = request.stream_id;
+		header.sequence_number = 0;
+		header.message_type = static_cast<uint8_t>(status == RpcStatus::OK ? MessageType::RESPONSE : MessageType::ERROR);
+		header.flags = Flag::NONE;
+		header.reserved = static_cast<uint16_t>(status);
+		return header;
+	}
 
-		// 将所有字段从主机字节序转换为网络字节序
-		network_header.message_size = hostToNetwork(network_header.message_size);
-		network_header.service_id = hostToNetwork(network_header.service_id);
-		network_header.method_id = hostToNetwork(network_header.method_id);
-		network_header.request_id = hostToNetwork(network_header.request_id);
-		network_header.stream_id = hostToNetwork(network_header.stream_id);
-		network_header.sequence_number = hostToNetwork(network_header.sequence_number);
-		network_header.reserved = hostToNetwork(network_header.reserved);
-		// message_type 和 flags 是单字节，不需要转换
+	// 请求的路由加请求体哈希, 在途合并和响应缓存用它定位相同的调用
+	inline size_t request_hash(uint32_t service_id, uint32_t method_id, std::string_view body) noexcept {
+		uint64_t route = (static_cast<uint64_t>(service_id) << 32) | method_id;
+		return std::hash<std::string_view>{}(body) ^ static_cast<size_t>(route * 0x9E3779B97F4A7C15ull);
+	}
+
+	// ===== 批量调用 =====
+	// BATCH 请求 payload: u32 子调用数, 每个子调用是 12 字节子头 (service_id, method_id, 请求体长度) + 请求体
+	// BATCH 响应 payload: u32 结果数, 每个结果是 6 字节子头 (RpcStatus, 响应体长度) + 响应体
+	// 整数都是网络字节序; 结果与子调用按顺序一一对应
+	constexpr size_t kBatchCallHeaderSize = 12;
+	constexpr size_t kBatchResultHeaderSize = 6;
+	constexpr uint32_t kMaxBatchCalls = 1024;
+
+	struct BatchCall {
+		uint32_t service_id = 0;
+		uint32_t method_id = 0;
+		std::string body;
+	};
 
-		buffer.append({ reinterpret_cast<const char*>(&network_header), sizeof(network_header) });
+	struct BatchResult {
+		RpcStatus status = RpcStatus::OK;
+		std::string payload;	// 失败时为错误描述
+	};
+
+	inline void append_batch_call(Buffer& buffer, uint32_t service_id, uint32_t method_id, std::string_view body) {
+		buffer.appendInt<uint32_t>(service_id);
+		buffer.appendInt<uint32_t>(method_id);
+		buffer.appendInt<uint32_t>(static_cast<uint32_t>(body.size()));
+		buffer.append(body);
 	}
 
-	// 插入buffer预制头部
-	inline void prepend_header(Buffer& buffer, const RpcHeader& header) {
-		RpcHeader network_header = header;
-
-		network_header.message_size = hostToNetwork(network_header.message_size);
-		network_header.service_id = hostToNetwork(network_header.service_id);
-		network_header.method_id = hostToNetwork(network_header.method_id);
-		network_header.request_id = hostToNetwork(network_header.request_id);
-		network_header.stream_id = hostToNetwork(network_header.stream_id);
-		network_header.sequence_number = hostToNetwork(network_header.sequence_number);
-		network_header.reserved = hostToNetwork(network_header.reserved);
-		// message_type 和 flags 是单字节，不需要转换
-
-		buffer.prepend(&network_header, sizeof(network_header));
+	inline void append_batch_result(Buffer& buffer, RpcStatus status, std::string_view payload) {
+		buffer.appendInt<uint16_t>(static_cast<uint16_t>(status));
+		buffer.appendInt<uint32_t>(static_cast<uint32_t>(payload.size()));
+		buffer.append(payload);
+	}
+
+	namespace detail {
+		template<typename IntType>
+		IntType read_network_int(const char* data) noexcept {
+			IntType value;
+			std::memcpy(&value, data, sizeof(value));
+			return networkToHost(value);
+		}
+	}
+
+	// 解析 BATCH 请求, 长度不符或子调用数超过 kMaxBatchCalls 时返回 false
+	inline bool parse_batch_calls(std::span<const char> payload, std::vector<BatchCall>& calls) {
+		if (payload.size() < sizeof(uint32_t)) {
+			return false;
+		}
+		uint32_t count = detail::read_network_int<uint32_t>(payload.data());
+		if (count > kMaxBatchCalls) {
+			return false;
+		}
+		size_t offset = sizeof(uint32_t);
+
+		calls.clear();
+		calls.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			if (payload.size() - offset < kBatchCallHeaderSize) {
+				return false;
+			}
+			BatchCall call;
+			call.service_id = detail::read_network_int<uint32_t>(payload.data() + offset);
+			call.method_id = detail::read_network_int<uint32_t>(payload.data() + offset + 4);
+			uint32_t length = detail::read_network_int<uint32_t>(payload.data() + offset + 8);
+			offset += kBatchCallHeaderSize;
+			if (payload.size() - offset < length) {
+				return false;
+			}
+			call.body.assign(payload.data() + offset, length);
+			offset += length;
+			calls.push_back(std::move(call));
+		}
+		return offset == payload.size();
+	}
+
+	// 解析 BATCH 响应
+	inline bool parse_batch_results(std::span<const char> payload, std::vector<BatchResult>& results) {
+		if (payload.size() < sizeof(uint32_t)) {
+			return false;
+		}
+		uint32_t count = detail::read_network_int<uint32_t>(payload.data());
+		if (count > kMaxBatchCalls) {
+			return false;
+		}
+		size_t offset = sizeof(uint32_t);
+
+		results.clear();
+		results.reserve(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			if (payload.size() - offset < kBatchResultHeaderSize) {
+				return false;
+			}
+			BatchResult result;
+			result.status = static_cast<RpcStatus>(detail::read_network_int<uint16_t>(payload.data() + offset));
+			uint32_t length = detail::read_network_int<uint32_t>(payload.data() + offset + 2);
+			offset += kBatchResultHeaderSize;
+			if (payload.size() - offset < length) {
+				return false;
+			}
+			result.payload.assign(payload.data() + offset, length);
+			offset += length;
+			results.push_back(std::move(result));
+		}
+		return offset == payload.size();
 	}
 }
\ No newline at end of file
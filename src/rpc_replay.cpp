@@ -0,0 +1,496 @@
+// cyfon_replay: 回放 TrafficCapture 抓取的流量
+//
+// 抓包文件整体 mmap 进来, 回放时 payload 直接从映射区发送; 每个在途调用占用一个预分配的槽位,
+// 槽位里只放改写过 request_id 的头部副本, 因此逐条回放不做任何堆分配
+// 按记录的时间间隔 (除以 --speed) 开环发送, 延迟从计划发送时间开始计算, 按方法分别统计
+//
+// 示例:
+//   CYFON_RPC_CAPTURE=/tmp/traffic.cap ./rpc_server
+//   cyfon_replay --file /tmp/traffic.cap --speed 2 --connections 4
+#include <boost/asio.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "buffer.h"
+#include "rpc_capture.h"
+#include "rpc_header.h"
+#include "rpc_metrics.h"
+#include "rpc_protocol_utils.h"
+
+using namespace cyfon_rpc;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+	struct ReplayOptions {
+		std::string file;
+		std::string host = "127.0.0.1";
+		unsigned short port = 8888;
+		std::string unix_path;
+		size_t connections = 1;
+		size_t concurrency = 256;		// 每条连接最多在途的调用数
+		double speed = 1.0;				// 回放速度倍率, 0 表示不等待, 尽快发送
+	};
+
+	void printUsage() {
+		std::cout <<
+			"usage: cyfon_replay --file <capture> [options]\n"
+			"  --host <host>         server host (default 127.0.0.1)\n"
+			"  --port <port>         server port (default 8888)\n"
+			"  --unix <path>         connect over a unix domain socket instead of TCP\n"
+			"  --connections <n>     records are spread round-robin over n connections (default 1)\n"
+			"  --concurrency <n>     max in-flight calls per connection (default 256)\n"
+			"  --speed <x>           replay rate multiplier, 0 = as fast as possible (default 1)\n";
+	}
+
+	bool parseOptions(int argc, char* argv[], ReplayOptions& options) {
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+				return false;
+			}
+			std::string value = argv[++i];
+			try {
+				if (arg == "--file") options.file = value;
+				else if (arg == "--host") options.host = value;
+				else if (arg == "--port") options.port = static_cast<unsigned short>(std::stoul(value));
+				else if (arg == "--unix") options.unix_path = value;
+				else if (arg == "--connections") options.connections = std::stoul(value);
+				else if (arg == "--concurrency") options.concurrency = std::stoul(value);
+				else if (arg == "--speed") options.speed = std::stod(value);
+				else {
+					std::cerr << "unknown option " << arg << std::endl;
+					return false;
+				}
+			}
+			catch (const std::exception&) {
+				std::cerr << "invalid value for " << arg << ": " << value << std::endl;
+				return false;
+			}
+		}
+		return !options.file.empty() && options.connections > 0 && options.concurrency > 0 && options.speed >= 0;
+	}
+
+	uint64_t toNanos(Clock::time_point tp) {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count());
+	}
+
+	uint64_t methodKey(uint32_t service_id, uint32_t method_id) {
+		return (static_cast<uint64_t>(service_id) << 32) | method_id;
+	}
+
+	// 按方法统计, 方法表在回放前扫描一遍文件建好
+	struct MethodTable {
+		std::unordered_map<uint64_t, size_t> index;
+		std::vector<uint64_t> keys;
+	};
+
+	// 回放一条连接: 负责抓包中序号 % connections == id 的请求
+	class ReplayConnection : public std::enable_shared_from_this<ReplayConnection> {
+	public:
+		ReplayConnection(boost::asio::io_context& ioc, const ReplayOptions& options, const MethodTable& methods,
+						 std::span<const char> data, size_t id, uint64_t first_timestamp_ns)
+			: options_(options), methods_(methods), reader_(data), id_(id), first_timestamp_ns_(first_timestamp_ns),
+			  socket_(ioc), timer_(ioc), slots_(options.concurrency) {
+			free_slots_.reserve(options.concurrency);
+			for (size_t i = options.concurrency; i > 0; --i) {
+				free_slots_.push_back(static_cast<uint32_t>(i - 1));
+			}
+			write_queue_.reserve(options.concurrency);
+			inflight_.reserve(options.concurrency);
+			write_buffers_.reserve(options.concurrency * 2);
+			for (size_t i = 0; i < methods.keys.size(); ++i) {
+				latency_.push_back(std::make_unique<LatencyHistogram>());
+			}
+			errors_.resize(methods.keys.size(), 0);
+		}
+
+		bool connect() {
+			boost::system::error_code ec;
+			if (options_.unix_path.empty()) {
+				boost::asio::ip::tcp::resolver resolver(socket_.get_executor());
+				auto endpoints = resolver.resolve(options_.host, std::to_string(options_.port), ec);
+				if (!ec) {
+					ec = boost::asio::error::host_not_found;
+					for (const auto& entry : endpoints) {
+						socket_.close(ec);
+						socket_.connect(Socket::endpoint_type(entry.endpoint()), ec);
+						if (!ec) {
+							socket_.set_option(boost::asio::ip::tcp::no_delay(true), ec);
+							break;
+						}
+					}
+				}
+			}
+			else {
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+				socket_.connect(boost::asio::local::stream_protocol::endpoint(options_.unix_path), ec);
+#else
+				ec = boost::asio::error::operation_not_supported;
+#endif
+			}
+			if (ec) {
+				std::cerr << "connect error: " << ec.message() << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+		void start(uint64_t base_ns) {
+			base_ns_ = base_ns;
+			do_read();
+			pump();
+		}
+
+		uint64_t sent() const { return sent_; }
+		uint64_t skipped() const { return skipped_; }
+		const LatencyHistogram& latency(size_t method) const { return *latency_[method]; }
+		uint64_t errors(size_t method) const { return errors_[method]; }
+
+	private:
+		using Socket = boost::asio::generic::stream_protocol::socket;
+
+		// 一个在途调用; payload 指向映射区, 只有头部是副本
+		struct Slot {
+			std::array<char, sizeof(RpcHeader)> header;
+			std::span<const char> payload;
+			uint64_t intended_ns = 0;
+			uint32_t method = 0;
+			bool busy = false;
+		};
+
+		// 取出下一条属于本连接的请求记录
+		bool nextRequest(CaptureRecord& record, RpcHeader& header) {
+			while (reader_.next(record)) {
+				if (record_index_++ % options_.connections != id_) {
+					continue;
+				}
+				deserialize_header(record.frame, header);
+				if (header.message_type != static_cast<uint8_t>(MessageType::REQUEST)) {
+					++skipped_;		// 流式后续帧和心跳依赖原连接的状态, 不回放
+					continue;
+				}
+				return true;
+			}
+			return false;
+		}
+
+		void pump() {
+			while (true) {
+				if (!has_pending_) {
+					if (!nextRequest(pending_record_, pending_header_)) {
+						exhausted_ = true;
+						checkFinished();
+						break;
+					}
+					has_pending_ = true;
+				}
+
+				// 旧版本抓包文件里的时间戳不保证单调, 早于起点的记录按起点发送, 不能让差值回绕
+				uint64_t offset = pending_record_.timestamp_ns > first_timestamp_ns_
+					? pending_record_.timestamp_ns - first_timestamp_ns_ : 0;
+				uint64_t intended = options_.speed > 0
+					? base_ns_ + static_cast<uint64_t>(static_cast<double>(offset) / options_.speed)
+					: toNanos(Clock::now());
+				uint64_t now = toNanos(Clock::now());
+				if (intended > now) {
+					armTimer(intended);
+					break;
+				}
+				if (free_slots_.empty()) {
+					break;	// 等在途调用结束后由 onReply 继续
+				}
+
+				submit(intended);
+				has_pending_ = false;
+			}
+
+			if (!write_queue_.empty() && !writing_) {
+				flush_writes();
+			}
+		}
+
+		void submit(uint64_t intended) {
+			uint32_t slot_index = free_slots_.back();
+			free_slots_.pop_back();
+			Slot& slot = slots_[slot_index];
+
+			// 同一条连接上原始 request_id 可能重复 (抓包来自多个客户端), 改写为槽位号用于匹配回复
+			slot.payload = prepare_replay_frame(pending_record_.frame, slot_index, slot.header.data());
+			slot.intended_ns = intended;
+			slot.method = static_cast<uint32_t>(methods_.index.at(methodKey(pending_header_.service_id, pending_header_.method_id)));
+			slot.busy = true;
+
+			write_queue_.push_back(slot_index);
+			++sent_;
+		}
+
+		void armTimer(uint64_t intended) {
+			if (timer_armed_) {
+				return;
+			}
+			timer_armed_ = true;
+			timer_.expires_at(Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(intended))));
+			timer_.async_wait([self = shared_from_this()](boost::system::error_code ec) {
+				self -> timer_armed_ = false;
+				if (!ec) {
+					self -> pump();
+				}
+			});
+		}
+
+		void flush_writes() {
+			writing_ = true;
+			inflight_.swap(write_queue_);
+			write_queue_.clear();
+
+			write_buffers_.clear();
+			for (uint32_t slot_index : inflight_) {
+				const Slot& slot = slots_[slot_index];
+				write_buffers_.emplace_back(slot.header.data(), slot.header.size());
+				if (!slot.payload.empty()) {
+					write_buffers_.emplace_back(slot.payload.data(), slot.payload.size());
+				}
+			}
+
+			boost::asio::async_write(socket_, write_buffers_,
+				[self = shared_from_this()](boost::system::error_code ec, size_t /*length*/) {
+					self -> inflight_.clear();
+					self -> writing_ = false;
+					if (ec) {
+						std::cerr << "write error: " << ec.message() << std::endl;
+						self -> abort();
+						return;
+					}
+					if (!self -> write_queue_.empty()) {
+						self -> flush_writes();
+					}
+				});
+		}
+
+		void do_read() {
+			read_buffer_.ensureWritableBytes(4096);
+			auto writable = read_buffer_.writableBytesView();
+			socket_.async_read_some(boost::asio::buffer(writable.data(), writable.size()),
+				[self = shared_from_this()](boost::system::error_code ec, size_t length) {
+					if (ec) {
+						if (!self -> finished_) {
+							std::cerr << "read error: " << ec.message() << std::endl;
+							self -> abort();
+						}
+						return;
+					}
+					self -> read_buffer_.hasWritten(length);
+					while (self -> processReply()) {
+					}
+					if (!self -> finished_) {
+						self -> do_read();
+					}
+				});
+		}
+
+		bool processReply() {
+			RpcHeader header;
+			auto header_status = decode_header(read_buffer_.readableBytesView(), header);
+			if (header_status == HeaderStatus::INCOMPLETE) {
+				return false;
+			}
+			// 帧长不可信时后面的数据无法再对齐, 结束这条连接的回放
+			if (header_status != HeaderStatus::OK) {
+				std::cerr << "malformed reply, message_size=" << header.message_size << std::endl;
+				abort();
+				return false;
+			}
+			if (read_buffer_.readableBytes() < header.message_size) {
+				return false;
+			}
+			read_buffer_.retrieve(header.message_size);
+
+			bool last = header.message_type != static_cast<uint8_t>(MessageType::STREAM) ||
+						(header.flags & Flag::STREAM_END);
+			if (!last || header.request_id >= slots_.size() || !slots_[header.request_id].busy) {
+				return true;
+			}
+
+			Slot& slot = slots_[header.request_id];
+			uint64_t now = toNanos(Clock::now());
+			latency_[slot.method] -> record(now > slot.intended_ns ? now - slot.intended_ns : 0);
+			if (header.message_type == static_cast<uint8_t>(MessageType::ERROR)) {
+				++errors_[slot.method];
+			}
+			slot.busy = false;
+			free_slots_.push_back(header.request_id);
+
+			pump();
+			return true;
+		}
+
+		void checkFinished() {
+			if (exhausted_ && free_slots_.size() == slots_.size() && !finished_) {
+				finished_ = true;
+				boost::system::error_code ec;
+				socket_.shutdown(boost::asio::socket_base::shutdown_both, ec);
+				socket_.close(ec);
+				timer_.cancel();
+			}
+		}
+
+		void abort() {
+			exhausted_ = true;
+			finished_ = true;
+			boost::system::error_code ec;
+			socket_.close(ec);
+			timer_.cancel();
+		}
+
+		const ReplayOptions& options_;
+		const MethodTable& methods_;
+		CaptureReader reader_;
+		size_t id_;
+		uint64_t first_timestamp_ns_;
+		uint64_t base_ns_ = 0;
+
+		Socket socket_;
+		boost::asio::steady_timer timer_;
+		bool timer_armed_ = false;
+
+		std::vector<Slot> slots_;
+		std::vector<uint32_t> free_slots_;
+		std::vector<uint32_t> write_queue_;
+		std::vector<uint32_t> inflight_;
+		std::vector<boost::asio::const_buffer> write_buffers_;
+		bool writing_ = false;
+		Buffer read_buffer_;
+
+		CaptureRecord pending_record_{};
+		RpcHeader pending_header_{};
+		bool has_pending_ = false;
+		uint64_t record_index_ = 0;
+		bool exhausted_ = false;
+		bool finished_ = false;
+
+		uint64_t sent_ = 0;
+		uint64_t skipped_ = 0;
+		std::vector<std::unique_ptr<LatencyHistogram>> latency_;
+		std::vector<uint64_t> errors_;
+	};
+}
+
+int main(int argc, char* argv[]) {
+	ReplayOptions options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage();
+		return 1;
+	}
+
+	namespace bip = boost::interprocess;
+	bip::file_mapping mapping;
+	bip::mapped_region region;
+	try {
+		mapping = bip::file_mapping(options.file.c_str(), bip::read_only);
+		region = bip::mapped_region(mapping, bip::read_only);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "cannot map " << options.file << ": " << e.what() << std::endl;
+		return 1;
+	}
+	region.advise(bip::mapped_region::advice_sequential);
+	std::span<const char> data(static_cast<const char*>(region.get_address()), region.get_size());
+
+	// 预扫描: 建方法表, 确定时间基准, 回放过程中不再分配
+	CaptureReader scanner(data);
+	if (!scanner.valid()) {
+		std::cerr << options.file << " is not a capture file" << std::endl;
+		return 1;
+	}
+	MethodTable methods;
+	CaptureRecord record{};
+	uint64_t first_timestamp = 0;
+	uint64_t last_timestamp = 0;
+	uint64_t total_records = 0;
+	while (scanner.next(record)) {
+		RpcHeader header;
+		deserialize_header(record.frame, header);
+		if (total_records++ == 0) {
+			first_timestamp = record.timestamp_ns;
+			last_timestamp = record.timestamp_ns;
+		}
+		first_timestamp = std::min(first_timestamp, record.timestamp_ns);
+		last_timestamp = std::max(last_timestamp, record.timestamp_ns);
+		uint64_t key = methodKey(header.service_id, header.method_id);
+		if (methods.index.emplace(key, methods.keys.size()).second) {
+			methods.keys.push_back(key);
+		}
+	}
+	if (total_records == 0) {
+		std::cerr << "capture contains no records" << std::endl;
+		return 1;
+	}
+
+	boost::asio::io_context ioc(1);
+	std::vector<std::shared_ptr<ReplayConnection>> connections;
+	for (size_t i = 0; i < options.connections; ++i) {
+		auto conn = std::make_shared<ReplayConnection>(ioc, options, methods, data, i, first_timestamp);
+		if (!conn -> connect()) {
+			return 1;
+		}
+		connections.push_back(std::move(conn));
+	}
+
+	std::printf("replaying %llu records (%.3f s recorded) ",
+		static_cast<unsigned long long>(total_records), static_cast<double>(last_timestamp - first_timestamp) / 1e9);
+	if (options.speed > 0) {
+		std::printf("at %gx recorded rate\n", options.speed);
+	}
+	else {
+		std::printf("at full speed\n");
+	}
+
+	auto start = Clock::now();
+	for (auto& conn : connections) {
+		conn -> start(toNanos(start));
+	}
+	ioc.run();
+	double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+	uint64_t sent = 0;
+	uint64_t skipped = 0;
+	for (auto& conn : connections) {
+		sent += conn -> sent();
+		skipped += conn -> skipped();
+	}
+	std::printf("sent %llu requests in %.3f s (%.0f req/s), skipped %llu non-request frames\n\n",
+		static_cast<unsigned long long>(sent), elapsed, static_cast<double>(sent) / elapsed,
+		static_cast<unsigned long long>(skipped));
+
+	std::printf("%-12s %-12s %10s %8s %10s %10s %10s %10s %10s\n",
+		"service", "method", "count", "errors", "p50(us)", "p90(us)", "p99(us)", "p99.9(us)", "max(us)");
+	for (size_t m = 0; m < methods.keys.size(); ++m) {
+		HistogramSnapshot hist;
+		uint64_t errors = 0;
+		for (auto& conn : connections) {
+			conn -> latency(m).mergeInto(hist);
+			errors += conn -> errors(m);
+		}
+		if (hist.count == 0) {
+			continue;
+		}
+		std::printf("%-12u %-12u %10llu %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			static_cast<uint32_t>(methods.keys[m] >> 32), static_cast<uint32_t>(methods.keys[m]),
+			static_cast<unsigned long long>(hist.count), static_cast<unsigned long long>(errors),
+			static_cast<double>(hist.percentile(0.5)) / 1e3, static_cast<double>(hist.percentile(0.9)) / 1e3,
+			static_cast<double>(hist.percentile(0.99)) / 1e3, static_cast<double>(hist.percentile(0.999)) / 1e3,
+			static_cast<double>(hist.max) / 1e3);
+	}
+	return 0;
+}
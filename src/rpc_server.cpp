@@ -3,16 +3,51 @@
 #include <iostream>
 #include <boost/asio.hpp>
 #include "Session.h"
-#include "spdlog/spdlog.h"
+#include "http_session.h"
+#include "stats_service.h"
+#include "rpc_log.h"
+#include "rpc_capture.h"
+#include "io_context_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 
 #include "calu.pb.h"
 
 class CalculatorServiceImpl : public cyfon_rpc::IService {
 public:
-	std::string callMethod(uint32_t method_id, const std::string& request_body) override {
-		static const uint32_t METHOD_ADD = std::hash<std::string>{}("Add");
-		static const uint32_t METHOD_SUBTRACT = std::hash<std::string>{}("Subtract");
+	static inline const uint32_t METHOD_ADD = std::hash<std::string>{}("Add");
+	static inline const uint32_t METHOD_SUBTRACT = std::hash<std::string>{}("Subtract");
+	static inline const uint32_t METHOD_COUNT = std::hash<std::string>{}("Count");
+
+	// Count 一次最多推送的消息数
+	static constexpr int kMaxCount = 4096;
+
+	bool hasMethod(uint32_t method_id) override {
+		return method_id == METHOD_ADD || method_id == METHOD_SUBTRACT || method_id == METHOD_COUNT;
+	}
+
+	cyfon_rpc::MethodType getMethodType(uint32_t method_id) override {
+		return method_id == METHOD_COUNT ? cyfon_rpc::MethodType::SERVER_STREAMING : cyfon_rpc::MethodType::UNARY;
+	}
+
+	// 服务端流式: 请求复用 AddRequest, 从 a 开始连续推送 b 个 AddResponse, 供压测工具的 stream 模式使用
+	void callServerStreaming(uint32_t method_id, const std::string& request_body, cyfon_rpc::StreamContext& stream_ctx) override {
+		if (method_id == METHOD_COUNT) {
+			rpc_demo::AddRequest req;
+			req.ParseFromString(request_body);
+
+			rpc_demo::AddResponse res;
+			int count = std::clamp(req.b(), 0, kMaxCount);
+			for (int i = 0; i < count; ++i) {
+				res.set_result(req.a() + i);
+				stream_ctx.send(res.SerializeAsString());
+			}
+		}
+		stream_ctx.finish();
+	}
 
+	std::string callMethod(uint32_t method_id, const std::string& request_body) override {
 		if (method_id == METHOD_ADD) {
 			rpc_demo::AddRequest req;
 			req.ParseFromString(request_body);
@@ -35,60 +70,186 @@ public:
 	}
 };
 
-class TcpServer {
+// 静态文件服务: Read 的请求体是相对于根目录的路径, 响应体是文件内容, 经 sendfile 零拷贝发送
+class FileServiceImpl : public cyfon_rpc::IService {
+public:
+	static inline const uint32_t METHOD_READ = std::hash<std::string>{}("Read");
+
+	// 根目录先解析成规范路径, 之后的包含检查都和它比较
+	explicit FileServiceImpl(const std::filesystem::path& root) : root_(std::filesystem::weakly_canonical(std::filesystem::absolute(root))) {
+		if (root_.filename().empty()) {
+			root_ = root_.parent_path();
+		}
+	}
+
+	bool hasMethod(uint32_t method_id) override {
+		return method_id == METHOD_READ;
+	}
+
+	cyfon_rpc::MethodType getMethodType(uint32_t method_id) override {
+		return method_id == METHOD_READ ? cyfon_rpc::MethodType::BLOB_RESPONSE : cyfon_rpc::MethodType::UNARY;
+	}
+
+	// HTTP 网关和批量调用走这里, 把文件整块读出
+	std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+		cyfon_rpc::BlobResponse blob = callBlobMethod(method_id, request_body);
+		std::string content(static_cast<size_t>(blob.size()), '\0');
+		if (!blob.readAt(0, content.data(), content.size())) {
+			throw cyfon_rpc::RpcStatusException(cyfon_rpc::RpcStatus::INTERNAL, "failed to read file");
+		}
+		return content;
+	}
+
+	cyfon_rpc::BlobResponse callBlobMethod(uint32_t method_id, const std::string& request_body) override {
+		if (method_id != METHOD_READ) {
+			throw cyfon_rpc::RpcStatusException(cyfon_rpc::RpcStatus::METHOD_NOT_FOUND, "method not found");
+		}
+		// 只允许访问根目录下的文件; 先解析符号链接和 "..", 指向根目录之外的链接同样拒绝
+		std::error_code ec;
+		auto path = std::filesystem::weakly_canonical(root_ / request_body, ec);
+		if (ec) {
+			throw cyfon_rpc::RpcStatusException(cyfon_rpc::RpcStatus::INVALID_ARGUMENT, "file not found");
+		}
+		auto [root_end, path_end] = std::mismatch(root_.begin(), root_.end(), path.begin(), path.end());
+		if (root_end != root_.end()) {
+			throw cyfon_rpc::RpcStatusException(cyfon_rpc::RpcStatus::INVALID_ARGUMENT, "path outside root");
+		}
+		auto blob = cyfon_rpc::BlobResponse::fromFile(path.string());
+		if (!blob) {
+			throw cyfon_rpc::RpcStatusException(cyfon_rpc::RpcStatus::INVALID_ARGUMENT, "file not found");
+		}
+		return std::move(*blob);
+	}
+
+private:
+	std::filesystem::path root_;
+};
+
+// 监听器对协议泛化: 同一套 accept 逻辑同时服务 TCP 和 AF_UNIX 端点
+// 监听 socket 在第一个 I/O 线程上, 新连接轮转分配到各 I/O 线程, 会话和它的定时器从此固定在那个线程
+template<typename Protocol>
+class RpcListener {
 public:
-	TcpServer(boost::asio::io_context& ioc_, short port, cyfon_rpc::RpcServer& rpc_server)
-		: acceptor_(ioc_, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port))
+	RpcListener(cyfon_rpc::IoContextPool& pool, const typename Protocol::endpoint& endpoint, cyfon_rpc::RpcServer& rpc_server)
+		: pool_(pool)
+		, acceptor_(pool.worker(0).context, endpoint)
 		, rpc_server_(rpc_server) {
 		do_accept();
 	}
 
 private:
 	void do_accept() {
-		acceptor_.async_accept(
-			[this](boost::system::error_code ec, boost::asio::ip::tcp::socket socket) {
+		auto& worker = pool_.next();
+		acceptor_.async_accept(worker.context,
+			[this, &worker](boost::system::error_code ec, typename Protocol::socket socket) {
 				if (!ec) {
-					std::make_shared<Session>(std::move(socket), rpc_server_) -> start();
+					std::make_shared<Session>(Session::socket_type(std::move(socket)), rpc_server_, worker.wheel) -> start();
 				}
 				do_accept();
 			});
 	};
 
-	boost::asio::ip::tcp::acceptor acceptor_;
+	cyfon_rpc::IoContextPool& pool_;
+	typename Protocol::acceptor acceptor_;
 	cyfon_rpc::RpcServer& rpc_server_;
 };
 
+using TcpServer = RpcListener<boost::asio::ip::tcp>;
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+using LocalServer = RpcListener<boost::asio::local::stream_protocol>;
+
+// 绑定前删除残留的 socket 文件, 否则上次异常退出后 bind 会失败
+static boost::asio::local::stream_protocol::endpoint makeLocalEndpoint(const std::string& path) {
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+	return boost::asio::local::stream_protocol::endpoint(path);
+}
+#endif
+
 int main() {
+	// 异步日志: I/O 线程和工作线程只负责格式化入队, 队列满时丢弃最旧的日志
+	cyfon_rpc::log::init();
+
 	try {
-		boost::asio::io_context ioc;
+		// 每个 I/O 线程一个 io_context 和一个时间轮
+		const size_t io_thread_count = std::max(1u, std::thread::hardware_concurrency());
+		cyfon_rpc::IoContextPool io_pool(io_thread_count);
 
 		cyfon_rpc::RpcServer rpc_server(std::thread::hardware_concurrency());
 
-		uint32_t service_id = std::hash<std::string>{}("CalculatorService");
-		rpc_server.registerService(service_id, std::make_unique<CalculatorServiceImpl>());
-
-		short port = 8888;
-		spdlog::info("Server starting on port {} .....", port);
-		TcpServer server(ioc, port, rpc_server);
-
-		const size_t io_thread_count = std::thread::hardware_concurrency();
-		std::vector<std::thread> io_threads;
-		io_threads.reserve(io_thread_count);
+		// 设置 CYFON_RPC_TRACE=1 时开启飞行记录器模式: 全量记录 span, 导出时保留 1% 的链路和所有超过 10ms 的慢链路
+		// 默认关闭, 每个请求只多一次 relaxed load
+		if (const char* trace_env = std::getenv("CYFON_RPC_TRACE"); trace_env && std::string_view(trace_env) != "0") {
+			cyfon_rpc::TraceOptions trace_options;
+			trace_options.enabled = true;
+			trace_options.sample_every = 100;
+			trace_options.slow_threshold_ns = 10'000'000;
+			cyfon_rpc::Tracer::instance().configure(trace_options);
+			CYFON_LOG_INFO("Request tracing enabled");
+		}
 
-		spdlog::info("Starting {} I/O threads.", io_thread_count);
-		for (size_t i = 0; i < io_thread_count; ++i) {
-			io_threads.emplace_back([&ioc]() { ioc.run(); });
+		// 设置 CYFON_RPC_CAPTURE=<文件> 时抓取收到的所有帧, 供 cyfon_replay 回放
+		if (const char* capture_path = std::getenv("CYFON_RPC_CAPTURE")) {
+			cyfon_rpc::TrafficCapture::instance().open(capture_path);
 		}
 
-		for (auto& t : io_threads) {
-			if (t.joinable()) {
-				t.join();
-			}
+		uint32_t service_id = std::hash<std::string>{}("CalculatorService");
+		rpc_server.registerService(service_id, std::make_unique<CalculatorServiceImpl>());
+		// 计算服务是纯函数, 相同的并发请求合并成一次调用, 结果缓存一段时间
+		for (const char* method : { "Add", "Subtract" }) {
+			uint32_t method_id = std::hash<std::string>{}(method);
+			rpc_server.enableSingleflight(service_id, method_id);
+			rpc_server.enableResponseCache(service_id, method_id, std::chrono::seconds(5));
 		}
+		// 计算请求只有几个整数, 超过 64KB 的帧一定是错的, 不必按默认上限缓存
+		rpc_server.setMessageLimits(service_id, { .max_message_size = 64 * 1024 });
+		rpc_server.registerService(cyfon_rpc::StatsService::kServiceId, std::make_unique<cyfon_rpc::StatsService>());
+		// 设置 CYFON_RPC_FILE_ROOT=<目录> 时提供该目录下的文件下载
+		if (const char* file_root = std::getenv("CYFON_RPC_FILE_ROOT")) {
+			rpc_server.registerService(std::hash<std::string>{}("FileService"), std::make_unique<FileServiceImpl>(file_root));
+		}
+
+		short port = 8888;
+		CYFON_LOG_INFO("Server starting on port {} .....", port);
+		TcpServer server(io_pool, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port), rpc_server);
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+		// 本机客户端可以走 AF_UNIX, 绕开 TCP 协议栈
+		const std::string local_path = "/tmp/cyfon_rpc.sock";
+		CYFON_LOG_INFO("Server also listening on unix socket {} .....", local_path);
+		LocalServer local_server(io_pool, makeLocalEndpoint(local_path), rpc_server);
+#endif
+
+		// HTTP/1.1 JSON 网关, 与 RPC 端口共享同一个 RpcServer
+		cyfon_rpc::HttpRouter router;
+		router.beginUpdate();
+		router.registerRoute("/v1/calculator/add", service_id, std::hash<std::string>{}("Add"),
+			rpc_demo::AddRequest::descriptor(), rpc_demo::AddResponse::descriptor());
+		router.registerRoute("/v1/calculator/subtract", service_id, std::hash<std::string>{}("Subtract"),
+			rpc_demo::SubtractRequest::descriptor(), rpc_demo::SubtractResponse::descriptor());
+		router.registerRoute("/metrics", cyfon_rpc::StatsService::kServiceId, cyfon_rpc::StatsService::kMethodPrometheus);
+		router.registerRoute("/debug/trace", cyfon_rpc::StatsService::kServiceId, cyfon_rpc::StatsService::kMethodChromeTrace);
+		router.commit();
+
+		short http_port = 8080;
+		CYFON_LOG_INFO("HTTP gateway listening on port {} .....", http_port);
+		cyfon_rpc::HttpGateway gateway(io_pool, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), http_port), rpc_server, router);
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+		CYFON_LOG_INFO("I/O backend: io_uring");
+#else
+		CYFON_LOG_INFO("I/O backend: reactor (epoll / kqueue / iocp)");
+#endif
+
+		CYFON_LOG_INFO("Starting {} I/O threads.", io_thread_count);
+		io_pool.run();
 	} catch (std::exception& e) {
-		spdlog::error("Exception: {}", e.what());
+		CYFON_LOG_ERROR("Exception: {}", e.what());
 	}
 
+	cyfon_rpc::TrafficCapture::instance().close();
 	google::protobuf::ShutdownProtobufLibrary();
+	cyfon_rpc::log::shutdown();
 	return 0;
 }
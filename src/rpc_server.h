@@ -3,33 +3,46 @@
 #include "Session.h"
 #include "rpc_protocol_utils.h"
 #include <string>
+#include <string_view>
 #include <memory>
 #include <unordered_map>
 #include <functional>
 #include "rpc_header.h"
 #include "threadpool.h"
-#include "spdlog/spdlog.h"
+#include "rpc_metrics.h"
+#include "rpc_trace.h"
+#include "rpc_log.h"
+#include "singleflight.h"
+#include "typed_service.h"
+#include "response_cache.h"
+#include "blob_response.h"
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <unordered_set>
 
 namespace cyfon_rpc {
 	enum class MethodType {
         UNARY,                 // 普通 RPC（一问一答）
         SERVER_STREAMING,      // 服务端流式（一个请求，多个响应）
         CLIENT_STREAMING,      // 客户端流式（多个请求，一个响应）
-        BIDIRECTIONAL          // 双向流式（多个请求，多个响应）
+        BIDIRECTIONAL,         // 双向流式（多个请求，多个响应）
+        BLOB_RESPONSE          // 一问一答, 响应体是文件或内存区间 (callBlobMethod), 零拷贝发送
 	};
 
 	// 流式调用的上下文
 	class StreamContext {
 	public:
-		using SendCallback = std::function<void(std::span<const char>)>;
+		using SendCallback = std::function<void(const std::string&)>;
 		using FinishCallback = std::function<void()>;
 		
 
 		StreamContext(SendCallback send, FinishCallback finish)
 			: send_(send), finish_(finish) {}
 
-		void send(const string& message) {
+		void send(const std::string& message) {
 			if (send_)  send_(message); 
 		}
 
@@ -42,6 +55,32 @@ namespace cyfon_rpc {
 		FinishCallback finish_;
 	};
 
+	// 业务方法抛出它来返回指定的错误状态; 其它异常一律按 INTERNAL 处理
+	class RpcStatusException : public std::runtime_error {
+	public:
+		RpcStatusException(RpcStatus status, const std::string& message)
+			: std::runtime_error(message), status_(status) {}
+
+		[[nodiscard]] RpcStatus status() const noexcept { return status_; }
+
+	private:
+		RpcStatus status_;
+	};
+
+	// 大请求体的分块接收器
+	// 请求体超过服务的分块阈值时, 会话不再缓存整帧, 而是把每次从 socket 读到的数据作为一块交给它;
+	// 所有回调都在该请求自己的 SerialQueue 上按到达顺序执行, 队列优先在会话的工作线程上执行. 连接中途断开或 CRC32C 校验失败时不会调用 finish, 对象直接析构
+	class ChunkedRequest {
+	public:
+		virtual ~ChunkedRequest() = default;
+
+		// 收到一块请求体, 块的大小由网络读决定, 与发送方的写入方式无关
+		virtual void onChunk(std::string_view chunk) = 0;
+
+		// 请求体已全部到达, 返回响应体; 抛 RpcStatusException 返回指定的错误状态
+		virtual std::string finish() = 0;
+	};
+
 	class IService {
 	public:		
 		virtual ~IService() = default;
@@ -52,6 +91,12 @@ namespace cyfon_rpc {
 			// 我们这里默认是普通RPC
 		}
 
+		// 方法是否存在; 只有存在的方法才按 (service, method) 单独统计, 其余记入 unknown 槽
+		// 默认认为所有方法都存在, 方法集合已知的服务应覆盖它, 否则随机的方法ID会各自占用一个统计槽
+		virtual bool hasMethod(uint32_t /*method_id*/) {
+			return true;
+		}
+
 		// 兼容普通RPC
 		virtual std::string callMethod(uint32_t method_id, const std::string& request_body) = 0;
 
@@ -73,17 +118,116 @@ namespace cyfon_rpc {
 			uint32_t method_id,
 			StreamContext& stream
 		) { stream.finish(); }
+
+		// 大块只读数据的响应: getMethodType 返回 BLOB_RESPONSE 的方法由会话调用它, 返回的区间不经拷贝直接发送
+		// 抛 RpcStatusException 返回指定的错误状态; HTTP 网关和批量调用仍然走 callMethod
+		virtual BlobResponse callBlobMethod(uint32_t /*method_id*/, const std::string& /*request_body*/) {
+			throw RpcStatusException(RpcStatus::METHOD_NOT_FOUND, "method not found");
+		}
+
+		// 分块接收普通请求: 请求体超过 RpcServer::MessageLimits::chunk_threshold 时调用, body_size 是请求体总长度
+		// 返回 nullptr 表示该方法不支持, 请求照常整帧缓存后交给 callMethod
+		// 在 I/O 线程上调用, 只应创建接收器, 不要在这里做耗时的工作
+		virtual std::unique_ptr<ChunkedRequest> openChunkedRequest(uint32_t /*method_id*/, size_t /*body_size*/) {
+			return nullptr;
+		}
+	};
+
+	// 一次分块请求在工作线程上的状态; 某一块处理失败后丢弃后续数据块, 收尾时回报错误
+	// 数据块和收尾都提交到这次请求自己的串行队列, 按顺序在会话的工作线程上执行
+	struct ChunkedCall {
+		uint32_t service_id = 0;
+		uint32_t method_id = 0;
+		std::shared_ptr<SerialQueue> queue;
+		std::unique_ptr<ChunkedRequest> request;
+		RpcStatus status = RpcStatus::OK;
+		std::string error;
+		MetricsRegistry::Clock::time_point started_at;
+	};
+
+	// 把类型化服务 (见 typed_service.h) 接到 RpcServer 上
+	// 方法表在编译期按方法ID排好序, 每个条目是一个直接调用 Impl::handle 的静态类型 thunk;
+	// 请求到来时二分查找方法ID, 再经函数指针调用, 不再经过 switch 或 Impl 的虚函数
+	template <TypedServiceDef Service, ServiceImplFor<Service> Impl>
+	class TypedServiceAdapter final : public IService {
+	public:
+		explicit TypedServiceAdapter(std::unique_ptr<Impl> impl) : impl_(std::move(impl)) {}
+
+		bool hasMethod(uint32_t method_id) override {
+			return find(method_id) != nullptr;
+		}
+
+		std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+			const Entry* entry = find(method_id);
+			if (!entry) {
+				// 服务端的方法在编译期已经检查过, 这里只可能是客户端发来了未定义的方法
+				throw RpcStatusException(RpcStatus::METHOD_NOT_FOUND, "method not found");
+			}
+			return entry -> thunk(*impl_, request_body);
+		}
+
+	private:
+		using Thunk = std::string (*)(Impl&, const std::string&);
+
+		struct Entry {
+			uint32_t id;
+			Thunk thunk;
+		};
+
+		template <typename M>
+		static std::string invokeMethod(Impl& impl, const std::string& request_body) {
+			typename M::Request request;
+			if (!decode_message(request_body, request)) {
+				throw RpcStatusException(RpcStatus::INVALID_ARGUMENT, "failed to parse request");
+			}
+			typename M::Response response = impl.handle(M{}, request);
+			std::string response_body;
+			if (!encode_message(response, response_body)) {
+				throw RpcStatusException(RpcStatus::INTERNAL, "failed to serialize response");
+			}
+			return response_body;
+		}
+
+		template <typename... Methods>
+		static constexpr auto makeTable(MethodList<Methods...>) {
+			std::array<Entry, sizeof...(Methods)> table{ Entry{ Methods::kId, &invokeMethod<Methods> }... };
+			std::sort(table.begin(), table.end(), [](const Entry& a, const Entry& b) { return a.id < b.id; });
+			return table;
+		}
+
+		static constexpr auto kTable = makeTable(typename Service::Methods{});
+
+		static const Entry* find(uint32_t method_id) {
+			auto it = std::lower_bound(kTable.begin(), kTable.end(), method_id,
+				[](const Entry& entry, uint32_t id) { return entry.id < id; });
+			return it != kTable.end() && it -> id == method_id ? &*it : nullptr;
+		}
+
+		std::unique_ptr<Impl> impl_;
 	};
 
 	class RpcServer {
 	public:
+		// 调用完成回调: 在工作线程上执行, 携带状态和响应体
+		using DispatchCallback = std::function<void(RpcStatus status, std::string payload)>;
+		// 零拷贝响应的调用完成回调: 成功时 blob 是响应体, 失败时 error 是错误描述
+		using BlobCallback = std::function<void(RpcStatus status, std::string error, BlobResponse blob)>;
+		// 批量调用完成回调
+		using BatchCallback = std::function<void(std::vector<BatchResult> results)>;
+
 		RpcServer(size_t thread_count = std::thread::hardware_concurrency()) : thread_pool_(thread_count){}
 
 		// 注册函数将服务id和服务实例进行绑定
 		void registerService(uint32_t service_id, std::unique_ptr<IService> service) {
 			if (services_.count(service_id)) { return; }
 			services_[service_id] = std::move(service);
-			spdlog::info("the id is success get in");
+			CYFON_LOG_INFO("Registered service {}", service_id);
+		}
+
+		// 注册类型化服务, 服务ID由服务名在编译期算出; 实现缺少方法时编译失败
+		template <TypedServiceDef Service, ServiceImplFor<Service> Impl>
+		void registerService(std::unique_ptr<Impl> impl) {
+			registerService(service_id_v<Service>, std::make_unique<TypedServiceAdapter<Service, Impl>>(std::move(impl)));
 		}
 
 		// 获取服务
@@ -92,53 +236,482 @@ namespace cyfon_rpc {
 			return it != services_.end() ? it -> second.get() : nullptr;
 		}
 
+		// 请求的统计槽: 已注册服务里存在的方法单独统计, 线路上其它任意的 ID 共用一个 unknown 槽,
+		// 否则客户端发送随机 ID 就能让每个线程无限分配直方图
+		MethodStats& methodStats(uint32_t service_id, uint32_t method_id) {
+			auto it = services_.find(service_id);
+			if (it != services_.end() && it -> second -> hasMethod(method_id)) {
+				return MetricsRegistry::instance().local(service_id, method_id);
+			}
+			return MetricsRegistry::instance().localUnknown();
+		}
+
+		// 为一个会话分配优先的工作线程; 会话的流和分块请求都优先在这个线程上执行, 轮流分配让会话均匀分布
+		size_t assignWorker() {
+			return next_worker_.fetch_add(1, std::memory_order_relaxed) % thread_pool_.size();
+		}
+
+		// 流的串行执行器: 优先在 worker 上执行, 同一条流的回调按提交顺序执行, 数据尽量留在同一个核的缓存里
+		// worker 被一个长处理函数占住时, 其它流最多等 ThreadPool::kStealAfter 就换到别的线程执行
+		std::shared_ptr<SerialQueue> openStreamExecutor(size_t worker) {
+			return std::make_shared<SerialQueue>(thread_pool_, worker);
+		}
+
+		// 服务端流式: 处理函数在流的执行器上运行
+		// 处理函数通过 StreamContext 发出的消息由会话切回自己的线程发送, 不需要加锁
 		void enqueueStreamTask(const RpcHeader& header,
 							   const std::string& body,
-							   StreamContext& stream_ctx) 
+							   StreamContext stream_ctx,
+							   std::shared_ptr<SerialQueue> executor)
 		{
 			auto it = services_.find(header.service_id);
 			if (it == services_.end()) {
-				spdlog::error("Service not found for stream: {}", header.service_id);
+				CYFON_LOG_ERROR("Service not found for stream: {}", header.service_id);
 				stream_ctx.finish();
 				return;
 			}
 		
 			auto service = it -> second.get();
 
-			thread_pool.enqueue([service, header, body, &stream_ctx]() {
-				service -> callServerStreaming(header.method_id, body, stream_ctx);
+			executor -> post([service, header, body, stream_ctx]() mutable {
+				try {
+					service -> callServerStreaming(header.method_id, body, stream_ctx);
+				}
+				catch (const std::exception& e) {
+					// 客户端还在等流结束, 处理函数异常时照样发出 STREAM_END
+					CYFON_LOG_ERROR("Server streaming method {} threw: {}", header.method_id, e.what());
+					stream_ctx.finish();
+				}
 			});
 		}
 
-		// 分发请求
-		void enqueueTask(const RpcHeader& header, std::string bd, std::function<void(std::span<const char>)> response_callback) {
-			thread_pool_.enqueue([this, header, body = std::move(bd), cb = std::move(response_callback)]() {
-				
-				auto it = services_.find(header.service_id);
-				std::string response_payload;
-				if (it != services_.end()) {
-					response_payload = it -> second -> callMethod(header.method_id, body);
+		// 客户端流式: 收齐消息后在流的执行器上调用处理函数, callback 也在该线程上执行
+		void enqueueClientStreamTask(uint32_t service_id, uint32_t method_id, std::vector<std::string> messages,
+									 std::shared_ptr<SerialQueue> executor, DispatchCallback callback) {
+			auto it = services_.find(service_id);
+			if (it == services_.end()) {
+				CYFON_LOG_ERROR("Service not found for stream: {}", service_id);
+				callback(RpcStatus::SERVICE_NOT_FOUND, "service not found");
+				return;
+			}
+
+			auto service = it -> second.get();
+
+			executor -> post([service, method_id, messages = std::move(messages), cb = std::move(callback)]() {
+				std::string response;
+				try {
+					response = service -> callClientStreaming(method_id, messages);
 				}
-				else {
-					spdlog::error("error not found id");
+				catch (const std::exception& e) {
+					CYFON_LOG_ERROR("Client streaming method {} threw: {}", method_id, e.what());
+					cb(RpcStatus::INTERNAL, e.what());
+					return;
 				}
+				cb(RpcStatus::OK, std::move(response));
+			});
+		}
+
+		// 对指定方法开启在途请求合并: 同一时刻 body 完全相同的调用只执行一次, 结果发给每个请求方
+		// 只适用于没有副作用、结果只取决于请求体的方法; 需在开始服务之前配置
+		void enableSingleflight(uint32_t service_id, uint32_t method_id) {
+			singleflight_methods_.insert(routeKey(service_id, method_id));
+			CYFON_LOG_INFO("Singleflight enabled for service {} method {}", service_id, method_id);
+		}
+
+		// 对指定方法开启响应缓存: 成功的响应按请求体缓存 ttl, 命中时在调用线程 (I/O 线程) 上直接应答, 不进线程池
+		// 只适用于结果只取决于请求体的幂等方法; 需在开始服务之前配置
+		void enableResponseCache(uint32_t service_id, uint32_t method_id, std::chrono::milliseconds ttl) {
+			cache_ttls_[routeKey(service_id, method_id)] = ttl;
+			CYFON_LOG_INFO("Response cache enabled for service {} method {}, ttl {}ms", service_id, method_id, ttl.count());
+		}
+
+		// 响应缓存的总内存上限 (字节), 所有方法共用
+		void setResponseCacheCapacity(size_t bytes) { response_cache_.setCapacity(bytes); }
+
+		// 服务级别的消息大小限制, 会话解出头部后立即按它检查, 不等整帧到达
+		struct MessageLimits {
+			uint32_t max_message_size = 0;	// 单帧上限 (含头部), 0 表示使用会话的默认上限
+			uint32_t chunk_threshold = 0;	// 请求体超过它时交给 openChunkedRequest 分块接收, 0 表示不分块
+		};
+
+		// 超过上限的帧回复 RESOURCE_EXHAUSTED, 其余数据到达后直接丢弃, 不为它分配内存; 需在开始服务之前配置
+		void setMessageLimits(uint32_t service_id, MessageLimits limits) {
+			message_limits_[service_id] = limits;
+			CYFON_LOG_INFO("Message limits for service {}: max {} bytes, chunk threshold {} bytes",
+				service_id, limits.max_message_size, limits.chunk_threshold);
+		}
 
-				Buffer response_buffer;
-				response_buffer.append(response_payload);
+		[[nodiscard]] MessageLimits messageLimits(uint32_t service_id) const {
+			if (message_limits_.empty()) {
+				return {};
+			}
+			auto it = message_limits_.find(service_id);
+			return it != message_limits_.end() ? it -> second : MessageLimits{};
+		}
 
-				RpcHeader response_header;
-				response_header.message_size = header.message_size;
-				response_header.method_id = header.method_id;
-				response_header.service_id = header.service_id;
+		// 为请求打开分块接收, 数据块优先在 worker 上处理; 服务或方法不支持时返回 nullptr
+		std::shared_ptr<ChunkedCall> openChunkedCall(const RpcHeader& header, size_t body_size, size_t worker) {
+			IService* service = getService(header.service_id);
+			if (!service) {
+				return nullptr;
+			}
+			auto request = service -> openChunkedRequest(header.method_id, body_size);
+			if (!request) {
+				return nullptr;
+			}
+			auto call = std::make_shared<ChunkedCall>();
+			call -> service_id = header.service_id;
+			call -> method_id = header.method_id;
+			call -> queue = std::make_shared<SerialQueue>(thread_pool_, worker);
+			call -> request = std::move(request);
+			call -> started_at = MetricsRegistry::Clock::now();
+			return call;
+		}
 
-				prepend_header(response_buffer, response_header);
+		// 分块请求的数据块在请求的串行队列上按提交顺序处理, 处理完 (无论成败) 调用 consumed
+		void enqueueChunk(std::shared_ptr<ChunkedCall> call, std::string chunk, std::function<void()> consumed) {
+			auto& queue = *call -> queue;
+			queue.post([call = std::move(call), chunk = std::move(chunk), consumed = std::move(consumed)]() {
+				if (call -> status == RpcStatus::OK) {
+					try {
+						call -> request -> onChunk(chunk);
+					}
+					catch (const RpcStatusException& e) {
+						CYFON_LOG_WARN("Service {} method {} rejected chunk: {}", call -> service_id, call -> method_id, e.what());
+						call -> status = e.status();
+						call -> error = e.what();
+					}
+					catch (const std::exception& e) {
+						CYFON_LOG_ERROR("Service {} method {} threw on chunk: {}", call -> service_id, call -> method_id, e.what());
+						call -> status = RpcStatus::INTERNAL;
+						call -> error = e.what();
+					}
+				}
+				consumed();
+			});
+		}
 
-				cb(response_buffer.readableBytesView());
+		// 请求体收齐后在同一个串行队列上收尾, 排在所有数据块之后; callback 也在执行收尾的工作线程上调用
+		void enqueueChunkedFinish(std::shared_ptr<ChunkedCall> call, DispatchCallback callback) {
+			auto& queue = *call -> queue;
+			queue.post([this, call = std::move(call), cb = std::move(callback)]() {
+				auto& stats = methodStats(call -> service_id, call -> method_id);
+				if (call -> status != RpcStatus::OK) {
+					stats.errors.add();
+					cb(call -> status, std::move(call -> error));
+					return;
+				}
+
+				std::string response;
+				try {
+					response = call -> request -> finish();
+				}
+				catch (const RpcStatusException& e) {
+					CYFON_LOG_WARN("Service {} method {} failed: {}", call -> service_id, call -> method_id, e.what());
+					stats.errors.add();
+					cb(e.status(), e.what());
+					return;
+				}
+				catch (const std::exception& e) {
+					CYFON_LOG_ERROR("Service {} method {} threw: {}", call -> service_id, call -> method_id, e.what());
+					stats.errors.add();
+					cb(RpcStatus::INTERNAL, e.what());
+					return;
+				}
+				stats.handler_time.record(MetricsRegistry::elapsedNanos(call -> started_at, MetricsRegistry::Clock::now()));
+				stats.bytes_out.add(response.size());
+				cb(RpcStatus::OK, std::move(response));
+			});
+		}
+
+		// BLOB_RESPONSE 方法: 在任意工作线程上调用 callBlobMethod, callback 也在该线程上执行
+		// 不参与响应缓存和请求合并, 区间本身就是共享的只读数据; 排队到 deadline 还没开始的请求不再调用业务方法
+		void dispatchBlob(uint32_t service_id, uint32_t method_id, std::string body, BlobCallback callback,
+						  const TraceContext& trace = {},
+						  MetricsRegistry::Clock::time_point deadline = MetricsRegistry::Clock::time_point::max()) {
+			auto enqueued_at = MetricsRegistry::Clock::now();
+
+			thread_pool_.post([this, service_id, method_id, enqueued_at, deadline, trace, body = std::move(body), cb = std::move(callback)]() {
+				auto started_at = MetricsRegistry::Clock::now();
+				auto& stats = methodStats(service_id, method_id);
+				stats.queue_wait.record(MetricsRegistry::elapsedNanos(enqueued_at, started_at));
+				Tracer::instance().record("threadpool_queue", trace, Tracer::toNanos(enqueued_at), Tracer::toNanos(started_at));
+				ScopedTraceContext trace_scope(trace);
+
+				if (started_at >= deadline) {
+					stats.errors.add();
+					cb(RpcStatus::DEADLINE_EXCEEDED, "deadline exceeded before dispatch", {});
+					return;
+				}
+
+				BlobResponse blob;
+				std::string error;
+				RpcStatus status = invokeService(service_id, method_id, error, started_at, [&](IService& service) {
+					blob = service.callBlobMethod(method_id, body);
+					return blob.size();
+				});
+				cb(status, std::move(error), std::move(blob));
+			});
+		}
+
+		// 直接按 (service_id, method_id) 调用普通 RPC, 不依赖 RpcHeader 封帧;
+		// TCP 会话和 HTTP 网关共用这一入口
+		// trace 非空时记录排队和处理 span, 处理期间它也是工作线程的当前链路
+		// deadline 之前还没轮到执行的请求直接以 DEADLINE_EXCEEDED 结束, 不再调用业务方法
+		void dispatch(uint32_t service_id, uint32_t method_id, std::string body, DispatchCallback callback,
+					  const TraceContext& trace = {},
+					  MetricsRegistry::Clock::time_point deadline = MetricsRegistry::Clock::time_point::max()) {
+			std::string cached;
+			if (lookupCache(service_id, method_id, body, cached)) {
+				callback(RpcStatus::OK, std::move(cached));
+				return;
+			}
+
+			if (singleflightEnabled(service_id, method_id)) {
+				auto flight = singleflight_.join(service_id, method_id, std::move(body), std::move(callback), deadline);
+				if (!flight) {
+					// 已挂接到相同的在途调用, 结果由领头者完成时分发; 挂接者的截止时间可能延长这次调用
+					MetricsRegistry::instance().local(service_id, method_id).coalesced.add();
+					return;
+				}
+				// 开始执行时取所有等待者中最晚的截止时间, 领头者先过期不会连累后来者
+				schedule(service_id, method_id,
+					[flight]() -> const std::string& { return flight -> body; },
+					[this, flight](RpcStatus status, std::string payload) {
+						singleflight_.complete(flight, status, std::move(payload));
+					}, trace,
+					[this, flight](MetricsRegistry::Clock::time_point started_at) {
+						return singleflight_.start(flight, started_at);
+					});
+				return;
+			}
+
+			schedule(service_id, method_id,
+				[body = std::move(body)]() -> const std::string& { return body; },
+				std::move(callback), trace,
+				[deadline](MetricsRegistry::Clock::time_point) { return deadline; });
+		}
+
+		// 批量调用: results 与 calls 按顺序一一对应, 回调在最后一个完成的工作线程上执行
+		// run_inline 为 true 时整批在一个任务里顺序执行, 子调用都很小时省去逐个入队和唤醒的开销;
+		// 否则每个子调用各自入队, 在多个工作线程上并行
+		// 两种方式下子调用与单独调用一样先查响应缓存; 开启了请求合并的方法要挂到在途调用上等结果, 内联时也经 dispatch 入队
+		void dispatchBatch(std::vector<BatchCall> calls, bool run_inline, BatchCallback callback,
+						   const TraceContext& trace = {},
+						   MetricsRegistry::Clock::time_point deadline = MetricsRegistry::Clock::time_point::max()) {
+			if (calls.empty()) {
+				callback({});
+				return;
+			}
+
+			auto state = std::make_shared<BatchState>();
+			state -> results.resize(calls.size());
+			state -> remaining.store(calls.size(), std::memory_order_relaxed);
+			state -> callback = std::move(callback);
+
+			if (run_inline) {
+				auto enqueued_at = MetricsRegistry::Clock::now();
+				thread_pool_.post([this, state, enqueued_at, deadline, trace, calls = std::move(calls)]() mutable {
+					auto started_at = MetricsRegistry::Clock::now();
+					Tracer::instance().record("threadpool_queue", trace, Tracer::toNanos(enqueued_at), Tracer::toNanos(started_at));
+					ScopedTraceContext trace_scope(trace);
+
+					for (size_t i = 0; i < calls.size(); ++i) {
+						auto& call = calls[i];
+						if (singleflightEnabled(call.service_id, call.method_id)) {
+							dispatch(call.service_id, call.method_id, std::move(call.body),
+								[state, i](RpcStatus status, std::string payload) {
+									state -> complete(i, status, std::move(payload));
+								}, trace, deadline);
+							continue;
+						}
+
+						auto& stats = methodStats(call.service_id, call.method_id);
+						stats.queue_wait.record(MetricsRegistry::elapsedNanos(enqueued_at, started_at));
+						std::string payload;
+						if (lookupCache(call.service_id, call.method_id, call.body, payload)) {
+							state -> complete(i, RpcStatus::OK, std::move(payload));
+							continue;
+						}
+						auto now = MetricsRegistry::Clock::now();
+						if (now >= deadline) {
+							stats.errors.add();
+							state -> complete(i, RpcStatus::DEADLINE_EXCEEDED, "deadline exceeded before dispatch");
+							continue;
+						}
+						RpcStatus status = invoke(call.service_id, call.method_id, call.body, payload, now);
+						if (status == RpcStatus::OK) {
+							storeCache(call.service_id, call.method_id, call.body, payload);
+						}
+						state -> complete(i, status, std::move(payload));
+					}
 				});
+				return;
+			}
+
+			for (size_t i = 0; i < calls.size(); ++i) {
+				dispatch(calls[i].service_id, calls[i].method_id, std::move(calls[i].body),
+					[state, i](RpcStatus status, std::string payload) {
+						state -> complete(i, status, std::move(payload));
+					}, trace, deadline);
+			}
+		}
+
+		// 分发请求
+		void enqueueTask(const RpcHeader& header, std::string bd, std::function<void(std::span<const char>)> response_callback,
+						 const TraceContext& trace = {},
+						 MetricsRegistry::Clock::time_point deadline = MetricsRegistry::Clock::time_point::max()) {
+			dispatch(header.service_id, header.method_id, std::move(bd),
+				[header, cb = std::move(response_callback)](RpcStatus status, std::string response_payload) {
+					Buffer response_buffer;
+					response_buffer.append(response_payload);
+
+					RpcHeader response_header = make_response_header(header, status, response_payload.size());
+					prepend_header(response_buffer, response_header);
+
+					cb(response_buffer.readableBytesView());
+				}, trace, deadline);
 		}
 	private:
+		// 一次批量调用的结果; 每个结果槽只由一个线程写, 计数器的 acq_rel 保证最后一个完成的线程看到所有结果
+		struct BatchState {
+			std::vector<BatchResult> results;
+			std::atomic<size_t> remaining;
+			BatchCallback callback;
+
+			void complete(size_t index, RpcStatus status, std::string payload) {
+				results[index].status = status;
+				results[index].payload = std::move(payload);
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+					callback(std::move(results));
+				}
+			}
+		};
+
+		static uint64_t routeKey(uint32_t service_id, uint32_t method_id) noexcept {
+			return (static_cast<uint64_t>(service_id) << 32) | method_id;
+		}
+
+		bool singleflightEnabled(uint32_t service_id, uint32_t method_id) const {
+			return !singleflight_methods_.empty() && singleflight_methods_.count(routeKey(service_id, method_id));
+		}
+
+		// 查响应缓存并计数; 方法没有开启缓存或未命中时返回 false
+		bool lookupCache(uint32_t service_id, uint32_t method_id, const std::string& body, std::string& response) {
+			if (cacheTtl(service_id, method_id).count() <= 0) {
+				return false;
+			}
+			auto& stats = MetricsRegistry::instance().local(service_id, method_id);
+			if (response_cache_.lookup(service_id, method_id, body, response)) {
+				stats.cache_hits.add();
+				stats.bytes_out.add(response.size());
+				return true;
+			}
+			stats.cache_misses.add();
+			return false;
+		}
+
+		// 成功的响应写入缓存, 方法没有开启缓存时什么也不做
+		void storeCache(uint32_t service_id, uint32_t method_id, const std::string& body, const std::string& response) {
+			if (auto ttl = cacheTtl(service_id, method_id); ttl.count() > 0) {
+				response_cache_.insert(service_id, method_id, body, response, ttl);
+			}
+		}
+
+		std::chrono::milliseconds cacheTtl(uint32_t service_id, uint32_t method_id) const {
+			if (cache_ttls_.empty()) {
+				return std::chrono::milliseconds::zero();
+			}
+			auto it = cache_ttls_.find(routeKey(service_id, method_id));
+			return it != cache_ttls_.end() ? it -> second : std::chrono::milliseconds::zero();
+		}
+
+		// 把一次普通调用放进线程池; body 返回请求体的引用, 合并调用时直接引用在途调用里的那份, 不再拷贝
+		// deadline(started_at) 在开始执行时求值, 合并调用在这一刻才知道所有等待者中最晚的截止时间
+		template <typename BodySource, typename DeadlineSource>
+		void schedule(uint32_t service_id, uint32_t method_id, BodySource body, DispatchCallback callback,
+					  const TraceContext& trace, DeadlineSource deadline) {
+			auto enqueued_at = MetricsRegistry::Clock::now();
+
+			thread_pool_.post([this, service_id, method_id, enqueued_at, trace, body = std::move(body),
+								  deadline = std::move(deadline), cb = std::move(callback)]() {
+				auto started_at = MetricsRegistry::Clock::now();
+				auto& stats = methodStats(service_id, method_id);
+				stats.queue_wait.record(MetricsRegistry::elapsedNanos(enqueued_at, started_at));
+
+				auto& tracer = Tracer::instance();
+				tracer.record("threadpool_queue", trace, Tracer::toNanos(enqueued_at), Tracer::toNanos(started_at));
+				ScopedTraceContext trace_scope(trace);
+
+				if (started_at >= deadline(started_at)) {
+					stats.errors.add();
+					cb(RpcStatus::DEADLINE_EXCEEDED, "deadline exceeded before dispatch");
+					return;
+				}
+
+				std::string response_payload;
+				RpcStatus status = invoke(service_id, method_id, body(), response_payload, started_at);
+				if (status == RpcStatus::OK) {
+					storeCache(service_id, method_id, body(), response_payload);
+				}
+				cb(status, std::move(response_payload));
+			});
+		}
+
+		// 在当前工作线程上调用一个普通 RPC, 记录处理耗时和错误; 失败时 response 为错误描述
+		RpcStatus invoke(uint32_t service_id, uint32_t method_id, const std::string& body, std::string& response,
+						 MetricsRegistry::Clock::time_point started_at) {
+			return invokeService(service_id, method_id, response, started_at, [&](IService& service) {
+				response = service.callMethod(method_id, body);
+				return response.size();
+			});
+		}
+
+		// 调用业务方法 call(IService&) -> 响应字节数, 统一处理服务查找、异常和指标; 失败时 error 为错误描述
+		template <typename Call>
+		RpcStatus invokeService(uint32_t service_id, uint32_t method_id, std::string& error,
+								MetricsRegistry::Clock::time_point started_at, Call&& call) {
+			auto it = services_.find(service_id);
+			if (it == services_.end()) {
+				CYFON_LOG_ERROR("Service not found: {}", service_id);
+				MetricsRegistry::instance().localUnknown().errors.add();
+				error = "service not found";
+				return RpcStatus::SERVICE_NOT_FOUND;
+			}
+
+			auto& stats = methodStats(service_id, method_id);
+			uint64_t response_bytes = 0;
+			try {
+				response_bytes = call(*it -> second);
+			}
+			catch (const RpcStatusException& e) {
+				CYFON_LOG_WARN("Service {} method {} failed: {}", service_id, method_id, e.what());
+				stats.errors.add();
+				error = e.what();
+				return e.status();
+			}
+			catch (const std::exception& e) {
+				CYFON_LOG_ERROR("Service {} method {} threw: {}", service_id, method_id, e.what());
+				stats.errors.add();
+				error = e.what();
+				return RpcStatus::INTERNAL;
+			}
+
+			auto finished_at = MetricsRegistry::Clock::now();
+			stats.handler_time.record(MetricsRegistry::elapsedNanos(started_at, finished_at));
+			Tracer::instance().record("handler", Tracer::current(), Tracer::toNanos(started_at), Tracer::toNanos(finished_at));
+			stats.bytes_out.add(response_bytes);
+			return RpcStatus::OK;
+		}
+
 		std::unordered_map<uint32_t, std::unique_ptr<IService>> services_;
+		std::unordered_set<uint64_t> singleflight_methods_;	// routeKey, 服务开始后只读
+		SingleflightGroup singleflight_;
+		std::unordered_map<uint64_t, std::chrono::milliseconds> cache_ttls_;	// routeKey -> ttl, 服务开始后只读
+		std::unordered_map<uint32_t, MessageLimits> message_limits_;	// service_id -> 限制, 服务开始后只读
+		ResponseCache response_cache_;
 		ThreadPool thread_pool_;
+		std::atomic<size_t> next_worker_{ 0 };
 	};
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "message_codec.h"
 #include "rpc_server.h" // �������ڰ���·����
 #include <google/protobuf/message.h>
 #include <string>
@@ -24,10 +25,8 @@ namespace cyfon_rpc {
 #define CYFON_RPC_DEFINE_ERROR_HANDLER() \
 protected: \
          virtual std::string OnRpcError(const char* method_name, const char* step, const std::string& error_message) {\
-             std::cerr << "[RPC_ERROR] ServiceID: " << kServiceId \
-             << ", Method: " << method_name \
-             << ", Step: " << step \
-             << ", Error: " << error_message << std::endl; \
+             CYFON_LOG_ERROR("[RPC_ERROR] ServiceID: {}, Method: {}, Step: {}, Error: {}", \
+                 kServiceId, method_name, step, error_message); \
              return ""; /* Ĭ�Ϸ��ؿ��ַ��� */ \
      } \
 private: /* �л��� private �����غ�����ʵ��ϸ�� */
@@ -56,7 +55,7 @@ public: \
 #define CYFON_RPC_DISPATCH(MethodName, RequestType, ResponseType) \
             case k##MethodName: { \
                 RequestType request; \
-                if (!request.ParseFromString(request_body)) { \
+                if (!cyfon_rpc::decode_message(request_body, request)) { \
                     return OnRpcError(#MethodName, "ParseRequest", "Failed to parse " #RequestType); \
                 } \
                 \
@@ -64,7 +63,7 @@ public: \
                 ResponseType response = MethodName(request); \
                 \
                 std::string response_str; \
-                if (!response.SerializeToString(&response_str)) { \
+                if (!cyfon_rpc::encode_message(response, response_str)) { \
                     return OnRpcError(#MethodName, "SerializeResponse", "Failed to serialize " #ResponseType); \
                 } \
                 return response_str; \
@@ -0,0 +1,176 @@
+#include "rpc_trace.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+namespace cyfon_rpc {
+
+	void SpanRing::collect(std::vector<SpanRecord>& out) const {
+		uint64_t head = head_.load(std::memory_order_acquire);
+		uint64_t begin = head > kCapacity ? head - kCapacity : 0;
+
+		for (uint64_t i = begin; i < head; ++i) {
+			const Slot& slot = slots_[i % kCapacity];
+			uint64_t before = slot.seq.load(std::memory_order_acquire);
+			if (before & 1) {
+				continue;
+			}
+			SpanRecord copy = slot.record;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.seq.load(std::memory_order_relaxed) != before) {
+				continue;
+			}
+			out.push_back(copy);
+		}
+	}
+
+	Tracer& Tracer::instance() {
+		static Tracer tracer;
+		return tracer;
+	}
+
+	TraceContext& Tracer::current() noexcept {
+		thread_local TraceContext ctx;
+		return ctx;
+	}
+
+	void Tracer::configure(const TraceOptions& options) {
+		sample_every_.store(options.sample_every, std::memory_order_relaxed);
+		slow_threshold_ns_.store(options.slow_threshold_ns, std::memory_order_relaxed);
+		enabled_.store(options.enabled, std::memory_order_relaxed);
+	}
+
+	namespace {
+		// 每个线程一个随机数引擎, 用系统随机源播种, 生成时不需要跨线程同步
+		uint64_t randomId() {
+			thread_local std::mt19937_64 engine([] {
+				std::random_device device;
+				return (static_cast<uint64_t>(device()) << 32) | device();
+			}());
+			return engine();
+		}
+	}
+
+	uint64_t Tracer::newTraceId() noexcept {
+		uint64_t id;
+		do {
+			id = randomId();
+		} while (id == 0);
+		return id;
+	}
+
+	uint64_t Tracer::newSpanId() noexcept {
+		// 高 16 位为线程编号, 低 48 位为线程内自增序号; 异或同一个种子不改变进程内的唯一性
+		static const uint64_t seed = randomId();
+		thread_local uint64_t counter = 0;
+		uint64_t thread_id = localRing().thread_id;
+		uint64_t id = seed ^ ((thread_id << 48) | (++counter & 0xFFFF'FFFF'FFFFull));
+		return id != 0 ? id : newSpanId();
+	}
+
+	TraceContext Tracer::startTrace(uint32_t request_id, uint64_t start_ns) {
+		TraceContext ctx;
+		ctx.trace_id = newTraceId();
+		ctx.span_id = newSpanId();
+		ctx.parent_span_id = 0;
+		ctx.request_id = request_id;
+		ctx.start_ns = start_ns;
+		return ctx;
+	}
+
+	TraceContext Tracer::childOf(const TraceContext& parent, uint64_t start_ns) {
+		TraceContext ctx;
+		ctx.trace_id = parent.trace_id;
+		ctx.span_id = newSpanId();
+		ctx.parent_span_id = parent.span_id;
+		ctx.request_id = parent.request_id;
+		ctx.start_ns = start_ns;
+		return ctx;
+	}
+
+	void Tracer::record(const char* name, const TraceContext& parent, uint64_t start_ns, uint64_t end_ns) {
+		if (!parent || !enabled()) {
+			return;
+		}
+		push(SpanRecord{ name, parent.trace_id, newSpanId(), parent.span_id, start_ns, end_ns, parent.request_id, 0 });
+	}
+
+	void Tracer::finish(const char* name, const TraceContext& ctx, uint64_t end_ns) {
+		if (!ctx || !enabled()) {
+			return;
+		}
+		push(SpanRecord{ name, ctx.trace_id, ctx.span_id, ctx.parent_span_id, ctx.start_ns, end_ns, ctx.request_id, 0 });
+	}
+
+	Tracer::LocalRing& Tracer::localRing() {
+		thread_local LocalRing* ring = nullptr;
+		if (!ring) {
+			auto created = std::make_shared<LocalRing>();
+			created->thread_id = next_thread_id_.fetch_add(1, std::memory_order_relaxed);
+			ring = created.get();
+			std::lock_guard<std::mutex> lock(rings_mutex_);
+			rings_.push_back(std::move(created));
+		}
+		return *ring;
+	}
+
+	void Tracer::push(const SpanRecord& record) {
+		LocalRing& local = localRing();
+		SpanRecord stamped = record;
+		stamped.thread_id = local.thread_id;
+		local.ring.push(stamped);
+	}
+
+	std::string Tracer::dumpChromeTrace() const {
+		std::vector<SpanRecord> spans;
+		{
+			std::lock_guard<std::mutex> lock(rings_mutex_);
+			for (const auto& local : rings_) {
+				local->ring.collect(spans);
+			}
+		}
+
+		// 逐条链路判断是否导出: 命中采样, 或者任一 span 超过延迟阈值
+		const uint32_t sample_every = sample_every_.load(std::memory_order_relaxed);
+		const uint64_t slow_threshold = slow_threshold_ns_.load(std::memory_order_relaxed);
+
+		std::unordered_map<uint64_t, bool> keep;
+		for (const auto& span : spans) {
+			bool& kept = keep[span.trace_id];
+			if (!kept) {
+				uint64_t duration = span.end_ns > span.start_ns ? span.end_ns - span.start_ns : 0;
+				kept = (sample_every != 0 && span.trace_id % sample_every == 0) ||
+					   duration >= slow_threshold;
+			}
+		}
+
+		std::sort(spans.begin(), spans.end(),
+			[](const SpanRecord& a, const SpanRecord& b) { return a.start_ns < b.start_ns; });
+
+		std::ostringstream out;
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		for (const auto& span : spans) {
+			if (!keep[span.trace_id]) {
+				continue;
+			}
+			if (!first) {
+				out << ',';
+			}
+			first = false;
+
+			uint64_t duration = span.end_ns > span.start_ns ? span.end_ns - span.start_ns : 0;
+			out << "{\"name\":\"" << span.name << "\",\"cat\":\"rpc\",\"ph\":\"X\""
+				<< ",\"ts\":" << span.start_ns / 1000 << '.' << (span.start_ns % 1000) / 100
+				<< ",\"dur\":" << duration / 1000 << '.' << (duration % 1000) / 100
+				<< ",\"pid\":1,\"tid\":" << span.thread_id
+				<< ",\"args\":{\"trace_id\":\"" << std::hex << span.trace_id
+				<< "\",\"span_id\":\"" << span.span_id
+				<< "\",\"parent_span_id\":\"" << span.parent_span_id << std::dec
+				<< "\",\"request_id\":" << span.request_id << "}}";
+		}
+		out << "],\"displayTimeUnit\":\"ns\"}";
+		return out.str();
+	}
+}
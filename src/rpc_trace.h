@@ -0,0 +1,166 @@
+#pragma once
+
+#include "buffer.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 链路上下文: 在线程之间随请求传递, 跨进程时通过 TRACE_CONTEXT 头部扩展携带
+	struct TraceContext {
+		uint64_t trace_id = 0;			// 整条链路的 ID, 0 表示未追踪
+		uint64_t span_id = 0;			// 当前 span, 后续 span 以它为父
+		uint64_t parent_span_id = 0;	// 当前 span 的父 span
+		uint32_t request_id = 0;
+		uint64_t start_ns = 0;			// 当前 span 的开始时间
+
+		explicit operator bool() const noexcept { return trace_id != 0; }
+	};
+
+	// 环形缓冲区中的一条 span 记录
+	struct SpanRecord {
+		const char* name;				// 必须是静态字符串
+		uint64_t trace_id;
+		uint64_t span_id;
+		uint64_t parent_span_id;
+		uint64_t start_ns;
+		uint64_t end_ns;
+		uint32_t request_id;
+		uint32_t thread_id;
+	};
+
+	struct TraceOptions {
+		bool enabled = false;
+		uint32_t sample_every = 100;					// 每 N 条链路导出一条, 0 表示只按延迟触发
+		uint64_t slow_threshold_ns = 10'000'000;		// 任一 span 超过该值时导出整条链路
+	};
+
+	// 单线程写入的 span 环形缓冲区, 写满后覆盖最旧的记录
+	// 每个槽位用 seqlock 保护, 导出线程读到正在被改写的槽位时直接跳过
+	class SpanRing {
+	public:
+		static constexpr size_t kCapacity = 4096;
+
+		void push(const SpanRecord& record) noexcept {
+			uint64_t head = head_.load(std::memory_order_relaxed);
+			Slot& slot = slots_[head % kCapacity];
+			uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+
+			slot.seq.store(seq + 1, std::memory_order_relaxed);		// 奇数: 写入中
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.record = record;
+			slot.seq.store(seq + 2, std::memory_order_release);		// 偶数: 可读
+			head_.store(head + 1, std::memory_order_release);
+		}
+
+		// 拷贝出当前所有完整的记录
+		void collect(std::vector<SpanRecord>& out) const;
+
+	private:
+		struct Slot {
+			std::atomic<uint64_t> seq{ 0 };
+			SpanRecord record{};
+		};
+
+		std::array<Slot, kCapacity> slots_{};
+		std::atomic<uint64_t> head_{ 0 };
+	};
+
+	// 全局追踪器
+	// 开启后所有 span 都写入本线程的环形缓冲区 (飞行记录器), 导出时才决定哪些链路保留:
+	// 按 trace_id 采样, 或者链路中任一 span 超过延迟阈值
+	class Tracer {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static Tracer& instance();
+
+		void configure(const TraceOptions& options);
+		[[nodiscard]] bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+		static uint64_t toNanos(Clock::time_point tp) noexcept {
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count());
+		}
+		static uint64_t nowNanos() noexcept { return toNanos(Clock::now()); }
+
+		// 新链路的 ID: 非零的 64 位随机数, 随 TRACE_CONTEXT 跨进程传递, 不同客户端之间不会撞在一起,
+		// 按 trace_id 取模采样在各进程之间也互不相关
+		uint64_t newTraceId() noexcept;
+
+		// span ID: 线程编号和线程内序号拼成进程内唯一的值, 再异或一个进程级的随机种子, 避免与其它进程的 span 重号
+		uint64_t newSpanId() noexcept;
+
+		// 开启一条新链路, 返回根 span 的上下文
+		TraceContext startTrace(uint32_t request_id, uint64_t start_ns);
+
+		// 在 parent 之下开启一个子 span, 返回子 span 的上下文
+		TraceContext childOf(const TraceContext& parent, uint64_t start_ns);
+
+		// 记录 parent 之下一个已经结束的子 span
+		void record(const char* name, const TraceContext& parent, uint64_t start_ns, uint64_t end_ns);
+
+		// 结束 ctx 本身代表的 span
+		void finish(const char* name, const TraceContext& ctx, uint64_t end_ns);
+
+		// 导出 Chrome trace JSON, 可直接在 chrome://tracing 或 Perfetto 中打开
+		[[nodiscard]] std::string dumpChromeTrace() const;
+
+		// 当前线程正在处理的链路, 用于服务端处理函数内发起的下游调用
+		static TraceContext& current() noexcept;
+
+	private:
+		struct LocalRing {
+			SpanRing ring;
+			uint32_t thread_id = 0;
+		};
+
+		LocalRing& localRing();
+		void push(const SpanRecord& record);
+
+		std::atomic<bool> enabled_{ false };
+		std::atomic<uint32_t> sample_every_{ 100 };
+		std::atomic<uint64_t> slow_threshold_ns_{ 10'000'000 };
+
+		mutable std::mutex rings_mutex_;
+		std::vector<std::shared_ptr<LocalRing>> rings_;
+		std::atomic<uint32_t> next_thread_id_{ 1 };
+	};
+
+	// 在作用域内把 ctx 设为当前线程的链路上下文
+	class ScopedTraceContext {
+	public:
+		explicit ScopedTraceContext(const TraceContext& ctx) : saved_(Tracer::current()) {
+			Tracer::current() = ctx;
+		}
+		~ScopedTraceContext() { Tracer::current() = saved_; }
+
+		ScopedTraceContext(const ScopedTraceContext&) = delete;
+		ScopedTraceContext& operator=(const ScopedTraceContext&) = delete;
+
+	private:
+		TraceContext saved_;
+	};
+
+	// TRACE_CONTEXT 头部扩展: 置位时 payload 前 16 字节为 trace_id 和上游 span_id (网络字节序)
+	inline constexpr size_t kTraceExtensionSize = 16;
+
+	inline void append_trace_extension(Buffer& buffer, const TraceContext& ctx) {
+		buffer.appendInt(ctx.trace_id);
+		buffer.appendInt(ctx.span_id);
+	}
+
+	// 从缓冲区读出并消费头部扩展, 返回上游上下文
+	inline TraceContext read_trace_extension(Buffer& buffer, uint32_t request_id) {
+		TraceContext upstream;
+		upstream.trace_id = buffer.readInt<uint64_t>();
+		upstream.span_id = buffer.readInt<uint64_t>();
+		upstream.request_id = request_id;
+		return upstream;
+	}
+}
@@ -0,0 +1,70 @@
+#include "singleflight.h"
+#include "rpc_protocol_utils.h"
+#include <algorithm>
+
+namespace cyfon_rpc {
+
+	std::shared_ptr<SingleflightGroup::Flight> SingleflightGroup::join(uint32_t service_id, uint32_t method_id,
+																	   std::string body, Callback callback, Clock::time_point deadline) {
+		const size_t hash = request_hash(service_id, method_id, body);
+		Shard& shard = shardFor(hash);
+
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.flights.find(Key{ service_id, method_id, hash, body });
+		if (it != shard.flights.end()) {
+			Flight& flight = *it -> second;
+			flight.waiters.push_back(Waiter{ std::move(callback), deadline });
+			flight.deadline = std::max(flight.deadline, deadline);
+			return nullptr;
+		}
+
+		auto flight = std::make_shared<Flight>();
+		flight -> service_id = service_id;
+		flight -> method_id = method_id;
+		flight -> hash = hash;
+		flight -> body = std::move(body);
+		flight -> waiters.push_back(Waiter{ std::move(callback), deadline });
+		flight -> deadline = deadline;
+		shard.flights.emplace(Key{ service_id, method_id, hash, flight -> body }, flight);
+		return flight;
+	}
+
+	SingleflightGroup::Clock::time_point SingleflightGroup::start(const std::shared_ptr<Flight>& flight, Clock::time_point now) {
+		std::lock_guard<std::mutex> lock(shardFor(flight -> hash).mutex);
+		flight -> started_at = now;
+		return flight -> deadline;
+	}
+
+	void SingleflightGroup::complete(const std::shared_ptr<Flight>& flight, RpcStatus status, std::string payload) {
+		std::vector<Waiter> waiters;
+		Clock::time_point started_at;
+		{
+			// 先摘掉条目, 之后到达的相同请求会重新执行, 不会拿到本次之后才过期的结果
+			Shard& shard = shardFor(flight -> hash);
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.flights.erase(Key{ flight -> service_id, flight -> method_id, flight -> hash, flight -> body });
+			waiters.swap(flight -> waiters);
+			started_at = flight -> started_at;
+		}
+
+		// 最后一个拿结果的等待者接管 payload, 其余拷贝
+		size_t last = waiters.size();
+		for (size_t i = waiters.size(); i-- > 0;) {
+			if (waiters[i].deadline > started_at) {
+				last = i;
+				break;
+			}
+		}
+		for (size_t i = 0; i < waiters.size(); ++i) {
+			if (waiters[i].deadline <= started_at) {
+				waiters[i].callback(RpcStatus::DEADLINE_EXCEEDED, "deadline exceeded before dispatch");
+			}
+			else if (i == last) {
+				waiters[i].callback(status, std::move(payload));
+			}
+			else {
+				waiters[i].callback(status, payload);
+			}
+		}
+	}
+}
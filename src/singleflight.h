@@ -0,0 +1,85 @@
+#pragma once
+
+#include "rpc_header.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 在途请求合并 (singleflight)
+	// 同一时刻到达的 (service_id, method_id, body) 完全相同的请求只执行一次, 结果分发给所有等待者;
+	// 先按哈希定位, 再逐字节比较 body, 哈希碰撞不会把不同请求合并在一起
+	// 按哈希分成 16 个分片, 每个分片一把锁, 锁内只做查找和挂接, 不执行业务代码
+	// 每个等待者保留自己的截止时间: 调用按最晚的截止时间决定是否执行, 挂接不会缩短任何调用方的截止时间;
+	// 开始执行前已经过期的等待者单独以 DEADLINE_EXCEEDED 结束, 其余等待者拿到结果
+	class SingleflightGroup {
+	public:
+		using Callback = std::function<void(RpcStatus status, std::string payload)>;
+		using Clock = std::chrono::steady_clock;
+
+		struct Waiter {
+			Callback callback;
+			Clock::time_point deadline;
+		};
+
+		// 一次在途调用; body 在调用完成前保持不变, 领头者直接引用它执行, 不再拷贝
+		// 除 body 以外的字段由分片锁保护
+		struct Flight {
+			uint32_t service_id = 0;
+			uint32_t method_id = 0;
+			size_t hash = 0;
+			std::string body;
+			std::vector<Waiter> waiters;							// 包括领头者自己的回调
+			Clock::time_point deadline = Clock::time_point::min();	// 所有等待者中最晚的截止时间
+			Clock::time_point started_at = Clock::time_point::min();
+		};
+
+		// 返回非空表示调用方是领头者, 需要执行调用并在完成后调用 complete;
+		// 返回空表示已挂接到相同的在途调用上, callback 会在那次调用完成时被调用
+		std::shared_ptr<Flight> join(uint32_t service_id, uint32_t method_id, std::string body, Callback callback,
+									 Clock::time_point deadline = Clock::time_point::max());
+
+		// 领头者的任务开始执行时调用, 返回此刻所有等待者中最晚的截止时间
+		// 之后挂接的等待者截止时间都晚于 now, 照常拿到结果
+		Clock::time_point start(const std::shared_ptr<Flight>& flight, Clock::time_point now);
+
+		// 结束在途调用并把结果分发给所有等待者, 在 start 之前已过期的等待者收到 DEADLINE_EXCEEDED; 回调在锁外执行
+		void complete(const std::shared_ptr<Flight>& flight, RpcStatus status, std::string payload);
+
+	private:
+		struct Key {
+			uint32_t service_id;
+			uint32_t method_id;
+			size_t hash;
+			std::string_view body;	// 指向 Flight::body, 条目存在期间有效
+
+			bool operator==(const Key& other) const noexcept {
+				return hash == other.hash && service_id == other.service_id &&
+					method_id == other.method_id && body == other.body;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const noexcept { return key.hash; }
+		};
+
+		struct Shard {
+			std::mutex mutex;
+			std::unordered_map<Key, std::shared_ptr<Flight>, KeyHash> flights;
+		};
+
+		static constexpr size_t kShardCount = 16;
+
+		Shard& shardFor(size_t hash) noexcept { return shards_[(hash >> 4) % kShardCount]; }
+
+		std::array<Shard, kShardCount> shards_;
+	};
+}
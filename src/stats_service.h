@@ -0,0 +1,33 @@
+#pragma once
+
+#include "rpc_server.h"
+#include "rpc_metrics.h"
+#include "rpc_trace.h"
+#include <string>
+#include <functional>
+
+namespace cyfon_rpc {
+
+	// 内置统计服务: 以 Prometheus 文本格式返回所有 (service, method) 的指标, 或导出 Chrome trace JSON
+	// 既可以通过 RPC 调用, 也可以在 HTTP 网关上挂一个 /metrics 路由
+	class StatsService : public IService {
+	public:
+		static inline const uint32_t kServiceId = static_cast<uint32_t>(std::hash<std::string>{}("CyfonStatsService"));
+		static inline const uint32_t kMethodPrometheus = static_cast<uint32_t>(std::hash<std::string>{}("Prometheus"));
+		static inline const uint32_t kMethodChromeTrace = static_cast<uint32_t>(std::hash<std::string>{}("ChromeTrace"));
+
+		bool hasMethod(uint32_t method_id) override {
+			return method_id == kMethodPrometheus || method_id == kMethodChromeTrace;
+		}
+
+		std::string callMethod(uint32_t method_id, const std::string& /*request_body*/) override {
+			if (method_id == kMethodPrometheus) {
+				return MetricsRegistry::instance().renderPrometheus();
+			}
+			if (method_id == kMethodChromeTrace) {
+				return Tracer::instance().dumpChromeTrace();
+			}
+			return "";
+		}
+	};
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SerialQueue;
+
+namespace cyfon_rpc {
+	enum class MethodType;
+
+	// 流的热数据: 每条流帧都要读写, 24 字节, 一条缓存行能放下两个多
+	struct StreamState {
+		uint32_t stream_id = 0;			// 带代号的流ID, 0 表示槽位空闲
+		uint32_t request_id = 0;		// 请求ID
+		uint32_t service_id = 0;		// 服务ID
+		uint32_t method_id = 0;			// 方法ID
+		uint32_t sequence_number = 0;	// 已发送/接收的消息序号
+		MethodType method_type{};		// 方法类型
+	};
+
+	// 会话内的流表: 槽位数组 + 带代号的流ID
+	// - stream_id = (generation << 16) | index, index 从 1 开始, 0 保留给非流式调用
+	// - 查找只是一次数组下标加一次比较; 关闭的槽位代号加一后复用, 迟到的旧ID不会误命中新流.
+	//   代号只有 16 位, 同一槽位复用 65536 次后代号回绕, 那时的旧ID会再次命中该槽位上的流;
+	//   代号回绕到 0 时流ID等于下标, 仍然不为 0, 也不会与其它槽位上的流相同
+	// - 热数据 (StreamState) 和冷数据 (客户端流收集的消息、流的串行执行器) 分开存放, 遍历热数据不会把消息缓冲带进缓存
+	// 非线程安全: 只在会话所属的 I/O 线程上访问
+	class StreamTable {
+	public:
+		static constexpr uint32_t kIndexBits = 16;
+		static constexpr uint32_t kIndexMask = (1u << kIndexBits) - 1;
+		static constexpr size_t kMaxStreams = kIndexMask;	// 同一会话最多同时打开的流
+
+		StreamTable() {
+			// 下标 0 不使用, 保证流ID不为 0
+			hot_.emplace_back();
+			cold_.emplace_back();
+			generations_.push_back(0);
+		}
+
+		// 分配一条流, 槽位用尽时返回 nullptr
+		// 返回的指针在下一次 open 之前有效
+		StreamState* open() {
+			uint32_t index;
+			if (!free_.empty()) {
+				index = free_.back();
+				free_.pop_back();
+			}
+			else {
+				if (hot_.size() > kMaxStreams) {
+					return nullptr;
+				}
+				index = static_cast<uint32_t>(hot_.size());
+				hot_.emplace_back();
+				cold_.emplace_back();
+				generations_.push_back(0);
+			}
+
+			uint16_t generation = ++generations_[index];
+			StreamState& state = hot_[index];
+			state = StreamState{};
+			state.stream_id = (static_cast<uint32_t>(generation) << kIndexBits) | index;
+			++size_;
+			return &state;
+		}
+
+		// 按流ID查找, 流不存在或已关闭时返回 nullptr
+		[[nodiscard]] StreamState* find(uint32_t stream_id) noexcept {
+			uint32_t index = stream_id & kIndexMask;
+			if (index == 0 || index >= hot_.size()) {
+				return nullptr;
+			}
+			StreamState& state = hot_[index];
+			return state.stream_id == stream_id ? &state : nullptr;
+		}
+
+		// 客户端流收集到的消息
+		[[nodiscard]] std::vector<std::string>& messages(const StreamState& state) noexcept {
+			return cold_[state.stream_id & kIndexMask].messages;
+		}
+
+		// 流的处理函数在这个串行队列上执行, 由会话在打开流时设置
+		[[nodiscard]] std::shared_ptr<SerialQueue>& executor(const StreamState& state) noexcept {
+			return cold_[state.stream_id & kIndexMask].executor;
+		}
+
+		bool close(uint32_t stream_id) {
+			StreamState* state = find(stream_id);
+			if (!state) {
+				return false;
+			}
+			uint32_t index = stream_id & kIndexMask;
+			state -> stream_id = 0;
+			// 归还消息占用的内存, 空槽位不保留大缓冲; 执行器上还没跑完的任务自己持有队列
+			std::vector<std::string>().swap(cold_[index].messages);
+			cold_[index].executor.reset();
+			free_.push_back(index);
+			--size_;
+			return true;
+		}
+
+		[[nodiscard]] size_t size() const noexcept { return size_; }
+
+	private:
+		struct StreamCold {
+			std::vector<std::string> messages;
+			std::shared_ptr<SerialQueue> executor;
+		};
+
+		std::vector<StreamState> hot_;
+		std::vector<StreamCold> cold_;
+		std::vector<uint16_t> generations_;
+		std::vector<uint32_t> free_;	// 空闲槽位栈, 最近释放的先复用, 缓存更热
+		size_t size_ = 0;
+	};
+}
@@ -2,6 +2,31 @@
 #include <cassert>
 #include <string_view> // ȷ string_view
 #include "buffer.h"
+#include "message_codec.h"
+#include "rpc_protocol_utils.h"
+#include "blob_response.h"
+#include "http_router.h"
+#include "rpc_server.h"
+#include "singleflight.h"
+#include "response_cache.h"
+#include "client_cache.h"
+#include "Session.h"
+#include "stream_table.h"
+#include "rpc_trace.h"
+#include "timer_wheel.h"
+#include "call_policy.h"
+#include "rpc_channel.h"
+#include "rpc_capture.h"
+#include "http_session.h"
+#include "io_context_pool.h"
+#include "calu.pb.h"
+#include <set>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include <memory>
+#include <future>
 
 // Ϊ˷㣬ʹ cyfon_rpc ռ
 using namespace cyfon_rpc;
@@ -15,6 +40,32 @@ void testIntegerOperations();
 void testPrepend();
 void testFindCRLF();
 void testShrink();
+void testShrinkTo();
+void testPodCodec();
+void testFlatCodec();
+void testHeaderCodec();
+void testCrc32c();
+void testBlobResponse();
+void testRouterBatchUpdate();
+void testRouterReclaim();
+void testMethodStatsUnknown();
+void testBatchCodec();
+void testBatchDispatch();
+void testSingleflightDeadline();
+void testResponseCache();
+void testClientCache();
+void testSerialQueue();
+void testStreamTable();
+void testTypedServiceAdapter();
+void testMessageLimits();
+void testBlobZeroCopy();
+void testSessionChecksum();
+void testCaptureReplayChecksum();
+void testTraceIds();
+void testTimerWheel();
+void testCallPolicy();
+void testHedgedCall();
+void testHttpGateway();
 
 int main() {
     std::cout << "Starting Buffer tests..." << std::endl;
@@ -27,6 +78,32 @@ int main() {
     testPrepend();
     testFindCRLF();
     testShrink();
+    testShrinkTo();
+    testPodCodec();
+    testFlatCodec();
+    testHeaderCodec();
+    testCrc32c();
+    testBlobResponse();
+    testRouterBatchUpdate();
+    testRouterReclaim();
+    testMethodStatsUnknown();
+    testBatchCodec();
+    testBatchDispatch();
+    testSingleflightDeadline();
+    testResponseCache();
+    testClientCache();
+    testSerialQueue();
+    testStreamTable();
+    testTypedServiceAdapter();
+    testMessageLimits();
+    testBlobZeroCopy();
+    testSessionChecksum();
+    testCaptureReplayChecksum();
+    testTraceIds();
+    testTimerWheel();
+    testCallPolicy();
+    testHedgedCall();
+    testHttpGateway();
 
     std::cout << "\nAll Buffer tests passed successfully!" << std::endl;
 
@@ -179,4 +256,1938 @@ void testShrink() {
     assert(buf.internalCapacity() == 5);
     assert(buf.toStringView() == "zzzzz");
     std::cout << "testShrink PASSED" << std::endl;
-}
\ No newline at end of file
+}
+
+// yԇ9yԇ shrinkTo տsᱣA^
+void testShrinkTo() {
+    std::cout << "--- Running testShrinkTo ---" << std::endl;
+    Buffer buf;
+    buf.append(std::string(64 * 1024, 'a'));
+    buf.retrieve(64 * 1024 - 3);
+    assert(buf.internalCapacity() > 64 * 1024);
+
+    buf.shrinkTo(100);
+    assert(buf.readableBytes() == 3);
+    assert(buf.toStringView() == "aaa");
+    assert(buf.prependableBytes() == Buffer::kCheapPrepend);
+    assert(buf.writableBytes() == 100);
+    assert(buf.internalCapacity() == Buffer::kCheapPrepend + 3 + 100);
+
+    buf.retrieveAll();
+    buf.shrinkTo(0);
+    assert(buf.internalCapacity() == Buffer::kCheapPrepend);
+    buf.append("hello");
+    assert(buf.toStringView() == "hello");
+    std::cout << "testShrinkTo PASSED" << std::endl;
+}
+
+// yԇ10L POD a, ֶΰWjֹo
+struct PodSample {
+    int32_t a;
+    int64_t b;
+    double c;
+    static constexpr auto kPodFields = std::make_tuple(&PodSample::a, &PodSample::b, &PodSample::c);
+};
+
+struct PodFlag {
+    bool on;
+    int32_t n;
+    static constexpr auto kPodFields = std::make_tuple(&PodFlag::on, &PodFlag::n);
+};
+
+void testPodCodec() {
+    std::cout << "--- Running testPodCodec ---" << std::endl;
+    static_assert(MessageCodec<PodSample>::kSize == 20);
+    PodSample in{ -5, int64_t{ 1 } << 40, 2.5 };
+    std::string bytes;
+    assert(encode_message(in, bytes));
+    assert(bytes.size() == 20);
+    assert(static_cast<unsigned char>(bytes[0]) == 0xff);
+    assert(static_cast<unsigned char>(bytes[3]) == 0xfb);
+
+    PodSample out{};
+    assert(decode_message(bytes, out));
+    assert(out.a == -5 && out.b == (int64_t{ 1 } << 40) && out.c == 2.5);
+    // LȲֱӾܽ^
+    assert(!decode_message(std::string_view(bytes).substr(0, 19), out));
+
+    // bool aһֹ, arκηֹ true
+    PodFlag flag{ true, 7 };
+    assert(encode_message(flag, bytes) && bytes.size() == 5 && bytes[0] == 1);
+    bytes[0] = 2;
+    PodFlag flag_out{};
+    assert(decode_message(bytes, flag_out) && flag_out.on == true && flag_out.n == 7);
+    bytes[0] = 0;
+    assert(decode_message(bytes, flag_out) && flag_out.on == false);
+    std::cout << "testPodCodec PASSED" << std::endl;
+}
+
+// yԇ11ƫƱa, f汾ֶλͨ, ؔϢܽ^
+struct FlatV1 {
+    int32_t id = 0;
+    std::string name;
+    static constexpr auto kFlatFields = std::make_tuple(&FlatV1::id, &FlatV1::name);
+};
+
+struct FlatV2 {
+    int32_t id = 0;
+    std::string name;
+    uint64_t extra = 42;
+    static constexpr auto kFlatFields = std::make_tuple(&FlatV2::id, &FlatV2::name, &FlatV2::extra);
+};
+
+void testFlatCodec() {
+    std::cout << "--- Running testFlatCodec ---" << std::endl;
+    FlatV2 in{ 7, "hello", 99 };
+    std::string bytes;
+    assert(encode_message(in, bytes));
+
+    FlatV2 out;
+    assert(decode_message(bytes, out));
+    assert(out.id == 7 && out.name == "hello" && out.extra == 99);
+
+    std::string name;
+    assert(MessageCodec<FlatV2>::get<1>(bytes, name) && name == "hello");
+
+    // f汾xϢ: ׷ӵֶ
+    FlatV1 old;
+    assert(decode_message(bytes, old) && old.id == 7 && old.name == "hello");
+
+    // °汾xfϢ: ׷ӵֶαĬJֵ
+    std::string old_bytes;
+    assert(encode_message(FlatV1{ 3, "abc" }, old_bytes));
+    FlatV2 upgraded;
+    assert(decode_message(old_bytes, upgraded));
+    assert(upgraded.id == 3 && upgraded.name == "abc" && upgraded.extra == 42);
+
+    assert(!decode_message(std::string_view(bytes).substr(0, bytes.size() - 1), out));
+    assert(!decode_message(std::string_view(bytes).substr(0, 2), out));
+    std::cout << "testFlatCodec PASSED" << std::endl;
+}
+
+// yԇ12^a, SIMD cֶνYһ, ǷLڷǰܽ^
+void testHeaderCodec() {
+    std::cout << "--- Running testHeaderCodec ---" << std::endl;
+    RpcHeader header{};
+    header.message_size = sizeof(RpcHeader) + 5;
+    header.service_id = 0x01020304;
+    header.method_id = 0xa0b0c0d0;
+    header.request_id = 7;
+    header.stream_id = 0x00010002;
+    header.sequence_number = 3;
+    header.message_type = static_cast<uint8_t>(MessageType::REQUEST);
+    header.flags = Flag::TRACE_CONTEXT;
+    header.reserved = 0x1234;
+    header.deadline_ms = 250;
+
+    char wire[sizeof(RpcHeader)];
+    encode_header(header, wire);
+    assert(wire[4] == 0x01 && wire[7] == 0x04);
+    assert(wire[26] == 0x12 && wire[27] == 0x34);
+
+    char scalar[sizeof(RpcHeader)];
+    detail::swapHeaderBytesScalar(reinterpret_cast<const char*>(&header), scalar);
+    assert(std::memcmp(wire, scalar, sizeof(wire)) == 0);
+
+    RpcHeader decoded{};
+    assert(decode_header({ wire, sizeof(wire) }, decoded) == HeaderStatus::OK);
+    assert(std::memcmp(&decoded, &header, sizeof(RpcHeader)) == 0);
+    assert(decode_header({ wire, sizeof(wire) - 1 }, decoded) == HeaderStatus::INCOMPLETE);
+
+    header.message_size = sizeof(RpcHeader) - 1;
+    encode_header(header, wire);
+    assert(decode_header({ wire, sizeof(wire) }, decoded) == HeaderStatus::MALFORMED);
+
+    header.message_size = 1024;
+    encode_header(header, wire);
+    assert(decode_header({ wire, sizeof(wire) }, decoded, 1023) == HeaderStatus::TOO_LARGE);
+    assert(decode_header({ wire, sizeof(wire) }, decoded, 1024) == HeaderStatus::OK);
+
+#if defined(CYFON_RPC_HEADER_SIMD_X86)
+    // \Еrɵÿ SIMD 汾 (CPU ֧֕r) cֶΰ汾ֹһ, DQɴ߀ԭ
+    std::vector<detail::SwapHeaderFn> variants;
+    if (detail::cpuHasSsse3()) {
+        variants.push_back(detail::swapHeaderBytesSsse3);
+    }
+    if (detail::cpuHasAvx2()) {
+        variants.push_back(detail::swapHeaderBytesAvx2);
+    }
+    std::cout << "header codec SIMD variants: " << variants.size() << std::endl;
+    char in[sizeof(RpcHeader)];
+    char expected[sizeof(RpcHeader)];
+    char got[sizeof(RpcHeader)];
+    char back[sizeof(RpcHeader)];
+    uint32_t seed = 12345;
+    for (int round = 0; round < 1000; ++round) {
+        for (char& c : in) {
+            seed = seed * 1103515245u + 12345u;
+            c = static_cast<char>(seed >> 24);
+        }
+        detail::swapHeaderBytesScalar(in, expected);
+        for (auto swap : variants) {
+            swap(in, got);
+            assert(std::memcmp(got, expected, sizeof(got)) == 0);
+            swap(got, back);
+            assert(std::memcmp(back, in, sizeof(in)) == 0);
+        }
+    }
+#endif
+    std::cout << "testHeaderCodec PASSED" << std::endl;
+}
+
+void testCrc32c() {
+    std::cout << "--- Running testCrc32c ---" << std::endl;
+    // yԇ1˜Уֵ
+    const std::string check = "123456789";
+    assert(crc32c(check.data(), check.size()) == 0xE3069283);
+    assert(detail::crc32cPortable(check.data(), check.size()) == 0xE3069283);
+    assert(crc32c(nullptr, 0) == 0);
+
+    // yԇ2ֶӋcһӋYͬ, ӲcYͬ (wL̷։K)
+    std::string data(100000, '\0');
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 131 + (i >> 7));
+    }
+    for (size_t size : { size_t{ 1 }, size_t{ 7 }, size_t{ 768 }, size_t{ 24576 }, data.size() }) {
+        assert(crc32c(data.data(), size) == detail::crc32cPortable(data.data(), size));
+    }
+    assert(crc32c(data.data() + 1000, data.size() - 1000, crc32c(data.data(), 1000)) == crc32c(data.data(), data.size()));
+
+    // yԇ3βӡУcȥ
+    Buffer frame;
+    frame.append("payload");
+    RpcHeader header{};
+    header.message_size = sizeof(RpcHeader) + 7;
+    header.message_type = static_cast<uint8_t>(MessageType::REQUEST);
+    prepend_header(frame, header);
+    append_checksum(frame);
+    RpcHeader sealed{};
+    assert(deserialize_header(frame, sealed));
+    assert(sealed.message_size == sizeof(RpcHeader) + 7 + kChecksumSize);
+    assert(sealed.flags & Flag::CHECKSUM);
+    assert(verify_checksum(frame.readableBytesView()));
+
+    Buffer corrupted;
+    corrupted.append(frame.peek(), frame.readableBytes());
+    const_cast<char*>(corrupted.peek())[sizeof(RpcHeader) + 2] ^= 0x01;
+    assert(!strip_checksum(corrupted));
+
+    // yԇ4βͬӸw^, request_id DҲܰlF; IλĎхf̕r
+    Buffer flipped;
+    flipped.append(frame.peek(), frame.readableBytes());
+    const_cast<char*>(flipped.peek())[offsetof(RpcHeader, request_id) + 3] ^= 0x01;
+    assert(!strip_checksum(flipped));
+
+    Buffer cleared;
+    cleared.append(frame.peek(), frame.readableBytes());
+    const_cast<char*>(cleared.peek())[offsetof(RpcHeader, flags)] &= ~Flag::CHECKSUM;
+    assert(!strip_checksum(cleared, true));
+
+    assert(strip_checksum(frame));
+    assert(frame.readableBytes() == sizeof(RpcHeader) + 7);
+    assert(deserialize_header(frame, sealed));
+    assert(sealed.message_size == sizeof(RpcHeader) + 7 && !(sealed.flags & Flag::CHECKSUM));
+    std::cout << "testCrc32c PASSED" << std::endl;
+}
+
+void testBlobResponse() {
+    std::cout << "--- Running testBlobResponse ---" << std::endl;
+    const std::string path = "blob_response_test.bin";
+    std::string content(300000, '\0');
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 7 + 3);
+    }
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        assert(file);
+        std::fwrite(content.data(), 1, content.size(), file);
+        std::fclose(file);
+    }
+
+    // yԇ1ļcָ^g
+    auto whole = BlobResponse::fromFile(path);
+    assert(whole && whole->isFile() && whole->size() == content.size());
+    auto range = BlobResponse::fromFile(path, 1000, 5000);
+    assert(range && range->offset() == 1000 && range->size() == 5000);
+    std::string out(100, '\0');
+    assert(range->readAt(4900, out.data(), 100));
+    assert(out == content.substr(5900, 100));
+    assert(!range->readAt(4950, out.data(), 100));
+
+    // yԇ2Խ^gcڵļ
+    assert(!BlobResponse::fromFile(path, content.size() + 1));
+    assert(!BlobResponse::fromFile(path, 10, content.size()));
+    assert(BlobResponse::fromFile(path, content.size()) && BlobResponse::fromFile(path, content.size())->size() == 0);
+    assert(!BlobResponse::fromFile("no_such_blob_file.bin"));
+
+    // yԇ3։KӋУcһӋͬ, ȴ^gҲһ
+    assert(crc32c(*whole) == crc32c(content.data(), content.size()));
+    assert(crc32c(*range) == crc32c(content.data() + 1000, 5000));
+    auto owner = std::make_shared<std::string>(content);
+    auto memory = BlobResponse::fromMemory(owner, owner->data() + 10, 20);
+    assert(!memory.isFile() && memory.size() == 20);
+    assert(crc32c(memory) == crc32c(content.data() + 10, 20));
+
+    std::remove(path.c_str());
+    std::cout << "testBlobResponse PASSED" << std::endl;
+}
+
+void testRouterBatchUpdate() {
+    std::cout << "--- Running testRouterBatchUpdate ---" << std::endl;
+    HttpRouter router;
+    router.registerRoute("/v1/a", 1, 1);
+    assert(router.size() == 1);
+
+    // yԇ1עgxԿf·, commit һΰl
+    router.beginUpdate();
+    router.registerRoute("/v1/{service}/{method}", 2, 2);
+    router.registerRoute("/static/*path", 3, 3);
+    assert(router.size() == 1);
+    assert(!router.match("/static/x.js"));
+    router.commit();
+    assert(router.size() == 3);
+    auto match = router.match("/v1/calc/add");
+    assert(match && match->target.service_id == 2 && match->param("method") == "add");
+    assert(router.findroute("/v1/a")->service_id == 1);
+
+    // yԇ2] beginUpdate  commit κ, ȵ clear ͬЧ
+    router.commit();
+    router.beginUpdate();
+    router.clear();
+    assert(router.size() == 3);
+    router.commit();
+    assert(router.size() == 0 && !router.match("/v1/a"));
+
+    // yԇ3 ReadGuard gQĿղጷ, ֮ǰȡąȻЧ
+    router.registerRoute("/v2/{name}", 4, 4);
+    {
+        HttpRouter::ReadGuard guard;
+        auto held = router.match("/v2/x");
+        assert(held);
+        router.clear();
+        assert(router.size() == 0 && !router.match("/v2/x"));
+        assert(router.retiredSnapshots() >= 1);
+        assert(held->param("name") == "x" && held->params[0].first == "name");
+    }
+
+    // yԇ4xx_һΰlȫۿ
+    router.registerRoute("/v3/a", 5, 5);
+    assert(router.retiredSnapshots() == 0);
+    std::cout << "testRouterBatchUpdate PASSED" << std::endl;
+}
+
+void testRouterReclaim() {
+    std::cout << "--- Running testRouterReclaim ---" << std::endl;
+    HttpRouter router;
+    router.registerRoute("/r/{id}", 1, 1);
+
+    // yԇ1һ̲ͣƥ, lע, xąʼKЧ
+    std::atomic<bool> stop{ false };
+    std::atomic<size_t> matches{ 0 };
+    std::thread reader([&] {
+        while (!stop.load(std::memory_order_relaxed)) {
+            HttpRouter::ReadGuard guard;
+            auto match = router.match("/r/42");
+            assert(match && match->target.service_id == 1);
+            assert(match->param("id") == "42" && match->params[0].first == "id");
+            matches.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    size_t max_retired = 0;
+    for (int i = 0; i < 500; ++i) {
+        router.registerRoute("/n" + std::to_string(i) + "/{x}", 2, static_cast<uint32_t>(i));
+        max_retired = std::max(max_retired, router.retiredSnapshots());
+    }
+    while (matches.load() == 0) {
+        std::this_thread::yield();
+    }
+    stop = true;
+    reader.join();
+
+    // yԇ2бֻlrڱxĿ, SעԴΔL; x˳ȫጷ
+    assert(max_retired < 500);
+    router.registerRoute("/final", 3, 3);
+    assert(router.retiredSnapshots() == 0);
+    assert(router.size() == 502);
+    std::cout << "testRouterReclaim PASSED (max retired " << max_retired << ")" << std::endl;
+}
+
+// ֻJ method 1  2 Ĝyԇ
+class TwoMethodService : public IService {
+public:
+    bool hasMethod(uint32_t method_id) override { return method_id == 1 || method_id == 2; }
+    std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+        if (!hasMethod(method_id)) {
+            throw RpcStatusException(RpcStatus::METHOD_NOT_FOUND, "no such method");
+        }
+        return std::to_string(method_id) + ":" + request_body;
+    }
+};
+
+// ӛ䛘Iշ{ôΔ; method 2  gate _, @Ոw
+class CountingService : public IService {
+public:
+    explicit CountingService(std::shared_future<void> gate) : gate_(std::move(gate)) {}
+    std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+        ++calls;
+        if (method_id == 2) {
+            gate_.wait();
+        }
+        return request_body;
+    }
+
+    std::atomic<int> calls{ 0 };
+
+private:
+    std::shared_future<void> gate_;
+};
+
+void testMethodStatsUnknown() {
+    std::cout << "--- Running testMethodStatsUnknown ---" << std::endl;
+    RpcServer server(1);
+    server.registerService(7, std::make_unique<TwoMethodService>());
+
+    // ¾ϽyӋ, ƬĿ_ʼ
+    std::thread([&server]() {
+        // yԇ1עԵķΪyӋ, δעԵķպͷ unknown 
+        MethodStats& known = server.methodStats(7, 1);
+        MethodStats& unknown = MetricsRegistry::instance().localUnknown();
+        assert(&known != &unknown);
+        assert(&server.methodStats(7, 3) == &unknown);
+        assert(&server.methodStats(12345, 1) == &unknown);
+        server.methodStats(99, 99).requests.add(5);
+
+        // yԇ2ֱӰ ID r, ۔_ͬ䵽 unknown 
+        for (uint32_t i = 0; i < MetricsRegistry::kMaxMethodsPerThread + 100; ++i) {
+            MetricsRegistry::instance().local(1000, i);
+        }
+        assert(&MetricsRegistry::instance().local(1000, MetricsRegistry::kMaxMethodsPerThread + 50) == &unknown);
+
+        known.handler_time.record(500);
+        known.handler_time.record(2000);
+        known.handler_time.record(100'000'000'000);
+    }).join();
+
+    std::string text = MetricsRegistry::instance().renderPrometheus();
+    assert(text.find("cyfon_rpc_requests_total{service=\"unknown\",method=\"unknown\"} 5") != std::string::npos);
+
+    // yԇ3t histogram , ӋͰ le c HDR ͰϽغ, ߅ֻӋ +Inf
+    assert(text.find("# TYPE cyfon_rpc_handler_seconds histogram") != std::string::npos);
+    assert(text.find("quantile=") == std::string::npos);
+    const std::string labels = "cyfon_rpc_handler_seconds_bucket{service=\"7\",method=\"1\",";
+    assert(text.find(labels + "le=\"7.67e-07\"} 1\n") != std::string::npos);
+    assert(text.find(labels + "le=\"2.047e-06\"} 2\n") != std::string::npos);
+    assert(text.find(labels + "le=\"68.7195\"} 2\n") != std::string::npos);
+    assert(text.find(labels + "le=\"+Inf\"} 3\n") != std::string::npos);
+    assert(text.find("cyfon_rpc_handler_seconds_count{service=\"7\",method=\"1\"} 3\n") != std::string::npos);
+    std::cout << "testMethodStatsUnknown PASSED" << std::endl;
+}
+
+void testBatchCodec() {
+    std::cout << "--- Running testBatchCodec ---" << std::endl;
+
+    // yԇ1{þaԭӽ؁, Ոw
+    Buffer calls_buffer;
+    calls_buffer.appendInt<uint32_t>(3);
+    append_batch_call(calls_buffer, 1, 2, "hello");
+    append_batch_call(calls_buffer, 3, 4, "");
+    append_batch_call(calls_buffer, 0xFFFFFFFFu, 5, std::string(1000, 'x'));
+    std::string encoded(calls_buffer.peek(), calls_buffer.readableBytes());
+    std::vector<BatchCall> calls;
+    assert(parse_batch_calls(encoded, calls));
+    assert(calls.size() == 3);
+    assert(calls[0].service_id == 1 && calls[0].method_id == 2 && calls[0].body == "hello");
+    assert(calls[1].service_id == 3 && calls[1].method_id == 4 && calls[1].body.empty());
+    assert(calls[2].service_id == 0xFFFFFFFFu && calls[2].body == std::string(1000, 'x'));
+
+    // yԇ2ض̵ŷκλöܽ^, βֹͬӾܽ^
+    for (size_t cut = 0; cut < encoded.size(); ++cut) {
+        assert(!parse_batch_calls(std::string_view(encoded.data(), cut), calls));
+    }
+    assert(!parse_batch_calls(encoded + "z", calls));
+
+    // yԇ3{Ô^, ^Lȳ^ʣNֹ
+    Buffer oversized;
+    oversized.appendInt<uint32_t>(kMaxBatchCalls + 1);
+    assert(!parse_batch_calls(oversized.readableBytesView(), calls));
+    Buffer lying;
+    lying.appendInt<uint32_t>(1);
+    lying.appendInt<uint32_t>(1);
+    lying.appendInt<uint32_t>(1);
+    lying.appendInt<uint32_t>(0xFFFFFFF0u);
+    lying.append("abc");
+    assert(!parse_batch_calls(lying.readableBytesView(), calls));
+
+    // yԇ4Ϸ
+    Buffer empty;
+    empty.appendInt<uint32_t>(0);
+    assert(parse_batch_calls(empty.readableBytesView(), calls) && calls.empty());
+
+    // yԇ5Yac, ɹʧӽYһ
+    Buffer results_buffer;
+    results_buffer.appendInt<uint32_t>(3);
+    append_batch_result(results_buffer, RpcStatus::OK, "42");
+    append_batch_result(results_buffer, RpcStatus::METHOD_NOT_FOUND, "no such method");
+    append_batch_result(results_buffer, RpcStatus::OK, "");
+    std::string encoded_results(results_buffer.peek(), results_buffer.readableBytes());
+    std::vector<BatchResult> results;
+    assert(parse_batch_results(encoded_results, results));
+    assert(results.size() == 3);
+    assert(results[0].status == RpcStatus::OK && results[0].payload == "42");
+    assert(results[1].status == RpcStatus::METHOD_NOT_FOUND && results[1].payload == "no such method");
+    assert(results[2].status == RpcStatus::OK && results[2].payload.empty());
+    for (size_t cut = 0; cut < encoded_results.size(); ++cut) {
+        assert(!parse_batch_results(std::string_view(encoded_results.data(), cut), results));
+    }
+    Buffer too_many_results;
+    too_many_results.appendInt<uint32_t>(kMaxBatchCalls + 1);
+    assert(!parse_batch_results(too_many_results.readableBytesView(), results));
+    std::cout << "testBatchCodec PASSED" << std::endl;
+}
+
+void testBatchDispatch() {
+    std::cout << "--- Running testBatchDispatch ---" << std::endl;
+    RpcServer server(2);
+    server.registerService(7, std::make_unique<TwoMethodService>());
+
+    for (bool run_inline : { true, false }) {
+        std::vector<BatchCall> calls(4);
+        calls[0] = { 7, 1, "a" };
+        calls[1] = { 7, 3, "b" };
+        calls[2] = { 8, 1, "c" };
+        calls[3] = { 7, 2, "d" };
+
+        std::promise<std::vector<BatchResult>> done;
+        auto future = done.get_future();
+        server.dispatchBatch(std::move(calls), run_inline, [&done](std::vector<BatchResult> results) {
+            done.set_value(std::move(results));
+        });
+        auto results = future.get();
+
+        // yԇ1Yc{һһ, ʧ{òӰ{
+        assert(results.size() == 4);
+        assert(results[0].status == RpcStatus::OK && results[0].payload == "1:a");
+        assert(results[1].status == RpcStatus::METHOD_NOT_FOUND && results[1].payload == "no such method");
+        assert(results[2].status == RpcStatus::SERVICE_NOT_FOUND);
+        assert(results[3].status == RpcStatus::OK && results[3].payload == "2:d");
+
+        // yԇ2Ԓķʽa͑
+        Buffer encoded;
+        encoded.appendInt<uint32_t>(static_cast<uint32_t>(results.size()));
+        for (const auto& result : results) {
+            append_batch_result(encoded, result.status, result.payload);
+        }
+        std::vector<BatchResult> parsed;
+        assert(parse_batch_results(encoded.readableBytesView(), parsed));
+        assert(parsed.size() == 4 && parsed[1].status == RpcStatus::METHOD_NOT_FOUND && parsed[3].payload == "2:d");
+    }
+
+    // yԇ3ֱӻ{
+    bool called = false;
+    server.dispatchBatch({}, true, [&called](std::vector<BatchResult> results) {
+        called = results.empty();
+    });
+    assert(called);
+
+    // yԇ4{cΪ{һ푑Ոρ
+    std::promise<void> gate;
+    auto counting = std::make_unique<CountingService>(gate.get_future().share());
+    CountingService& service = *counting;
+    server.registerService(9, std::move(counting));
+    server.enableResponseCache(9, 1, std::chrono::hours(1));
+    server.enableSingleflight(9, 2);
+
+    auto runBatch = [&server](std::vector<BatchCall> calls, bool run_inline) {
+        auto done = std::make_shared<std::promise<std::vector<BatchResult>>>();
+        auto future = done->get_future();
+        server.dispatchBatch(std::move(calls), run_inline, [done](std::vector<BatchResult> results) {
+            done->set_value(std::move(results));
+        });
+        return future;
+    };
+
+    // ͬһeڶͬ{еһľ, ֮ĆΪ{ú́KҲ
+    auto cached = runBatch({ { 9, 1, "x" }, { 9, 1, "x" } }, true).get();
+    assert(cached[0].status == RpcStatus::OK && cached[0].payload == "x" && cached[1].payload == "x");
+    assert(service.calls == 1);
+    std::promise<std::string> single;
+    server.dispatch(9, 1, "x", [&single](RpcStatus, std::string payload) { single.set_value(std::move(payload)); });
+    assert(single.get_future().get() == "x");
+    assert(runBatch({ { 9, 1, "x" } }, false).get()[0].payload == "x");
+    assert(service.calls == 1);
+
+    // Ϊ{ÿژIշer, eͬ{Ò쵽, Iշֻһ
+    std::promise<std::string> leader;
+    server.dispatch(9, 2, "y", [&leader](RpcStatus, std::string payload) { leader.set_value(std::move(payload)); });
+    auto coalesced = runBatch({ { 9, 2, "y" }, { 9, 1, "x" } }, true);
+    assert(coalesced.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+    gate.set_value();
+    auto coalesced_results = coalesced.get();
+    assert(leader.get_future().get() == "y");
+    assert(coalesced_results[0].status == RpcStatus::OK && coalesced_results[0].payload == "y");
+    assert(coalesced_results[1].payload == "x");
+    assert(service.calls == 2);
+    std::cout << "testBatchDispatch PASSED" << std::endl;
+}
+
+// method 1  gate _, ÁסΨһĹ; @Ոw
+class GateService : public IService {
+public:
+    explicit GateService(std::shared_future<void> gate) : gate_(std::move(gate)) {}
+    std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+        if (method_id == 1) {
+            gate_.wait();
+        }
+        return request_body;
+    }
+
+private:
+    std::shared_future<void> gate_;
+};
+
+void testSingleflightDeadline() {
+    std::cout << "--- Running testSingleflightDeadline ---" << std::endl;
+    using Clock = SingleflightGroup::Clock;
+    auto now = Clock::now();
+
+    // yԇ1I^^, {ðĽֹrg, ֻ^ڵĵȴյ DEADLINE_EXCEEDED
+    SingleflightGroup group;
+    std::vector<std::pair<RpcStatus, std::string>> got(3);
+    auto record = [&got](size_t i) {
+        return [&got, i](RpcStatus status, std::string payload) { got[i] = { status, std::move(payload) }; };
+    };
+    auto flight = group.join(1, 1, "req", record(0), now + std::chrono::milliseconds(10));
+    assert(flight);
+    assert(!group.join(1, 1, "req", record(1), now + std::chrono::hours(1)));
+    assert(!group.join(1, 1, "req", record(2), now + std::chrono::milliseconds(20)));
+    assert(group.start(flight, now + std::chrono::seconds(1)) == now + std::chrono::hours(1));
+    group.complete(flight, RpcStatus::OK, "result");
+    assert(got[0].first == RpcStatus::DEADLINE_EXCEEDED);
+    assert(got[1].first == RpcStatus::OK && got[1].second == "result");
+    assert(got[2].first == RpcStatus::DEADLINE_EXCEEDED);
+
+    // yԇ2_ʼҽӵĵȴճõY, ͬՈ³ɞI^
+    got.assign(3, {});
+    flight = group.join(1, 1, "req", record(0), now + std::chrono::hours(1));
+    assert(group.start(flight, now) == now + std::chrono::hours(1));
+    assert(!group.join(1, 1, "req", record(1), now + std::chrono::seconds(1)));
+    group.complete(flight, RpcStatus::OK, "late");
+    assert(got[0].second == "late" && got[1].first == RpcStatus::OK && got[1].second == "late");
+    flight = group.join(1, 1, "req", record(2));
+    assert(flight);
+    group.complete(flight, RpcStatus::INTERNAL, "boom");
+    assert(got[2].first == RpcStatus::INTERNAL && got[2].second == "boom");
+
+    // yԇ3 RpcServer ְlr, I^e^ڲB۽ֹrgĹҽ
+    std::promise<void> gate;
+    RpcServer server(1);
+    server.registerService(9, std::make_unique<GateService>(gate.get_future().share()));
+    server.enableSingleflight(9, 2);
+    server.dispatch(9, 1, "", [](RpcStatus, std::string) {});
+
+    std::promise<std::pair<RpcStatus, std::string>> leader;
+    std::promise<std::pair<RpcStatus, std::string>> follower;
+    auto start = MetricsRegistry::Clock::now();
+    server.dispatch(9, 2, "x", [&leader](RpcStatus status, std::string payload) {
+        leader.set_value({ status, std::move(payload) });
+    }, {}, start + std::chrono::milliseconds(10));
+    server.dispatch(9, 2, "x", [&follower](RpcStatus status, std::string payload) {
+        follower.set_value({ status, std::move(payload) });
+    }, {}, start + std::chrono::seconds(30));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gate.set_value();
+
+    auto leader_result = leader.get_future().get();
+    auto follower_result = follower.get_future().get();
+    assert(leader_result.first == RpcStatus::DEADLINE_EXCEEDED);
+    assert(follower_result.first == RpcStatus::OK && follower_result.second == "x");
+    std::cout << "testSingleflightDeadline PASSED" << std::endl;
+}
+
+// ҳ count ڵ shard ƬՈw, Lȶ 7 ֹ; Ƭ㷨c ResponseCache::shardFor ͬ
+static std::vector<std::string> bodiesInShard(size_t shard, size_t count) {
+    std::vector<std::string> bodies;
+    char body[16];
+    for (int i = 0; bodies.size() < count; ++i) {
+        std::snprintf(body, sizeof(body), "key%04d", i);
+        if ((request_hash(1, 1, body) >> 4) % 16 == shard) {
+            bodies.emplace_back(body);
+        }
+    }
+    return bodies;
+}
+
+void testResponseCache() {
+    std::cout << "--- Running testResponseCache ---" << std::endl;
+    std::string payload;
+
+    // yԇ1TTL ᲻, }ͬһՈֻᵽĽY
+    {
+        ResponseCache cache(1024 * 1024);
+        cache.insert(1, 1, "a", "first", std::chrono::milliseconds(50));
+        cache.insert(1, 1, "a", "second", std::chrono::milliseconds(50));
+        assert(cache.size() == 1);
+        assert(cache.lookup(1, 1, "a", payload) && payload == "second");
+        cache.insert(1, 1, "zero", "x", std::chrono::milliseconds(0));
+        assert(!cache.lookup(1, 1, "zero", payload));
+        std::this_thread::sleep_for(std::chrono::milliseconds(80));
+        assert(!cache.lookup(1, 1, "a", payload));
+    }
+
+    // yԇ2ƬֹAr CLOCK ̭, L^ėlĿ^һ݆, ֻFһεėlĿȱ̭
+    {
+        // ÿl 7 + 147 + 96 = 250 ֹ, ÿƬ 1000 ֹ, ǡ÷ 4 l
+        ResponseCache cache(16 * 1000);
+        const std::string value(147, 'v');
+        auto bodies = bodiesInShard(3, 6);
+        for (size_t i = 0; i < 4; ++i) {
+            cache.insert(1, 1, bodies[i], value, std::chrono::hours(1));
+        }
+        assert(cache.size() == 4 && cache.bytes() == 1000);
+        assert(cache.lookup(1, 1, bodies[0], payload));
+
+        cache.insert(1, 1, bodies[4], value, std::chrono::hours(1));
+        assert(cache.size() == 4 && cache.bytes() <= 1000);
+        assert(cache.lookup(1, 1, bodies[0], payload));
+        assert(!cache.lookup(1, 1, bodies[1], payload));
+        assert(cache.lookup(1, 1, bodies[4], payload));
+
+        // Ηl^Ƭr, ҲDЗlĿ
+        cache.insert(1, 1, bodies[5], std::string(2000, 'x'), std::chrono::hours(1));
+        assert(!cache.lookup(1, 1, bodies[5], payload));
+        assert(cache.size() == 4);
+    }
+
+    // yԇ3һƬM̭ӰƬ, ͬͬՈw
+    {
+        ResponseCache cache(16 * 1000);
+        auto other = bodiesInShard(7, 1);
+        cache.insert(1, 1, other[0], "kept", std::chrono::hours(1));
+        auto hot = bodiesInShard(3, 50);
+        for (const auto& body : hot) {
+            cache.insert(1, 1, body, std::string(147, 'v'), std::chrono::hours(1));
+        }
+        assert(cache.lookup(1, 1, other[0], payload) && payload == "kept");
+        assert(!cache.lookup(1, 2, other[0], payload));
+        assert(!cache.lookup(2, 1, other[0], payload));
+        assert(cache.lookup(1, 1, hot.back(), payload));
+        assert(!cache.lookup(1, 1, hot.front(), payload));
+        assert(cache.bytes() <= 16 * 1000);
+    }
+    std::cout << "testResponseCache PASSED" << std::endl;
+}
+
+void testClientCache() {
+    std::cout << "--- Running testClientCache ---" << std::endl;
+
+    // ȵ condition ,  5 
+    auto waitFor = [](auto condition) {
+        for (int i = 0; i < 5000 && !condition(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return condition();
+    };
+
+    // yԇ1ɂͬrδ, ֻһd, һĽY
+    {
+        ClientCache cache;
+        cache.setPolicy(1, { std::chrono::hours(1), std::chrono::milliseconds(0) });
+        std::promise<void> gate;
+        auto gate_future = gate.get_future().share();
+        std::atomic<int> loads{ 0 };
+        auto loader = [&]() {
+            ++loads;
+            gate_future.wait();
+            return std::string("value");
+        };
+        std::string first;
+        std::thread leader([&]() { first = cache.get(1, "k", loader); });
+        assert(waitFor([&]() { return loads.load() == 1; }));
+        std::string second;
+        std::thread follower([&]() { second = cache.get(1, "k", loader); });
+        assert(waitFor([&]() { return cache.stats().coalesced.load() == 1; }));
+        gate.set_value();
+        leader.join();
+        follower.join();
+        assert(first == "value" && second == "value");
+        assert(loads == 1);
+        assert(cache.stats().misses == 1 && cache.stats().coalesced == 1);
+        assert(cache.get(1, "k", loader) == "value" && loads == 1 && cache.stats().hits == 1);
+    }
+
+    // yԇ2lĿ^ڵڃ, {÷ (|lˢµĵһ) ֱfֵ, ̨ˢõֵ
+    {
+        ClientCache cache;
+        cache.setPolicy(1, { std::chrono::milliseconds(20), std::chrono::hours(1) });
+        assert(cache.get(1, "k", []() { return std::string("old"); }) == "old");
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+
+        std::promise<void> gate;
+        auto gate_future = gate.get_future().share();
+        std::atomic<bool> refreshing{ false };
+        std::atomic<int> refresh_loads{ 0 };
+        auto refresh = [&refreshing, &refresh_loads, gate_future]() {
+            ++refresh_loads;
+            refreshing = true;
+            gate_future.wait();
+            return std::string("new");
+        };
+        assert(cache.get(1, "k", refresh) == "old");
+        assert(waitFor([&]() { return refreshing.load(); }));
+        assert(cache.get(1, "k", refresh) == "old");
+        assert(cache.stats().stale_hits == 2 && refresh_loads == 1);
+        gate.set_value();
+        assert(waitFor([&]() { return cache.stats().refreshes.load() == 1; }));
+        bool loaded = false;
+        assert(cache.get(1, "k", [&]() { loaded = true; return std::string("unexpected"); }) == "new");
+        assert(!loaded && refresh_loads == 1);
+    }
+
+    // yԇ3dr, lߺеȴ߶յͬһ, ֮{¼d
+    {
+        ClientCache cache;
+        cache.setPolicy(1, { std::chrono::hours(1), std::chrono::milliseconds(0) });
+        std::promise<void> gate;
+        auto gate_future = gate.get_future().share();
+        std::atomic<int> loads{ 0 };
+        auto failing = [&]() -> std::string {
+            ++loads;
+            gate_future.wait();
+            throw std::runtime_error("load failed");
+        };
+        std::atomic<int> failures{ 0 };
+        auto call = [&]() {
+            try {
+                cache.get(1, "k", failing);
+            }
+            catch (const std::runtime_error& e) {
+                if (std::string(e.what()) == "load failed") {
+                    ++failures;
+                }
+            }
+        };
+        std::thread leader(call);
+        assert(waitFor([&]() { return loads.load() == 1; }));
+        std::vector<std::thread> waiters;
+        for (int i = 0; i < 3; ++i) {
+            waiters.emplace_back(call);
+        }
+        assert(waitFor([&]() { return cache.stats().coalesced.load() == 3; }));
+        gate.set_value();
+        leader.join();
+        for (auto& waiter : waiters) {
+            waiter.join();
+        }
+        assert(failures == 4 && loads == 1);
+        assert(cache.get(1, "k", []() { return std::string("ok"); }) == "ok");
+
+        // ̨ˢʧr{÷Ӱ, fֵ, һ{÷ٴ|lˢ
+        ClientCache stale;
+        stale.setPolicy(1, { std::chrono::milliseconds(20), std::chrono::hours(1) });
+        stale.get(1, "k", []() { return std::string("old"); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        assert(stale.get(1, "k", []() -> std::string { throw std::runtime_error("refresh failed"); }) == "old");
+        assert(waitFor([&]() { return stale.stats().refresh_failures.load() == 1; }));
+        assert(stale.get(1, "k", []() { return std::string("new"); }) == "old");
+        assert(waitFor([&]() { return stale.stats().refreshes.load() == 1; }));
+        assert(stale.get(1, "k", []() { return std::string("unexpected"); }) == "new");
+    }
+    std::cout << "testClientCache PASSED" << std::endl;
+}
+
+void testSerialQueue() {
+    std::cout << "--- Running testSerialQueue ---" << std::endl;
+    ThreadPool pool(4);
+
+    // yԇ1ͬһе΄հύ, دB; ^һε΄ՔҲG
+    auto queue = std::make_shared<SerialQueue>(pool);
+    std::vector<int> order;
+    std::atomic<int> running{ 0 };
+    bool overlapped = false;
+    std::promise<void> done;
+    const int kTasks = 1000;
+    for (int i = 0; i < kTasks; ++i) {
+        queue->post([&, i]() {
+            if (running.fetch_add(1) != 0) {
+                overlapped = true;
+            }
+            order.push_back(i);
+            running.fetch_sub(1);
+            if (i == kTasks - 1) {
+                done.set_value();
+            }
+        });
+    }
+    done.get_future().wait();
+    assert(!overlapped);
+    assert(order.size() == static_cast<size_t>(kTasks));
+    for (int i = 0; i < kTasks; ++i) {
+        assert(order[i] == i);
+    }
+
+    // yԇ2һϵL΄ֻtԼ΄, ճڄeĹψ
+    std::promise<void> gate;
+    auto gate_future = gate.get_future().share();
+    auto slow = std::make_shared<SerialQueue>(pool);
+    auto fast = std::make_shared<SerialQueue>(pool);
+    std::atomic<bool> slow_second_ran{ false };
+    slow->post([gate_future]() { gate_future.wait(); });
+    slow->post([&slow_second_ran]() { slow_second_ran = true; });
+    std::promise<void> fast_done;
+    fast->post([]() {});
+    fast->post([&fast_done]() { fast_done.set_value(); });
+    assert(fast_done.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    assert(!slow_second_ran);
+
+    // yԇ3΄ղД
+    std::promise<void> after_throw;
+    slow->post([]() { throw std::runtime_error("boom"); });
+    slow->post([&after_throw]() { after_throw.set_value(); });
+    gate.set_value();
+    assert(after_throw.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    assert(slow_second_ran);
+
+    // yԇ4postTo Ŀ˾̿fr
+    auto postedOn = [&pool](size_t worker) {
+        auto ran_on = std::make_shared<std::promise<std::thread::id>>();
+        auto future = ran_on->get_future();
+        pool.postTo(worker, [ran_on]() { ran_on->set_value(std::this_thread::get_id()); });
+        return future.get();
+    };
+    auto preferred_id = postedOn(2);
+    for (int i = 0; i < 20; ++i) {
+        assert(postedOn(2) == preferred_id);
+    }
+    assert(postedOn(2 + pool.size()) == preferred_id);
+
+    // yԇ5ָȾ̵׃, ̳ؿfrڃȾψ
+    auto preferred = std::make_shared<SerialQueue>(pool, 2);
+    std::vector<std::thread::id> preferred_threads;
+    std::vector<int> preferred_order;
+    std::promise<void> preferred_done;
+    for (int i = 0; i < 100; ++i) {
+        preferred->post([&, i]() {
+            preferred_threads.push_back(std::this_thread::get_id());
+            preferred_order.push_back(i);
+            if (i == 99) {
+                preferred_done.set_value();
+            }
+        });
+    }
+    assert(preferred_done.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    for (int i = 0; i < 100; ++i) {
+        assert(preferred_order[i] == i);
+    }
+    assert(std::count(preferred_threads.begin(), preferred_threads.end(), preferred_id) >= 50);
+
+    // yԇ6ɂԒͬһ, һlrһl kStealAfter Qeľ̈
+    ThreadPool pair_pool(2);
+    auto blocked = std::make_shared<SerialQueue>(pair_pool, 0);
+    auto neighbour = std::make_shared<SerialQueue>(pair_pool, 0);
+    std::promise<void> release;
+    auto release_future = release.get_future().share();
+    std::promise<std::thread::id> blocked_started;
+    blocked->post([&blocked_started, release_future]() {
+        blocked_started.set_value(std::this_thread::get_id());
+        release_future.wait();
+    });
+    auto blocked_thread = blocked_started.get_future().get();
+
+    std::promise<std::thread::id> neighbour_ran;
+    auto neighbour_future = neighbour_ran.get_future();
+    neighbour->post([&neighbour_ran]() { neighbour_ran.set_value(std::this_thread::get_id()); });
+    assert(neighbour_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+    assert(neighbour_future.get() != blocked_thread);
+    release.set_value();
+    std::cout << "testSerialQueue PASSED" << std::endl;
+}
+
+void testStreamTable() {
+    std::cout << "--- Running testStreamTable ---" << std::endl;
+    StreamTable table;
+
+    // yԇ1_P]_; _ͬһλIDͬ, fID鲻
+    StreamState* first = table.open();
+    assert(first && first->stream_id != 0 && table.size() == 1);
+    const uint32_t first_id = first->stream_id;
+    assert(table.find(first_id) == first);
+    table.messages(*first).push_back("buffered");
+    assert(table.close(first_id) && table.size() == 0);
+    assert(!table.close(first_id) && !table.find(first_id));
+
+    StreamState* reopened = table.open();
+    assert(reopened && reopened->stream_id != first_id);
+    assert((reopened->stream_id & StreamTable::kIndexMask) == (first_id & StreamTable::kIndexMask));
+    assert(table.messages(*reopened).empty() && !table.executor(*reopened));
+    assert(!table.find(first_id) && table.find(reopened->stream_id) == reopened);
+    assert(!table.find(0) && !table.find(StreamTable::kIndexMask));
+    const uint32_t reopened_id = reopened->stream_id;
+    assert(table.close(reopened_id));
+
+    // yԇ2̖@: ͬһλ͏, IDĲ 0, ҲһλԴ_;
+    //  65536 ̖صԭֵ, fIDٴ (^ļ]f)
+    StreamState* live = table.open();
+    const uint32_t live_id = live->stream_id;
+    StreamState* cycling = table.open();
+    const uint32_t cycling_index = cycling->stream_id & StreamTable::kIndexMask;
+    const uint32_t stale_id = cycling->stream_id;
+    assert(cycling_index != (live_id & StreamTable::kIndexMask));
+    for (uint32_t reuse = 1; reuse <= (1u << 16); ++reuse) {
+        assert(table.close(cycling->stream_id));
+        cycling = table.open();
+        assert(cycling->stream_id != 0 && cycling->stream_id != live_id);
+        assert((cycling->stream_id & StreamTable::kIndexMask) == cycling_index);
+        if (reuse < (1u << 16)) {
+            assert(!table.find(stale_id));
+        }
+        assert(table.find(live_id) && table.find(live_id)->stream_id == live_id);
+    }
+    assert(cycling->stream_id == stale_id && table.find(stale_id) == cycling);
+    assert(table.close(cycling->stream_id) && table.close(live_id) && table.size() == 0);
+
+    // yԇ3λñMr open  nullptr, P]һlܴ_
+    std::vector<uint32_t> ids;
+    for (size_t i = 0; i < StreamTable::kMaxStreams; ++i) {
+        StreamState* state = table.open();
+        assert(state);
+        ids.push_back(state->stream_id);
+    }
+    assert(table.size() == StreamTable::kMaxStreams);
+    assert(!table.open());
+    assert(table.close(ids[100]));
+    StreamState* refill = table.open();
+    assert(refill && refill->stream_id != ids[100]);
+    assert(!table.open());
+    std::cout << "testStreamTable PASSED" << std::endl;
+}
+
+// ͻ: Ո푑ǶL POD Ϣ
+struct PairRequest {
+    int32_t a;
+    int32_t b;
+    static constexpr auto kPodFields = std::make_tuple(&PairRequest::a, &PairRequest::b);
+};
+
+struct ValueResponse {
+    int64_t value;
+    static constexpr auto kPodFields = std::make_tuple(&ValueResponse::value);
+};
+
+struct TypedCalc {
+    static constexpr std::string_view kName = "TypedCalc";
+    using Add = RpcMethod<"Add", PairRequest, ValueResponse>;
+    using Divide = RpcMethod<"Divide", PairRequest, ValueResponse>;
+    using Methods = MethodList<Add, Divide>;
+};
+
+struct TypedCalcImpl {
+    ValueResponse handle(TypedCalc::Add, const PairRequest& request) {
+        return { int64_t{ request.a } + request.b };
+    }
+    ValueResponse handle(TypedCalc::Divide, const PairRequest& request) {
+        if (request.b == 0) {
+            throw RpcStatusException(RpcStatus::INVALID_ARGUMENT, "divide by zero");
+        }
+        return { request.a / request.b };
+    }
+};
+
+static std::pair<RpcStatus, std::string> dispatchAndWait(RpcServer& server, uint32_t service_id, uint32_t method_id, std::string body) {
+    std::promise<std::pair<RpcStatus, std::string>> done;
+    auto future = done.get_future();
+    server.dispatch(service_id, method_id, std::move(body), [&done](RpcStatus status, std::string payload) {
+        done.set_value({ status, std::move(payload) });
+    });
+    return future.get();
+}
+
+void testTypedServiceAdapter() {
+    std::cout << "--- Running testTypedServiceAdapter ---" << std::endl;
+    static_assert(service_id_v<TypedCalc> == fnv1a("TypedCalc"));
+    static_assert(TypedCalc::Add::kId == fnv1a("Add"));
+
+    RpcServer server(1);
+    server.registerService<TypedCalc>(std::make_unique<TypedCalcImpl>());
+    const uint32_t service_id = service_id_v<TypedCalc>;
+    IService* service = server.getService(service_id);
+    assert(service);
+    assert(service->hasMethod(TypedCalc::Add::kId) && service->hasMethod(TypedCalc::Divide::kId));
+    assert(!service->hasMethod(fnv1a("Multiply")));
+
+    std::string request;
+    assert(encode_message(PairRequest{ 40, 2 }, request));
+
+    // yԇ1IDְl handle d, 푑푑;a
+    auto [status, body] = dispatchAndWait(server, service_id, TypedCalc::Add::kId, request);
+    ValueResponse response{};
+    assert(status == RpcStatus::OK && decode_message(body, response) && response.value == 42);
+    std::tie(status, body) = dispatchAndWait(server, service_id, TypedCalc::Divide::kId, request);
+    assert(status == RpcStatus::OK && decode_message(body, response) && response.value == 20);
+
+    // yԇ2δxķ METHOD_NOT_FOUND
+    std::tie(status, body) = dispatchAndWait(server, service_id, fnv1a("Multiply"), request);
+    assert(status == RpcStatus::METHOD_NOT_FOUND);
+    try {
+        service->callMethod(fnv1a("Multiply"), request);
+        assert(false);
+    }
+    catch (const RpcStatusException& e) {
+        assert(e.status() == RpcStatus::METHOD_NOT_FOUND);
+    }
+
+    // yԇ3̎ RpcStatusException ԭӳɠBe`, aʧ INVALID_ARGUMENT
+    std::string zero;
+    assert(encode_message(PairRequest{ 1, 0 }, zero));
+    std::tie(status, body) = dispatchAndWait(server, service_id, TypedCalc::Divide::kId, zero);
+    assert(status == RpcStatus::INVALID_ARGUMENT && body == "divide by zero");
+    std::tie(status, body) = dispatchAndWait(server, service_id, TypedCalc::Add::kId, "short");
+    assert(status == RpcStatus::INVALID_ARGUMENT && body == "failed to parse request");
+    std::cout << "testTypedServiceAdapter PASSED" << std::endl;
+}
+
+// ։KյĜyԇ̎: gate _֮ǰÿKڹ
+class GatedUpload : public ChunkedRequest {
+public:
+    GatedUpload(std::shared_future<void> gate, std::atomic<size_t>& received) : gate_(std::move(gate)), received_(received) {}
+    void onChunk(std::string_view chunk) override {
+        gate_.wait();
+        for (unsigned char c : chunk) {
+            sum_ += c;
+        }
+        total_ += chunk.size();
+        received_ += chunk.size();
+    }
+    std::string finish() override { return std::to_string(total_) + " " + std::to_string(sum_); }
+
+private:
+    std::shared_future<void> gate_;
+    std::atomic<size_t>& received_;
+    size_t total_ = 0;
+    uint64_t sum_ = 0;
+};
+
+// method 1 ַ֧։K, method 2 ֻ
+class UploadService : public IService {
+public:
+    explicit UploadService(std::shared_future<void> gate) : gate_(std::move(gate)) {}
+    bool hasMethod(uint32_t method_id) override { return method_id == 1 || method_id == 2; }
+    std::string callMethod(uint32_t, const std::string& request_body) override {
+        return "buffered " + std::to_string(request_body.size());
+    }
+    std::unique_ptr<ChunkedRequest> openChunkedRequest(uint32_t method_id, size_t) override {
+        return method_id == 1 ? std::make_unique<GatedUpload>(gate_, received) : nullptr;
+    }
+
+    std::atomic<size_t> received{ 0 };
+
+private:
+    std::shared_future<void> gate_;
+};
+
+static std::string makeRequestFrame(uint32_t service_id, uint32_t method_id, uint32_t request_id,
+                                    std::string_view body, uint32_t declared_size = 0) {
+    RpcHeader header{};
+    header.message_size = declared_size ? declared_size : static_cast<uint32_t>(sizeof(RpcHeader) + body.size());
+    header.service_id = service_id;
+    header.method_id = method_id;
+    header.request_id = request_id;
+    header.message_type = static_cast<uint8_t>(MessageType::REQUEST);
+    std::string frame(sizeof(RpcHeader), '\0');
+    encode_header(header, frame.data());
+    frame.append(body);
+    return frame;
+}
+
+template <typename Socket>
+static std::pair<RpcHeader, std::string> readReply(Socket& socket) {
+    char wire[sizeof(RpcHeader)];
+    boost::asio::read(socket, boost::asio::buffer(wire));
+    RpcHeader header{};
+    assert(decode_header({ wire, sizeof(wire) }, header) == HeaderStatus::OK);
+    std::string payload(header.message_size - sizeof(RpcHeader), '\0');
+    boost::asio::read(socket, boost::asio::buffer(payload));
+    return { header, payload };
+}
+
+void testMessageLimits() {
+    std::cout << "--- Running testMessageLimits ---" << std::endl;
+    constexpr uint32_t kService = 44;
+    std::promise<void> gate;
+    RpcServer server(2);
+    auto service = std::make_unique<UploadService>(gate.get_future().share());
+    UploadService& upload = *service;
+    server.registerService(kService, std::move(service));
+    server.setMessageLimits(kService, { .max_message_size = 16u << 20, .chunk_threshold = 1024 });
+    server.setMessageLimits(kService + 1, { .max_message_size = 4096 });
+    server.registerService(kService + 1, std::make_unique<UploadService>(std::shared_future<void>()));
+
+    boost::asio::io_context ioc;
+    boost::asio::io_context client_ioc;
+    boost::asio::local::stream_protocol::socket server_socket(ioc);
+    boost::asio::local::stream_protocol::socket client(client_ioc);
+    boost::asio::local::connect_pair(server_socket, client);
+    TimerWheel wheel;
+    std::make_shared<Session>(Session::socket_type(std::move(server_socket)), server, wheel) -> start();
+    auto guard = boost::asio::make_work_guard(ioc);
+    std::thread io_thread([&ioc]() { ioc.run(); });
+    const std::string capture_path = "message_limits_test.cap";
+    auto& capture = TrafficCapture::instance();
+    assert(capture.open(capture_path));
+
+    // yԇ1^Lȳ^, Ϣw߀]lյ RESOURCE_EXHAUSTED
+    const uint32_t oversized = 100 * 1024;
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService + 1, 2, 1, "", oversized)));
+    auto [header, payload] = readReply(client);
+    assert(header.request_id == 1);
+    assert(static_cast<RpcStatus>(header.reserved) == RpcStatus::RESOURCE_EXHAUSTED && payload == "message too large");
+
+    // yԇ2ގϢw_ᱻG, BϵһՈճ̎
+    boost::asio::write(client, boost::asio::buffer(std::string(oversized - sizeof(RpcHeader), 'x')));
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService + 1, 2, 2, "abc")));
+    std::tie(header, payload) = readReply(client);
+    assert(header.request_id == 2 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK && payload == "buffered 3");
+
+    // yԇ3^։Kֵַ֧։Kr
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService, 2, 3, std::string(5000, 'y'))));
+    std::tie(header, payload) = readReply(client);
+    assert(header.request_id == 3 && payload == "buffered 5000");
+
+    // yԇ4̎סre 4MiB Ԓͣx, ˌMȥ; ̎֏x֏, ՈR
+    const size_t body_size = 12u << 20;
+    std::string body(body_size, '\0');
+    uint64_t expected_sum = 0;
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>(i % 251);
+        expected_sum += static_cast<unsigned char>(body[i]);
+    }
+    std::string frame = makeRequestFrame(kService, 1, 4, body);
+    std::atomic<size_t> written{ 0 };
+    std::thread writer([&]() {
+        for (size_t offset = 0; offset < frame.size(); offset += 64 * 1024) {
+            size_t length = std::min<size_t>(64 * 1024, frame.size() - offset);
+            boost::asio::write(client, boost::asio::buffer(frame.data() + offset, length));
+            written += length;
+        }
+    });
+
+    size_t last = 0;
+    for (int stable = 0; stable < 5;) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        size_t now = written.load();
+        stable = now == last ? stable + 1 : 0;
+        last = now;
+    }
+    assert(upload.received == 0);
+    assert(last >= (4u << 20));
+    assert(last < body_size);
+
+    gate.set_value();
+    std::tie(header, payload) = readReply(client);
+    writer.join();
+    assert(header.request_id == 4 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK);
+    assert(payload == std::to_string(body_size) + " " + std::to_string(expected_sum));
+    assert(upload.received == body_size);
+
+    // yԇ5ގͷ։KյՈ]ӛ, ץֻӋ; Ոճӛ
+    assert(capture.skippedFrames() == 2);
+    assert(capture.skippedBytes() == oversized + frame.size());
+    capture.close();
+    std::remove(capture_path.c_str());
+
+    client.close();
+    guard.reset();
+    ioc.stop();
+    io_thread.join();
+    std::cout << "testMessageLimits PASSED" << std::endl;
+}
+
+static std::string sealFrame(const std::string& frame) {
+    Buffer buffer;
+    buffer.append(frame);
+    append_checksum(buffer);
+    return std::string(buffer.peek(), buffer.readableBytes());
+}
+
+// xһlظKУȥβ, زβ^ payload
+static std::pair<RpcHeader, std::string> readSealedReply(boost::asio::local::stream_protocol::socket& socket) {
+    auto [header, payload] = readReply(socket);
+    std::string frame(sizeof(RpcHeader), '\0');
+    encode_header(header, frame.data());
+    Buffer buffer;
+    buffer.append(frame + payload);
+    assert(strip_checksum(buffer, true));
+    RpcHeader stripped{};
+    assert(deserialize_header(buffer, stripped));
+    buffer.retrieve(sizeof(RpcHeader));
+    return { stripped, buffer.retrieveAllAsString() };
+}
+
+// ؃ȴ^gķ: Ոwǅ^gL, ӛÿ owner , Á_J^gڰlʹ_J֮ᱻጷ
+class MemoryBlobService : public IService {
+public:
+    MethodType getMethodType(uint32_t) override { return MethodType::BLOB_RESPONSE; }
+    std::string callMethod(uint32_t, const std::string&) override { return ""; }
+    BlobResponse callBlobMethod(uint32_t, const std::string& request_body) override {
+        auto owner = std::make_shared<std::string>(expected(std::stoul(request_body)));
+        std::lock_guard<std::mutex> lock(mutex_);
+        owners_.push_back(owner);
+        return BlobResponse::fromMemory(owner, owner -> data(), owner -> size());
+    }
+
+    static std::string expected(size_t size) {
+        std::string data(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<char>(i * 13 + (i >> 11));
+        }
+        return data;
+    }
+
+    // ȵЅ^gԒጷ, r false
+    bool waitReleased(std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (std::all_of(owners_.begin(), owners_.end(), [](const auto& owner) { return owner.expired(); })) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::weak_ptr<const std::string>> owners_;
+};
+
+void testBlobZeroCopy() {
+    std::cout << "--- Running testBlobZeroCopy ---" << std::endl;
+    constexpr uint32_t kService = 46;
+    RpcServer server(2);
+    auto service = std::make_unique<MemoryBlobService>();
+    MemoryBlobService& blobs = *service;
+    server.registerService(kService, std::move(service));
+
+    boost::asio::io_context ioc;
+    boost::asio::io_context client_ioc;
+    boost::asio::ip::tcp::acceptor acceptor(ioc, { boost::asio::ip::make_address("127.0.0.1"), 0 });
+    boost::asio::ip::tcp::socket client(client_ioc);
+    client.connect(acceptor.local_endpoint());
+    boost::asio::ip::tcp::socket tcp_server = acceptor.accept();
+    boost::asio::local::stream_protocol::socket unix_server(ioc);
+    boost::asio::local::stream_protocol::socket unix_client(client_ioc);
+    boost::asio::local::connect_pair(unix_server, unix_client);
+    TimerWheel wheel;
+    std::make_shared<Session>(Session::socket_type(std::move(tcp_server)), server, wheel) -> start();
+    std::make_shared<Session>(Session::socket_type(std::move(unix_server)), server, wheel) -> start();
+    auto guard = boost::asio::make_work_guard(ioc);
+    std::thread io_thread([&ioc]() { ioc.run(); });
+
+    // yԇ1TCP ϵĴ^g MSG_ZEROCOPY, ; ֪ͨȡB߀_^gͱጷ
+    const size_t large = 1u << 20;
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService, 1, 1, std::to_string(large))));
+    auto [header, payload] = readReply(client);
+    assert(header.request_id == 1 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK);
+    assert(payload == MemoryBlobService::expected(large));
+    assert(blobs.waitReleased(std::chrono::seconds(5)));
+
+    // yԇ2حhσȺ˻˿ؐ, ֮ą^gͨ, ͬһBϵ푑ճ
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService, 1, 2, std::to_string(large))));
+    std::tie(header, payload) = readReply(client);
+    assert(header.request_id == 2 && payload == MemoryBlobService::expected(large));
+
+    // yԇ3ֵС^gֱӌ
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService, 1, 3, "1000")));
+    std::tie(header, payload) = readReply(client);
+    assert(header.request_id == 3 && payload == MemoryBlobService::expected(1000));
+
+    // yԇ4Unix  socket ֧ SO_ZEROCOPY, ˻ͨ
+    boost::asio::write(unix_client, boost::asio::buffer(makeRequestFrame(kService, 1, 4, std::to_string(large))));
+    std::tie(header, payload) = readReply(unix_client);
+    assert(header.request_id == 4 && payload == MemoryBlobService::expected(large));
+    assert(blobs.waitReleased(std::chrono::seconds(5)));
+
+    client.close();
+    unix_client.close();
+    guard.reset();
+    ioc.stop();
+    io_thread.join();
+    std::cout << "testBlobZeroCopy PASSED" << std::endl;
+}
+
+void testSessionChecksum() {
+    std::cout << "--- Running testSessionChecksum ---" << std::endl;
+    constexpr uint32_t kService = 45;
+    std::promise<void> gate;
+    gate.set_value();
+    RpcServer server(2);
+    server.registerService(kService, std::make_unique<UploadService>(gate.get_future().share()));
+    server.setMessageLimits(kService, { .max_message_size = 16u << 20, .chunk_threshold = 1024 });
+
+    boost::asio::io_context ioc;
+    boost::asio::io_context client_ioc;
+    boost::asio::local::stream_protocol::socket server_socket(ioc);
+    boost::asio::local::stream_protocol::socket client(client_ioc);
+    boost::asio::local::connect_pair(server_socket, client);
+    TimerWheel wheel;
+    std::make_shared<Session>(Session::socket_type(std::move(server_socket)), server, wheel) -> start();
+    auto guard = boost::asio::make_work_guard(ioc);
+    std::thread io_thread([&ioc]() { ioc.run(); });
+
+    // yԇ1β PING _У, PONG Iβw^
+    RpcHeader ping{};
+    ping.message_size = sizeof(RpcHeader);
+    ping.request_id = 1;
+    ping.message_type = static_cast<uint8_t>(MessageType::PING);
+    std::string ping_frame(sizeof(RpcHeader), '\0');
+    encode_header(ping, ping_frame.data());
+    boost::asio::write(client, boost::asio::buffer(sealFrame(ping_frame)));
+    auto [header, payload] = readSealedReply(client);
+    assert(header.request_id == 1 && header.message_type == static_cast<uint8_t>(MessageType::PONG));
+
+    // yԇ2fᎧβՈ̎, ظͬӎβ
+    boost::asio::write(client, boost::asio::buffer(sealFrame(makeRequestFrame(kService, 2, 2, "abc"))));
+    std::tie(header, payload) = readSealedReply(client);
+    assert(header.request_id == 2 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK && payload == "buffered 3");
+
+    // yԇ3f᲻βĎp̎
+    boost::asio::write(client, boost::asio::buffer(makeRequestFrame(kService, 2, 3, "abc")));
+    std::tie(header, payload) = readSealedReply(client);
+    assert(header.request_id == 3 && static_cast<RpcStatus>(header.reserved) == RpcStatus::DATA_LOSS && payload == "checksum required");
+
+    // yԇ4⎬^ method_id Ą, Уʧ
+    std::string sealed = sealFrame(makeRequestFrame(kService, 2, 4, "abc"));
+    sealed[offsetof(RpcHeader, method_id) + 3] ^= 0x01;
+    boost::asio::write(client, boost::asio::buffer(sealed));
+    std::tie(header, payload) = readSealedReply(client);
+    assert(header.request_id == 4 && static_cast<RpcStatus>(header.reserved) == RpcStatus::DATA_LOSS && payload == "checksum mismatch");
+
+    // yԇ5։KյՈ^_ʼӋУ
+    std::string body(5000, 'z');
+    boost::asio::write(client, boost::asio::buffer(sealFrame(makeRequestFrame(kService, 1, 5, body))));
+    std::tie(header, payload) = readSealedReply(client);
+    assert(header.request_id == 5 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK);
+    assert(payload == "5000 " + std::to_string(5000 * static_cast<uint64_t>('z')));
+
+    client.close();
+    guard.reset();
+    ioc.stop();
+    io_thread.join();
+    std::cout << "testSessionChecksum PASSED" << std::endl;
+}
+
+void testCaptureReplayChecksum() {
+    std::cout << "--- Running testCaptureReplayChecksum ---" << std::endl;
+    constexpr uint32_t kService = 46;
+    const std::string path = "capture_replay_test.cap";
+    std::promise<void> gate;
+    gate.set_value();
+    RpcServer server(2);
+    server.registerService(kService, std::make_unique<UploadService>(gate.get_future().share()));
+
+    boost::asio::io_context ioc;
+    boost::asio::io_context client_ioc;
+    boost::asio::local::stream_protocol::socket sealed_server(ioc);
+    boost::asio::local::stream_protocol::socket sealed_client(client_ioc);
+    boost::asio::local::connect_pair(sealed_server, sealed_client);
+    boost::asio::local::stream_protocol::socket replay_server(ioc);
+    boost::asio::local::stream_protocol::socket replay_client(client_ioc);
+    boost::asio::local::connect_pair(replay_server, replay_client);
+    TimerWheel wheel;
+    std::make_shared<Session>(Session::socket_type(std::move(sealed_server)), server, wheel) -> start();
+    std::make_shared<Session>(Session::socket_type(std::move(replay_server)), server, wheel) -> start();
+    auto guard = boost::asio::make_work_guard(ioc);
+    std::thread io_thread([&ioc]() { ioc.run(); });
+
+    // yԇ1_УBץՈ, ӛ䛕rȥβK CHECKSUM I
+    auto& capture = TrafficCapture::instance();
+    assert(capture.open(path));
+    RpcHeader ping{};
+    ping.message_size = sizeof(RpcHeader);
+    ping.request_id = 1;
+    ping.message_type = static_cast<uint8_t>(MessageType::PING);
+    std::string ping_frame(sizeof(RpcHeader), '\0');
+    encode_header(ping, ping_frame.data());
+    boost::asio::write(sealed_client, boost::asio::buffer(sealFrame(ping_frame)));
+    readSealedReply(sealed_client);
+    boost::asio::write(sealed_client, boost::asio::buffer(sealFrame(makeRequestFrame(kService, 2, 2, "abc"))));
+    auto [header, payload] = readSealedReply(sealed_client);
+    assert(header.request_id == 2 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK);
+    capture.close();
+
+    std::string data;
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        assert(file);
+        char chunk[4096];
+        size_t n;
+        while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+            data.append(chunk, n);
+        }
+        std::fclose(file);
+    }
+    std::remove(path.c_str());
+    CaptureReader reader({ data.data(), data.size() });
+    assert(reader.valid());
+    CaptureRecord record{};
+    std::optional<CaptureRecord> request;
+    while (reader.next(record)) {
+        RpcHeader recorded{};
+        deserialize_header(record.frame, recorded);
+        if (recorded.message_type == static_cast<uint8_t>(MessageType::REQUEST)) {
+            assert(!request);
+            assert(!(recorded.flags & Flag::CHECKSUM));
+            assert(recorded.message_size == record.frame.size() && record.frame.size() == sizeof(RpcHeader) + 3);
+            request = record;
+        }
+    }
+    assert(request);
+
+    // yԇ2Č request_id ڛ]ЅfУBϻط, ̎
+    char replay_header[sizeof(RpcHeader)];
+    auto replay_payload = prepare_replay_frame(request->frame, 9, replay_header);
+    boost::asio::write(replay_client, std::array<boost::asio::const_buffer, 2>{
+        boost::asio::buffer(replay_header), boost::asio::buffer(replay_payload.data(), replay_payload.size()) });
+    std::tie(header, payload) = readReply(replay_client);
+    assert(header.request_id == 9 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK && payload == "buffered 3");
+
+    // yԇ3fץļeβĎ, طŕrȥβ,  request_id ČУʧ
+    std::string sealed = sealFrame(makeRequestFrame(kService, 2, 3, "abcd"));
+    replay_payload = prepare_replay_frame({ sealed.data(), sealed.size() }, 10, replay_header);
+    RpcHeader rewritten{};
+    assert(decode_header({ replay_header, sizeof(replay_header) }, rewritten) == HeaderStatus::OK);
+    assert(!(rewritten.flags & Flag::CHECKSUM) && rewritten.message_size == sizeof(RpcHeader) + 4 && replay_payload.size() == 4);
+    boost::asio::write(replay_client, std::array<boost::asio::const_buffer, 2>{
+        boost::asio::buffer(replay_header), boost::asio::buffer(replay_payload.data(), replay_payload.size()) });
+    std::tie(header, payload) = readReply(replay_client);
+    assert(header.request_id == 10 && static_cast<RpcStatus>(header.reserved) == RpcStatus::OK && payload == "buffered 4");
+
+    sealed_client.close();
+    replay_client.close();
+    guard.reset();
+    ioc.stop();
+    io_thread.join();
+    std::cout << "testCaptureReplayChecksum PASSED" << std::endl;
+}
+
+void testTraceIds() {
+    std::cout << "--- Running testTraceIds ---" << std::endl;
+    auto& tracer = Tracer::instance();
+
+    // yԇ1trace_id SC,  1 _ʼf, ȡģӲͬһN
+    std::set<uint64_t> trace_ids;
+    size_t sampled = 0;
+    for (int i = 0; i < 1000; ++i) {
+        uint64_t id = tracer.newTraceId();
+        assert(id != 0);
+        trace_ids.insert(id);
+        sampled += id % 100 == 0;
+    }
+    assert(trace_ids.size() == 1000);
+    assert(*trace_ids.begin() > 1000);
+    assert(sampled < 100);
+
+    // yԇ2span ID ڶ֮g}
+    std::vector<uint64_t> spans[4];
+    std::vector<std::thread> threads;
+    for (auto& ids : spans) {
+        threads.emplace_back([&tracer, &ids]() {
+            for (int i = 0; i < 1000; ++i) {
+                ids.push_back(tracer.newSpanId());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::set<uint64_t> span_ids;
+    for (auto& ids : spans) {
+        span_ids.insert(ids.begin(), ids.end());
+    }
+    assert(span_ids.size() == 4000 && !span_ids.count(0));
+    std::cout << "testTraceIds PASSED" << std::endl;
+}
+
+void testTimerWheel() {
+    std::cout << "--- Running testTimerWheel ---" << std::endl;
+    using Clock = TimerWheel::Clock;
+    using std::chrono::milliseconds;
+    using std::chrono::microseconds;
+    const Clock::time_point origin{};
+
+    // yԇ1Խ 0  (256 tick) ͵ 1  (16384 tick) ߅Ķr tick Mrʕr|l
+    {
+        TimerWheel wheel(milliseconds(1), origin);
+        wheel.advance(origin + milliseconds(199));
+        const uint64_t start = 200;
+        const std::vector<uint64_t> delays = { 1, 55, 56, 57, 255, 256, 257, 311, 16183, 16184, 16185, 16384, 16385, 20000, 1048576 + 5 };
+        std::vector<uint64_t> fired(delays.size(), 0);
+        for (size_t i = 0; i < delays.size(); ++i) {
+            wheel.schedule(milliseconds(delays[i]), [&wheel, &fired, i]() {
+                fired[i] = static_cast<uint64_t>((wheel.now() - wheel.tick()).time_since_epoch() / wheel.tick());
+            });
+        }
+        for (uint64_t tick = start; wheel.size() > 0; ++tick) {
+            wheel.advance(origin + milliseconds(tick));
+        }
+        for (size_t i = 0; i < delays.size(); ++i) {
+            assert(fired[i] == start + delays[i]);
+        }
+    }
+
+    // yԇ2{eȡͬһr͸ߌӵĶr, ȡĲ|l
+    {
+        TimerWheel wheel(milliseconds(1), origin);
+        int fired = 0;
+        bool cancelled_peer = false;
+        TimerWheel::TimerId first, second, far;
+        far = wheel.schedule(milliseconds(20000), [&fired]() { ++fired; });
+        first = wheel.schedule(milliseconds(300), [&]() {
+            ++fired;
+            cancelled_peer = wheel.cancel(second);
+            assert(wheel.cancel(far));
+        });
+        second = wheel.schedule(milliseconds(300), [&]() {
+            ++fired;
+            cancelled_peer = wheel.cancel(first);
+            assert(wheel.cancel(far));
+        });
+        wheel.advance(origin + milliseconds(30000));
+        assert(fired == 1 && cancelled_peer);
+        assert(!wheel.pending(first) && !wheel.pending(second) && !wheel.pending(far));
+        assert(wheel.size() == 0);
+
+        // {eȡԼǿղ
+        TimerWheel::TimerId self;
+        self = wheel.schedule(milliseconds(5), [&]() { assert(!wheel.cancel(self)); });
+        wheel.advance(origin + milliseconds(30010));
+        assert(wheel.size() == 0);
+    }
+
+    // yԇ3{e¼ӵĶrM tick, tһ̎ tick 
+    {
+        TimerWheel wheel(milliseconds(1), origin);
+        uint64_t outer_tick = 0, next_tick = 0, later_tick = 0;
+        auto tickOf = [&wheel]() {
+            return static_cast<uint64_t>((wheel.now() - wheel.tick()).time_since_epoch() / wheel.tick());
+        };
+        wheel.schedule(milliseconds(10), [&]() {
+            outer_tick = tickOf();
+            wheel.schedule(milliseconds(0), [&]() { next_tick = tickOf(); });
+            wheel.schedule(milliseconds(300), [&]() { later_tick = tickOf(); });
+        });
+        wheel.advance(origin + milliseconds(10));
+        assert(outer_tick == 10 && next_tick == 0);
+        // {Еr tick 10 ѽ^ȥ, 0 tȡһ tick,  tick 12 |l
+        wheel.advance(origin + milliseconds(11));
+        assert(next_tick == 0);
+        wheel.advance(origin + milliseconds(12));
+        assert(next_tick == 12);
+        wheel.advance(origin + milliseconds(2000));
+        assert(later_tick >= outer_tick + 300 && later_tick <= outer_tick + 302);
+    }
+
+    // yԇ4rgcR tick, SMrrĲǰ, ɂ tick
+    {
+        TimerWheel wheel(milliseconds(1), origin);
+        uint64_t seed = 12345;
+        auto next = [&seed](uint64_t bound) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            return (seed >> 33) % bound;
+        };
+        Clock::time_point now = origin + microseconds(next(1000));
+        wheel.advance(now);
+        size_t scheduled = 0, fired = 0;
+        while (now < origin + std::chrono::seconds(3000)) {
+            for (int i = 0; i < 20; ++i) {
+                auto delay = microseconds(next(2'000'000'000));
+                const Clock::time_point deadline = now + delay;
+                const Clock::time_point* last = &now;
+                wheel.schedule(delay, [&wheel, &fired, deadline, last]() {
+                    Clock::time_point fired_at = wheel.now() - wheel.tick();
+                    assert(*last >= deadline);
+                    assert(fired_at >= deadline && fired_at <= deadline + 2 * wheel.tick());
+                    ++fired;
+                });
+                ++scheduled;
+            }
+            now += microseconds(next(60'000'000));
+            wheel.advance(now);
+        }
+        now += std::chrono::seconds(2100);
+        wheel.advance(now);
+        assert(fired == scheduled && wheel.size() == 0);
+    }
+    std::cout << "testTimerWheel PASSED" << std::endl;
+}
+
+void testCallPolicy() {
+    std::cout << "--- Running testCallPolicy ---" << std::endl;
+    using std::chrono::milliseconds;
+
+    // yԇ1˱ [0, min(max_backoff, initial * multiplier^attempt)] , Δܴr max_backoff
+    CallPolicy policy;
+    policy.initial_backoff = milliseconds(10);
+    policy.max_backoff = milliseconds(1000);
+    policy.backoff_multiplier = 2.0;
+    for (uint32_t attempt : { 0u, 1u, 3u }) {
+        const auto ceiling = milliseconds(10 << attempt);
+        for (int i = 0; i < 200; ++i) {
+            auto wait = policy.backoff(attempt);
+            assert(wait >= milliseconds(0) && wait <= ceiling);
+        }
+    }
+    milliseconds longest{ 0 };
+    for (int i = 0; i < 1000; ++i) {
+        auto wait = policy.backoff(1000);
+        assert(wait <= policy.max_backoff);
+        longest = std::max(longest, wait);
+    }
+    assert(longest > milliseconds(500));
+
+    // yԇ2AʼM, ȡܽ^; 밴ӋҲ^
+    RetryBudget budget(0.5, 2.0);
+    assert(budget.tryWithdraw() && budget.tryWithdraw() && !budget.tryWithdraw());
+    budget.deposit();
+    assert(budget.tokens() == 0.5 && !budget.tryWithdraw());
+    budget.deposit();
+    assert(budget.tryWithdraw() && budget.tokens() == 0.0);
+    for (int i = 0; i < 10; ++i) {
+        budget.deposit();
+    }
+    assert(budget.tokens() == 2.0);
+
+    // yԇ3ӱ kMinSamples r fallback, ֮ᰴ kCapacity ӱoλ
+    LatencyWindow window;
+    const auto fallback = std::chrono::microseconds(777);
+    for (size_t i = 1; i < LatencyWindow::kMinSamples; ++i) {
+        window.record(std::chrono::microseconds(i));
+    }
+    assert(window.percentile(0.5, fallback) == fallback);
+    window.record(std::chrono::microseconds(LatencyWindow::kMinSamples));
+    assert(window.percentile(0.0, fallback) == std::chrono::microseconds(1));
+    assert(window.percentile(1.0, fallback) == std::chrono::microseconds(LatencyWindow::kMinSamples));
+    for (size_t i = 0; i < LatencyWindow::kCapacity; ++i) {
+        window.record(std::chrono::microseconds(1000 + i));
+    }
+    assert(window.percentile(0.0, fallback) == std::chrono::microseconds(1000));
+    assert(window.percentile(0.5, fallback) == std::chrono::microseconds(1000 + LatencyWindow::kCapacity / 2));
+    std::cout << "testCallPolicy PASSED" << std::endl;
+}
+
+void testHedgedCall() {
+    std::cout << "--- Running testHedgedCall ---" << std::endl;
+    constexpr uint32_t kService = 46;
+    std::promise<void> slow_gate, open_gate;
+    open_gate.set_value();
+    RpcServer slow_server(1), fast_server(1);
+    slow_server.registerService(kService, std::make_unique<GateService>(slow_gate.get_future().share()));
+    fast_server.registerService(kService, std::make_unique<GateService>(open_gate.get_future().share()));
+
+    // ɂһl connect_pair B, һ method 1  gate 
+    boost::asio::io_context server_ioc;
+    boost::asio::io_context client_ioc;
+    TimerWheel wheel;
+    std::vector<std::shared_ptr<AsyncRpcClient>> replicas;
+    for (RpcServer* server : { &slow_server, &fast_server }) {
+        boost::asio::local::stream_protocol::socket server_socket(server_ioc);
+        boost::asio::local::stream_protocol::socket client_socket(client_ioc);
+        boost::asio::local::connect_pair(server_socket, client_socket);
+        std::make_shared<Session>(Session::socket_type(std::move(server_socket)), *server, wheel) -> start();
+        replicas.push_back(std::make_shared<AsyncRpcClient>(AsyncRpcClient::stream_protocol::socket(std::move(client_socket))));
+        replicas.back() -> start();
+    }
+    auto server_guard = boost::asio::make_work_guard(server_ioc);
+    auto client_guard = boost::asio::make_work_guard(client_ioc);
+    std::thread server_thread([&server_ioc]() { server_ioc.run(); });
+    std::thread client_thread([&client_ioc]() { client_ioc.run(); });
+
+    RpcClient unused_client(client_ioc);
+    RpcChannel channel(unused_client, kService);
+    CallPolicy policy;
+    policy.max_hedges = 1;
+    policy.initial_hedge_delay = std::chrono::milliseconds(20);
+    channel.setCallPolicy(1, policy);
+    channel.setReplicas(replicas);
+
+    // yԇ1^ntδ, nl츱Kٳ, {ñȡ
+    auto started = std::chrono::steady_clock::now();
+    PairRequest request{ 3, 4 };
+    PairRequest response = channel.callMethod<PairRequest, PairRequest>(1, request);
+    assert(response.a == 3 && response.b == 4);
+    assert(std::chrono::steady_clock::now() - started < std::chrono::seconds(2));
+    assert(channel.retryBudget().tokens() < 10.0);
+    for (int i = 0; i < 100 && replicas[0] -> pending() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(replicas[0] -> pending() == 0 && replicas[1] -> pending() == 0);
+
+    // yԇ2ĻظSᵽ_ҲֱӁG, Bճ
+    slow_gate.set_value();
+    std::promise<std::string> echoed;
+    replicas[0] -> call(kService, 2, "after", [&echoed](RpcStatus, const RpcHeader&, std::string_view payload, bool last) {
+        if (last) {
+            echoed.set_value(std::string(payload));
+        }
+    });
+    auto echoed_future = echoed.get_future();
+    assert(echoed_future.wait_for(std::chrono::seconds(5)) == std::future_status::ready && echoed_future.get() == "after");
+
+    // yԇ3ݔʧ (δBӵĿ͑)  UNAVAILABLE, ԇKA
+    RpcChannel broken(unused_client, kService);
+    CallPolicy retry;
+    retry.max_attempts = 3;
+    retry.initial_backoff = std::chrono::milliseconds(1);
+    broken.setCallPolicy(3, retry);
+    for (uint32_t method : { 2u, 3u }) {
+        bool unavailable = false;
+        try {
+            broken.callMethod<PairRequest, PairRequest>(method, request);
+        }
+        catch (const RpcError& e) {
+            unavailable = e.status() == RpcStatus::UNAVAILABLE;
+        }
+        assert(unavailable);
+    }
+    assert(broken.retryBudget().tokens() < 9.0);
+
+    for (auto& replica : replicas) {
+        replica -> close();
+    }
+    server_guard.reset();
+    client_guard.reset();
+    server_ioc.stop();
+    client_ioc.stop();
+    server_thread.join();
+    client_thread.join();
+    std::cout << "testHedgedCall PASSED" << std::endl;
+}
+
+// WPyԇõķ: 1 = Add (protobuf), 2 = ַĮ, 3 = ȴlTԭӷ, 4 = ؟o푑
+class GatewayTestService : public IService {
+public:
+    explicit GatewayTestService(std::shared_future<void> gate) : gate_(std::move(gate)) {}
+    std::string callMethod(uint32_t method_id, const std::string& request_body) override {
+        switch (method_id) {
+            case 1: {
+                rpc_demo::AddRequest request;
+                request.ParseFromString(request_body);
+                rpc_demo::AddResponse response;
+                response.set_result(request.a() + request.b());
+                return response.SerializeAsString();
+            }
+            case 2:
+                throw std::runtime_error("bad\x01\"quote\"\nline");
+            case 3:
+                entered.fetch_add(1);
+                gate_.wait();
+                return request_body;
+            default:
+                return std::string("\xff\xff\xff", 3);
+        }
+    }
+
+    std::atomic<int> entered{ 0 };
+
+private:
+    std::shared_future<void> gate_;
+};
+
+void testHttpGateway() {
+    std::cout << "--- Running testHttpGateway ---" << std::endl;
+    namespace http = boost::beast::http;
+    using boost::asio::ip::tcp;
+
+    std::promise<void> gate;
+    auto service = std::make_unique<GatewayTestService>(gate.get_future().share());
+    auto* gateway_service = service.get();
+    RpcServer server(24);
+    server.registerService(77, std::move(service));
+
+    HttpRouter router;
+    router.beginUpdate();
+    router.registerRoute("/add", 77, 1, rpc_demo::AddRequest::descriptor(), rpc_demo::AddResponse::descriptor());
+    router.registerRoute("/bad", 77, 2);
+    router.registerRoute("/gate", 77, 3);
+    router.registerRoute("/badreply", 77, 4, nullptr, rpc_demo::AddResponse::descriptor());
+    router.commit();
+
+    IoContextPool io_pool(1);
+    HttpGateway gateway(io_pool, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0), server, router);
+    std::thread io_thread([&io_pool]() { io_pool.run(); });
+
+    boost::asio::io_context client_ioc;
+    tcp::socket socket(client_ioc);
+    socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), gateway.port()));
+    boost::beast::flat_buffer buffer;
+
+    auto request = [](std::string_view method, std::string_view target, std::string_view body) {
+        std::string raw = std::string(method) + " " + std::string(target) + " HTTP/1.1\r\nHost: test\r\n";
+        raw += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        raw += body;
+        return raw;
+    };
+    auto readResponse = [&socket, &buffer]() {
+        http::response<http::string_body> res;
+        http::read(socket, buffer, res);
+        return res;
+    };
+
+    // yԇ1ͬһBˮlՈ, 푑Ո򷵻, Bӱֿ
+    boost::asio::write(socket, boost::asio::buffer(
+        request("POST", "/add", R"({"a":1,"b":2})") +
+        request("POST", "/add?debug=1", R"({"a":5,"b":7})") +
+        request("GET", "/missing", "")));
+    auto first = readResponse();
+    assert(first.result() == http::status::ok && first.body() == R"({"result":3})" && first.keep_alive());
+    auto second = readResponse();
+    assert(second.result() == http::status::ok && second.body() == R"({"result":12})");
+    auto third = readResponse();
+    assert(third.result() == http::status::not_found && third.body() == R"({"error":"route not found"})");
+    boost::asio::write(socket, boost::asio::buffer(request("POST", "/add", R"({"a":-4})")));
+    assert(readResponse().body() == R"({"result":-4})");
+
+    // yԇ2JSON c protobuf Daʧ: Ո JSON Ϸ 400, 푑o 500
+    boost::asio::write(socket, boost::asio::buffer(request("POST", "/add", "{not json")));
+    auto invalid = readResponse();
+    assert(invalid.result() == http::status::bad_request);
+    assert(invalid.body() == R"({"error":"invalid JSON request body"})");
+    boost::asio::write(socket, boost::asio::buffer(request("POST", "/badreply", "")));
+    auto unencodable = readResponse();
+    assert(unencodable.result() == http::status::internal_server_error);
+    assert(unencodable.body() == R"({"error":"failed to encode response"})");
+
+    // yԇ3Iծıe̖ͿַDx, e`wǺϷ JSON
+    boost::asio::write(socket, boost::asio::buffer(request("POST", "/bad", "")));
+    auto escaped = readResponse();
+    assert(escaped.result() == http::status::internal_server_error);
+    assert(escaped.body() == R"({"error":"bad\u0001\"quote\"\nline"})");
+
+    // yԇ4ˮ 16 Ո;, Ոǰ푑űxȡ
+    const int kPipelined = 20;
+    std::string burst;
+    for (int i = 0; i < kPipelined; ++i) {
+        burst += request("POST", "/gate", std::to_string(i));
+    }
+    boost::asio::write(socket, boost::asio::buffer(burst));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (gateway_service->entered.load() < 16 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    assert(gateway_service->entered.load() == 16);
+    gate.set_value();
+    for (int i = 0; i < kPipelined; ++i) {
+        auto res = readResponse();
+        assert(res.result() == http::status::ok && res.body() == std::to_string(i));
+    }
+    assert(gateway_service->entered.load() == kPipelined);
+
+    socket.close();
+    io_pool.stop();
+    io_thread.join();
+    std::cout << "testHttpGateway PASSED" << std::endl;
+}
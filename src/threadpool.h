@@ -13,9 +13,28 @@
 #include <utility>
 #include <memory>
 #include <tuple>
+#include <optional>
+#include <exception>
+#include <deque>
+#include <chrono>
+#include <bit>
+#include <cstdint>
+#include "rpc_log.h"
 
+// 线程池: 一个共享队列加上每个工作线程自己的优先队列
+// - enqueue / post 放进共享队列, 任意空闲线程都可以取走, 任务之间没有顺序保证; post 不创建 future, 给不关心结果的调用方用
+// - postTo 把任务交给指定线程优先执行, 目标线程空闲时直接唤醒它. 目标线程在忙时任务排队等它,
+//   排队超过 kStealAfter 后其它空闲线程可以偷走, 所以一个长任务最多把同一线程上排在后面的任务推迟 kStealAfter
+// - 线程在自己的队列和共享队列之间轮流取任务, 互相不会饿死
+// 空闲线程记在位图里, 进出空闲都是 O(1) 的位操作
+// 需要按提交顺序执行的一组任务用下面的 SerialQueue
 class ThreadPool {
 public:
+	using Clock = std::chrono::steady_clock;
+
+	// 优先线程一直在忙时, 任务最多等这么久就允许被其它线程偷走
+	static constexpr std::chrono::microseconds kStealAfter{ 1000 };
+
 	explicit ThreadPool(size_t threads_count = std::thread::hardware_concurrency());
 	~ThreadPool();
 
@@ -26,35 +45,84 @@ public:
 	auto enqueue(F&& f, Args&&... args)
 		-> std::future<std::invoke_result_t<F, Args...>>;
 
+	// 不需要结果的任务, 不分配 packaged_task / future; 任务抛出的异常记录日志后丢弃
+	void post(std::function<void()> task);
+
+	// 优先交给第 worker 个工作线程 (按线程数取模) 执行, 规则见类注释
+	void postTo(size_t worker, std::function<void()> task);
+
+	[[nodiscard]] size_t size() const noexcept { return workers_.size(); }
+
 private:
-	void worker_thread_loop();
+	struct PreferredTask {
+		std::function<void()> task;
+		Clock::time_point queued_at;
+	};
+
+	struct WorkerState {
+		std::deque<PreferredTask> tasks;	// 优先由本线程执行的任务
+		std::condition_variable condition;
+		bool last_was_preferred = false;	// 上一个任务取自自己的队列, 下一次先看共享队列
+	};
+
+	void worker_thread_loop(size_t index);
+	static void run(std::function<void()>& task) noexcept;
+
+	template<class F, class... Args>
+	auto package(F&& f, Args&&... args)
+		-> std::pair<std::function<void()>, std::future<std::invoke_result_t<F, Args...>>>;
+
+	// 以下函数调用方持有 queue_mutex_
+	bool takeTask(size_t index, std::function<void()>& task);
+	std::optional<Clock::time_point> nextStealTime(size_t index) const;
+	void wakeIdleWorker();
+	void setIdle(size_t index) noexcept { idle_bits_[index / 64] |= uint64_t{ 1 } << (index % 64); }
+	bool clearIdle(size_t index) noexcept;
 
 	std::vector<std::thread> workers_;
+	std::vector<std::unique_ptr<WorkerState>> states_;
 	std::queue<std::function<void()>> tasks_;
+	std::vector<uint64_t> idle_bits_;	// 第 i 位为 1 表示第 i 个线程正在等待任务
+	size_t preferred_pending_ = 0;		// 所有线程自己队列里的任务总数
 
 	std::mutex queue_mutex_;
-	std::condition_variable condition_;
 
 	std::atomic<bool> stop_; 
 };
 
+namespace threadpool_detail {
+	// 当前线程所属的线程池和下标, 用来识别工作线程给自己提交任务的情况
+	inline thread_local const ThreadPool* current_pool = nullptr;
+	inline thread_local size_t current_worker = 0;
+}
+
 inline ThreadPool::ThreadPool(size_t threads_count) : stop_(false) {
 	if (threads_count == 0) {
 		throw std::invalid_argument("ThreadPool constructor requires a thread count greater than 0.");
 	}
 
-	workers_.reserve(threads_count);
+	states_.reserve(threads_count);
+	for (size_t i = 0; i < threads_count; ++i) {
+		states_.push_back(std::make_unique<WorkerState>());
+	}
+	idle_bits_.assign((threads_count + 63) / 64, 0);
 
+	workers_.reserve(threads_count);
 	for (size_t i = 0; i < threads_count; ++i) {
-		workers_.emplace_back([this] {
-			this -> worker_thread_loop();
+		workers_.emplace_back([this, i] {
+			this -> worker_thread_loop(i);
 			});
 	}
 }
 
 inline ThreadPool::~ThreadPool() {
-	stop_.store(true);
-	condition_.notify_all();
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex_);
+		stop_.store(true);
+	}
+	for (auto& state : states_) {
+		state -> condition.notify_all();
+	}
 
 	for (std::thread& worker : workers_) {
 		if (worker.joinable()) {
@@ -63,40 +131,168 @@ inline ThreadPool::~ThreadPool() {
 	}
 }
 
-inline void ThreadPool::worker_thread_loop() {
+inline void ThreadPool::worker_thread_loop(size_t index) {
+	threadpool_detail::current_pool = this;
+	threadpool_detail::current_worker = index;
+	WorkerState& self = *states_[index];
+
 	while (true) {
 		std::function<void()> task;
 	
 		{
 			std::unique_lock<std::mutex> lock(queue_mutex_);
-			condition_.wait(lock, [this] {
-				return this->stop_.load() || !this->tasks_.empty();
-			});
-
-			if (stop_.load() && tasks_.empty()) {
-				return;
+			while (!takeTask(index, task)) {
+				if (stop_.load()) {
+					return;
+				}
+				setIdle(index);
+				// 别的线程队列里还有任务时只睡到最早的那个可以偷的时刻
+				if (auto steal_at = nextStealTime(index)) {
+					self.condition.wait_until(lock, *steal_at);
+				}
+				else {
+					self.condition.wait(lock);
+				}
 			}
+			clearIdle(index);
+		}
+
+		run(task);
+	}	
+}
+
+inline void ThreadPool::run(std::function<void()>& task) noexcept {
+	try {
+		task();
+	}
+	catch (const std::exception& e) {
+		CYFON_LOG_ERROR("ThreadPool task threw: {}", e.what());
+	}
+	catch (...) {
+		CYFON_LOG_ERROR("ThreadPool task threw an unknown exception");
+	}
+}
+
+inline bool ThreadPool::takeTask(size_t index, std::function<void()>& task) {
+	WorkerState& self = *states_[index];
 
-			task = std::move(this -> tasks_.front());
-			this -> tasks_.pop();
+	bool shared_first = self.last_was_preferred && !tasks_.empty();
+	if (!self.tasks.empty() && !shared_first) {
+		task = std::move(self.tasks.front().task);
+		self.tasks.pop_front();
+		--preferred_pending_;
+		self.last_was_preferred = true;
+		// 本线程可能是被共享任务唤醒的, 它先去做自己的任务, 共享任务交给别的空闲线程
+		if (!tasks_.empty()) {
+			wakeIdleWorker();
 		}
+		return true;
+	}
+	self.last_was_preferred = false;
+	if (!tasks_.empty()) {
+		task = std::move(tasks_.front());
+		tasks_.pop();
+		return true;
+	}
+	if (preferred_pending_ == 0) {
+		return false;
+	}
 
-		if (task) {
-			task();
+	// 偷别的线程排队最久、已超过 kStealAfter 的任务
+	auto now = Clock::now();
+	WorkerState* victim = nullptr;
+	for (size_t i = 0; i < states_.size(); ++i) {
+		WorkerState& other = *states_[i];
+		if (i == index || other.tasks.empty() || now - other.tasks.front().queued_at < kStealAfter) {
+			continue;
 		}
-	}	
+		if (!victim || other.tasks.front().queued_at < victim -> tasks.front().queued_at) {
+			victim = &other;
+		}
+	}
+	if (!victim) {
+		return false;
+	}
+	task = std::move(victim -> tasks.front().task);
+	victim -> tasks.pop_front();
+	--preferred_pending_;
+	return true;
 }
 
-template <class F, class... Args>
-auto ThreadPool::enqueue(F&& f, Args&&... args)
-  -> std::future<std::invoke_result_t<F, Args...>> {
-	
-	using return_type = std::invoke_result_t<F, Args...>;
+inline std::optional<ThreadPool::Clock::time_point> ThreadPool::nextStealTime(size_t index) const {
+	if (preferred_pending_ == 0) {
+		return std::nullopt;
+	}
+	std::optional<Clock::time_point> earliest;
+	for (size_t i = 0; i < states_.size(); ++i) {
+		const WorkerState& other = *states_[i];
+		if (i == index || other.tasks.empty()) {
+			continue;
+		}
+		auto steal_at = other.tasks.front().queued_at + kStealAfter;
+		if (!earliest || steal_at < *earliest) {
+			earliest = steal_at;
+		}
+	}
+	return earliest;
+}
+
+inline void ThreadPool::wakeIdleWorker() {
+	for (size_t word = 0; word < idle_bits_.size(); ++word) {
+		if (idle_bits_[word] == 0) {
+			continue;
+		}
+		size_t index = word * 64 + static_cast<size_t>(std::countr_zero(idle_bits_[word]));
+		clearIdle(index);
+		states_[index] -> condition.notify_one();
+		return;
+	}
+}
+
+inline bool ThreadPool::clearIdle(size_t index) noexcept {
+	uint64_t bit = uint64_t{ 1 } << (index % 64);
+	bool was_idle = (idle_bits_[index / 64] & bit) != 0;
+	idle_bits_[index / 64] &= ~bit;
+	return was_idle;
+}
+
+inline void ThreadPool::post(std::function<void()> task) {
+	std::unique_lock<std::mutex> lock(queue_mutex_);
 
 	if (stop_.load()) {
 		throw std::runtime_error("enqueue on stopped ThreadPool");
 	}
 
+	tasks_.emplace(std::move(task));
+	wakeIdleWorker();
+}
+
+inline void ThreadPool::postTo(size_t worker, std::function<void()> task) {
+	size_t index = worker % states_.size();
+	std::unique_lock<std::mutex> lock(queue_mutex_);
+
+	if (stop_.load()) {
+		throw std::runtime_error("enqueue on stopped ThreadPool");
+	}
+
+	states_[index] -> tasks.push_back({ std::move(task), Clock::now() });
+	++preferred_pending_;
+
+	if (clearIdle(index)) {
+		states_[index] -> condition.notify_one();
+	}
+	else if (threadpool_detail::current_pool != this || threadpool_detail::current_worker != index) {
+		// 目标线程在忙: 叫醒一个空闲线程, 它睡到任务可偷时再来检查; 工作线程给自己续的任务不需要
+		wakeIdleWorker();
+	}
+}
+
+template <class F, class... Args>
+auto ThreadPool::package(F&& f, Args&&... args)
+  -> std::pair<std::function<void()>, std::future<std::invoke_result_t<F, Args...>>> {
+
+	using return_type = std::invoke_result_t<F, Args...>;
+
 	auto task = std::make_shared<std::packaged_task<return_type()>>(
 		[func = std::forward<F>(f), t = std::make_tuple(std::forward<Args>(args)...)]() mutable -> return_type {
 			return std::apply(std::move(func), std::move(t));
@@ -104,6 +300,18 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 	);
 
 	std::future<return_type> res = task -> get_future();
+	return { [task]() { (*task)(); }, std::move(res) };
+}
+
+template <class F, class... Args>
+auto ThreadPool::enqueue(F&& f, Args&&... args)
+  -> std::future<std::invoke_result_t<F, Args...>> {
+
+	if (stop_.load()) {
+		throw std::runtime_error("enqueue on stopped ThreadPool");
+	}
+
+	auto [task, res] = package(std::forward<F>(f), std::forward<Args>(args)...);
 
 	{
 		std::unique_lock<std::mutex> lock(queue_mutex_);
@@ -112,10 +320,92 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 			throw std::runtime_error("enqueue on stopped ThreadPool");
 		}
 
-		tasks_.emplace([task]() { (*task)(); });
+		tasks_.emplace(std::move(task));
+		wakeIdleWorker();
 	}
 
-	condition_.notify_one();
-	return res;
+	return std::move(res);
 }
 
+// 串行队列 (strand): 提交到同一个队列的任务按顺序逐个执行, 前一个任务的写入对后一个可见, 不需要另外加锁
+// - 不指定 worker 时每一段任务经 post 由任意空闲的工作线程接手
+// - 指定 worker 时每一段经 postTo 优先交给这个线程, 队列访问的数据尽量留在同一个核的缓存里;
+//   这个线程被别的长任务占住时, 队列最多等 ThreadPool::kStealAfter 就由其它线程接手
+// 一个队列上的长任务只推迟它自己后面的任务. 每段最多执行 kMaxBatch 个任务, 剩下的重新排队, 不长期占着一个工作线程
+class SerialQueue : public std::enable_shared_from_this<SerialQueue> {
+public:
+	explicit SerialQueue(ThreadPool& pool, std::optional<size_t> worker = std::nullopt)
+		: pool_(pool), worker_(worker) {}
+
+	SerialQueue(const SerialQueue&) = delete;
+	SerialQueue& operator=(const SerialQueue&) = delete;
+
+	// 只能对 shared_ptr 管理的队列调用; 队列在所有任务执行完之前保持存活
+	void post(std::function<void()> task);
+
+private:
+	void schedule();
+	void drain();
+
+	static constexpr size_t kMaxBatch = 16;
+
+	ThreadPool& pool_;
+	std::optional<size_t> worker_;	// 优先的工作线程, 为空表示不指定
+	std::mutex mutex_;
+	std::queue<std::function<void()>> tasks_;
+	bool scheduled_ = false;	// 已有一段 drain 在线程池中排队或执行
+};
+
+inline void SerialQueue::post(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push(std::move(task));
+		if (scheduled_) {
+			return;
+		}
+		scheduled_ = true;
+	}
+	schedule();
+}
+
+inline void SerialQueue::schedule() {
+	if (worker_) {
+		pool_.postTo(*worker_, [self = shared_from_this()]() { self -> drain(); });
+	}
+	else {
+		pool_.post([self = shared_from_this()]() { self -> drain(); });
+	}
+}
+
+inline void SerialQueue::drain() {
+	// 一次取出一批, 整批只加一次锁
+	std::vector<std::function<void()>> batch;
+	batch.reserve(kMaxBatch);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		while (!tasks_.empty() && batch.size() < kMaxBatch) {
+			batch.push_back(std::move(tasks_.front()));
+			tasks_.pop();
+		}
+	}
+	for (auto& task : batch) {
+		// 任务抛出的异常不会中断队列, 只记录下来; 需要回报错误的任务应自己捕获
+		try {
+			task();
+		}
+		catch (const std::exception& e) {
+			CYFON_LOG_ERROR("SerialQueue task threw: {}", e.what());
+		}
+		catch (...) {
+			CYFON_LOG_ERROR("SerialQueue task threw an unknown exception");
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (tasks_.empty()) {
+			scheduled_ = false;
+			return;
+		}
+	}
+	schedule();
+}
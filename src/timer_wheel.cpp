@@ -0,0 +1,167 @@
+#include "timer_wheel.h"
+#include <algorithm>
+#include <cassert>
+
+namespace cyfon_rpc {
+
+	TimerWheel::TimerWheel(Clock::duration tick, Clock::time_point now)
+		: tick_(tick), origin_(now) {
+		assert(tick_.count() > 0);
+		slots_.fill(kNil);
+	}
+
+	TimerWheel::TimerId TimerWheel::schedule(Clock::duration delay, Callback callback) {
+		uint64_t ticks = delay.count() <= 0 ? 1 : static_cast<uint64_t>((delay + tick_ - Clock::duration(1)) / tick_);
+		ticks = std::clamp<uint64_t>(ticks, 1, kMaxTicks);
+
+		uint32_t index;
+		if (free_head_ != kNil) {
+			index = free_head_;
+			free_head_ = entries_[index].next;
+		}
+		else {
+			index = static_cast<uint32_t>(entries_.size());
+			entries_.emplace_back();
+		}
+
+		Entry& entry = entries_[index];
+		// current_tick_ 是下一个待处理的 tick, 从它开始计数保证不会提前触发, 最多晚两个 tick
+		entry.expires = current_tick_ + ticks;
+		entry.callback = std::move(callback);
+		link(index);
+		++active_;
+		return { index, entry.generation };
+	}
+
+	bool TimerWheel::cancel(TimerId id) {
+		if (!pending(id)) {
+			return false;
+		}
+		unlink(id.index);
+		release(id.index);
+		return true;
+	}
+
+	bool TimerWheel::pending(TimerId id) const noexcept {
+		return id.index < entries_.size() &&
+			entries_[id.index].generation == id.generation &&
+			entries_[id.index].slot != kNil;
+	}
+
+	void TimerWheel::advance(Clock::time_point now) {
+		if (now < origin_) {
+			return;
+		}
+		const uint64_t target = static_cast<uint64_t>((now - origin_) / tick_);
+
+		while (current_tick_ <= target) {
+			const uint32_t index = static_cast<uint32_t>(current_tick_ & (kRootSize - 1));
+			// 第 0 层转完一圈, 从高层下沉一个槽
+			if (index == 0) {
+				for (unsigned level = 1; level < kLevels; ++level) {
+					cascade(level);
+					uint64_t level_index = (current_tick_ >> (kRootBits + (level - 1) * kLevelBits)) & (kLevelSize - 1);
+					if (level_index != 0) {
+						break;
+					}
+				}
+			}
+			++current_tick_;
+
+			// 先把到期槽整体移到执行链表, 回调里新加的定时器不会落进本轮;
+			// 执行时每次从链表头取一个, 回调中取消同一批的其它定时器也是安全的
+			uint32_t entry_index = slots_[index];
+			slots_[index] = kNil;
+			while (entry_index != kNil) {
+				uint32_t next = entries_[entry_index].next;
+				pushFront(kFiringSlot, entry_index);
+				entry_index = next;
+			}
+
+			while (slots_[kFiringSlot] != kNil) {
+				entry_index = slots_[kFiringSlot];
+				unlink(entry_index);
+				Callback callback = std::move(entries_[entry_index].callback);
+				release(entry_index);
+				if (callback) {
+					callback();
+				}
+			}
+		}
+	}
+
+	uint32_t TimerWheel::slotFor(uint64_t expires) const {
+		// 已经过期的放到下一个要处理的槽
+		const uint64_t base = current_tick_;
+		if (expires < base) {
+			expires = base;
+		}
+		const uint64_t delta = expires - base;
+		if (delta < kRootSize) {
+			return static_cast<uint32_t>(expires & (kRootSize - 1));
+		}
+		for (unsigned level = 1; level < kLevels; ++level) {
+			const unsigned shift = kRootBits + level * kLevelBits;
+			if (delta < (uint64_t{ 1 } << shift) || level == kLevels - 1) {
+				const unsigned level_shift = kRootBits + (level - 1) * kLevelBits;
+				return kRootSize + (level - 1) * kLevelSize +
+					static_cast<uint32_t>((expires >> level_shift) & (kLevelSize - 1));
+			}
+		}
+		return kNil;
+	}
+
+	void TimerWheel::cascade(unsigned level) {
+		const unsigned level_shift = kRootBits + (level - 1) * kLevelBits;
+		const uint32_t slot = kRootSize + (level - 1) * kLevelSize +
+			static_cast<uint32_t>((current_tick_ >> level_shift) & (kLevelSize - 1));
+
+		uint32_t entry_index = slots_[slot];
+		slots_[slot] = kNil;
+		while (entry_index != kNil) {
+			uint32_t next = entries_[entry_index].next;
+			link(entry_index);
+			entry_index = next;
+		}
+	}
+
+	void TimerWheel::link(uint32_t index) {
+		pushFront(slotFor(entries_[index].expires), index);
+	}
+
+	void TimerWheel::pushFront(uint32_t slot, uint32_t index) {
+		Entry& entry = entries_[index];
+		entry.slot = slot;
+		entry.prev = kNil;
+		entry.next = slots_[slot];
+		if (entry.next != kNil) {
+			entries_[entry.next].prev = index;
+		}
+		slots_[slot] = index;
+	}
+
+	void TimerWheel::unlink(uint32_t index) {
+		Entry& entry = entries_[index];
+		if (entry.prev != kNil) {
+			entries_[entry.prev].next = entry.next;
+		}
+		else {
+			slots_[entry.slot] = entry.next;
+		}
+		if (entry.next != kNil) {
+			entries_[entry.next].prev = entry.prev;
+		}
+		entry.prev = kNil;
+		entry.next = kNil;
+		entry.slot = kNil;
+	}
+
+	void TimerWheel::release(uint32_t index) {
+		Entry& entry = entries_[index];
+		entry.callback = nullptr;
+		++entry.generation;
+		entry.next = free_head_;
+		free_head_ = index;
+		--active_;
+	}
+}
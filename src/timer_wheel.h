@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cyfon_rpc {
+
+	// 分层哈希时间轮 (与 Linux 经典定时器相同的 8/6/6/6 位布局)
+	// - 第 0 层 256 个槽, 每槽一个 tick; 第 1~3 层各 64 个槽, 每层跨度是下一层的 64 倍
+	// - 添加和取消都是 O(1), 每 tick 只处理当前槽, 低层转完一圈时把高层对应槽下沉一层
+	// - 定时器条目放在连续数组里用下标串成双向链表, 释放的条目进入空闲链表复用, 稳定后不再分配
+	// 非线程安全: 每个 I/O 线程一个实例, 只在所属线程上调用
+	class TimerWheel {
+	public:
+		using Clock = std::chrono::steady_clock;
+		using Callback = std::function<void()>;
+
+		// 定时器句柄; 定时器触发或取消后句柄失效, 对失效句柄 cancel 是空操作
+		struct TimerId {
+			uint32_t index = UINT32_MAX;
+			uint32_t generation = 0;
+
+			explicit operator bool() const noexcept { return index != UINT32_MAX; }
+		};
+
+		explicit TimerWheel(Clock::duration tick = std::chrono::milliseconds(10), Clock::time_point now = Clock::now());
+
+		TimerWheel(const TimerWheel&) = delete;
+		TimerWheel& operator=(const TimerWheel&) = delete;
+
+		// delay 向上取整到 tick, 至少一个 tick 后触发
+		TimerId schedule(Clock::duration delay, Callback callback);
+
+		// 返回 true 表示定时器在触发前被取消
+		bool cancel(TimerId id);
+
+		// 定时器是否仍在等待触发
+		[[nodiscard]] bool pending(TimerId id) const noexcept;
+
+		// 推进到 now, 依次执行所有到期的回调; 回调里可以继续 schedule / cancel
+		void advance(Clock::time_point now);
+
+		// 最近一次 advance 时的时间, 精度为一个 tick, 可用来代替 Clock::now() 记录活跃时间
+		[[nodiscard]] Clock::time_point now() const noexcept { return origin_ + tick_ * static_cast<int64_t>(current_tick_); }
+		[[nodiscard]] Clock::duration tick() const noexcept { return tick_; }
+		[[nodiscard]] size_t size() const noexcept { return active_; }
+
+	private:
+		static constexpr unsigned kRootBits = 8;
+		static constexpr unsigned kLevelBits = 6;
+		static constexpr unsigned kLevels = 4;
+		static constexpr uint32_t kRootSize = 1u << kRootBits;
+		static constexpr uint32_t kLevelSize = 1u << kLevelBits;
+		static constexpr uint32_t kSlotCount = kRootSize + (kLevels - 1) * kLevelSize;
+		static constexpr uint32_t kFiringSlot = kSlotCount;	// 当前 tick 正在执行的定时器
+		static constexpr uint64_t kMaxTicks = (uint64_t{ 1 } << (kRootBits + (kLevels - 1) * kLevelBits)) - 1;
+		static constexpr uint32_t kNil = UINT32_MAX;
+
+		struct Entry {
+			uint32_t prev = kNil;
+			uint32_t next = kNil;
+			uint32_t slot = kNil;			// 所在槽, kNil 表示空闲
+			uint32_t generation = 0;
+			uint64_t expires = 0;			// 到期 tick
+			Callback callback;
+		};
+
+		void link(uint32_t index);
+		void pushFront(uint32_t slot, uint32_t index);
+		void unlink(uint32_t index);
+		void release(uint32_t index);
+		void cascade(unsigned level);
+		uint32_t slotFor(uint64_t expires) const;
+
+		Clock::duration tick_;
+		Clock::time_point origin_;
+		uint64_t current_tick_ = 0;		// 下一个待处理的 tick
+
+		std::array<uint32_t, kSlotCount + 1> slots_;	// 每个槽的链表头
+		std::vector<Entry> entries_;
+		uint32_t free_head_ = kNil;
+		size_t active_ = 0;
+	};
+}
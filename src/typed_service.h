@@ -0,0 +1,135 @@
+#pragma once
+
+#include "message_codec.h"
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace cyfon_rpc {
+
+	// ===== 编译期类型化服务定义 =====
+	// 服务定义是一个普通结构体, 客户端和服务端共用:
+	//
+	//   struct Calculator {
+	//       static constexpr std::string_view kName = "CalculatorService";
+	//       using Add = RpcMethod<"Add", rpc_demo::AddRequest, rpc_demo::AddResponse>;
+	//       using Subtract = RpcMethod<"Subtract", rpc_demo::SubtractRequest, rpc_demo::SubtractResponse>;
+	//       using Methods = MethodList<Add, Subtract>;
+	//   };
+	//
+	// 服务端实现为每个方法提供一个 handle 重载, 不需要继承 IService:
+	//
+	//   struct CalculatorImpl {
+	//       rpc_demo::AddResponse handle(Calculator::Add, const rpc_demo::AddRequest& request);
+	//       rpc_demo::SubtractResponse handle(Calculator::Subtract, const rpc_demo::SubtractRequest& request);
+	//   };
+	//   server.registerService<Calculator>(std::make_unique<CalculatorImpl>());
+	//
+	// 缺少某个方法的实现、请求/响应类型不匹配或方法ID冲突都在编译期报错;
+	// 服务和方法ID是名字的 32 位 FNV-1a, 编译期算出, 两端一致
+
+	constexpr uint32_t fnv1a(std::string_view text) noexcept {
+		uint32_t hash = 2166136261u;
+		for (char c : text) {
+			hash ^= static_cast<uint8_t>(c);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// 可作为模板参数的字符串字面量
+	template <size_t N>
+	struct FixedString {
+		char data[N]{};
+
+		constexpr FixedString(const char (&text)[N]) {
+			for (size_t i = 0; i < N; ++i) {
+				data[i] = text[i];
+			}
+		}
+
+		[[nodiscard]] constexpr std::string_view view() const noexcept { return { data, N - 1 }; }
+	};
+
+	// 一个普通 (一问一答) 方法的描述: 名字、请求类型、响应类型; 消息可以是任何有 MessageCodec 的类型
+	template <FixedString Name, WireMessage Request_, WireMessage Response_>
+	struct RpcMethod {
+		using Request = Request_;
+		using Response = Response_;
+		static constexpr std::string_view kName = Name.view();
+		static constexpr uint32_t kId = fnv1a(kName);
+	};
+
+	template <typename... Methods>
+	struct MethodList {
+		static constexpr size_t size = sizeof...(Methods);
+	};
+
+	// 方法描述的编译期特征
+	template <typename M>
+	concept RpcMethodDef = requires {
+		typename M::Request;
+		typename M::Response;
+		{ M::kName } -> std::convertible_to<std::string_view>;
+		{ M::kId } -> std::convertible_to<uint32_t>;
+	} && WireMessage<typename M::Request> && WireMessage<typename M::Response>;
+
+	namespace detail {
+		template <typename List>
+		struct IsMethodList : std::false_type {};
+		template <typename... Methods>
+		struct IsMethodList<MethodList<Methods...>> : std::bool_constant<(RpcMethodDef<Methods> && ...)> {};
+
+		template <typename... Methods>
+		constexpr bool uniqueIds(MethodList<Methods...>) {
+			constexpr uint32_t ids[] = { Methods::kId..., 0 };
+			for (size_t i = 0; i < sizeof...(Methods); ++i) {
+				for (size_t j = i + 1; j < sizeof...(Methods); ++j) {
+					if (ids[i] == ids[j]) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		template <typename M, typename... Methods>
+		constexpr bool contains(MethodList<Methods...>) {
+			return (std::is_same_v<M, Methods> || ...);
+		}
+
+	}
+
+	// Impl 实现了方法 M: Response handle(M, const Request&)
+	template <typename Impl, typename M>
+	concept HandlesMethod = RpcMethodDef<M> && requires(Impl& impl, const typename M::Request& request) {
+		{ impl.handle(M{}, request) } -> std::same_as<typename M::Response>;
+	};
+
+	namespace detail {
+		template <typename Impl, typename... Methods>
+		constexpr bool implementsAll(MethodList<Methods...>) {
+			return (HandlesMethod<Impl, Methods> && ...);
+		}
+	}
+
+	// 服务定义: 有名字, Methods 是 RpcMethod 的列表, 且方法ID互不相同
+	template <typename S>
+	concept TypedServiceDef = requires {
+		{ S::kName } -> std::convertible_to<std::string_view>;
+		typename S::Methods;
+	} && detail::IsMethodList<typename S::Methods>::value && (detail::uniqueIds(typename S::Methods{}));
+
+	template <typename S, typename M>
+	concept ServiceMethod = TypedServiceDef<S> && detail::contains<M>(typename S::Methods{});
+
+	// Impl 为 S 的每个方法都提供了 Response handle(Method, const Request&)
+	template <typename Impl, typename S>
+	concept ServiceImplFor = TypedServiceDef<S> && detail::implementsAll<Impl>(typename S::Methods{});
+
+	template <TypedServiceDef S>
+	inline constexpr uint32_t service_id_v = fnv1a(S::kName);
+}